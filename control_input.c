@@ -0,0 +1,613 @@
+/*
+ * Control Input Implementation - Input Thread for Keys, Remotes and UDP
+ *
+ * Every source is read on one thread that sleeps in poll(). Terminal bytes
+ * and network commands are translated into evdev key codes, so a keypad, a
+ * remote, the keyboard and the network all go through one key map. A burst
+ * of events (a held arrow key, a scripted sequence of corner moves) is
+ * applied to the warp parameters one by one, which is cheap, and published
+ * once after the burst: the homography is solved and the blend baked here,
+ * and the render thread only ever picks up the finished result.
+ *
+ * Key devices are only grabbed when asked to (grab_evdev), since a grab takes
+ * them from every other reader. Without it, full keyboards are left to the
+ * terminal reader while it runs: a USB keyboard on the console also types
+ * into the terminal, which would deliver each key a second time.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "control_input.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <endian.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/input.h>
+
+/* Key devices opened at most */
+#define CONTROL_INPUT_MAX_DEVICES  8
+/* Retry period while the render thread still holds the previous warp */
+#define PUBLISH_RETRY_MS           5
+/* Largest control datagram */
+#define CONTROL_DATAGRAM_SIZE      512
+
+/* Bits in a key capability mask */
+#define KEY_BITS_LONGS   ((KEY_MAX + 8 * sizeof(long)) / (8 * sizeof(long)))
+#define KEY_BIT(bits, k) (((bits)[(k) / (8 * sizeof(long))] >> ((k) % (8 * sizeof(long)))) & 1)
+
+/* Internal control input context */
+struct control_input {
+    control_input_config_t config;
+    
+    /* Sources (-1 = not open) */
+    int udp_sock;
+    int devices[CONTROL_INPUT_MAX_DEVICES];
+    int device_count;
+    int ctrl_down;            /* Ctrl held on a grabbed keyboard (Ctrl+C quits) */
+    
+    /* Input thread */
+    pthread_t thread;
+    int thread_started;
+    int stop_fd;
+    
+    /* Player actions for the render thread (atomics) and their wake-up */
+    int notify_fd;
+    int quit;
+    int seek_steps;
+    int chapter_steps;
+    int posted;               /* Input thread: actions added this wake-up */
+};
+
+/* Control command names that stand for a key */
+static const struct {
+    const char *name;
+    int key;
+} command_keys[] = {
+    { "up", KEY_UP }, { "down", KEY_DOWN }, { "left", KEY_LEFT }, { "right", KEY_RIGHT },
+    { "reset", KEY_R }, { "fine", KEY_F }, { "save", KEY_S }, { "load", KEY_L },
+    { "quit", KEY_Q },
+};
+
+/**
+ * Create control input context
+ */
+control_input_t *control_input_create(void) {
+    control_input_t *ctx = calloc(1, sizeof(control_input_t));
+    if (!ctx) {
+        fprintf(stderr, "Failed to allocate control input context\n");
+        return NULL;
+    }
+    
+    ctx->udp_sock = -1;
+    ctx->stop_fd = -1;
+    ctx->notify_fd = -1;
+    return ctx;
+}
+
+/**
+ * Apply a warp action (ignored when there is no warp to edit)
+ */
+static void warp_action(control_input_t *ctx, warp_action_type_t type, int corner, float x, float y) {
+    warp_action_t action = { .type = type, .corner = corner, .x = x, .y = y };
+    
+    if (ctx->config.warp) {
+        warp_control_apply_action(ctx->config.warp, &action);
+    }
+}
+
+/**
+ * Queue a player action for the render thread
+ */
+static void post_action(control_input_t *ctx, int quit, int seek_steps, int chapter_steps) {
+    if (quit) {
+        __atomic_store_n(&ctx->quit, 1, __ATOMIC_RELEASE);
+    }
+    __atomic_add_fetch(&ctx->seek_steps, seek_steps, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&ctx->chapter_steps, chapter_steps, __ATOMIC_RELEASE);
+    ctx->posted = 1;
+}
+
+/**
+ * One key press (auto-repeats only move corners and seek)
+ */
+static void handle_key(control_input_t *ctx, int key, int repeat) {
+    switch (key) {
+        case KEY_UP:    warp_action(ctx, WARP_ACTION_NUDGE, 0, 0.0f, -1.0f); return;
+        case KEY_DOWN:  warp_action(ctx, WARP_ACTION_NUDGE, 0, 0.0f, 1.0f); return;
+        case KEY_LEFT:  warp_action(ctx, WARP_ACTION_NUDGE, 0, -1.0f, 0.0f); return;
+        case KEY_RIGHT: warp_action(ctx, WARP_ACTION_NUDGE, 0, 1.0f, 0.0f); return;
+        
+        case KEY_COMMA:
+        case KEY_REWIND:      post_action(ctx, 0, -1, 0); return;
+        case KEY_DOT:
+        case KEY_FASTFORWARD: post_action(ctx, 0, 1, 0); return;
+    }
+    
+    if (repeat) {
+        return;
+    }
+    
+    switch (key) {
+        case KEY_1: case KEY_KP1: warp_action(ctx, WARP_ACTION_SELECT, 0, 0.0f, 0.0f); break;
+        case KEY_2: case KEY_KP2: warp_action(ctx, WARP_ACTION_SELECT, 1, 0.0f, 0.0f); break;
+        case KEY_3: case KEY_KP3: warp_action(ctx, WARP_ACTION_SELECT, 2, 0.0f, 0.0f); break;
+        case KEY_4: case KEY_KP4: warp_action(ctx, WARP_ACTION_SELECT, 3, 0.0f, 0.0f); break;
+        
+        case KEY_R: warp_action(ctx, WARP_ACTION_RESET, 0, 0.0f, 0.0f); break;
+        case KEY_F: warp_action(ctx, WARP_ACTION_FINE, 0, 0.0f, 0.0f); break;
+        case KEY_S: warp_action(ctx, WARP_ACTION_SAVE, 0, 0.0f, 0.0f); break;
+        case KEY_L: warp_action(ctx, WARP_ACTION_LOAD, 0, 0.0f, 0.0f); break;
+        
+        case KEY_P:
+        case KEY_PREVIOUSSONG: post_action(ctx, 0, 0, -1); break;
+        case KEY_N:
+        case KEY_NEXTSONG:     post_action(ctx, 0, 0, 1); break;
+        
+        case KEY_C:
+            if (ctx->ctrl_down) {
+                post_action(ctx, 1, 0, 0);  /* A grab keeps SIGINT from the terminal */
+            }
+            break;
+        
+        case KEY_Q:
+        case KEY_ESC:
+        case KEY_EXIT:
+        case KEY_STOP:
+            post_action(ctx, 1, 0, 0);
+            break;
+    }
+}
+
+/**
+ * Terminal byte -> key code (0 = not a control key)
+ */
+static int key_from_char(char c) {
+    switch (c) {
+        case '1': return KEY_1;
+        case '2': return KEY_2;
+        case '3': return KEY_3;
+        case '4': return KEY_4;
+        case 'r': case 'R': return KEY_R;
+        case 'f': case 'F': return KEY_F;
+        case 's': case 'S': return KEY_S;
+        case 'l': case 'L': return KEY_L;
+        case 'p': case 'P': return KEY_P;
+        case 'n': case 'N': return KEY_N;
+        case 'q': case 'Q': return KEY_Q;
+        case ',': return KEY_COMMA;
+        case '.': return KEY_DOT;
+        default:  return 0;
+    }
+}
+
+/**
+ * Read the raw terminal: plain keys and ESC [ A-D arrow sequences
+ */
+static void read_stdin(control_input_t *ctx) {
+    char buf[64];
+    ssize_t len;
+    
+    while ((len = read(STDIN_FILENO, buf, sizeof(buf))) > 0) {
+        for (ssize_t i = 0; i < len; i++) {
+            if (buf[i] != 27) {
+                handle_key(ctx, key_from_char(buf[i]), 0);
+                continue;
+            }
+            
+            /* An escape sequence arrives in one read; a lone ESC quits */
+            if (i + 2 < len && buf[i + 1] == '[') {
+                static const int arrows[4] = { KEY_UP, KEY_DOWN, KEY_RIGHT, KEY_LEFT };
+                if (buf[i + 2] >= 'A' && buf[i + 2] <= 'D') {
+                    handle_key(ctx, arrows[buf[i + 2] - 'A'], 0);
+                }
+                i += 2;
+            } else {
+                handle_key(ctx, KEY_ESC, 0);
+            }
+        }
+        
+        /* VMIN=0 terminals return 0 once drained */
+        if (len < (ssize_t)sizeof(buf)) {
+            break;
+        }
+    }
+}
+
+/**
+ * Read one key device (returns negative once it is gone)
+ */
+static int read_device(control_input_t *ctx, int fd) {
+    struct input_event events[16];
+    ssize_t len;
+    
+    while ((len = read(fd, events, sizeof(events))) > 0) {
+        for (size_t i = 0; i < (size_t)len / sizeof(events[0]); i++) {
+            const struct input_event *ev = &events[i];
+            
+            if (ev->type != EV_KEY) {
+                continue;
+            }
+            if (ev->code == KEY_LEFTCTRL || ev->code == KEY_RIGHTCTRL) {
+                ctx->ctrl_down = ev->value != 0;
+            } else if (ev->value == 1 || ev->value == 2) {
+                handle_key(ctx, ev->code, ev->value == 2);
+            }
+        }
+    }
+    
+    return (len < 0 && errno == ENODEV) ? CONTROL_INPUT_ERROR : CONTROL_INPUT_OK;
+}
+
+/**
+ * One text command line
+ */
+static void handle_command(control_input_t *ctx, const char *line) {
+    char name[16];
+    int used = 0, corner, steps;
+    float x, y;
+    
+    if (sscanf(line, "%15s%n", name, &used) != 1) {
+        return;
+    }
+    line += used;
+    
+    for (size_t i = 0; i < sizeof(command_keys) / sizeof(command_keys[0]); i++) {
+        if (strcmp(name, command_keys[i].name) == 0) {
+            handle_key(ctx, command_keys[i].key, 0);
+            return;
+        }
+    }
+    
+    if (strcmp(name, "corner") == 0) {
+        int n = sscanf(line, "%d %f %f", &corner, &x, &y);
+        if (n == 3) {
+            warp_action(ctx, WARP_ACTION_SET_CORNER, corner - 1, x, y);
+        } else if (n == 1) {
+            warp_action(ctx, WARP_ACTION_SELECT, corner - 1, 0.0f, 0.0f);
+        }
+    } else if (strcmp(name, "seek") == 0 || strcmp(name, "chapter") == 0) {
+        if (sscanf(line, "%d", &steps) != 1) {
+            steps = 1;
+        }
+        post_action(ctx, 0, name[0] == 's' ? steps : 0, name[0] == 'c' ? steps : 0);
+    } else {
+        printf("⚠ Unknown control command: %s\n", name);
+    }
+}
+
+/**
+ * OSC message -> text command ("/pickle/corner ,iff 1 0.5 0.5" -> "corner 1 0.5 0.5")
+ */
+static int osc_to_text(const char *msg, size_t len, char *text, size_t size) {
+    size_t prefix = strlen(CONTROL_INPUT_OSC_PREFIX);
+    size_t addr_len = strnlen(msg, len);
+    size_t pos, out;
+    
+    if (addr_len == len || strncmp(msg, CONTROL_INPUT_OSC_PREFIX, prefix) != 0) {
+        return CONTROL_INPUT_ERROR;
+    }
+    out = (size_t)snprintf(text, size, "%s", msg + prefix);
+    
+    /* Strings are NUL-terminated and padded to 4 bytes; no type tags = no arguments */
+    pos = (addr_len + 4) & ~(size_t)3;
+    if (pos >= len || msg[pos] != ',') {
+        return CONTROL_INPUT_OK;
+    }
+    
+    const char *tags = msg + pos + 1;
+    size_t tags_len = strnlen(msg + pos, len - pos);
+    if (tags_len == len - pos) {
+        return CONTROL_INPUT_ERROR;
+    }
+    pos = (pos + tags_len + 4) & ~(size_t)3;
+    
+    for (; *tags && out < size; tags++) {
+        uint32_t word;
+        
+        if (*tags == 's') {
+            size_t str_len = pos < len ? strnlen(msg + pos, len - pos) : 0;
+            if (pos >= len || str_len == len - pos) {
+                return CONTROL_INPUT_ERROR;
+            }
+            out += (size_t)snprintf(text + out, size - out, " %s", msg + pos);
+            pos = (pos + str_len + 4) & ~(size_t)3;
+            continue;
+        }
+        
+        if ((*tags != 'i' && *tags != 'f') || pos + 4 > len) {
+            return CONTROL_INPUT_ERROR;
+        }
+        memcpy(&word, msg + pos, sizeof(word));
+        word = be32toh(word);
+        pos += 4;
+        
+        if (*tags == 'i') {
+            out += (size_t)snprintf(text + out, size - out, " %d", (int32_t)word);
+        } else {
+            float value;
+            memcpy(&value, &word, sizeof(value));
+            out += (size_t)snprintf(text + out, size - out, " %g", value);
+        }
+    }
+    
+    return CONTROL_INPUT_OK;
+}
+
+/**
+ * Read every waiting control datagram
+ */
+static void read_udp(control_input_t *ctx) {
+    char buf[CONTROL_DATAGRAM_SIZE + 1];
+    char text[CONTROL_DATAGRAM_SIZE];
+    ssize_t len;
+    
+    while ((len = recv(ctx->udp_sock, buf, CONTROL_DATAGRAM_SIZE, MSG_DONTWAIT)) > 0) {
+        if (buf[0] == '/') {
+            if (osc_to_text(buf, (size_t)len, text, sizeof(text)) == 0) {
+                handle_command(ctx, text);
+            }
+            continue;
+        }
+        
+        /* Text: one command per line */
+        buf[len] = '\0';
+        for (char *save = NULL, *line = strtok_r(buf, "\r\n", &save); line;
+             line = strtok_r(NULL, "\r\n", &save)) {
+            handle_command(ctx, line);
+        }
+    }
+}
+
+/**
+ * Input thread: read every source, apply the burst, publish once
+ */
+static void *input_thread_main(void *arg) {
+    control_input_t *ctx = arg;
+    struct pollfd fds[3 + CONTROL_INPUT_MAX_DEVICES];
+    int publish_pending = 0;
+    
+    for (;;) {
+        int n = 0, stdin_slot = -1, udp_slot = -1, device_slot;
+        
+        fds[n++] = (struct pollfd){ .fd = ctx->stop_fd, .events = POLLIN };
+        if (ctx->config.use_stdin) {
+            stdin_slot = n;
+            fds[n++] = (struct pollfd){ .fd = STDIN_FILENO, .events = POLLIN };
+        }
+        if (ctx->udp_sock >= 0) {
+            udp_slot = n;
+            fds[n++] = (struct pollfd){ .fd = ctx->udp_sock, .events = POLLIN };
+        }
+        device_slot = n;
+        for (int i = 0; i < ctx->device_count; i++) {
+            fds[n++] = (struct pollfd){ .fd = ctx->devices[i], .events = POLLIN };
+        }
+        
+        if (poll(fds, (nfds_t)n, publish_pending ? PUBLISH_RETRY_MS : -1) < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Control input poll failed: %s\n", strerror(errno));
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            break;
+        }
+        
+        if (stdin_slot >= 0 && (fds[stdin_slot].revents & POLLIN)) {
+            read_stdin(ctx);
+        }
+        if (stdin_slot >= 0 && (fds[stdin_slot].revents & (POLLHUP | POLLERR | POLLNVAL))) {
+            ctx->config.use_stdin = 0;  /* Terminal gone: stop polling it */
+        }
+        if (udp_slot >= 0 && (fds[udp_slot].revents & POLLIN)) {
+            read_udp(ctx);
+        }
+        
+        /* Walk backwards so an unplugged device can be swapped with the last one */
+        for (int i = ctx->device_count - 1; i >= 0; i--) {
+            short revents = fds[device_slot + i].revents;
+            
+            if (((revents & POLLIN) && read_device(ctx, ctx->devices[i]) < 0) ||
+                (revents & (POLLERR | POLLHUP | POLLNVAL))) {
+                printf("⚠ Input device removed\n");
+                close(ctx->devices[i]);
+                ctx->devices[i] = ctx->devices[--ctx->device_count];
+            }
+        }
+        
+        /* The whole burst becomes one snapshot (no-op if the warp didn't change) */
+        if (ctx->config.warp) {
+            publish_pending = warp_control_publish(ctx->config.warp) == WARP_CONTROL_EAGAIN;
+        }
+        
+        if (ctx->posted) {
+            uint64_t one = 1;
+            if (write(ctx->notify_fd, &one, sizeof(one)) < 0) {
+                /* Counter already non-zero: the render thread is due to look anyway */
+            }
+            ctx->posted = 0;
+        }
+    }
+    
+    return NULL;
+}
+
+/**
+ * Open every evdev device that has control keys (grabbed if configured)
+ */
+static void open_devices(control_input_t *ctx) {
+    DIR *dir = opendir("/dev/input");
+    struct dirent *entry;
+    
+    if (!dir) {
+        return;
+    }
+    
+    while ((entry = readdir(dir)) && ctx->device_count < CONTROL_INPUT_MAX_DEVICES) {
+        unsigned long keys[KEY_BITS_LONGS];
+        char path[512], name[128] = "unknown";
+        
+        if (strncmp(entry->d_name, "event", 5) != 0) {
+            continue;
+        }
+        
+        snprintf(path, sizeof(path), "/dev/input/%s", entry->d_name);
+        int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            continue;  /* No permission (not in the input group) or gone */
+        }
+        
+        /* Mice, touchscreens and power buttons have keys too, but none of ours */
+        memset(keys, 0, sizeof(keys));
+        if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keys)), keys) < 0 ||
+            !(KEY_BIT(keys, KEY_UP) || KEY_BIT(keys, KEY_1) || KEY_BIT(keys, KEY_NEXTSONG) ||
+              KEY_BIT(keys, KEY_FASTFORWARD))) {
+            close(fd);
+            continue;
+        }
+        
+        ioctl(fd, EVIOCGNAME(sizeof(name)), name);
+        if (!ctx->config.grab_evdev) {
+            if (ctx->config.use_stdin && KEY_BIT(keys, KEY_A) && KEY_BIT(keys, KEY_Z)) {
+                close(fd);  /* A keyboard: its keys already come in through the terminal */
+                continue;
+            }
+        } else if (ioctl(fd, EVIOCGRAB, 1) < 0) {
+            printf("⚠ Input %s (%s) not grabbed: keys may also reach the terminal\n", path, name);
+        }
+        printf("✓ Input device %s: %s\n", path, name);
+        ctx->devices[ctx->device_count++] = fd;
+    }
+    
+    closedir(dir);
+}
+
+/**
+ * Open the UDP control port
+ */
+static int open_udp(control_input_t *ctx, int port) {
+    struct sockaddr_in addr;
+    int reuse = 1;
+    
+    ctx->udp_sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (ctx->udp_sock < 0) {
+        fprintf(stderr, "Control port: socket failed: %s\n", strerror(errno));
+        return CONTROL_INPUT_ERROR;
+    }
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    setsockopt(ctx->udp_sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(ctx->udp_sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "Control port: bind to %d failed: %s\n", port, strerror(errno));
+        close(ctx->udp_sock);
+        ctx->udp_sock = -1;
+        return CONTROL_INPUT_ERROR;
+    }
+    
+    printf("✓ Control port: UDP %d (text or OSC %s*)\n", port, CONTROL_INPUT_OSC_PREFIX);
+    return CONTROL_INPUT_OK;
+}
+
+/**
+ * Open the input sources and start the input thread
+ */
+int control_input_configure(control_input_t *ctx, const control_input_config_t *config) {
+    if (!ctx || !config || ctx->thread_started) {
+        return CONTROL_INPUT_ERROR;
+    }
+    
+    ctx->config = *config;
+    
+    if (config->use_evdev) {
+        open_devices(ctx);
+    }
+    if (config->udp_port > 0 && open_udp(ctx, config->udp_port) < 0) {
+        printf("⚠ Network control unavailable\n");
+    }
+    
+    ctx->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    ctx->notify_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ctx->stop_fd < 0 || ctx->notify_fd < 0 ||
+        pthread_create(&ctx->thread, NULL, input_thread_main, ctx) != 0) {
+        fprintf(stderr, "Control input: failed to start input thread\n");
+        return CONTROL_INPUT_ERROR;
+    }
+    ctx->thread_started = 1;
+    
+    return CONTROL_INPUT_OK;
+}
+
+/**
+ * Descriptor readable while player actions are waiting
+ */
+int control_input_get_fd(control_input_t *ctx) {
+    return ctx ? ctx->notify_fd : CONTROL_INPUT_ERROR;
+}
+
+/**
+ * Take the player actions that arrived since the last call
+ */
+int control_input_take(control_input_t *ctx, control_input_actions_t *actions) {
+    uint64_t drain;
+    
+    memset(actions, 0, sizeof(*actions));
+    if (!ctx || ctx->notify_fd < 0) {
+        return 0;
+    }
+    
+    /* Reset the wake-up first: anything posted after it wakes the next poll */
+    if (read(ctx->notify_fd, &drain, sizeof(drain)) < 0 && errno != EAGAIN) {
+        return 0;
+    }
+    
+    actions->quit = __atomic_exchange_n(&ctx->quit, 0, __ATOMIC_ACQUIRE);
+    actions->seek_steps = __atomic_exchange_n(&ctx->seek_steps, 0, __ATOMIC_ACQUIRE);
+    actions->chapter_steps = __atomic_exchange_n(&ctx->chapter_steps, 0, __ATOMIC_ACQUIRE);
+    
+    return actions->quit || actions->seek_steps || actions->chapter_steps;
+}
+
+/**
+ * Stop the input thread and free the context
+ */
+void control_input_destroy(control_input_t *ctx) {
+    if (!ctx) {
+        return;
+    }
+    
+    if (ctx->thread_started) {
+        uint64_t one = 1;
+        if (write(ctx->stop_fd, &one, sizeof(one)) < 0) {
+            /* Can't fail for an eventfd below its maximum */
+        }
+        pthread_join(ctx->thread, NULL);
+    }
+    
+    /* Closing a grabbed device releases the grab */
+    for (int i = 0; i < ctx->device_count; i++) {
+        close(ctx->devices[i]);
+    }
+    if (ctx->udp_sock >= 0) {
+        close(ctx->udp_sock);
+    }
+    if (ctx->stop_fd >= 0) {
+        close(ctx->stop_fd);
+    }
+    if (ctx->notify_fd >= 0) {
+        close(ctx->notify_fd);
+    }
+    
+    free(ctx);
+}
@@ -0,0 +1,92 @@
+/*
+ * Control Input Module - Keys, Remotes and Network Control
+ *
+ * This module handles:
+ * - One input thread reading the terminal, evdev key devices (USB keypads
+ *   and remotes on headless units) and an optional UDP control port
+ * - Turning key presses and control messages into warp actions, applied and
+ *   coalesced on that thread and handed over with warp_control_publish()
+ * - Collecting player actions (quit, seek, chapter) for the render thread,
+ *   which picks them up without blocking or parsing anything
+ *
+ * Control datagrams are text, one command per line, or OSC messages whose
+ * address is CONTROL_INPUT_OSC_PREFIX followed by the command name:
+ *   up | down | left | right      Nudge the selected corner
+ *   corner N [X Y]                Select corner N (1-4), or put it at X, Y
+ *   reset | fine | save | load    As the R, F, S and L keys
+ *   seek [STEPS] | chapter [STEPS]  Forward (negative = back), default 1
+ *   quit
+ */
+
+#ifndef CONTROL_INPUT_H
+#define CONTROL_INPUT_H
+
+#include "warp_control.h"
+
+/* Return codes */
+#define CONTROL_INPUT_OK           0
+#define CONTROL_INPUT_ERROR       -1
+
+/* OSC address prefix of control messages (e.g. /pickle/corner ,iff 1 -0.9 -1.0) */
+#define CONTROL_INPUT_OSC_PREFIX  "/pickle/"
+
+/* Forward declarations */
+typedef struct control_input control_input_t;
+
+/* Input sources */
+typedef struct {
+    warp_control_ctx_t *warp;  /* Edited on the input thread (NULL = no warp controls) */
+    int use_stdin;             /* Read keys from the terminal (already in raw mode) */
+    int use_evdev;             /* Read /dev/input/event* devices that have keys */
+    int grab_evdev;            /* Grab them (exclusive), keyboards included */
+    int udp_port;              /* Control datagrams on this port (0 = off) */
+} control_input_config_t;
+
+/* Player actions since the last control_input_take(), coalesced */
+typedef struct {
+    int quit;
+    int seek_steps;            /* Net seek presses (positive = forward) */
+    int chapter_steps;         /* Net chapter presses (positive = next) */
+} control_input_actions_t;
+
+/* API Functions */
+
+/**
+ * Create control input context
+ * @return New context or NULL on error
+ */
+control_input_t *control_input_create(void);
+
+/**
+ * Open the input sources and start the input thread
+ *
+ * While it runs the thread owns config->warp: the render thread only calls
+ * warp_control_process_input() on it.
+ * @param ctx Control input context
+ * @param config Input sources
+ * @return 0 on success (even if no source opened), negative on error
+ */
+int control_input_configure(control_input_t *ctx, const control_input_config_t *config);
+
+/**
+ * Descriptor that is readable while player actions are waiting (for poll())
+ * @param ctx Control input context
+ * @return eventfd, or negative if not configured
+ */
+int control_input_get_fd(control_input_t *ctx);
+
+/**
+ * Take the player actions that arrived since the last call (never blocks)
+ * @param ctx Control input context
+ * @param actions Output actions
+ * @return 1 if there were any, 0 if not
+ */
+int control_input_take(control_input_t *ctx, control_input_actions_t *actions);
+
+/**
+ * Stop the input thread, release grabbed devices and free the context
+ * @param ctx Control input context
+ */
+void control_input_destroy(control_input_t *ctx);
+
+#endif /* CONTROL_INPUT_H */
@@ -16,6 +16,8 @@
 #include <unistd.h>
 #include <errno.h>
 #include <sys/time.h>
+#include <sys/ioctl.h>
+#include <linux/sync_file.h>
 #include <EGL/eglext.h>
 
 /* Fallback for O_CLOEXEC if not defined */
@@ -26,6 +28,12 @@
 /* Default DRM device path */
 #define DEFAULT_DRM_DEVICE "/dev/dri/card1"
 
+/* Connector modes looked at (HDMI sinks list a few dozen) */
+#define MAX_CONNECTOR_MODES 64
+
+/* A refresh within this of a content rate multiple matches (24 and 23.976 Hz are 0.1% apart) */
+#define REFRESH_MATCH_PPM   500
+
 /* EGL error reporting helper */
 static const char* egl_error_string(EGLint error) {
     switch (error) {
@@ -48,6 +56,13 @@ static const char* egl_error_string(EGLint error) {
     }
 }
 
+/* A further scanout head: own CRTC, GBM surface and EGL window surface */
+typedef struct {
+    display_ctx_t drm_ctx;
+    EGLSurface egl_surface;
+    display_info_t info;
+} display_head_t;
+
 /* Internal display context */
 struct display_output_ctx {
     /* DRM/GBM context - using robust drm_display module */
@@ -63,9 +78,26 @@ struct display_output_ctx {
     EGLSurface egl_surface;
     EGLConfig egl_config;
     
+    /* Heads after the first (which is drm_ctx/egl_surface/info above) */
+    int head_count;
+    display_head_t heads[DISPLAY_OUTPUT_MAX_HEADS - 1];
+    
     /* State */
     int configured;
     
+    /* Frame layout the overlay last rejected: GL until format or size changes */
+    int plane_rejected;
+    uint32_t rejected_format;
+    uint64_t rejected_modifier;
+    int rejected_width, rejected_height;
+    
+    /* Explicit render fences (EGL_ANDROID_native_fence_sync -> KMS IN_FENCE_FD) */
+    int has_native_fence;
+    PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR;
+    PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR;
+    PFNEGLDUPNATIVEFENCEFDANDROIDPROC eglDupNativeFenceFDANDROID;
+    int last_fence_fd;       /* Our copy of the latest frame's fence, for GPU timing */
+    
     /* Statistics */
     uint64_t frames_presented;
     uint64_t vblank_count;
@@ -254,6 +286,139 @@ surface_success:
     return DISPLAY_OUTPUT_OK;
 }
 
+/**
+ * Look up native fence sync support (optional; implicit sync otherwise)
+ */
+static void init_native_fence(display_output_ctx_t *ctx) {
+    const char *extensions = eglQueryString(ctx->egl_display, EGL_EXTENSIONS);
+    
+    ctx->has_native_fence = 0;
+    if (!ctx->drm_ctx.atomic_enabled || !ctx->drm_ctx.primary_props.in_fence_fd ||
+        !extensions || !strstr(extensions, "EGL_KHR_fence_sync") ||
+        !strstr(extensions, "EGL_ANDROID_native_fence_sync")) {
+        printf("Render fences: implicit sync\n");
+        return;
+    }
+    
+    ctx->eglCreateSyncKHR = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+    ctx->eglDestroySyncKHR = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+    ctx->eglDupNativeFenceFDANDROID =
+        (PFNEGLDUPNATIVEFENCEFDANDROIDPROC)eglGetProcAddress("eglDupNativeFenceFDANDROID");
+    
+    ctx->has_native_fence = ctx->eglCreateSyncKHR && ctx->eglDestroySyncKHR &&
+                            ctx->eglDupNativeFenceFDANDROID;
+    printf("Render fences: %s\n", ctx->has_native_fence ? "✓ native fence -> IN_FENCE_FD" :
+                                                          "implicit sync");
+}
+
+/**
+ * Release the frame reference held while a frame was on the overlay plane
+ */
+static void release_plane_frame(void *opaque) {
+    AVFrame *av_frame = opaque;
+    av_frame_free(&av_frame);
+}
+
+/**
+ * DRM state and EGL surface of one head (0 = the head owning the device)
+ */
+static display_ctx_t *head_drm(display_output_ctx_t *ctx, int head) {
+    return head == 0 ? &ctx->drm_ctx : &ctx->heads[head - 1].drm_ctx;
+}
+
+static EGLSurface head_surface(display_output_ctx_t *ctx, int head) {
+    return head == 0 ? ctx->egl_surface : ctx->heads[head - 1].egl_surface;
+}
+
+/**
+ * Exact refresh of a mode in millihertz (vrefresh is rounded to whole Hz)
+ */
+static int mode_refresh_mhz(const drmModeModeInfo *mode) {
+    uint64_t frame = (uint64_t)mode->htotal * mode->vtotal;
+    uint64_t mhz;
+    
+    if (!frame) {
+        return (int)mode->vrefresh * 1000;
+    }
+    
+    mhz = ((uint64_t)mode->clock * 1000000 + frame / 2) / frame;
+    if (mode->flags & DRM_MODE_FLAG_INTERLACE) {
+        mhz *= 2;
+    }
+    if (mode->flags & DRM_MODE_FLAG_DBLSCAN) {
+        mhz /= 2;
+    }
+    if (mode->vscan > 1) {
+        mhz /= mode->vscan;
+    }
+    return (int)mhz;
+}
+
+/**
+ * Fill display info from a head's mode and connector
+ */
+static void fill_head_info(display_output_ctx_t *ctx, const display_ctx_t *drm,
+                           display_info_t *info) {
+    memset(info, 0, sizeof(*info));
+    info->width = drm->width;
+    info->height = drm->height;
+    info->refresh_rate = drm->refresh_rate;
+    info->refresh_mhz = drm->kms_enabled ? mode_refresh_mhz(&drm->mode) :
+                        (int)drm->refresh_rate * 1000;
+    
+    if (drm->kms_enabled) {
+        /* We own the CRTC, so report the real connector */
+        info->physical_width_mm = drm->mm_width;
+        info->physical_height_mm = drm->mm_height;
+        snprintf(info->connector_name, sizeof(info->connector_name),
+                 "%s-%u", display_output_connector_type_name(drm->connector_type),
+                 drm->connector_type_id);
+    } else {
+        /* Physical size unknown in GBM-only mode; generic connector name */
+        snprintf(info->connector_name, sizeof(info->connector_name),
+                 "%s", ctx->config.headless ? "Offscreen" : "GBM-Surface");
+    }
+}
+
+/**
+ * Bring up the heads after the first on the same device and EGL context
+ * 
+ * They take the first head's mode so one refresh paces them all. A head
+ * that can't be set up is left out; playback carries on with fewer.
+ */
+static void init_extra_heads(display_output_ctx_t *ctx) {
+    while (ctx->head_count < ctx->config.head_count &&
+           ctx->head_count < DISPLAY_OUTPUT_MAX_HEADS) {
+        display_head_t *head = &ctx->heads[ctx->head_count - 1];
+        uint32_t connector_id = ctx->head_count == 1 ? (uint32_t)ctx->config.second_connector_id : 0;
+        
+        if (drm_init_head(&head->drm_ctx, &ctx->drm_ctx, ctx->drm_ctx.width,
+                          ctx->drm_ctx.height, ctx->drm_ctx.refresh_rate, connector_id) < 0) {
+            fprintf(stderr, "⚠ Head %d unavailable - continuing with %d head(s)\n",
+                    ctx->head_count + 1, ctx->head_count);
+            drm_cleanup(&head->drm_ctx);
+            return;
+        }
+        
+        head->egl_surface = eglCreateWindowSurface(ctx->egl_display, ctx->egl_config,
+                                                   (EGLNativeWindowType)head->drm_ctx.gbm_surface,
+                                                   NULL);
+        if (head->egl_surface == EGL_NO_SURFACE) {
+            EGLint egl_error = eglGetError();
+            fprintf(stderr, "⚠ Head %d: no EGL surface: %s (0x%04x)\n", ctx->head_count + 1,
+                    egl_error_string(egl_error), egl_error);
+            drm_cleanup(&head->drm_ctx);
+            return;
+        }
+        
+        head->drm_ctx.plane_release = release_plane_frame;
+        fill_head_info(ctx, &head->drm_ctx, &head->info);
+        ctx->head_count++;
+        printf("✓ Head %d: %dx%d@%dHz on %s\n", ctx->head_count, head->info.width,
+               head->info.height, head->info.refresh_rate, head->info.connector_name);
+    }
+}
+
 /**
  * Create display output context
  */
@@ -264,6 +429,10 @@ display_output_ctx_t *display_output_create(void) {
         return NULL;
     }
     
+    /* No DRM device opened yet */
+    ctx->drm_ctx.drm_fd = -1;
+    ctx->last_fence_fd = -1;
+    
     return ctx;
 }
 
@@ -283,8 +452,13 @@ int display_output_configure(display_output_ctx_t *ctx, int width, int height, i
     ctx->config.preferred_refresh = refresh_rate;
     
     /* Initialize DRM/GBM using robust drm_display module */
-    printf("Initializing DRM/KMS display...\n");
-    ret = drm_init(&ctx->drm_ctx);
+    if (ctx->config.headless) {
+        ret = drm_init_offscreen(&ctx->drm_ctx, width, height);
+    } else {
+        printf("Initializing DRM/KMS display...\n");
+        ret = drm_init(&ctx->drm_ctx, width, height, refresh_rate,
+                       (uint32_t)ctx->config.connector_id, (uint32_t)ctx->config.crtc_id);
+    }
     if (ret) {
         fprintf(stderr, "Failed to initialize DRM display\n");
         return DISPLAY_OUTPUT_ERROR;
@@ -295,6 +469,9 @@ int display_output_configure(display_output_ctx_t *ctx, int width, int height, i
            ctx->drm_ctx.height, 
            ctx->drm_ctx.refresh_rate);
     
+    /* Frames handed to the overlay plane are released through us */
+    ctx->drm_ctx.plane_release = release_plane_frame;
+    
     /* Initialize EGL with GBM surface from DRM context */
     ret = init_egl_with_drm_surface(ctx);
     if (ret < 0) {
@@ -302,16 +479,25 @@ int display_output_configure(display_output_ctx_t *ctx, int width, int height, i
         return ret;
     }
     
+    init_native_fence(ctx);
+    
+    /* Nothing paces an offscreen surface: swaps return as soon as a buffer is free */
+    if (ctx->config.headless) {
+        eglSwapInterval(ctx->egl_display, 0);
+    }
+    
     /* Fill display info with GBM surface data */
-    ctx->info.width = ctx->drm_ctx.width;
-    ctx->info.height = ctx->drm_ctx.height;
-    ctx->info.refresh_rate = ctx->drm_ctx.refresh_rate;
-    ctx->info.physical_width_mm = 0;  /* Unknown in GBM-only mode */
-    ctx->info.physical_height_mm = 0; /* Unknown in GBM-only mode */
+    fill_head_info(ctx, &ctx->drm_ctx, &ctx->info);
     
-    /* Set generic connector name for GBM-only mode */
-    snprintf(ctx->info.connector_name, sizeof(ctx->info.connector_name), 
-             "GBM-Surface");
+    /* Further heads only exist with KMS scanout on the first */
+    ctx->head_count = 1;
+    if (ctx->config.head_count > 1) {
+        if (ctx->drm_ctx.kms_enabled) {
+            init_extra_heads(ctx);
+        } else {
+            fprintf(stderr, "⚠ Multiple heads need DRM master - using one\n");
+        }
+    }
     
     ctx->configured = 1;
     printf("Display output configured: %dx%d@%dHz on %s\n",
@@ -321,6 +507,82 @@ int display_output_configure(display_output_ctx_t *ctx, int width, int height, i
     return DISPLAY_OUTPUT_OK;
 }
 
+/**
+ * Set advanced display configuration
+ */
+int display_output_set_config(display_output_ctx_t *ctx, const display_config_t *config) {
+    if (!ctx || !config) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    if (ctx->configured) {
+        fprintf(stderr, "Display config must be set before display_output_configure()\n");
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    ctx->config = *config;
+    return DISPLAY_OUTPUT_OK;
+}
+
+/**
+ * Swap one head's EGL surface and queue its (fenced) page flip
+ */
+static int present_head(display_output_ctx_t *ctx, int head) {
+    EGLSurface surface = head_surface(ctx, head);
+    
+    /* The renderer leaves the last head it drew current */
+    if (ctx->head_count > 1 &&
+        !eglMakeCurrent(ctx->egl_display, surface, surface, ctx->egl_context)) {
+        fprintf(stderr, "Failed to make head %d current\n", head + 1);
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    /* Fence after the frame's GL commands; KMS waits on it instead of the CPU */
+    EGLSyncKHR sync = EGL_NO_SYNC_KHR;
+    int fence_fd = -1;
+    if (ctx->has_native_fence) {
+        static const EGLint sync_attribs[] = {
+            EGL_SYNC_NATIVE_FENCE_FD_ANDROID, EGL_NO_NATIVE_FENCE_FD_ANDROID,
+            EGL_NONE
+        };
+        sync = ctx->eglCreateSyncKHR(ctx->egl_display, EGL_SYNC_NATIVE_FENCE_ANDROID,
+                                     sync_attribs);
+    }
+    
+    /* The one swap per frame (also flushes, which materialises the fence fd) */
+    if (!eglSwapBuffers(ctx->egl_display, surface)) {
+        fprintf(stderr, "Failed to swap EGL buffers\n");
+        if (sync != EGL_NO_SYNC_KHR) {
+            ctx->eglDestroySyncKHR(ctx->egl_display, sync);
+        }
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    if (sync != EGL_NO_SYNC_KHR) {
+        fence_fd = ctx->eglDupNativeFenceFDANDROID(ctx->egl_display, sync);
+        ctx->eglDestroySyncKHR(ctx->egl_display, sync);
+        if (fence_fd == EGL_NO_NATIVE_FENCE_FD_ANDROID) {
+            fence_fd = -1;
+        }
+    }
+    
+    /* Keep a reference so the GPU completion time can be read back later */
+    if (head == 0) {
+        if (ctx->last_fence_fd >= 0) {
+            close(ctx->last_fence_fd);
+        }
+        ctx->last_fence_fd = fence_fd >= 0 ? dup(fence_fd) : -1;
+    }
+    
+    /* Use DRM module's robust buffer swapping (it takes the fence) */
+    if (drm_swap_buffers(head_drm(ctx, head), fence_fd)) {
+        fprintf(stderr, "Failed to swap DRM buffers on head %d\n", head + 1);
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    return DISPLAY_OUTPUT_OK;
+}
+
 /**
  * Present frame to display using DRM module
  */
@@ -334,18 +596,126 @@ int display_output_present_frame(display_output_ctx_t *ctx) {
     
     gettimeofday(&start_time, NULL);
     
-    /* Swap EGL buffers */
-    if (!eglSwapBuffers(ctx->egl_display, ctx->egl_surface)) {
-        fprintf(stderr, "Failed to swap EGL buffers\n");
+    /* Last head first: it is still current, and head 0 ends up current for the next frame */
+    for (int head = ctx->head_count - 1; head >= 0; head--) {
+        ret = present_head(ctx, head);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    
+    /* Update statistics */
+    gettimeofday(&end_time, NULL);
+    uint64_t present_time = (end_time.tv_sec - start_time.tv_sec) * 1000000LL +
+                           (end_time.tv_usec - start_time.tv_usec);
+    
+    ctx->frames_presented++;
+    ctx->total_present_time_us += present_time;
+    ctx->last_present_time = end_time;
+    
+    return DISPLAY_OUTPUT_OK;
+}
+
+/**
+ * When the GPU finished the last presented GL frame
+ */
+int display_output_get_render_done(display_output_ctx_t *ctx, uint64_t *done_us) {
+    struct sync_fence_info fence_info[4];
+    struct sync_file_info file_info;
+    
+    if (!ctx || !done_us || ctx->last_fence_fd < 0) {
         return DISPLAY_OUTPUT_ERROR;
     }
     
-    /* Use DRM module's robust buffer swapping */
-    ret = drm_swap_buffers(&ctx->drm_ctx);
-    if (ret) {
-        fprintf(stderr, "Failed to swap DRM buffers\n");
+    memset(&file_info, 0, sizeof(file_info));
+    memset(fence_info, 0, sizeof(fence_info));
+    file_info.num_fences = 4;
+    file_info.sync_fence_info = (uint64_t)(uintptr_t)fence_info;
+    
+    if (ioctl(ctx->last_fence_fd, SYNC_IOC_FILE_INFO, &file_info) < 0) {
         return DISPLAY_OUTPUT_ERROR;
     }
+    if (file_info.status != 1) {
+        return DISPLAY_OUTPUT_EAGAIN;  /* Still rendering (or failed) */
+    }
+    
+    /* Signal timestamps are CLOCK_MONOTONIC; the last one to signal wins */
+    uint64_t latest_ns = 0;
+    for (uint32_t i = 0; i < file_info.num_fences && i < 4; i++) {
+        if (fence_info[i].timestamp_ns > latest_ns) {
+            latest_ns = fence_info[i].timestamp_ns;
+        }
+    }
+    
+    /* Each frame's fence is read once */
+    close(ctx->last_fence_fd);
+    ctx->last_fence_fd = -1;
+    
+    if (latest_ns == 0) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    *done_us = latest_ns / 1000;
+    return DISPLAY_OUTPUT_OK;
+}
+
+/**
+ * Present decoded frame directly on the overlay plane
+ */
+int display_output_present_dmabuf(display_output_ctx_t *ctx, const decoded_frame_t *frame) {
+    struct timeval start_time, end_time;
+    drm_plane_buffer_t buf;
+    
+    if (!ctx || !ctx->configured || !frame) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    /* Only zero-copy frames with a layout the overlay can scan out (one head only) */
+    if (ctx->head_count > 1 || frame->dmabuf_fd[0] < 0 || !frame->av_frame ||
+        frame->num_planes < 1 ||
+        !drm_plane_supports_format(&ctx->drm_ctx, frame->drm_format, frame->modifier)) {
+        return DISPLAY_OUTPUT_EAGAIN;
+    }
+    
+    /* A rejected layout stays on GL; a new format or size gets another try */
+    if (ctx->plane_rejected) {
+        if (frame->drm_format == ctx->rejected_format && frame->modifier == ctx->rejected_modifier &&
+            frame->width == ctx->rejected_width && frame->height == ctx->rejected_height) {
+            return DISPLAY_OUTPUT_EAGAIN;
+        }
+        ctx->plane_rejected = 0;
+    }
+    
+    gettimeofday(&start_time, NULL);
+    
+    memset(&buf, 0, sizeof(buf));
+    buf.width = frame->width;
+    buf.height = frame->height;
+    buf.format = frame->drm_format;
+    buf.modifier = frame->modifier;
+    buf.num_planes = frame->num_planes;
+    for (int i = 0; i < frame->num_planes; i++) {
+        buf.fds[i] = frame->dmabuf_fd[i];
+        buf.offsets[i] = frame->offsets[i];
+        buf.pitches[i] = frame->pitches[i];
+    }
+    
+    /* Keep the decoder buffer alive until it leaves the screen */
+    buf.opaque = av_frame_clone(frame->av_frame);
+    if (!buf.opaque) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    if (drm_plane_present(&ctx->drm_ctx, &buf) < 0) {
+        /* Usually a layout the plane rejects - don't retry it every frame */
+        av_frame_free((AVFrame **)&buf.opaque);
+        ctx->plane_rejected = 1;
+        ctx->rejected_format = frame->drm_format;
+        ctx->rejected_modifier = frame->modifier;
+        ctx->rejected_width = frame->width;
+        ctx->rejected_height = frame->height;
+        fprintf(stderr, "Direct plane scanout failed, using GL until the format or size changes\n");
+        return DISPLAY_OUTPUT_EAGAIN;
+    }
     
     /* Update statistics */
     gettimeofday(&end_time, NULL);
@@ -359,6 +729,131 @@ int display_output_present_frame(display_output_ctx_t *ctx) {
     return DISPLAY_OUTPUT_OK;
 }
 
+/**
+ * Check if direct plane scanout is available
+ */
+int display_output_plane_available(display_output_ctx_t *ctx) {
+    if (!ctx || !ctx->configured || ctx->head_count > 1) {
+        return 0;
+    }
+    return ctx->drm_ctx.atomic_enabled ? 1 : 0;
+}
+
+/**
+ * Wait for vertical blank
+ * 
+ * With KMS scanout this blocks in poll() on the DRM fd until the pending
+ * page flip (or the next vblank) completes. In GBM-only mode there is no
+ * CRTC to wait on, so it sleeps until the next refresh period instead.
+ */
+int display_output_wait_vblank(display_output_ctx_t *ctx, uint64_t *timestamp_us) {
+    if (!ctx || !ctx->configured) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    if (drm_wait_vblank(&ctx->drm_ctx, timestamp_us) < 0) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    /* The first head paces; the others only need their own flips to land */
+    for (int head = 1; head < ctx->head_count; head++) {
+        if (drm_wait_for_flip(head_drm(ctx, head)) < 0) {
+            return DISPLAY_OUTPUT_ERROR;
+        }
+    }
+    
+    ctx->vblank_count++;
+    return DISPLAY_OUTPUT_OK;
+}
+
+/**
+ * Get DRM event fd
+ */
+int display_output_get_event_fd(display_output_ctx_t *ctx) {
+    if (!ctx || !ctx->configured || !ctx->drm_ctx.kms_enabled || !ctx->drm_ctx.mode_set) {
+        return -1;
+    }
+    return ctx->drm_ctx.drm_fd;
+}
+
+/**
+ * Start non-blocking vblank wait
+ */
+int display_output_begin_vblank_wait(display_output_ctx_t *ctx) {
+    if (display_output_get_event_fd(ctx) < 0) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    if (drm_request_vblank_event(&ctx->drm_ctx) < 0) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    return DISPLAY_OUTPUT_OK;
+}
+
+/**
+ * Give up on a vblank wait that timed out
+ */
+void display_output_cancel_vblank_wait(display_output_ctx_t *ctx) {
+    if (!ctx || !ctx->configured) {
+        return;
+    }
+    drm_cancel_vblank_event(&ctx->drm_ctx);
+}
+
+/**
+ * Dispatch pending DRM events
+ */
+int display_output_dispatch_events(display_output_ctx_t *ctx, uint64_t *timestamp_us) {
+    if (display_output_get_event_fd(ctx) < 0) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    /* Events for every head arrive on the one fd and are routed to their head */
+    int ret = drm_dispatch_events(&ctx->drm_ctx);
+    if (ret < 0) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    if (ret == 0) {
+        return DISPLAY_OUTPUT_EAGAIN;
+    }
+    for (int head = 1; head < ctx->head_count; head++) {
+        if (head_drm(ctx, head)->flip_pending) {
+            return DISPLAY_OUTPUT_EAGAIN;
+        }
+    }
+    
+    ctx->vblank_count++;
+    if (timestamp_us) {
+        *timestamp_us = ctx->drm_ctx.last_vblank_us;
+    }
+    return DISPLAY_OUTPUT_OK;
+}
+
+/**
+ * Get display statistics
+ */
+void display_output_get_stats(display_output_ctx_t *ctx,
+                             uint64_t *frames_presented,
+                             uint64_t *vblank_count,
+                             uint64_t *avg_present_time_us) {
+    if (!ctx) {
+        return;
+    }
+    
+    if (frames_presented) {
+        *frames_presented = ctx->frames_presented;
+    }
+    
+    if (vblank_count) {
+        *vblank_count = ctx->vblank_count;
+    }
+    
+    if (avg_present_time_us) {
+        *avg_present_time_us = ctx->frames_presented > 0 ?
+                              ctx->total_present_time_us / ctx->frames_presented : 0;
+    }
+}
+
 /**
  * Get EGL display handle
  */
@@ -373,6 +868,35 @@ EGLSurface display_output_get_egl_surface(display_output_ctx_t *ctx) {
     return ctx ? ctx->egl_surface : EGL_NO_SURFACE;
 }
 
+/**
+ * Get number of heads
+ */
+int display_output_get_head_count(display_output_ctx_t *ctx) {
+    return ctx && ctx->configured ? ctx->head_count : 0;
+}
+
+/**
+ * Get one head's EGL surface
+ */
+EGLSurface display_output_get_head_surface(display_output_ctx_t *ctx, int head) {
+    if (!ctx || !ctx->configured || head < 0 || head >= ctx->head_count) {
+        return EGL_NO_SURFACE;
+    }
+    return head_surface(ctx, head);
+}
+
+/**
+ * Get one head's display information
+ */
+int display_output_get_head_info(display_output_ctx_t *ctx, int head, display_info_t *info) {
+    if (!ctx || !info || !ctx->configured || head < 0 || head >= ctx->head_count) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    *info = head == 0 ? ctx->info : ctx->heads[head - 1].info;
+    return DISPLAY_OUTPUT_OK;
+}
+
 /**
  * Get display information
  */
@@ -385,6 +909,196 @@ int display_output_get_info(display_output_ctx_t *ctx, display_info_t *info) {
     return DISPLAY_OUTPUT_OK;
 }
 
+static void fill_mode(display_mode_t *out, const drmModeModeInfo *mode) {
+    out->width = mode->hdisplay;
+    out->height = mode->vdisplay;
+    out->refresh_rate = (int)mode->vrefresh;
+    out->refresh_mhz = mode_refresh_mhz(mode);
+    out->interlaced = (mode->flags & DRM_MODE_FLAG_INTERLACE) != 0;
+    snprintf(out->name, sizeof(out->name), "%s", mode->name);
+}
+
+/**
+ * Integer multiple of the content frame rate a refresh is (0 = none)
+ */
+static int refresh_multiple(int refresh_mhz, int fps_num, int fps_den) {
+    /* refresh / (fps_num / fps_den), all in millihertz */
+    int64_t refresh = (int64_t)refresh_mhz * fps_den;
+    int64_t content = (int64_t)fps_num * 1000;
+    int64_t multiple = (refresh + content / 2) / content;
+    int64_t error;
+    
+    if (multiple < 1) {
+        return 0;
+    }
+    
+    error = refresh - multiple * content;
+    if (error < 0) {
+        error = -error;
+    }
+    return error * 1000000 <= multiple * content * REFRESH_MATCH_PPM ? (int)multiple : 0;
+}
+
+/**
+ * Get list of available display modes
+ */
+int display_output_get_modes(display_output_ctx_t *ctx, display_mode_t *modes, int max_modes) {
+    drmModeModeInfo drm_modes[MAX_CONNECTOR_MODES];
+    int count;
+    
+    if (!ctx || !modes || max_modes <= 0 || !ctx->configured) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    count = drm_get_modes(&ctx->drm_ctx, drm_modes,
+                          max_modes < MAX_CONNECTOR_MODES ? max_modes : MAX_CONNECTOR_MODES);
+    if (count < 0) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        fill_mode(&modes[i], &drm_modes[i]);
+    }
+    return count;
+}
+
+/**
+ * Find the mode that shows the content at its own frame rate
+ */
+int display_output_find_content_mode(display_output_ctx_t *ctx, int fps_num, int fps_den,
+                                     int width, int height, display_mode_t *mode) {
+    display_mode_t modes[MAX_CONNECTOR_MODES];
+    int fit = width > 0 && height > 0;
+    int best = -1;
+    int best_multiple = 0;
+    int count;
+    
+    if (!ctx || !mode || fps_num <= 0 || fps_den <= 0) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    count = display_output_get_modes(ctx, modes, MAX_CONNECTOR_MODES);
+    if (count < 0) {
+        return count;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        const display_mode_t *m = &modes[i];
+        int multiple;
+        
+        if (m->interlaced ||
+            (fit ? m->width < width || m->height < height
+                 : m->width != ctx->info.width || m->height != ctx->info.height)) {
+            continue;
+        }
+        
+        multiple = refresh_multiple(m->refresh_mhz, fps_num, fps_den);
+        if (!multiple) {
+            continue;
+        }
+        
+        /* Fewest pixels first, then fewest repeats of each frame */
+        if (best >= 0) {
+            int64_t area = (int64_t)m->width * m->height;
+            int64_t best_area = (int64_t)modes[best].width * modes[best].height;
+            
+            if (area > best_area || (area == best_area && multiple >= best_multiple)) {
+                continue;
+            }
+        }
+        best = i;
+        best_multiple = multiple;
+    }
+    
+    if (best < 0) {
+        /* Content bigger than every matching mode: keep the resolution, match the rate */
+        return fit ? display_output_find_content_mode(ctx, fps_num, fps_den, 0, 0, mode) :
+                     DISPLAY_OUTPUT_EAGAIN;
+    }
+    
+    *mode = modes[best];
+    return DISPLAY_OUTPUT_OK;
+}
+
+/**
+ * Switch to another of the connector's modes
+ */
+int display_output_set_mode(display_output_ctx_t *ctx, const display_mode_t *mode) {
+    drmModeModeInfo drm_modes[MAX_CONNECTOR_MODES];
+    const drmModeModeInfo *match = NULL;
+    int count;
+    int resize;
+    int ret;
+    
+    if (!ctx || !mode || !ctx->configured) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    /* The CRTC is programmed with the first frame; until then the mode is free */
+    if (!ctx->drm_ctx.kms_enabled || ctx->drm_ctx.mode_set) {
+        fprintf(stderr, "Display mode can only change with KMS, before the first frame\n");
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    count = drm_get_modes(&ctx->drm_ctx, drm_modes, MAX_CONNECTOR_MODES);
+    for (int i = 0; i < count && !match; i++) {
+        display_mode_t candidate;
+        
+        fill_mode(&candidate, &drm_modes[i]);
+        if (candidate.width == mode->width && candidate.height == mode->height &&
+            candidate.refresh_mhz == mode->refresh_mhz && candidate.interlaced == mode->interlaced) {
+            match = &drm_modes[i];
+        }
+    }
+    if (!match) {
+        fprintf(stderr, "Mode %s is not offered by %s\n", mode->name, ctx->info.connector_name);
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    /* Further heads take the first one's mode, so they come up again afterwards */
+    for (int head = ctx->head_count - 1; head >= 1; head--) {
+        eglDestroySurface(ctx->egl_display, ctx->heads[head - 1].egl_surface);
+        drm_cleanup(&ctx->heads[head - 1].drm_ctx);
+    }
+    ctx->head_count = 1;
+    
+    /* A new size means a new GBM surface under our EGL window surface */
+    resize = mode->width != ctx->info.width || mode->height != ctx->info.height;
+    if (resize) {
+        eglMakeCurrent(ctx->egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroySurface(ctx->egl_display, ctx->egl_surface);
+    }
+    
+    ret = drm_set_mode(&ctx->drm_ctx, match);
+    
+    if (resize) {
+        /* On failure this is the old GBM surface again */
+        ctx->egl_surface = eglCreateWindowSurface(ctx->egl_display, ctx->egl_config,
+                                                  (EGLNativeWindowType)ctx->drm_ctx.gbm_surface,
+                                                  NULL);
+        if (ctx->egl_surface == EGL_NO_SURFACE ||
+            !eglMakeCurrent(ctx->egl_display, ctx->egl_surface, ctx->egl_surface,
+                            ctx->egl_context)) {
+            EGLint egl_error = eglGetError();
+            fprintf(stderr, "Failed to recreate EGL window surface: %s (0x%04x)\n",
+                    egl_error_string(egl_error), egl_error);
+            ret = DISPLAY_OUTPUT_ERROR;  /* The other heads still come back below */
+        }
+    }
+    
+    fill_head_info(ctx, &ctx->drm_ctx, &ctx->info);
+    if (ctx->config.head_count > 1) {
+        init_extra_heads(ctx);
+    }
+    if (ret < 0) {
+        return DISPLAY_OUTPUT_ERROR;
+    }
+    
+    printf("✓ Display mode %dx%d@%.3fHz on %s\n", ctx->info.width, ctx->info.height,
+           (double)mode->refresh_mhz / 1000.0, ctx->info.connector_name);
+    return DISPLAY_OUTPUT_OK;
+}
+
 /**
  * Check if DRM/KMS is available
  */
@@ -436,13 +1150,23 @@ void display_output_destroy(display_output_ctx_t *ctx) {
         if (ctx->egl_context != EGL_NO_CONTEXT) {
             eglDestroyContext(ctx->egl_display, ctx->egl_context);
         }
+        for (int head = 1; head < ctx->head_count; head++) {
+            eglDestroySurface(ctx->egl_display, ctx->heads[head - 1].egl_surface);
+        }
         if (ctx->egl_surface != EGL_NO_SURFACE) {
             eglDestroySurface(ctx->egl_display, ctx->egl_surface);
         }
         eglTerminate(ctx->egl_display);
     }
     
-    /* Clean up DRM using robust drm_display module */
+    if (ctx->last_fence_fd >= 0) {
+        close(ctx->last_fence_fd);
+    }
+    
+    /* Clean up DRM using robust drm_display module; the first head owns the device */
+    for (int head = ctx->head_count - 1; head >= 1; head--) {
+        drm_cleanup(&ctx->heads[head - 1].drm_ctx);
+    }
     drm_cleanup(&ctx->drm_ctx);
     
     free(ctx);
@@ -6,6 +6,7 @@
  * - EGL surface creation for direct display output
  * - Display configuration (resolution, refresh rate)
  * - Frame presentation and vsync
+ * - Further heads (Pi 4: second HDMI) on free CRTCs, paced with the first
  */
 
 #ifndef DISPLAY_OUTPUT_H
@@ -16,12 +17,16 @@
 #include <gbm.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
+#include "hw_decoder.h"
 
 /* Return codes */
 #define DISPLAY_OUTPUT_OK          0
 #define DISPLAY_OUTPUT_ERROR      -1
 #define DISPLAY_OUTPUT_EAGAIN     -2
 
+/* Most heads (CRTCs) driven at once */
+#define DISPLAY_OUTPUT_MAX_HEADS   2
+
 /* Forward declarations */
 typedef struct display_output_ctx display_output_ctx_t;
 
@@ -30,6 +35,7 @@ typedef struct {
     int width;
     int height;
     int refresh_rate;
+    int refresh_mhz;          /* Exact refresh in millihertz (59940 for 59.94 Hz) */
     int interlaced;
     char name[32];
 } display_mode_t;
@@ -43,6 +49,9 @@ typedef struct {
     int connector_id;        /* Specific connector ID (0 = auto) */
     int crtc_id;            /* Specific CRTC ID (0 = auto) */
     const char *device_path; /* DRM device path (NULL = auto) */
+    int headless;            /* Offscreen GBM surface: no scanout, no vsync (benchmarks) */
+    int head_count;          /* Heads to drive (0/1 = one, up to DISPLAY_OUTPUT_MAX_HEADS) */
+    int second_connector_id; /* Second head's connector ID (0 = next connected) */
 } display_config_t;
 
 /* Display information */
@@ -50,6 +59,7 @@ typedef struct {
     int width;
     int height;
     int refresh_rate;
+    int refresh_mhz;          /* Exact refresh in millihertz */
     int physical_width_mm;
     int physical_height_mm;
     char connector_name[32];
@@ -75,7 +85,7 @@ display_output_ctx_t *display_output_create(void);
 int display_output_configure(display_output_ctx_t *ctx, int width, int height, int refresh_rate);
 
 /**
- * Set advanced display configuration
+ * Set advanced display configuration (call before display_output_configure)
  * @param ctx Display context
  * @param config Advanced configuration options
  * @return 0 on success, negative on error
@@ -100,18 +110,125 @@ int display_output_get_info(display_output_ctx_t *ctx, display_info_t *info);
 int display_output_get_modes(display_output_ctx_t *ctx, display_mode_t *modes, int max_modes);
 
 /**
- * Present frame to display (swap buffers)
+ * Find the mode that shows the content at its own frame rate
+ * 
+ * Candidates refresh at an integer multiple of fps_num/fps_den (24 Hz or
+ * 48 Hz for 24p, 50 Hz for 25p, 59.94 Hz for 59.94p); the lowest multiple
+ * wins, as it repeats no frames. With width and height 0 only modes of the
+ * current resolution are considered, otherwise the smallest mode that holds
+ * a width x height frame.
+ * @param ctx Display context
+ * @param fps_num Content frame rate numerator
+ * @param fps_den Content frame rate denominator
+ * @param width Content width (0 = keep the current resolution)
+ * @param height Content height (0 = keep the current resolution)
+ * @param mode Output mode
+ * @return 0 if a mode matches, DISPLAY_OUTPUT_EAGAIN if none does, negative on error
+ */
+int display_output_find_content_mode(display_output_ctx_t *ctx, int fps_num, int fps_den,
+                                     int width, int height, display_mode_t *mode);
+
+/**
+ * Switch to another of the connector's modes (only before the first frame)
+ * 
+ * Further heads are brought up again in the new mode.
+ * @param ctx Display context
+ * @param mode Mode from display_output_get_modes()
+ * @return 0 on success, negative on error (the previous mode stays)
+ */
+int display_output_set_mode(display_output_ctx_t *ctx, const display_mode_t *mode);
+
+/**
+ * Present the rendered frame: one eglSwapBuffers, then a (fenced) page flip
+ * 
+ * With several heads every head's surface is swapped and flipped; each
+ * flip completes on its own CRTC's vblank.
  * @param ctx Display context
  * @return 0 on success, negative on error
  */
 int display_output_present_frame(display_output_ctx_t *ctx);
 
+/**
+ * Present decoded frame directly on a hardware overlay plane (bypasses GL)
+ * 
+ * The DMABUF planes are wrapped in a KMS framebuffer and shown through an
+ * atomic commit. The display keeps its own reference to the frame until it
+ * has left the screen, so the caller may release the frame right away.
+ * Single-head only: with more heads this always returns EAGAIN.
+ * @param ctx Display context
+ * @param frame Decoded DRM PRIME frame
+ * @return 0 on success, DISPLAY_OUTPUT_EAGAIN if the frame can't use the plane path, negative on error
+ */
+int display_output_present_dmabuf(display_output_ctx_t *ctx, const decoded_frame_t *frame);
+
+/**
+ * When the GPU finished rendering the last presented GL frame
+ * 
+ * Read from the frame's render fence once its flip has completed; only
+ * available with native fence sync.
+ * @param ctx Display context
+ * @param done_us Output CLOCK_MONOTONIC time in microseconds
+ * @return 0 on success, DISPLAY_OUTPUT_EAGAIN if not done yet, negative on error
+ */
+int display_output_get_render_done(display_output_ctx_t *ctx, uint64_t *done_us);
+
+/**
+ * Check if direct plane scanout is available
+ * @param ctx Display context
+ * @return 1 if available, 0 if not
+ */
+int display_output_plane_available(display_output_ctx_t *ctx);
+
 /**
  * Wait for vertical blank (vsync)
+ * 
+ * If a flip is pending this returns once it has landed, so the timestamp
+ * is the vblank the new frame became visible on. With several heads it
+ * returns once every head's flip has landed; the timestamp is the first head's.
  * @param ctx Display context
+ * @param timestamp_us Output vblank time, CLOCK_MONOTONIC microseconds (may be NULL)
  * @return 0 on success, negative on error
  */
-int display_output_wait_vblank(display_output_ctx_t *ctx);
+int display_output_wait_vblank(display_output_ctx_t *ctx, uint64_t *timestamp_us);
+
+/**
+ * Get the pollable DRM event fd (page flip and vblank events)
+ * @param ctx Display context
+ * @return File descriptor, or -1 without KMS scanout (use display_output_wait_vblank)
+ */
+int display_output_get_event_fd(display_output_ctx_t *ctx);
+
+/**
+ * Start a non-blocking vblank wait for an event loop
+ * 
+ * Same semantics as display_output_wait_vblank(): the pending flip if there
+ * is one, otherwise the next vblank. Poll the event fd, then call
+ * display_output_dispatch_events() until it returns 0.
+ * @param ctx Display context
+ * @return 0 on success, negative on error (or without an event fd)
+ */
+int display_output_begin_vblank_wait(display_output_ctx_t *ctx);
+
+/**
+ * Give up on a vblank wait whose event did not arrive in time
+ * 
+ * The next display_output_begin_vblank_wait() then requests a fresh event
+ * instead of waiting for the lost one.
+ * @param ctx Display context
+ */
+void display_output_cancel_vblank_wait(display_output_ctx_t *ctx);
+
+/**
+ * Handle DRM events waiting on the event fd (never blocks)
+ * 
+ * All heads share the event fd; the wait completes once the first head's
+ * vblank has arrived and no other head still has a flip in flight.
+ * @param ctx Display context
+ * @param timestamp_us Output vblank time once the wait completed (may be NULL)
+ * @return 0 when the wait has completed, DISPLAY_OUTPUT_EAGAIN if still
+ *         pending, negative on error
+ */
+int display_output_dispatch_events(display_output_ctx_t *ctx, uint64_t *timestamp_us);
 
 /**
  * Get EGL display handle (for renderer integration)
@@ -127,6 +244,33 @@ EGLDisplay display_output_get_egl_display(display_output_ctx_t *ctx);
  */
 EGLSurface display_output_get_egl_surface(display_output_ctx_t *ctx);
 
+/**
+ * Get the number of heads actually driven (may be fewer than requested)
+ * @param ctx Display context
+ * @return Head count, 0 if not configured
+ */
+int display_output_get_head_count(display_output_ctx_t *ctx);
+
+/**
+ * Get one head's EGL window surface (head 0 is display_output_get_egl_surface())
+ * 
+ * All heads share the EGL display, config and context; render to a head by
+ * making its surface current.
+ * @param ctx Display context
+ * @param head Head index
+ * @return EGL surface handle or EGL_NO_SURFACE on error
+ */
+EGLSurface display_output_get_head_surface(display_output_ctx_t *ctx, int head);
+
+/**
+ * Get one head's display information
+ * @param ctx Display context
+ * @param head Head index
+ * @param info Output display information
+ * @return 0 on success, negative on error
+ */
+int display_output_get_head_info(display_output_ctx_t *ctx, int head, display_info_t *info);
+
 /**
  * Get GBM device handle
  * @param ctx Display context
@@ -6,11 +6,15 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
+#include <time.h>
 #include <sys/mman.h>
 #include <sys/select.h>
 #include <stdint.h>
+#include <drm_fourcc.h>
 
-// Forward declarations - none needed for GBM-only implementation
+// Timeout for a single page flip event before we consider the CRTC stuck
+#define DRM_FLIP_TIMEOUT_MS 1000
 
 static const char *drm_device_paths[] = {
     "/dev/dri/card1",       // Working display card (detected by diagnostics)
@@ -20,6 +24,18 @@ static const char *drm_device_paths[] = {
     NULL
 };
 
+// Framebuffer bookkeeping attached to each scanout BO as GBM user data
+typedef struct {
+    int drm_fd;
+    uint32_t fb_id;
+} drm_fb_t;
+
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
 static int find_drm_device(void) {
     for (int i = 0; drm_device_paths[i]; i++) {
         int fd = open(drm_device_paths[i], O_RDWR | O_CLOEXEC);
@@ -27,7 +43,7 @@ static int find_drm_device(void) {
             return fd;
         }
     }
-    
+
     printf("\nTroubleshooting:\n");
     printf("1. Make sure you're in the 'render' group: groups | grep render\n");
     printf("2. If not, run: sudo usermod -a -G render $USER && logout\n");
@@ -35,57 +51,549 @@ static int find_drm_device(void) {
     return -1;
 }
 
+// Pick the connector mode closest to the requested one (0 = don't care)
+static int find_mode(drmModeConnector *connector, int width, int height,
+                     int refresh_rate, drmModeModeInfo *mode_out) {
+    int preferred = -1;
 
+    for (int i = 0; i < connector->count_modes; i++) {
+        drmModeModeInfo *m = &connector->modes[i];
 
-int drm_init(display_ctx_t *drm) {
-    memset(drm, 0, sizeof(*drm));
+        if ((width == 0 || m->hdisplay == width) &&
+            (height == 0 || m->vdisplay == height) &&
+            (refresh_rate == 0 || (int)m->vrefresh == refresh_rate) &&
+            (width || height || refresh_rate)) {
+            *mode_out = *m;
+            return 0;
+        }
+        if (preferred < 0 && (m->type & DRM_MODE_TYPE_PREFERRED)) {
+            preferred = i;
+        }
+    }
 
-    printf("Initializing GBM (Generic Buffer Manager) for hardware-accelerated rendering...\n");
+    if (connector->count_modes == 0) {
+        return -1;
+    }
 
-    // Open DRM device for GBM (no master required)
-    drm->drm_fd = find_drm_device();
-    if (drm->drm_fd < 0) {
-        fprintf(stderr, "Failed to open DRM device\n");
-        fprintf(stderr, "Hint: Make sure you're in the 'video' group: sudo usermod -a -G video $USER\n");
+    *mode_out = connector->modes[preferred >= 0 ? preferred : 0];
+    return 0;
+}
+
+// First CRTC one of the connector's encoders can drive: want_crtc if given,
+// never busy_crtc (already scanning out another head)
+static int pick_crtc(display_ctx_t *drm, drmModeRes *resources, drmModeConnector *connector,
+                     uint32_t want_crtc, uint32_t busy_crtc) {
+    drm->crtc_id = 0;
+    drm->crtc_index = -1;
+
+    for (int e = -1; e < connector->count_encoders && !drm->crtc_id; e++) {
+        // Prefer the CRTC already bound to the connector's current encoder
+        uint32_t encoder_id = e < 0 ? connector->encoder_id : connector->encoders[e];
+        if (!encoder_id || (e >= 0 && encoder_id == connector->encoder_id)) continue;
+
+        drmModeEncoder *encoder = drmModeGetEncoder(drm->drm_fd, encoder_id);
+        if (!encoder) continue;
+
+        for (int pass = 0; pass < 2 && !drm->crtc_id; pass++) {
+            for (int i = 0; i < resources->count_crtcs; i++) {
+                uint32_t crtc = resources->crtcs[i];
+                bool usable = pass == 0 ? (encoder->crtc_id && crtc == encoder->crtc_id)
+                                        : (encoder->possible_crtcs & (1u << i)) != 0;
+
+                if (!usable || crtc == busy_crtc || (want_crtc && crtc != want_crtc)) {
+                    continue;
+                }
+                drm->crtc_id = crtc;
+                drm->crtc_index = i;
+                break;
+            }
+        }
+        drmModeFreeEncoder(encoder);
+    }
+
+    return drm->crtc_id ? 0 : -1;
+}
+
+// Find a connected connector, a mode and a CRTC that can drive it.
+// want_connector/want_crtc pin the choice (0 = first free); other is a
+// head already set up on this device whose connector and CRTC are taken.
+static int kms_setup(display_ctx_t *drm, int width, int height, int refresh_rate,
+                     uint32_t want_connector, uint32_t want_crtc,
+                     const display_ctx_t *other) {
+    drmModeRes *resources = drmModeGetResources(drm->drm_fd);
+    if (!resources) {
+        fprintf(stderr, "Failed to get DRM resources: %s\n", strerror(errno));
         return -1;
     }
 
-    printf("Opened DRM device for GBM buffer management\n");
-    
-    // Note: We intentionally do NOT become DRM master
-    // This allows the system's display manager to handle mode setting
-    // while we use GBM for efficient buffer management
-
-    // For GBM-only mode, use standard display resolution without querying DRM
-    // This avoids need for DRM master permissions while still providing efficient buffers
-    drm->width = 1920;   // Standard HD resolution
-    drm->height = 1080;
-    drm->refresh_rate = 60;
-    
-    printf("Using GBM surface: %dx%d@%dHz (standard resolution)\n", 
-           drm->width, drm->height, drm->refresh_rate);
-    
-    // Initialize GBM buffer state
-    drm->current_bo = NULL;
-    drm->next_bo = NULL;
+    drmModeConnector *connector = NULL;
+    for (int i = 0; i < resources->count_connectors; i++) {
+        if ((want_connector && resources->connectors[i] != want_connector) ||
+            (other && resources->connectors[i] == other->connector_id)) {
+            continue;
+        }
+        drmModeConnector *conn = drmModeGetConnector(drm->drm_fd, resources->connectors[i]);
+        if (conn && conn->connection == DRM_MODE_CONNECTED && conn->count_modes > 0) {
+            connector = conn;
+            break;
+        }
+        if (conn) drmModeFreeConnector(conn);
+    }
+
+    if (!connector) {
+        if (want_connector) {
+            fprintf(stderr, "Connector %u is not connected\n", want_connector);
+        } else {
+            fprintf(stderr, "No %sconnected display connector found\n", other ? "other " : "");
+        }
+        drmModeFreeResources(resources);
+        return -1;
+    }
+
+    if (find_mode(connector, width, height, refresh_rate, &drm->mode) < 0) {
+        fprintf(stderr, "Connector %u has no usable modes\n", connector->connector_id);
+        drmModeFreeConnector(connector);
+        drmModeFreeResources(resources);
+        return -1;
+    }
+
+    pick_crtc(drm, resources, connector, want_crtc, other ? other->crtc_id : 0);
+
+    drm->connector_id = connector->connector_id;
+    drm->connector_type = connector->connector_type;
+    drm->connector_type_id = connector->connector_type_id;
+    drm->mm_width = connector->mmWidth;
+    drm->mm_height = connector->mmHeight;
+
+    drmModeFreeConnector(connector);
+    drmModeFreeResources(resources);
+
+    if (!drm->crtc_id) {
+        fprintf(stderr, "No CRTC available for connector %u\n", drm->connector_id);
+        return -1;
+    }
+
+    // Remember what was on screen so we can hand the display back cleanly
+    drm->saved_crtc = drmModeGetCrtc(drm->drm_fd, drm->crtc_id);
+
+    printf("KMS: connector %u, CRTC %u, mode %s (%dx%d@%dHz)\n",
+           drm->connector_id, drm->crtc_id, drm->mode.name,
+           drm->mode.hdisplay, drm->mode.vdisplay, drm->mode.vrefresh);
+    return 0;
+}
+
+static void drm_fb_destroy_callback(struct gbm_bo *bo, void *data) {
+    drm_fb_t *fb = data;
+    (void)bo;
+
+    if (fb->fb_id) {
+        drmModeRmFB(fb->drm_fd, fb->fb_id);
+    }
+    free(fb);
+}
+
+// Return the KMS framebuffer for a BO, creating it on first use.
+// GBM surfaces recycle a small set of BOs, so this is a one-time cost per BO.
+static uint32_t drm_fb_get_from_bo(display_ctx_t *drm, struct gbm_bo *bo) {
+    drm_fb_t *fb = gbm_bo_get_user_data(bo);
+    if (fb) {
+        return fb->fb_id;
+    }
+
+    fb = calloc(1, sizeof(*fb));
+    if (!fb) {
+        return 0;
+    }
+    fb->drm_fd = drm->drm_fd;
+
+    uint32_t width = gbm_bo_get_width(bo);
+    uint32_t height = gbm_bo_get_height(bo);
+    uint32_t handles[4] = { gbm_bo_get_handle(bo).u32, 0, 0, 0 };
+    uint32_t pitches[4] = { gbm_bo_get_stride(bo), 0, 0, 0 };
+    uint32_t offsets[4] = { 0, 0, 0, 0 };
+
+    int ret = drmModeAddFB2(drm->drm_fd, width, height, gbm_bo_get_format(bo),
+                            handles, pitches, offsets, &fb->fb_id, 0);
+    if (ret) {
+        // Older kernels/drivers: fall back to the legacy depth/bpp interface
+        ret = drmModeAddFB(drm->drm_fd, width, height, 24, 32,
+                           pitches[0], handles[0], &fb->fb_id);
+    }
+    if (ret) {
+        fprintf(stderr, "Failed to create framebuffer: %s\n", strerror(errno));
+        free(fb);
+        return 0;
+    }
+
+    gbm_bo_set_user_data(bo, fb, drm_fb_destroy_callback);
+    return fb->fb_id;
+}
+
+static uint32_t get_property_id(int fd, uint32_t object_id, uint32_t object_type,
+                                const char *name, uint64_t *value_out) {
+    drmModeObjectProperties *props = drmModeObjectGetProperties(fd, object_id, object_type);
+    uint32_t prop_id = 0;
+
+    if (!props) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < props->count_props && !prop_id; i++) {
+        drmModePropertyRes *prop = drmModeGetProperty(fd, props->props[i]);
+        if (prop) {
+            if (strcmp(prop->name, name) == 0) {
+                prop_id = prop->prop_id;
+                if (value_out) {
+                    *value_out = props->prop_values[i];
+                }
+            }
+            drmModeFreeProperty(prop);
+        }
+    }
+
+    drmModeFreeObjectProperties(props);
+    return prop_id;
+}
+
+// Collect the format/modifier pairs from the plane's IN_FORMATS blob
+static void get_plane_format_mods(display_ctx_t *drm, uint32_t plane_id) {
+    uint64_t blob_id = 0;
+
+    drm->overlay_format_mod_count = 0;
+    if (!get_property_id(drm->drm_fd, plane_id, DRM_MODE_OBJECT_PLANE, "IN_FORMATS", &blob_id) ||
+        !blob_id) {
+        return;
+    }
+
+    drmModePropertyBlobRes *blob = drmModeGetPropertyBlob(drm->drm_fd, (uint32_t)blob_id);
+    if (!blob) {
+        return;
+    }
+
+    const struct drm_format_modifier_blob *header = blob->data;
+    if (blob->length < sizeof(*header) ||
+        header->formats_offset + (uint64_t)header->count_formats * sizeof(uint32_t) > blob->length ||
+        header->modifiers_offset +
+            (uint64_t)header->count_modifiers * sizeof(struct drm_format_modifier) > blob->length) {
+        drmModeFreePropertyBlob(blob);
+        return;
+    }
+
+    const uint32_t *formats = (const uint32_t *)((const char *)header + header->formats_offset);
+    const struct drm_format_modifier *mods =
+        (const struct drm_format_modifier *)((const char *)header + header->modifiers_offset);
+
+    // Each modifier carries a 64-bit mask of formats, starting at its offset
+    for (uint32_t m = 0; m < header->count_modifiers; m++) {
+        for (uint32_t bit = 0; bit < 64; bit++) {
+            uint32_t index = mods[m].offset + bit;
+
+            if (!(mods[m].formats & (1ULL << bit)) || index >= header->count_formats) {
+                continue;
+            }
+            if (drm->overlay_format_mod_count == DRM_MAX_PLANE_FORMAT_MODS) {
+                break;
+            }
+            drm->overlay_format_mods[drm->overlay_format_mod_count].format = formats[index];
+            drm->overlay_format_mods[drm->overlay_format_mod_count].modifier = mods[m].modifier;
+            drm->overlay_format_mod_count++;
+        }
+    }
+
+    drmModeFreePropertyBlob(blob);
+}
+
+static int get_plane_props(int fd, uint32_t plane_id, drm_plane_props_t *props) {
+    props->fb_id = get_property_id(fd, plane_id, DRM_MODE_OBJECT_PLANE, "FB_ID", NULL);
+    props->crtc_id = get_property_id(fd, plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_ID", NULL);
+    props->src_x = get_property_id(fd, plane_id, DRM_MODE_OBJECT_PLANE, "SRC_X", NULL);
+    props->src_y = get_property_id(fd, plane_id, DRM_MODE_OBJECT_PLANE, "SRC_Y", NULL);
+    props->src_w = get_property_id(fd, plane_id, DRM_MODE_OBJECT_PLANE, "SRC_W", NULL);
+    props->src_h = get_property_id(fd, plane_id, DRM_MODE_OBJECT_PLANE, "SRC_H", NULL);
+    props->crtc_x = get_property_id(fd, plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_X", NULL);
+    props->crtc_y = get_property_id(fd, plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_Y", NULL);
+    props->crtc_w = get_property_id(fd, plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_W", NULL);
+    props->crtc_h = get_property_id(fd, plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_H", NULL);
+    props->in_fence_fd = get_property_id(fd, plane_id, DRM_MODE_OBJECT_PLANE, "IN_FENCE_FD", NULL);
+
+    return (props->fb_id && props->crtc_id && props->src_x && props->src_y &&
+            props->src_w && props->src_h && props->crtc_x && props->crtc_y &&
+            props->crtc_w && props->crtc_h) ? 0 : -1;
+}
 
-    // Initialize GBM device
-    drm->gbm_device = gbm_create_device(drm->drm_fd);
+// Enable atomic modesetting and find a primary + overlay plane for our CRTC
+// (skipping planes another head on the device already uses).
+// Failure is not fatal: we just keep presenting through GL.
+static int atomic_setup(display_ctx_t *drm, const display_ctx_t *other) {
+    uint64_t value = 0;
+
+    if (drmSetClientCap(drm->drm_fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) ||
+        drmSetClientCap(drm->drm_fd, DRM_CLIENT_CAP_ATOMIC, 1)) {
+        printf("Atomic modesetting not supported - direct plane scanout disabled\n");
+        return -1;
+    }
+
+    drmModePlaneRes *plane_res = drmModeGetPlaneResources(drm->drm_fd);
+    if (!plane_res) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < plane_res->count_planes; i++) {
+        drmModePlane *plane = drmModeGetPlane(drm->drm_fd, plane_res->planes[i]);
+        if (!plane) continue;
+
+        if (!(plane->possible_crtcs & (1u << drm->crtc_index)) ||
+            (other && (plane->plane_id == other->primary_plane_id ||
+                       plane->plane_id == other->overlay_plane_id))) {
+            drmModeFreePlane(plane);
+            continue;
+        }
+
+        if (!get_property_id(drm->drm_fd, plane->plane_id, DRM_MODE_OBJECT_PLANE,
+                             "type", &value)) {
+            drmModeFreePlane(plane);
+            continue;
+        }
+
+        if (value == DRM_PLANE_TYPE_PRIMARY && !drm->primary_plane_id) {
+            drm->primary_plane_id = plane->plane_id;
+        } else if (value == DRM_PLANE_TYPE_OVERLAY && !drm->overlay_plane_id) {
+            drm->overlay_plane_id = plane->plane_id;
+            drm->overlay_format_count = 0;
+            for (uint32_t f = 0; f < plane->count_formats &&
+                                 drm->overlay_format_count < DRM_MAX_PLANE_FORMATS; f++) {
+                drm->overlay_formats[drm->overlay_format_count++] = plane->formats[f];
+            }
+            get_plane_format_mods(drm, plane->plane_id);
+        }
+        drmModeFreePlane(plane);
+    }
+    drmModeFreePlaneResources(plane_res);
+
+    if (!drm->primary_plane_id || !drm->overlay_plane_id ||
+        get_plane_props(drm->drm_fd, drm->primary_plane_id, &drm->primary_props) < 0 ||
+        get_plane_props(drm->drm_fd, drm->overlay_plane_id, &drm->overlay_props) < 0) {
+        printf("No usable overlay plane - direct plane scanout disabled\n");
+        drm->primary_plane_id = 0;
+        drm->overlay_plane_id = 0;
+        return -1;
+    }
+
+    drm->atomic_enabled = true;
+    printf("✓ Atomic KMS: primary plane %u, overlay plane %u (%d formats, %d with modifiers)\n",
+           drm->primary_plane_id, drm->overlay_plane_id, drm->overlay_format_count,
+           drm->overlay_format_mod_count);
+    return 0;
+}
+
+static bool plane_fb_uses_handle(const drm_plane_fb_t *fb, uint32_t handle) {
+    for (int i = 0; i < 4; i++) {
+        if (fb->handles[i] == handle) return true;
+    }
+    return false;
+}
+
+// Drop a framebuffer that has left the overlay plane and hand its owner back
+static void plane_fb_release(display_ctx_t *drm, drm_plane_fb_t *fb) {
+    if (fb->fb_id) {
+        drmModeRmFB(drm->drm_fd, fb->fb_id);
+    }
+
+    // GEM handles are per dmabuf, so two live framebuffers may share one
+    for (int i = 0; i < 4; i++) {
+        uint32_t handle = fb->handles[i];
+        bool seen = false;
+
+        if (!handle) continue;
+        for (int j = 0; j < i; j++) {
+            if (fb->handles[j] == handle) seen = true;
+        }
+        if (seen || plane_fb_uses_handle(&drm->plane_current, handle) ||
+            plane_fb_uses_handle(&drm->plane_next, handle)) {
+            continue;
+        }
+
+        struct drm_gem_close gem_close = { .handle = handle };
+        drmIoctl(drm->drm_fd, DRM_IOCTL_GEM_CLOSE, &gem_close);
+    }
+
+    if (fb->opaque && drm->plane_release) {
+        drm->plane_release(fb->opaque);
+    }
+    memset(fb, 0, sizeof(*fb));
+}
+
+static void atomic_add_plane(drmModeAtomicReq *req, uint32_t plane_id,
+                             const drm_plane_props_t *props, uint32_t fb_id,
+                             uint32_t crtc_id, uint32_t src_w, uint32_t src_h,
+                             uint32_t crtc_w, uint32_t crtc_h) {
+    drmModeAtomicAddProperty(req, plane_id, props->fb_id, fb_id);
+    drmModeAtomicAddProperty(req, plane_id, props->crtc_id, crtc_id);
+    if (!fb_id) {
+        return;  // Disabling the plane
+    }
+    // Source coordinates are 16.16 fixed point
+    drmModeAtomicAddProperty(req, plane_id, props->src_x, 0);
+    drmModeAtomicAddProperty(req, plane_id, props->src_y, 0);
+    drmModeAtomicAddProperty(req, plane_id, props->src_w, (uint64_t)src_w << 16);
+    drmModeAtomicAddProperty(req, plane_id, props->src_h, (uint64_t)src_h << 16);
+    drmModeAtomicAddProperty(req, plane_id, props->crtc_x, 0);
+    drmModeAtomicAddProperty(req, plane_id, props->crtc_y, 0);
+    drmModeAtomicAddProperty(req, plane_id, props->crtc_w, crtc_w);
+    drmModeAtomicAddProperty(req, plane_id, props->crtc_h, crtc_h);
+}
+
+static void drm_page_flip_handler(int fd, unsigned int sequence,
+                                  unsigned int tv_sec, unsigned int tv_usec,
+                                  void *user_data) {
+    display_ctx_t *drm = user_data;
+    (void)fd;
+
+    drm->flip_pending = false;
+    drm->last_vblank_seq = sequence;
+    drm->last_vblank_us = (uint64_t)tv_sec * 1000000ULL + tv_usec;
+    drm->flips_completed++;
+
+    // The previous front buffer is no longer scanned out
+    if (drm->next_bo) {
+        if (drm->current_bo) {
+            gbm_surface_release_buffer(drm->gbm_surface, drm->current_bo);
+        }
+        drm->current_bo = drm->next_bo;
+        drm->next_bo = NULL;
+    }
+
+    // Same for the overlay plane when this flip changed its contents
+    if (drm->plane_flip_pending) {
+        drm_plane_fb_t old = drm->plane_current;
+        drm->plane_current = drm->plane_next;
+        memset(&drm->plane_next, 0, sizeof(drm->plane_next));
+        drm->plane_flip_pending = false;
+        plane_fb_release(drm, &old);
+    }
+}
+
+static void drm_vblank_handler(int fd, unsigned int sequence,
+                               unsigned int tv_sec, unsigned int tv_usec,
+                               void *user_data) {
+    display_ctx_t *drm = user_data;
+    (void)fd;
+
+    drm->vblank_pending = false;
+    drm->last_vblank_seq = sequence;
+    drm->last_vblank_us = (uint64_t)tv_sec * 1000000ULL + tv_usec;
+}
+
+// drmHandleEvent on a readable fd (one read, every queued event)
+static int drm_read_events(display_ctx_t *drm) {
+    drmEventContext evctx = {
+        .version = 2,
+        .vblank_handler = drm_vblank_handler,
+        .page_flip_handler = drm_page_flip_handler,
+    };
+
+    if (drmHandleEvent(drm->drm_fd, &evctx) != 0) {
+        fprintf(stderr, "drmHandleEvent failed: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// Block until a DRM event arrives and dispatch it
+static int drm_handle_events(display_ctx_t *drm, int timeout_ms) {
+    struct pollfd pfd = { .fd = drm->drm_fd, .events = POLLIN };
+
+    int ret = poll(&pfd, 1, timeout_ms);
+    if (ret < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        fprintf(stderr, "poll on DRM fd failed: %s\n", strerror(errno));
+        return -1;
+    }
+    if (ret == 0) {
+        fprintf(stderr, "Timed out waiting for DRM event\n");
+        return -1;
+    }
+
+    return drm_read_events(drm);
+}
+
+
+
+// GBM device plus a render target surface sized drm->width x drm->height
+static int gbm_setup(display_ctx_t *drm) {
+    // Further heads come with the first head's device already set
+    if (!drm->gbm_device) {
+        drm->gbm_device = gbm_create_device(drm->drm_fd);
+    }
     if (!drm->gbm_device) {
         fprintf(stderr, "Failed to create GBM device\n");
-        close(drm->drm_fd);
+        drm_cleanup(drm);
         return -1;
     }
 
-    // Create GBM surface for efficient buffer management
+    // Scanout BOs are only needed when we hand them to KMS ourselves
+    uint32_t bo_flags = GBM_BO_USE_RENDERING;
+    if (drm->kms_enabled) {
+        bo_flags |= GBM_BO_USE_SCANOUT;
+    }
+
     drm->gbm_surface = gbm_surface_create(drm->gbm_device,
                                           drm->width, drm->height,
                                           GBM_FORMAT_XRGB8888,
-                                          GBM_BO_USE_RENDERING);  // Only rendering, no scanout needed
+                                          bo_flags);
     if (!drm->gbm_surface) {
         fprintf(stderr, "Failed to create GBM surface\n");
-        gbm_device_destroy(drm->gbm_device);
-        close(drm->drm_fd);
+        drm_cleanup(drm);
+        return -1;
+    }
+
+    return 0;
+}
+
+int drm_init(display_ctx_t *drm, int width, int height, int refresh_rate,
+             uint32_t connector_id, uint32_t crtc_id) {
+    memset(drm, 0, sizeof(*drm));
+    drm->crtc_index = -1;
+
+    printf("Initializing GBM (Generic Buffer Manager) for hardware-accelerated rendering...\n");
+
+    drm->drm_fd = find_drm_device();
+    if (drm->drm_fd < 0) {
+        fprintf(stderr, "Failed to open DRM device\n");
+        fprintf(stderr, "Hint: Make sure you're in the 'video' group: sudo usermod -a -G video $USER\n");
+        return -1;
+    }
+
+    printf("Opened DRM device for GBM buffer management\n");
+
+    // Try to become DRM master so we can scan out our own buffers.
+    // If a display manager already owns the device we fall back to
+    // GBM-only buffer management and leave mode setting to it.
+    if (drmSetMaster(drm->drm_fd) == 0 &&
+        kms_setup(drm, width, height, refresh_rate, connector_id, crtc_id, NULL) == 0) {
+        drm->kms_enabled = true;
+        drm->width = drm->mode.hdisplay;
+        drm->height = drm->mode.vdisplay;
+        drm->refresh_rate = drm->mode.vrefresh;
+        printf("✓ DRM master acquired - using KMS page-flip scanout\n");
+        atomic_setup(drm, NULL);
+    } else {
+        // Don't keep master we can't use - a compositor may want it back
+        drmDropMaster(drm->drm_fd);
+        printf("DRM master not available - using GBM-only mode (no scanout)\n");
+
+        // For GBM-only mode, use the requested or standard display resolution
+        drm->width = width > 0 ? (uint32_t)width : 1920;
+        drm->height = height > 0 ? (uint32_t)height : 1080;
+        drm->refresh_rate = refresh_rate > 0 ? (uint32_t)refresh_rate : 60;
+
+        printf("Using GBM surface: %dx%d@%dHz (standard resolution)\n",
+               drm->width, drm->height, drm->refresh_rate);
+    }
+
+    if (gbm_setup(drm) < 0) {
         return -1;
     }
 
@@ -93,58 +601,501 @@ int drm_init(display_ctx_t *drm) {
     return 0;
 }
 
+int drm_init_head(display_ctx_t *drm, const display_ctx_t *first, int width, int height,
+                  int refresh_rate, uint32_t connector_id) {
+    memset(drm, 0, sizeof(*drm));
+    drm->crtc_index = -1;
+    drm->drm_fd = -1;
+
+    // Another CRTC on the same device needs the master the first head holds
+    if (!first->kms_enabled) {
+        fprintf(stderr, "Second head needs KMS scanout on the first one\n");
+        return -1;
+    }
+
+    drm->drm_fd = first->drm_fd;
+    drm->gbm_device = first->gbm_device;
+    drm->shared_device = true;
+
+    if (kms_setup(drm, width, height, refresh_rate, connector_id, 0, first) < 0) {
+        drm->drm_fd = -1;
+        drm->gbm_device = NULL;
+        return -1;
+    }
+    drm->kms_enabled = true;
+    drm->width = drm->mode.hdisplay;
+    drm->height = drm->mode.vdisplay;
+    drm->refresh_rate = drm->mode.vrefresh;
+    if (first->atomic_enabled) {
+        atomic_setup(drm, first);
+    }
+
+    if (gbm_setup(drm) < 0) {
+        return -1;
+    }
+
+    printf("✓ Second head on CRTC %u sharing the DRM device\n", drm->crtc_id);
+    return 0;
+}
+
+int drm_get_modes(display_ctx_t *drm, drmModeModeInfo *modes, int max_modes) {
+    if (!drm->kms_enabled) {
+        return 0;
+    }
+
+    // kms_setup() already probed the connector; don't read the EDID again
+    drmModeConnector *connector = drmModeGetConnectorCurrent(drm->drm_fd, drm->connector_id);
+    if (!connector) {
+        fprintf(stderr, "Failed to get connector %u: %s\n", drm->connector_id, strerror(errno));
+        return -1;
+    }
+
+    int count = connector->count_modes < max_modes ? connector->count_modes : max_modes;
+    if (count > 0) {
+        memcpy(modes, connector->modes, (size_t)count * sizeof(*modes));
+    }
+    drmModeFreeConnector(connector);
+    return count;
+}
+
+int drm_set_mode(display_ctx_t *drm, const drmModeModeInfo *mode) {
+    if (!drm->kms_enabled || drm->mode_set || drm->current_bo) {
+        fprintf(stderr, "Display mode can only change before the first frame\n");
+        return -1;
+    }
+
+    // A new size needs a new surface; keep the old one until that worked
+    if (mode->hdisplay != drm->width || mode->vdisplay != drm->height) {
+        struct gbm_surface *surface = gbm_surface_create(drm->gbm_device,
+                                                         mode->hdisplay, mode->vdisplay,
+                                                         GBM_FORMAT_XRGB8888,
+                                                         GBM_BO_USE_SCANOUT | GBM_BO_USE_RENDERING);
+        if (!surface) {
+            fprintf(stderr, "Failed to create %ux%u GBM surface\n", mode->hdisplay, mode->vdisplay);
+            return -1;
+        }
+        gbm_surface_destroy(drm->gbm_surface);
+        drm->gbm_surface = surface;
+    }
+
+    drm->mode = *mode;
+    drm->width = mode->hdisplay;
+    drm->height = mode->vdisplay;
+    drm->refresh_rate = mode->vrefresh;
+    printf("KMS: connector %u switched to mode %s (%dx%d@%dHz)\n",
+           drm->connector_id, drm->mode.name,
+           drm->mode.hdisplay, drm->mode.vdisplay, drm->mode.vrefresh);
+    return 0;
+}
+
+int drm_init_offscreen(display_ctx_t *drm, int width, int height) {
+    memset(drm, 0, sizeof(*drm));
+    drm->crtc_index = -1;
+
+    // The render node needs no master and never touches the connected display
+    drm->drm_fd = open("/dev/dri/renderD128", O_RDWR | O_CLOEXEC);
+    if (drm->drm_fd < 0) {
+        drm->drm_fd = find_drm_device();
+    }
+    if (drm->drm_fd < 0) {
+        fprintf(stderr, "Failed to open DRM device\n");
+        return -1;
+    }
+
+    drm->width = width > 0 ? (uint32_t)width : 1920;
+    drm->height = height > 0 ? (uint32_t)height : 1080;
+    drm->refresh_rate = 60;
 
+    if (gbm_setup(drm) < 0) {
+        return -1;
+    }
 
+    printf("✓ Offscreen GBM surface: %dx%d (no scanout, no vsync)\n", drm->width, drm->height);
+    return 0;
+}
 
+// Primary plane flip through atomic, with an explicit render fence if we have one
+static int atomic_flip_primary(display_ctx_t *drm, uint32_t fb_id, int in_fence_fd) {
+    drmModeAtomicReq *req = drmModeAtomicAlloc();
+    if (!req) {
+        return -1;
+    }
 
+    drmModeAtomicAddProperty(req, drm->primary_plane_id, drm->primary_props.fb_id, fb_id);
+    if (in_fence_fd >= 0 && drm->primary_props.in_fence_fd) {
+        // KMS waits for the GPU itself; nobody blocks on the CPU
+        drmModeAtomicAddProperty(req, drm->primary_plane_id, drm->primary_props.in_fence_fd,
+                                 (uint64_t)in_fence_fd);
+    }
+    if (drm->plane_active) {
+        // Coming back from direct scanout: show the GL frame and take the
+        // overlay down in the same commit so nothing stale is ever visible
+        atomic_add_plane(req, drm->overlay_plane_id, &drm->overlay_props,
+                         0, 0, 0, 0, 0, 0);
+    }
 
+    int ret = drmModeAtomicCommit(drm->drm_fd, req,
+                                  DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT,
+                                  drm);
+    drmModeAtomicFree(req);
+    if (ret) {
+        fprintf(stderr, "Failed to commit primary plane: %s\n", strerror(errno));
+        return -1;
+    }
 
-int drm_swap_buffers(display_ctx_t *drm) {
-    // GBM-only buffer management without DRM master requirements
-    
-    // Get the front buffer from GBM surface
-    drm->next_bo = gbm_surface_lock_front_buffer(drm->gbm_surface);
-    if (!drm->next_bo) {
+    if (drm->plane_active) {
+        drm->plane_active = false;
+        drm->plane_flip_pending = true;
+    }
+    return 0;
+}
+
+static int drm_swap_buffers_fenced(display_ctx_t *drm, int in_fence_fd) {
+    struct gbm_bo *bo = gbm_surface_lock_front_buffer(drm->gbm_surface);
+    if (!bo) {
         fprintf(stderr, "Failed to lock front buffer\n");
         return -1;
     }
-    
-    // Release previous buffer if we have one
-    if (drm->current_bo) {
-        gbm_surface_release_buffer(drm->gbm_surface, drm->current_bo);
+
+    if (!drm->kms_enabled) {
+        // GBM-only buffer management: nothing is scanned out, just recycle
+        if (drm->current_bo) {
+            gbm_surface_release_buffer(drm->gbm_surface, drm->current_bo);
+        }
+        drm->current_bo = bo;
+        return 0;
+    }
+
+    uint32_t fb_id = drm_fb_get_from_bo(drm, bo);
+    if (!fb_id) {
+        gbm_surface_release_buffer(drm->gbm_surface, bo);
+        return -1;
+    }
+
+    // First frame: program the mode with this buffer on the primary plane
+    if (!drm->mode_set) {
+        if (drmModeSetCrtc(drm->drm_fd, drm->crtc_id, fb_id, 0, 0,
+                           &drm->connector_id, 1, &drm->mode)) {
+            fprintf(stderr, "Failed to set CRTC mode: %s\n", strerror(errno));
+            gbm_surface_release_buffer(drm->gbm_surface, bo);
+            return -1;
+        }
+        drm->mode_set = true;
+        drm->last_vblank_us = monotonic_us();
+        if (drm->current_bo) {
+            gbm_surface_release_buffer(drm->gbm_surface, drm->current_bo);
+        }
+        drm->current_bo = bo;
+        return 0;
+    }
+
+    // Only one flip may be queued per CRTC; this is where we get paced to vblank
+    if (drm_wait_for_flip(drm) < 0) {
+        gbm_surface_release_buffer(drm->gbm_surface, bo);
+        return -1;
+    }
+
+    if (drm->atomic_enabled) {
+        if (atomic_flip_primary(drm, fb_id, in_fence_fd) < 0) {
+            gbm_surface_release_buffer(drm->gbm_surface, bo);
+            return -1;
+        }
+    } else if (drmModePageFlip(drm->drm_fd, drm->crtc_id, fb_id,
+                               DRM_MODE_PAGE_FLIP_EVENT, drm)) {
+        // Legacy flips rely on the kernel's implicit sync on the BO
+        fprintf(stderr, "Failed to queue page flip: %s\n", strerror(errno));
+        gbm_surface_release_buffer(drm->gbm_surface, bo);
+        return -1;
+    }
+
+    drm->next_bo = bo;
+    drm->flip_pending = true;
+    return 0;
+}
+
+int drm_swap_buffers(display_ctx_t *drm, int in_fence_fd) {
+    int ret = drm_swap_buffers_fenced(drm, in_fence_fd);
+
+    // The kernel takes its own reference during the commit
+    if (in_fence_fd >= 0) {
+        close(in_fence_fd);
+    }
+    return ret;
+}
+
+bool drm_plane_supports_format(display_ctx_t *drm, uint32_t format, uint64_t modifier) {
+    bool found = false;
+
+    if (!drm->atomic_enabled) {
+        return false;
+    }
+    for (int i = 0; i < drm->overlay_format_count && !found; i++) {
+        found = drm->overlay_formats[i] == format;
+    }
+    if (!found || modifier == DRM_FORMAT_MOD_INVALID) {
+        return found;
+    }
+
+    // Without IN_FORMATS the plane only promises linear buffers
+    if (drm->overlay_format_mod_count == 0) {
+        return modifier == DRM_FORMAT_MOD_LINEAR;
+    }
+    for (int i = 0; i < drm->overlay_format_mod_count; i++) {
+        if (drm->overlay_format_mods[i].format == format &&
+            drm->overlay_format_mods[i].modifier == modifier) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int drm_plane_present(display_ctx_t *drm, const drm_plane_buffer_t *buf) {
+    drm_plane_fb_t fb;
+    uint32_t pitches[4] = {0}, offsets[4] = {0};
+    uint64_t modifiers[4] = {0};
+    int ret;
+
+    // The CRTC has to be running (first GL frame sets the mode)
+    if (!drm->mode_set || !drm_plane_supports_format(drm, buf->format, buf->modifier) ||
+        buf->num_planes < 1 || buf->num_planes > 4) {
+        return -1;
+    }
+
+    if (drm_wait_for_flip(drm) < 0) {
+        return -1;
+    }
+
+    memset(&fb, 0, sizeof(fb));
+    for (int i = 0; i < buf->num_planes; i++) {
+        if (drmPrimeFDToHandle(drm->drm_fd, buf->fds[i], &fb.handles[i])) {
+            fprintf(stderr, "Failed to import dmabuf fd %d: %s\n", buf->fds[i], strerror(errno));
+            plane_fb_release(drm, &fb);
+            return -1;
+        }
+        pitches[i] = buf->pitches[i];
+        offsets[i] = buf->offsets[i];
+        modifiers[i] = buf->modifier;
+    }
+
+    if (buf->modifier != DRM_FORMAT_MOD_INVALID) {
+        ret = drmModeAddFB2WithModifiers(drm->drm_fd, buf->width, buf->height, buf->format,
+                                         fb.handles, pitches, offsets, modifiers,
+                                         &fb.fb_id, DRM_MODE_FB_MODIFIERS);
+    } else {
+        ret = drmModeAddFB2(drm->drm_fd, buf->width, buf->height, buf->format,
+                            fb.handles, pitches, offsets, &fb.fb_id, 0);
+    }
+    if (ret) {
+        fprintf(stderr, "Failed to create plane framebuffer: %s\n", strerror(errno));
+        plane_fb_release(drm, &fb);
+        return -1;
+    }
+
+    drmModeAtomicReq *req = drmModeAtomicAlloc();
+    if (!req) {
+        plane_fb_release(drm, &fb);
+        return -1;
+    }
+
+    // Scale the frame to the whole CRTC, same as the GL fullscreen quad
+    atomic_add_plane(req, drm->overlay_plane_id, &drm->overlay_props,
+                     fb.fb_id, drm->crtc_id, buf->width, buf->height,
+                     drm->mode.hdisplay, drm->mode.vdisplay);
+
+    ret = drmModeAtomicCommit(drm->drm_fd, req,
+                              DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT, drm);
+    drmModeAtomicFree(req);
+    if (ret) {
+        fprintf(stderr, "Failed to commit overlay plane: %s\n", strerror(errno));
+        plane_fb_release(drm, &fb);
+        return -1;
+    }
+
+    // Ownership of buf->opaque passes to us only once the commit is queued
+    fb.opaque = buf->opaque;
+    drm->plane_next = fb;
+    drm->plane_flip_pending = true;
+    drm->plane_active = true;
+    drm->flip_pending = true;
+    return 0;
+}
+
+int drm_wait_for_flip(display_ctx_t *drm) {
+    while (drm->flip_pending) {
+        if (drm_handle_events(drm, DRM_FLIP_TIMEOUT_MS) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int drm_wait_vblank(display_ctx_t *drm, uint64_t *timestamp_us) {
+    if (drm->kms_enabled && drm->mode_set) {
+        if (drm->flip_pending) {
+            // The flip event is delivered at the vblank it completed on
+            if (drm_wait_for_flip(drm) < 0) {
+                return -1;
+            }
+        } else {
+            drmVBlank vbl;
+            memset(&vbl, 0, sizeof(vbl));
+            vbl.request.type = DRM_VBLANK_RELATIVE;
+            if (drm->crtc_index > 1) {
+                vbl.request.type |= (drm->crtc_index << DRM_VBLANK_HIGH_CRTC_SHIFT) &
+                                    DRM_VBLANK_HIGH_CRTC_MASK;
+            } else if (drm->crtc_index == 1) {
+                vbl.request.type |= DRM_VBLANK_SECONDARY;
+            }
+            vbl.request.sequence = 1;
+
+            if (drmWaitVBlank(drm->drm_fd, &vbl)) {
+                fprintf(stderr, "drmWaitVBlank failed: %s\n", strerror(errno));
+                return -1;
+            }
+            drm->last_vblank_seq = vbl.reply.sequence;
+            drm->last_vblank_us = (uint64_t)vbl.reply.tval_sec * 1000000ULL +
+                                  (uint64_t)vbl.reply.tval_usec;
+        }
+    } else {
+        // No CRTC to wait on: pace to a steady software vblank at refresh_rate
+        uint64_t period_us = 1000000ULL / (drm->refresh_rate ? drm->refresh_rate : 60);
+        uint64_t now = monotonic_us();
+        uint64_t next = drm->last_vblank_us + period_us;
+
+        if (drm->last_vblank_us == 0 || next + period_us < now) {
+            // First call or we fell far behind: resynchronise instead of bursting
+            next = now + period_us;
+        }
+
+        struct timespec ts = {
+            .tv_sec = (time_t)(next / 1000000ULL),
+            .tv_nsec = (long)(next % 1000000ULL) * 1000L,
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+
+        drm->last_vblank_seq++;
+        drm->last_vblank_us = next;
+    }
+
+    if (timestamp_us) {
+        *timestamp_us = drm->last_vblank_us;
     }
-    
-    // Update current buffer
-    drm->current_bo = drm->next_bo;
-    
-    // GBM buffer management successful - no DRM master operations needed
-    // The EGL context and OpenGL rendering handles the actual display output
-    // through the existing display manager or compositor
-    
     return 0;
 }
 
+int drm_request_vblank_event(display_ctx_t *drm) {
+    if (!drm->kms_enabled || !drm->mode_set) {
+        return -1;
+    }
+    // A pending flip already delivers an event at the vblank it lands on
+    if (drm->flip_pending || drm->vblank_pending) {
+        return 0;
+    }
+
+    drmVBlank vbl;
+    memset(&vbl, 0, sizeof(vbl));
+    vbl.request.type = DRM_VBLANK_RELATIVE | DRM_VBLANK_EVENT;
+    if (drm->crtc_index > 1) {
+        vbl.request.type |= (drm->crtc_index << DRM_VBLANK_HIGH_CRTC_SHIFT) &
+                            DRM_VBLANK_HIGH_CRTC_MASK;
+    } else if (drm->crtc_index == 1) {
+        vbl.request.type |= DRM_VBLANK_SECONDARY;
+    }
+    vbl.request.sequence = 1;
+    vbl.request.signal = (unsigned long)drm;
+
+    if (drmWaitVBlank(drm->drm_fd, &vbl)) {
+        fprintf(stderr, "drmWaitVBlank (event) failed: %s\n", strerror(errno));
+        return -1;
+    }
+    drm->vblank_pending = true;
+    return 0;
+}
+
+void drm_cancel_vblank_event(display_ctx_t *drm) {
+    drm->vblank_pending = false;
+}
+
+int drm_dispatch_events(display_ctx_t *drm) {
+    struct pollfd pfd = { .fd = drm->drm_fd, .events = POLLIN };
+
+    // drmHandleEvent blocks in read(), so only call it when data is there
+    if (poll(&pfd, 1, 0) > 0 && drm_read_events(drm) < 0) {
+        return -1;
+    }
+    return (drm->flip_pending || drm->vblank_pending) ? 0 : 1;
+}
+
 void drm_cleanup(display_ctx_t *drm) {
-    // GBM buffer cleanup
-    if (drm->current_bo) {
-        gbm_surface_release_buffer(drm->gbm_surface, drm->current_bo);
+    if (drm->kms_enabled) {
+        // Let an in-flight flip land before tearing the buffers down
+        if (drm->flip_pending) {
+            drm_wait_for_flip(drm);
+        }
+
+        if (drm->plane_active) {
+            drmModeAtomicReq *req = drmModeAtomicAlloc();
+            if (req) {
+                atomic_add_plane(req, drm->overlay_plane_id, &drm->overlay_props,
+                                 0, 0, 0, 0, 0, 0);
+                drmModeAtomicCommit(drm->drm_fd, req, 0, NULL);
+                drmModeAtomicFree(req);
+            }
+            drm->plane_active = false;
+        }
+        drm_plane_fb_t last = drm->plane_current;
+        memset(&drm->plane_current, 0, sizeof(drm->plane_current));
+        plane_fb_release(drm, &last);
+
+        if (drm->saved_crtc) {
+            drmModeSetCrtc(drm->drm_fd, drm->saved_crtc->crtc_id,
+                           drm->saved_crtc->buffer_id,
+                           drm->saved_crtc->x, drm->saved_crtc->y,
+                           &drm->connector_id, 1, &drm->saved_crtc->mode);
+            drmModeFreeCrtc(drm->saved_crtc);
+            drm->saved_crtc = NULL;
+        }
     }
+
+    // GBM buffer cleanup
     if (drm->next_bo && drm->next_bo != drm->current_bo) {
         gbm_surface_release_buffer(drm->gbm_surface, drm->next_bo);
     }
-    
-    // GBM resources cleanup
+    if (drm->current_bo) {
+        gbm_surface_release_buffer(drm->gbm_surface, drm->current_bo);
+    }
+    drm->current_bo = NULL;
+    drm->next_bo = NULL;
+
+    // GBM resources cleanup (destroys the per-BO framebuffers as well)
     if (drm->gbm_surface) {
         gbm_surface_destroy(drm->gbm_surface);
+        drm->gbm_surface = NULL;
+    }
+
+    // A further head only borrowed the device; the first head closes it
+    if (drm->shared_device) {
+        drm->gbm_device = NULL;
+        drm->drm_fd = -1;
+        drm->kms_enabled = false;
+        drm->shared_device = false;
+        return;
     }
+
     if (drm->gbm_device) {
         gbm_device_destroy(drm->gbm_device);
+        drm->gbm_device = NULL;
     }
-    
-    // Close DRM device (no master to drop since we never acquired it)
+
     if (drm->drm_fd >= 0) {
+        if (drm->kms_enabled) {
+            drmDropMaster(drm->drm_fd);
+        }
         close(drm->drm_fd);
+        drm->drm_fd = -1;
     }
-    
+    drm->kms_enabled = false;
+
     printf("GBM cleanup completed\n");
-}
\ No newline at end of file
+}
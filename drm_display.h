@@ -6,27 +6,146 @@
 #include <gbm.h>
 #include <stdbool.h>
 
+// Scanout buffer description for direct plane presentation (dmabuf backed)
 typedef struct {
-    // DRM device handle (for GBM device creation only)
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;              // DRM fourcc (e.g. DRM_FORMAT_NV12)
+    uint64_t modifier;            // DRM format modifier (DRM_FORMAT_MOD_INVALID = implicit)
+    int num_planes;
+    int fds[4];
+    uint32_t offsets[4];
+    uint32_t pitches[4];
+    void *opaque;                 // Handed to plane_release once it is off screen
+} drm_plane_buffer_t;
+
+// Framebuffer currently (or about to be) scanned out on the overlay plane
+typedef struct {
+    uint32_t fb_id;
+    uint32_t handles[4];
+    void *opaque;
+} drm_plane_fb_t;
+
+// Atomic property IDs for one plane
+typedef struct {
+    uint32_t fb_id;
+    uint32_t crtc_id;
+    uint32_t src_x, src_y, src_w, src_h;
+    uint32_t crtc_x, crtc_y, crtc_w, crtc_h;
+    uint32_t in_fence_fd;         // 0 if the plane has no IN_FENCE_FD (optional)
+} drm_plane_props_t;
+
+#define DRM_MAX_PLANE_FORMATS 64
+#define DRM_MAX_PLANE_FORMAT_MODS 256
+
+// One format/modifier pair the plane advertises in IN_FORMATS
+typedef struct {
+    uint32_t format;
+    uint64_t modifier;
+} drm_format_mod_t;
+
+typedef void (*drm_plane_release_fn)(void *opaque);
+
+typedef struct {
+    // DRM device handle
     int drm_fd;
-    
+
     // GBM resources
     struct gbm_device *gbm_device;
     struct gbm_surface *gbm_surface;
-    
+
     // Buffer management
-    struct gbm_bo *current_bo;
-    struct gbm_bo *next_bo;
-    
+    struct gbm_bo *current_bo;    // Buffer currently scanned out
+    struct gbm_bo *next_bo;       // Buffer queued by a pending page flip
+
+    // KMS scanout state (only valid when kms_enabled is set)
+    bool kms_enabled;             // We are DRM master and drive the CRTC ourselves
+    bool shared_device;           // drm_fd/gbm_device belong to the first head
+    bool mode_set;                // drmModeSetCrtc has been issued
+    bool flip_pending;            // Page flip queued, waiting for its event
+    bool vblank_pending;          // Vblank event requested, not yet delivered
+    uint32_t connector_id;
+    uint32_t connector_type;
+    uint32_t connector_type_id;
+    uint32_t crtc_id;
+    int crtc_index;
+    uint32_t mm_width;
+    uint32_t mm_height;
+    drmModeModeInfo mode;
+    drmModeCrtc *saved_crtc;      // CRTC state to restore on exit
+
+    // Atomic overlay plane for direct video scanout (bypasses GL)
+    bool atomic_enabled;          // Atomic modesetting and both planes found
+    bool plane_active;            // Overlay is (or will be after the flip) showing video
+    bool plane_flip_pending;      // Pending flip changes overlay contents
+    uint32_t primary_plane_id;
+    uint32_t overlay_plane_id;
+    drm_plane_props_t primary_props;
+    drm_plane_props_t overlay_props;
+    uint32_t overlay_formats[DRM_MAX_PLANE_FORMATS];
+    int overlay_format_count;
+    drm_format_mod_t overlay_format_mods[DRM_MAX_PLANE_FORMAT_MODS];
+    int overlay_format_mod_count; // 0 = no IN_FORMATS, linear buffers only
+    drm_plane_fb_t plane_current;
+    drm_plane_fb_t plane_next;
+    drm_plane_release_fn plane_release;
+
+    // Vblank tracking (CLOCK_MONOTONIC microseconds)
+    uint32_t last_vblank_seq;
+    uint64_t last_vblank_us;
+    uint64_t flips_completed;
+
     // Surface properties
     uint32_t width;
     uint32_t height;
     uint32_t refresh_rate;
 } display_ctx_t;
 
-// Function declarations - GBM buffer management without DRM master
-int drm_init(display_ctx_t *drm);
-int drm_swap_buffers(display_ctx_t *drm);
+// Function declarations
+// drm_init() tries to become DRM master and drive a CRTC with page flips.
+// If that is not possible it falls back to GBM buffer management only.
+// width/height/refresh_rate select the preferred mode (0 = connector default),
+// connector_id/crtc_id the output (0 = first connected connector, any CRTC).
+int drm_init(display_ctx_t *drm, int width, int height, int refresh_rate,
+             uint32_t connector_id, uint32_t crtc_id);
+// drm_init_head() drives a further connector on a free CRTC of the device
+// first already masters, with its own GBM surface and flip state. Page
+// flip and vblank events for every head arrive on the shared drm_fd and
+// are routed to their head by drm_dispatch_events()/drm_wait_for_flip().
+// Clean it up with drm_cleanup() before the first head.
+int drm_init_head(display_ctx_t *drm, const display_ctx_t *first, int width, int height,
+                  int refresh_rate, uint32_t connector_id);
+// drm_get_modes() copies up to max_modes of the connector's modes (KMS
+// only; 0 without scanout) without probing the connector again.
+int drm_get_modes(display_ctx_t *drm, drmModeModeInfo *modes, int max_modes);
+// drm_set_mode() replaces the mode drm_init() picked, before the first
+// frame programs the CRTC. A new size recreates the GBM surface, so the
+// caller destroys any EGL surface on it first and creates a new one after.
+int drm_set_mode(display_ctx_t *drm, const drmModeModeInfo *mode);
+// drm_init_offscreen() renders into a GBM surface on the render node only:
+// no master, no mode set, and drm_swap_buffers() just recycles buffers.
+int drm_init_offscreen(display_ctx_t *drm, int width, int height);
+// in_fence_fd: sync_file signalled when rendering into the new front buffer
+// completes (-1 = implicit sync). Ownership passes to drm_swap_buffers.
+int drm_swap_buffers(display_ctx_t *drm, int in_fence_fd);
+int drm_wait_for_flip(display_ctx_t *drm);
+int drm_wait_vblank(display_ctx_t *drm, uint64_t *timestamp_us);
+// Event-loop variant of drm_wait_vblank(): request a vblank event (unless a
+// flip is already pending), poll drm_fd, then drm_dispatch_events() once
+// readable. Both need kms_enabled && mode_set.
+int drm_request_vblank_event(display_ctx_t *drm);
+// Forget a requested vblank event that never arrived, so the next
+// drm_request_vblank_event() asks again (a late event is harmless).
+void drm_cancel_vblank_event(display_ctx_t *drm);
+// Reads the events waiting on drm_fd without blocking; 1 once neither a
+// flip nor a vblank event is outstanding, 0 if still waiting.
+int drm_dispatch_events(display_ctx_t *drm);
+// Direct plane scanout: drm takes ownership of buf->opaque on success
+// and calls plane_release() once the buffer has left the screen.
+// Explicit modifiers are checked against the plane's IN_FORMATS;
+// DRM_FORMAT_MOD_INVALID (implicit layout) only needs the format.
+bool drm_plane_supports_format(display_ctx_t *drm, uint32_t format, uint64_t modifier);
+int drm_plane_present(display_ctx_t *drm, const drm_plane_buffer_t *buf);
 void drm_cleanup(display_ctx_t *drm);
 
-#endif // DRM_DISPLAY_H
\ No newline at end of file
+#endif // DRM_DISPLAY_H
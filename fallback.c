@@ -3,6 +3,16 @@
  * 
  * Provides software video playback using libmpv when hardware acceleration fails.
  * Simplified implementation for basic playback functionality.
+ *
+ * With an output set, mpv never touches the display: it decodes and draws
+ * each frame into an FBO texture on our EGL context (render API), and the
+ * frame then takes the same path as a decoded one - the gpu_renderer warp
+ * pass, display_output's swap and page flip, one vsync.
+ *
+ * The playback loop sleeps in a single poll() on two descriptors: an
+ * eventfd that mpv's wakeup and render-update callbacks and the
+ * pause/seek/stop calls write, and the caller's stop fd. Nothing wakes it
+ * but an mpv event, a frame, a command or a stop request.
  */
 
 #define _GNU_SOURCE  /* For strdup() */
@@ -12,6 +22,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 
 /* Conditional libmpv includes - may not be available on all systems */
 #ifdef HAVE_LIBMPV
@@ -27,6 +41,21 @@ struct fallback_ctx {
     mpv_render_context *mpv_gl;
     #endif
     
+    /* Render into pickle's pipeline (fallback_set_output) */
+    fallback_output_t output;
+    GLuint fbo;
+    GLuint fbo_texture;
+    int fbo_width, fbo_height;
+    
+    /* Control channel */
+    int wake_fd;              /* eventfd: mpv event, new frame or pending command */
+    int stop_fd;              /* Caller's: readable once playback must end (-1 = none) */
+    pthread_mutex_t command_lock;
+    int pending_pause;        /* -1 = none, else the pause state to set */
+    int pending_seek;
+    double seek_position;
+    int pending_stop;
+    
     fallback_config_t config;
     int initialized;
     int playing;
@@ -47,10 +76,267 @@ fallback_ctx_t *fallback_create(void) {
     ctx->config.enable_hardware_decode = 1;
     ctx->config.enable_audio = 1;
     ctx->config.vo_driver = "gpu";  /* Default to GPU output */
+    ctx->stop_fd = -1;
+    ctx->pending_pause = -1;
+    
+    ctx->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ctx->wake_fd < 0) {
+        fprintf(stderr, "Failed to create fallback wake eventfd: %s\n", strerror(errno));
+        free(ctx);
+        return NULL;
+    }
+    pthread_mutex_init(&ctx->command_lock, NULL);
     
     return ctx;
 }
 
+/**
+ * Wake the playback loop (any thread, including mpv's)
+ */
+static void wake_loop(fallback_ctx_t *ctx) {
+    uint64_t one = 1;
+    
+    if (write(ctx->wake_fd, &one, sizeof(one)) < 0) {
+        /* Counter already non-zero: the loop is due to wake anyway */
+    }
+}
+
+/**
+ * Render into pickle's display pipeline
+ */
+int fallback_set_output(fallback_ctx_t *ctx, const fallback_output_t *output) {
+    if (!ctx || !output || !output->display || !output->renderer) {
+        return FALLBACK_ERROR;
+    }
+    
+    if (ctx->initialized) {
+        fprintf(stderr, "Cannot change output after initialization\n");
+        return FALLBACK_ERROR;
+    }
+    
+    ctx->output = *output;
+    return FALLBACK_OK;
+}
+
+/**
+ * End playback when a descriptor becomes readable
+ */
+int fallback_set_stop_fd(fallback_ctx_t *ctx, int fd) {
+    if (!ctx) {
+        return FALLBACK_ERROR;
+    }
+    
+    ctx->stop_fd = fd;
+    return FALLBACK_OK;
+}
+
+#ifdef HAVE_LIBMPV
+/**
+ * GL entry points for mpv (the display's EGL context is current)
+ */
+static void *get_proc_address(void *data __attribute__((unused)), const char *name) {
+    return (void *)eglGetProcAddress(name);
+}
+
+/**
+ * mpv's wakeup and render-update callbacks (any mpv thread): wake the loop, nothing else
+ */
+static void on_mpv_wakeup(void *data) {
+    wake_loop(data);
+}
+
+/**
+ * Create mpv's render context on our EGL context
+ */
+static int init_render_context(fallback_ctx_t *ctx) {
+    mpv_opengl_init_params gl_init = { .get_proc_address = get_proc_address };
+    mpv_render_param params[] = {
+        { MPV_RENDER_PARAM_API_TYPE, (void *)MPV_RENDER_API_TYPE_OPENGL },
+        { MPV_RENDER_PARAM_OPENGL_INIT_PARAMS, &gl_init },
+        { 0, NULL }
+    };
+    
+    if (mpv_render_context_create(&ctx->mpv_gl, ctx->mpv, params) < 0) {
+        fprintf(stderr, "Failed to create mpv render context\n");
+        ctx->mpv_gl = NULL;
+        return FALLBACK_ERROR;
+    }
+    
+    mpv_render_context_set_update_callback(ctx->mpv_gl, on_mpv_wakeup, ctx);
+    printf("✓ mpv rendering into pickle's display pipeline\n");
+    return FALLBACK_OK;
+}
+
+/**
+ * (Re)allocate the FBO mpv draws into: the video's size, so crop and warp
+ * see the same source resolution as the hardware path
+ */
+static int ensure_fbo(fallback_ctx_t *ctx) {
+    int64_t width = 0, height = 0;
+    
+    if (mpv_get_property(ctx->mpv, "dwidth", MPV_FORMAT_INT64, &width) < 0 ||
+        mpv_get_property(ctx->mpv, "dheight", MPV_FORMAT_INT64, &height) < 0 ||
+        width <= 0 || height <= 0) {
+        display_info_t info;
+        memset(&info, 0, sizeof(info));
+        display_output_get_info(ctx->output.display, &info);
+        width = info.width > 0 ? info.width : 1920;
+        height = info.height > 0 ? info.height : 1080;
+    }
+    
+    if (ctx->fbo && width == ctx->fbo_width && height == ctx->fbo_height) {
+        return FALLBACK_OK;
+    }
+    
+    if (!ctx->fbo) {
+        glGenFramebuffers(1, &ctx->fbo);
+        glGenTextures(1, &ctx->fbo_texture);
+    }
+    
+    glBindTexture(GL_TEXTURE_2D, ctx->fbo_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, (GLsizei)width, (GLsizei)height, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, ctx->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           ctx->fbo_texture, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "mpv FBO incomplete: 0x%x\n", status);
+        return FALLBACK_ERROR;
+    }
+    
+    ctx->fbo_width = (int)width;
+    ctx->fbo_height = (int)height;
+    printf("mpv render target: %dx%d\n", ctx->fbo_width, ctx->fbo_height);
+    return FALLBACK_OK;
+}
+
+/**
+ * Draw mpv's next frame into the FBO, warp it onto the heads and present it
+ */
+static int render_mpv_frame(fallback_ctx_t *ctx) {
+    if (!(mpv_render_context_update(ctx->mpv_gl) & MPV_RENDER_UPDATE_FRAME)) {
+        return FALLBACK_OK;  /* Only mpv-internal work this time */
+    }
+    
+    if (ensure_fbo(ctx) < 0) {
+        return FALLBACK_ERROR;
+    }
+    
+    /* FBO texture rows run from the top, as the renderer's other sources do: no flip */
+    mpv_opengl_fbo fbo = { (int)ctx->fbo, ctx->fbo_width, ctx->fbo_height, GL_RGBA8 };
+    int flip_y = 0;
+    mpv_render_param params[] = {
+        { MPV_RENDER_PARAM_OPENGL_FBO, &fbo },
+        { MPV_RENDER_PARAM_FLIP_Y, &flip_y },
+        { 0, NULL }
+    };
+    if (mpv_render_context_render(ctx->mpv_gl, params) < 0) {
+        return FALLBACK_ERROR;
+    }
+    
+    /* Keystone, mesh and blend: the published snapshot, as the main render loop takes it */
+    if (ctx->output.warp && warp_control_process_input(ctx->output.warp) < 0) {
+        return FALLBACK_ERROR;
+    }
+    
+    if (gpu_renderer_render_texture(ctx->output.renderer, ctx->fbo_texture,
+                                    ctx->fbo_width, ctx->fbo_height) < 0 ||
+        display_output_present_frame(ctx->output.display) < 0) {
+        return FALLBACK_ERROR;
+    }
+    
+    /* One vsync source: our page flip paces mpv */
+    display_output_wait_vblank(ctx->output.display, NULL);
+    mpv_render_context_report_swap(ctx->mpv_gl);
+    return FALLBACK_OK;
+}
+
+/**
+ * Hand commands posted by other threads to mpv
+ */
+static void apply_commands(fallback_ctx_t *ctx) {
+    int pause, seek, stop;
+    double position;
+    
+    pthread_mutex_lock(&ctx->command_lock);
+    pause = ctx->pending_pause;
+    seek = ctx->pending_seek;
+    position = ctx->seek_position;
+    stop = ctx->pending_stop;
+    ctx->pending_pause = -1;
+    ctx->pending_seek = 0;
+    ctx->pending_stop = 0;
+    pthread_mutex_unlock(&ctx->command_lock);
+    
+    if (stop) {
+        ctx->playing = 0;
+        return;
+    }
+    
+    if (pause >= 0) {
+        const char *cmd[] = {"set", "pause", pause ? "yes" : "no", NULL};
+        mpv_command_async(ctx->mpv, 0, cmd);
+    }
+    
+    if (seek) {
+        char target[32];
+        snprintf(target, sizeof(target), "%.3f", position);
+        const char *cmd[] = {"seek", target, "absolute", NULL};
+        mpv_command_async(ctx->mpv, 0, cmd);
+    }
+}
+
+/**
+ * Handle every queued mpv event (the wakeup callback only fires on new ones)
+ */
+static void handle_events(fallback_ctx_t *ctx) {
+    for (;;) {
+        mpv_event *event = mpv_wait_event(ctx->mpv, 0);
+        
+        switch (event->event_id) {
+            case MPV_EVENT_NONE:
+                return;
+            
+            case MPV_EVENT_SHUTDOWN:
+            case MPV_EVENT_END_FILE:
+                printf("Playback finished\n");
+                ctx->playing = 0;
+                break;
+            
+            case MPV_EVENT_FILE_LOADED:
+                printf("File loaded successfully\n");
+                break;
+            
+            case MPV_EVENT_PLAYBACK_RESTART:
+                printf("Playback started\n");
+                break;
+            
+            case MPV_EVENT_LOG_MESSAGE: {
+                mpv_event_log_message *msg = event->data;
+                if (msg->log_level <= MPV_LOG_LEVEL_ERROR) {
+                    printf("mpv: [%s] %s", msg->prefix, msg->text);
+                }
+                break;
+            }
+            
+            case MPV_EVENT_VIDEO_RECONFIG:
+                ctx->fbo_width = 0;  /* New size: reallocate the FBO on the next frame */
+                break;
+            
+            default:
+                break;
+        }
+    }
+}
+#endif
+
 /**
  * Initialize libmpv (if available)
  */
@@ -62,8 +348,12 @@ static int init_mpv(fallback_ctx_t *ctx) {
         return FALLBACK_ERROR;
     }
     
-    /* Set basic options */
-    mpv_set_option_string(ctx->mpv, "vo", ctx->config.vo_driver ? ctx->config.vo_driver : "gpu");
+    /* Set basic options; rendering into our pipeline needs the render API's vo */
+    if (ctx->output.renderer) {
+        mpv_set_option_string(ctx->mpv, "vo", "libmpv");
+    } else {
+        mpv_set_option_string(ctx->mpv, "vo", ctx->config.vo_driver ? ctx->config.vo_driver : "gpu");
+    }
     
     if (ctx->config.enable_hardware_decode && ctx->config.hwdec) {
         mpv_set_option_string(ctx->mpv, "hwdec", ctx->config.hwdec);
@@ -85,6 +375,12 @@ static int init_mpv(fallback_ctx_t *ctx) {
         return FALLBACK_ERROR;
     }
     
+    mpv_set_wakeup_callback(ctx->mpv, on_mpv_wakeup, ctx);
+    
+    if (ctx->output.renderer && init_render_context(ctx) < 0) {
+        return FALLBACK_ERROR;
+    }
+    
     ctx->initialized = 1;
     printf("libmpv initialized successfully\n");
     return FALLBACK_OK;
@@ -146,45 +442,43 @@ int fallback_play_file(fallback_ctx_t *ctx, const char *filename) {
     /* Simple event loop for playback */
     printf("Playing video with libmpv. Press Ctrl+C to stop.\n");
     
+    /* Events queued before the wakeup callback was set would not wake us */
+    wake_loop(ctx);
+    
     while (ctx->playing) {
-        mpv_event *event = mpv_wait_event(ctx->mpv, 0.1);
+        struct pollfd fds[2] = {
+            { .fd = ctx->wake_fd, .events = POLLIN },
+            { .fd = ctx->stop_fd, .events = POLLIN },  /* poll() ignores a negative fd */
+        };
+        uint64_t wakeups;
         
-        switch (event->event_id) {
-            case MPV_EVENT_SHUTDOWN:
-            case MPV_EVENT_END_FILE:
-                printf("Playback finished\n");
-                ctx->playing = 0;
-                break;
-                
-            case MPV_EVENT_FILE_LOADED:
-                printf("File loaded successfully\n");
-                break;
-                
-            case MPV_EVENT_PLAYBACK_RESTART:
-                printf("Playback started\n");
-                break;
-                
-            case MPV_EVENT_LOG_MESSAGE: {
-                mpv_event_log_message *msg = event->data;
-                if (msg->log_level <= MPV_LOG_LEVEL_ERROR) {
-                    printf("mpv: [%s] %s", msg->prefix, msg->text);
-                }
-                break;
+        /* Sleep until mpv, a command or the caller has something for us */
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;  /* The signal's handler writes stop_fd; seen on the next poll */
             }
-            
-            default:
-                break;
+            fprintf(stderr, "Fallback poll failed: %s\n", strerror(errno));
+            break;
         }
         
-        /* Check for external stop signal */
-        if (access("/tmp/pickle_stop", F_OK) == 0) {
-            unlink("/tmp/pickle_stop");
+        if (fds[1].revents & POLLIN) {
             printf("Stop signal received\n");
             break;
         }
         
-        /* Brief yield to allow signal handling */
-        usleep(1000);
+        /* Reset the counter before looking, so a wake-up during the work is kept */
+        if (read(ctx->wake_fd, &wakeups, sizeof(wakeups)) < 0 && errno != EAGAIN) {
+            fprintf(stderr, "Fallback wake eventfd read failed: %s\n", strerror(errno));
+            break;
+        }
+        
+        apply_commands(ctx);
+        handle_events(ctx);
+        
+        if (ctx->mpv_gl && ctx->playing && render_mpv_frame(ctx) < 0) {
+            fprintf(stderr, "mpv frame render failed\n");
+            break;
+        }
     }
     
     printf("Stopping mpv playback...\n");
@@ -233,16 +527,53 @@ int fallback_stop(fallback_ctx_t *ctx) {
         return FALLBACK_ERROR;
     }
     
-    #ifdef HAVE_LIBMPV
-    if (ctx->mpv && ctx->playing) {
-        const char *cmd[] = {"stop", NULL};
-        mpv_command(ctx->mpv, cmd);
-        ctx->playing = 0;
+    /* The playback loop stops mpv on its way out */
+    pthread_mutex_lock(&ctx->command_lock);
+    ctx->pending_stop = 1;
+    pthread_mutex_unlock(&ctx->command_lock);
+    wake_loop(ctx);
+    return FALLBACK_OK;
+}
+
+/**
+ * Pause/resume playback
+ */
+int fallback_pause(fallback_ctx_t *ctx, int pause) {
+    if (!ctx) {
+        return FALLBACK_ERROR;
     }
+    
+    #ifdef HAVE_LIBMPV
+    pthread_mutex_lock(&ctx->command_lock);
+    ctx->pending_pause = pause ? 1 : 0;
+    pthread_mutex_unlock(&ctx->command_lock);
+    wake_loop(ctx);
+    return FALLBACK_OK;
+    #else
+    (void)pause;
+    return FALLBACK_ERROR;
     #endif
+}
+
+/**
+ * Seek to position
+ */
+int fallback_seek(fallback_ctx_t *ctx, double position_seconds) {
+    if (!ctx || position_seconds < 0) {
+        return FALLBACK_ERROR;
+    }
     
-    ctx->playing = 0;
+    #ifdef HAVE_LIBMPV
+    /* Only the latest target matters; an unapplied earlier seek is replaced */
+    pthread_mutex_lock(&ctx->command_lock);
+    ctx->pending_seek = 1;
+    ctx->seek_position = position_seconds;
+    pthread_mutex_unlock(&ctx->command_lock);
+    wake_loop(ctx);
     return FALLBACK_OK;
+    #else
+    return FALLBACK_ERROR;
+    #endif
 }
 
 /**
@@ -328,6 +659,7 @@ void fallback_destroy(fallback_ctx_t *ctx) {
     }
     
     #ifdef HAVE_LIBMPV
+    /* The render context goes first, on the thread whose EGL context it uses */
     if (ctx->mpv_gl) {
         mpv_render_context_free(ctx->mpv_gl);
     }
@@ -337,6 +669,13 @@ void fallback_destroy(fallback_ctx_t *ctx) {
     }
     #endif
     
+    if (ctx->fbo) {
+        glDeleteFramebuffers(1, &ctx->fbo);
+        glDeleteTextures(1, &ctx->fbo_texture);
+    }
+    close(ctx->wake_fd);
+    pthread_mutex_destroy(&ctx->command_lock);
+    
     free(ctx->current_file);
     free(ctx);
 }
\ No newline at end of file
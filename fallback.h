@@ -5,12 +5,18 @@
  * - Software video playback using libmpv
  * - Fallback when hardware acceleration fails
  * - Basic playback controls and error handling
+ * - An event-driven control loop: mpv wakeups, commands and stop share one poll()
+ * - Rendering through mpv's render API into pickle's own EGL/DRM output,
+ *   so fallback playback keeps the warp, heads and vsync of the main path
  */
 
 #ifndef FALLBACK_H
 #define FALLBACK_H
 
 #include <stdint.h>
+#include "display_output.h"
+#include "gpu_renderer.h"
+#include "warp_control.h"
 
 /* Return codes */
 #define FALLBACK_OK          0
@@ -29,6 +35,13 @@ typedef struct {
     int loop_file;              /* Loop playback */
 } fallback_config_t;
 
+/* Pickle's display pipeline to render into (instead of mpv opening its own) */
+typedef struct {
+    display_output_ctx_t *display;   /* Configured display (its EGL context is current) */
+    gpu_renderer_ctx_t *renderer;    /* Configured renderer: warp, crop, blend, heads */
+    warp_control_ctx_t *warp;        /* Configured warp, applied before every redraw (or NULL) */
+} fallback_output_t;
+
 /* API Functions */
 
 /**
@@ -45,6 +58,29 @@ fallback_ctx_t *fallback_create(void);
  */
 int fallback_set_config(fallback_ctx_t *ctx, const fallback_config_t *config);
 
+/**
+ * Render into pickle's display pipeline (call before the first play)
+ * 
+ * mpv then uses vo=libmpv and draws each frame into an FBO on the calling
+ * thread's EGL context; the renderer warps that onto the display heads.
+ * Without it mpv opens its own video output.
+ * @param ctx Fallback context
+ * @param output Display and renderer, owned by the caller and outliving ctx
+ * @return 0 on success, negative on error
+ */
+int fallback_set_output(fallback_ctx_t *ctx, const fallback_output_t *output);
+
+/**
+ * End playback when a descriptor becomes readable (call before play)
+ * 
+ * poll() only: the fd is never read or closed, so one shutdown eventfd
+ * can be shared with the rest of the player.
+ * @param ctx Fallback context
+ * @param fd Descriptor to watch (-1 = none)
+ * @return 0 on success, negative on error
+ */
+int fallback_set_stop_fd(fallback_ctx_t *ctx, int fd);
+
 /**
  * Play video file using libmpv
  * @param ctx Fallback context
@@ -54,14 +90,14 @@ int fallback_set_config(fallback_ctx_t *ctx, const fallback_config_t *config);
 int fallback_play_file(fallback_ctx_t *ctx, const char *filename);
 
 /**
- * Stop playback
+ * Stop playback (any thread; the playback loop acts on it)
  * @param ctx Fallback context
  * @return 0 on success, negative on error
  */
 int fallback_stop(fallback_ctx_t *ctx);
 
 /**
- * Pause/resume playback
+ * Pause/resume playback (any thread; the playback loop acts on it)
  * @param ctx Fallback context
  * @param pause 1 to pause, 0 to resume
  * @return 0 on success, negative on error
@@ -69,7 +105,7 @@ int fallback_stop(fallback_ctx_t *ctx);
 int fallback_pause(fallback_ctx_t *ctx, int pause);
 
 /**
- * Seek to position
+ * Seek to position (any thread; the playback loop acts on it)
  * @param ctx Fallback context
  * @param position_seconds Position in seconds
  * @return 0 on success, negative on error
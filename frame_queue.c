@@ -0,0 +1,291 @@
+/*
+ * Frame Queue Implementation - Bounded SPSC Ring Buffer
+ *
+ * The fast path is lock-free: the producer only writes tail, the consumer
+ * only writes head. The mutex/condvars are touched only when one side has
+ * to sleep (ring full or empty) or has to wake a sleeping peer.
+ *
+ * For poll()-based consumers an eventfd is written on each empty -> non-empty
+ * transition. The consumer clears it before its final emptiness check, and
+ * the producer checks for emptiness after publishing tail, so (both being
+ * sequentially consistent) at least one of them sees the other's element.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "frame_queue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+/* Internal queue structure */
+struct frame_queue {
+    /* Ring storage */
+    unsigned char *slots;
+    size_t elem_size;
+    unsigned int capacity;
+    
+    /* Free-running indices; count = tail - head */
+    unsigned int head;            /* Written by consumer only */
+    unsigned int tail;            /* Written by producer only */
+    int closed;
+    
+    /* Slow path: sleeping on full/empty */
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+    pthread_cond_t not_empty;
+    int producer_waiting;
+    int consumer_waiting;
+    
+    /* Readable while elements may be waiting (see frame_queue_get_fd) */
+    int event_fd;
+};
+
+/**
+ * Create queue
+ */
+frame_queue_t *frame_queue_create(size_t elem_size, int capacity) {
+    pthread_condattr_t attr;
+    
+    if (elem_size == 0 || capacity <= 0) {
+        return NULL;
+    }
+    
+    frame_queue_t *queue = calloc(1, sizeof(frame_queue_t));
+    if (!queue) {
+        fprintf(stderr, "Failed to allocate frame queue\n");
+        return NULL;
+    }
+    
+    queue->slots = calloc((size_t)capacity, elem_size);
+    if (!queue->slots) {
+        fprintf(stderr, "Failed to allocate frame queue storage\n");
+        free(queue);
+        return NULL;
+    }
+    
+    queue->elem_size = elem_size;
+    queue->capacity = (unsigned int)capacity;
+    
+    queue->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (queue->event_fd < 0) {
+        fprintf(stderr, "Failed to create frame queue eventfd\n");
+        free(queue->slots);
+        free(queue);
+        return NULL;
+    }
+    
+    /* Timed pops are measured against the monotonic clock */
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_full, &attr);
+    pthread_cond_init(&queue->not_empty, &attr);
+    pthread_condattr_destroy(&attr);
+    
+    return queue;
+}
+
+/**
+ * Wake the other side if it announced that it is sleeping
+ */
+static void wake_peer(frame_queue_t *queue, int *waiting, pthread_cond_t *cond) {
+    if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&queue->lock);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+/**
+ * Make the event fd readable
+ */
+static void signal_event(frame_queue_t *queue) {
+    uint64_t one = 1;
+    
+    if (write(queue->event_fd, &one, sizeof(one)) < 0) {
+        /* Only fails when the counter is saturated, i.e. already readable */
+    }
+}
+
+/**
+ * Make the event fd unreadable again
+ */
+static void clear_event(frame_queue_t *queue) {
+    uint64_t count;
+    
+    if (read(queue->event_fd, &count, sizeof(count)) < 0) {
+        /* EAGAIN: nothing was pending */
+    }
+}
+
+/**
+ * Append element (producer side)
+ */
+int frame_queue_push(frame_queue_t *queue, const void *elem) {
+    unsigned int tail, head;
+    
+    if (!queue || !elem) {
+        return FRAME_QUEUE_ERROR;
+    }
+    
+    tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    
+    for (;;) {
+        if (__atomic_load_n(&queue->closed, __ATOMIC_ACQUIRE)) {
+            return FRAME_QUEUE_CLOSED;
+        }
+        
+        head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+        if (tail - head < queue->capacity) {
+            break;
+        }
+        
+        /* Full: announce ourselves, then re-check so a pop can't be missed */
+        pthread_mutex_lock(&queue->lock);
+        __atomic_store_n(&queue->producer_waiting, 1, __ATOMIC_SEQ_CST);
+        head = __atomic_load_n(&queue->head, __ATOMIC_SEQ_CST);
+        if (tail - head >= queue->capacity && !queue->closed) {
+            pthread_cond_wait(&queue->not_full, &queue->lock);
+        }
+        __atomic_store_n(&queue->producer_waiting, 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&queue->lock);
+    }
+    
+    memcpy(queue->slots + (size_t)(tail % queue->capacity) * queue->elem_size,
+           elem, queue->elem_size);
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_SEQ_CST);
+    
+    /* Was empty: a polling consumer may be asleep */
+    if (__atomic_load_n(&queue->head, __ATOMIC_SEQ_CST) == tail) {
+        signal_event(queue);
+    }
+    
+    wake_peer(queue, &queue->consumer_waiting, &queue->not_empty);
+    return FRAME_QUEUE_OK;
+}
+
+/**
+ * Remove oldest element (consumer side)
+ */
+int frame_queue_pop(frame_queue_t *queue, void *elem, int timeout_ms) {
+    struct timespec deadline;
+    unsigned int head, tail;
+    int timed_out = 0;
+    
+    if (!queue || !elem) {
+        return FRAME_QUEUE_ERROR;
+    }
+    
+    if (timeout_ms > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+    
+    head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    
+    for (;;) {
+        tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+        if (tail != head) {
+            break;
+        }
+        
+        /* Looks empty: clear the fd, then look again (see top of file) */
+        clear_event(queue);
+        tail = __atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST);
+        if (tail != head) {
+            break;
+        }
+        
+        /* Empty: drained and closed, or out of time */
+        if (__atomic_load_n(&queue->closed, __ATOMIC_ACQUIRE)) {
+            return FRAME_QUEUE_CLOSED;
+        }
+        if (timeout_ms == 0 || timed_out) {
+            return FRAME_QUEUE_EAGAIN;
+        }
+        
+        pthread_mutex_lock(&queue->lock);
+        __atomic_store_n(&queue->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+        tail = __atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST);
+        if (tail == head && !queue->closed) {
+            if (timeout_ms < 0) {
+                pthread_cond_wait(&queue->not_empty, &queue->lock);
+            } else if (pthread_cond_timedwait(&queue->not_empty, &queue->lock,
+                                              &deadline) == ETIMEDOUT) {
+                timed_out = 1;
+            }
+        }
+        __atomic_store_n(&queue->consumer_waiting, 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&queue->lock);
+    }
+    
+    memcpy(elem, queue->slots + (size_t)(head % queue->capacity) * queue->elem_size,
+           queue->elem_size);
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_SEQ_CST);
+    
+    wake_peer(queue, &queue->producer_waiting, &queue->not_full);
+    return FRAME_QUEUE_OK;
+}
+
+/**
+ * Close queue and wake both sides
+ */
+void frame_queue_close(frame_queue_t *queue) {
+    if (!queue) {
+        return;
+    }
+    
+    pthread_mutex_lock(&queue->lock);
+    __atomic_store_n(&queue->closed, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    
+    signal_event(queue);
+}
+
+/**
+ * Consumer's pollable fd
+ */
+int frame_queue_get_fd(frame_queue_t *queue) {
+    return queue ? queue->event_fd : -1;
+}
+
+/**
+ * Number of queued elements
+ */
+int frame_queue_count(frame_queue_t *queue) {
+    if (!queue) {
+        return 0;
+    }
+    
+    return (int)(__atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) -
+                 __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * Destroy queue
+ */
+void frame_queue_destroy(frame_queue_t *queue) {
+    if (!queue) {
+        return;
+    }
+    
+    pthread_cond_destroy(&queue->not_full);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_mutex_destroy(&queue->lock);
+    close(queue->event_fd);
+    free(queue->slots);
+    free(queue);
+}
@@ -0,0 +1,86 @@
+/*
+ * Frame Queue Module - Bounded SPSC Ring Buffer
+ *
+ * This module handles:
+ * - Lock-free single-producer/single-consumer hand-off between pipeline threads
+ * - Blocking backpressure when the ring is full (producer) or empty (consumer)
+ * - Orderly shutdown: close() wakes both sides, the consumer drains what is left
+ * - A pollable fd for consumers that wait on several event sources at once
+ *
+ * Elements are copied by value (frame_packet_t, decoded_frame_t, ...), so the
+ * queue never owns the resources the elements reference.
+ */
+
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include <stddef.h>
+
+/* Return codes */
+#define FRAME_QUEUE_OK          0
+#define FRAME_QUEUE_ERROR      -1
+#define FRAME_QUEUE_EAGAIN     -2
+#define FRAME_QUEUE_CLOSED     -3
+
+/* Forward declarations */
+typedef struct frame_queue frame_queue_t;
+
+/* API Functions */
+
+/**
+ * Create queue
+ * @param elem_size Size of one element in bytes
+ * @param capacity Maximum number of queued elements
+ * @return New queue or NULL on error
+ */
+frame_queue_t *frame_queue_create(size_t elem_size, int capacity);
+
+/**
+ * Append element, blocking while the queue is full (producer side only)
+ * @param queue Queue
+ * @param elem Element to copy in
+ * @return 0 on success, FRAME_QUEUE_CLOSED if the queue was closed
+ */
+int frame_queue_push(frame_queue_t *queue, const void *elem);
+
+/**
+ * Remove oldest element, blocking while the queue is empty (consumer side only)
+ * @param queue Queue
+ * @param elem Output element
+ * @param timeout_ms Maximum wait (-1 = forever, 0 = don't block)
+ * @return 0 on success, FRAME_QUEUE_EAGAIN on timeout,
+ *         FRAME_QUEUE_CLOSED once closed and drained
+ */
+int frame_queue_pop(frame_queue_t *queue, void *elem, int timeout_ms);
+
+/**
+ * Get the consumer's pollable fd
+ * 
+ * Readable (POLLIN) once an element is pushed into the empty queue or the
+ * queue is closed. A pop that finds the queue empty clears it, so the usual
+ * loop is: pop with timeout 0 until FRAME_QUEUE_EAGAIN, then poll().
+ * @param queue Queue
+ * @return File descriptor (owned by the queue)
+ */
+int frame_queue_get_fd(frame_queue_t *queue);
+
+/**
+ * Close queue: blocked and future pushes fail, pops drain remaining elements
+ * @param queue Queue
+ */
+void frame_queue_close(frame_queue_t *queue);
+
+/**
+ * Number of queued elements (approximate while both sides are running)
+ * @param queue Queue
+ * @return Element count
+ */
+int frame_queue_count(frame_queue_t *queue);
+
+/**
+ * Destroy queue (elements still queued are discarded, not released)
+ * @param queue Queue
+ */
+void frame_queue_destroy(frame_queue_t *queue);
+
+#endif /* FRAME_QUEUE_H */
@@ -0,0 +1,241 @@
+/*
+ * Frame Scheduler Implementation - PTS to Vblank Presentation Timing
+ *
+ * The first frame shown anchors the media clock to a vblank timestamp:
+ * target(pts) = anchor_vblank + (pts - anchor_pts). Every later frame is
+ * shown on the first vblank that is no more than a quarter refresh period
+ * before its target. The quarter-period bias keeps 24p-on-60Hz targets
+ * (which fall exactly half way between vblanks) clear of the decision
+ * boundary, so vblank jitter cannot turn a clean 3:2 cadence into 3:3:2:2.
+ */
+
+#include "frame_scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Lateness or timestamp jump that forces a re-anchor (bounds latency) */
+#define SCHEDULER_RESYNC_US      1000000
+/* Always show one frame out of this many consecutive late ones */
+#define SCHEDULER_MAX_DROPS      4
+/* Reference clock error beyond which the anchor snaps instead of slewing */
+#define SCHEDULER_SNAP_US        100000
+/* Largest anchor correction per slew call */
+#define SCHEDULER_SLEW_STEP_US   1000
+/* Missing timestamps (AV_NOPTS_VALUE) */
+#define SCHEDULER_NOPTS          INT64_MIN
+
+/* Internal scheduler state */
+struct frame_scheduler {
+    /* Timing */
+    int64_t frame_duration_us;    /* 0 if the stream frame rate is unknown */
+    int64_t refresh_period_us;
+    
+    /* Media clock anchor */
+    int anchored;
+    int64_t anchor_pts_us;
+    uint64_t anchor_vblank_us;
+    int64_t last_pts_us;
+    int consecutive_drops;
+    
+    /* Statistics */
+    uint64_t frames_shown;
+    uint64_t frames_dropped;
+    uint64_t vblanks_repeated;
+};
+
+/**
+ * Create frame scheduler
+ */
+frame_scheduler_t *frame_scheduler_create(void) {
+    frame_scheduler_t *sched = calloc(1, sizeof(frame_scheduler_t));
+    if (!sched) {
+        fprintf(stderr, "Failed to allocate frame scheduler\n");
+        return NULL;
+    }
+    
+    sched->refresh_period_us = 1000000 / 60;
+    return sched;
+}
+
+/**
+ * Configure scheduler timing
+ */
+void frame_scheduler_configure(frame_scheduler_t *sched, int fps_num, int fps_den,
+                               int refresh_mhz) {
+    if (!sched) {
+        return;
+    }
+    
+    /* Millihertz, so 59.94 Hz paces at 16683 us and not 60 Hz's 16666 */
+    if (refresh_mhz <= 0) {
+        refresh_mhz = 60000;
+    }
+    sched->frame_duration_us = (fps_num > 0 && fps_den > 0) ?
+                               (int64_t)1000000 * fps_den / fps_num : 0;
+    sched->refresh_period_us = ((int64_t)1000000000 + refresh_mhz / 2) / refresh_mhz;
+    
+    printf("Frame scheduler: %.3f fps content on %.3f Hz display (%.2f vblanks/frame)\n",
+           sched->frame_duration_us ? 1e6 / (double)sched->frame_duration_us : 0.0,
+           (double)refresh_mhz / 1000.0,
+           sched->frame_duration_us ?
+               (double)sched->frame_duration_us / (double)sched->refresh_period_us : 0.0);
+    
+    frame_scheduler_reset(sched);
+}
+
+/**
+ * Tie the media clock to a vblank
+ */
+static void scheduler_anchor(frame_scheduler_t *sched, int64_t pts_us, uint64_t vblank_us) {
+    sched->anchored = 1;
+    sched->anchor_pts_us = pts_us;
+    sched->anchor_vblank_us = vblank_us;
+    sched->last_pts_us = pts_us;
+    sched->consecutive_drops = 0;
+}
+
+/**
+ * Decide what to do with a frame for the upcoming vblank
+ */
+schedule_action_t frame_scheduler_decide(frame_scheduler_t *sched, int64_t pts_us,
+                                         uint64_t vblank_us) {
+    int64_t target_us, late_us, superseded_us;
+    
+    if (!sched) {
+        return SCHEDULE_SHOW;
+    }
+    
+    /* Frames without a timestamp follow on from the previous one */
+    if (pts_us == SCHEDULER_NOPTS) {
+        pts_us = sched->anchored ? sched->last_pts_us + sched->frame_duration_us : 0;
+    }
+    
+    /* First frame, or a seek/loop the caller didn't tell us about */
+    if (!sched->anchored ||
+        pts_us < sched->last_pts_us - SCHEDULER_RESYNC_US ||
+        pts_us > sched->last_pts_us + SCHEDULER_RESYNC_US) {
+        scheduler_anchor(sched, pts_us, vblank_us);
+        sched->frames_shown++;
+        return SCHEDULE_SHOW;
+    }
+    
+    target_us = (int64_t)sched->anchor_vblank_us + (pts_us - sched->anchor_pts_us);
+    
+    /* Too early: the current frame stays up for another refresh */
+    if ((int64_t)vblank_us + sched->refresh_period_us / 4 < target_us) {
+        sched->vblanks_repeated++;
+        return SCHEDULE_WAIT;
+    }
+    
+    late_us = (int64_t)vblank_us - target_us;
+    
+    /* Hopelessly behind (long stall): restart the clock rather than drop for seconds */
+    if (late_us > SCHEDULER_RESYNC_US) {
+        scheduler_anchor(sched, pts_us, vblank_us);
+        sched->frames_shown++;
+        return SCHEDULE_SHOW;
+    }
+    
+    /* Late enough that the next frame is already due: skip this one */
+    superseded_us = sched->frame_duration_us > sched->refresh_period_us ?
+                    sched->frame_duration_us : sched->refresh_period_us;
+    if (late_us > superseded_us && sched->consecutive_drops < SCHEDULER_MAX_DROPS) {
+        sched->consecutive_drops++;
+        sched->frames_dropped++;
+        sched->last_pts_us = pts_us;
+        return SCHEDULE_DROP;
+    }
+    
+    sched->consecutive_drops = 0;
+    sched->last_pts_us = pts_us;
+    sched->frames_shown++;
+    return SCHEDULE_SHOW;
+}
+
+/**
+ * Predict the next vblank from the last one observed
+ */
+uint64_t frame_scheduler_next_vblank(frame_scheduler_t *sched, uint64_t last_vblank_us,
+                                     uint64_t now_us) {
+    uint64_t period_us = sched ? (uint64_t)sched->refresh_period_us : 1000000 / 60;
+    
+    if (last_vblank_us == 0 || last_vblank_us > now_us + period_us) {
+        return now_us + period_us;
+    }
+    
+    /* Skip over any vblanks that already passed */
+    return last_vblank_us + period_us * ((now_us - last_vblank_us) / period_us + 1);
+}
+
+/**
+ * Steer the media clock towards a reference
+ */
+int64_t frame_scheduler_slew(frame_scheduler_t *sched, int64_t pts_us, uint64_t vblank_us) {
+    int64_t error_us, step_us;
+    
+    /* Nothing to steer yet; the first frame anchors and the next call corrects it */
+    if (!sched || !sched->anchored) {
+        return 0;
+    }
+    
+    error_us = (int64_t)sched->anchor_vblank_us + (pts_us - sched->anchor_pts_us) -
+               (int64_t)vblank_us;
+    
+    if (error_us > SCHEDULER_SNAP_US || error_us < -SCHEDULER_SNAP_US) {
+        /* Keep last_pts_us: this re-times frames, it is not a discontinuity */
+        sched->anchor_pts_us = pts_us;
+        sched->anchor_vblank_us = vblank_us;
+        return error_us;
+    }
+    
+    step_us = error_us;
+    if (step_us > SCHEDULER_SLEW_STEP_US) step_us = SCHEDULER_SLEW_STEP_US;
+    if (step_us < -SCHEDULER_SLEW_STEP_US) step_us = -SCHEDULER_SLEW_STEP_US;
+    sched->anchor_vblank_us = (uint64_t)((int64_t)sched->anchor_vblank_us - step_us);
+    
+    return error_us;
+}
+
+/**
+ * Forget the clock anchor
+ */
+void frame_scheduler_reset(frame_scheduler_t *sched) {
+    if (!sched) {
+        return;
+    }
+    
+    sched->anchored = 0;
+    sched->consecutive_drops = 0;
+}
+
+/**
+ * Get scheduler statistics
+ */
+void frame_scheduler_get_stats(frame_scheduler_t *sched,
+                               uint64_t *frames_shown,
+                               uint64_t *frames_dropped,
+                               uint64_t *vblanks_repeated) {
+    if (!sched) {
+        return;
+    }
+    
+    if (frames_shown) {
+        *frames_shown = sched->frames_shown;
+    }
+    
+    if (frames_dropped) {
+        *frames_dropped = sched->frames_dropped;
+    }
+    
+    if (vblanks_repeated) {
+        *vblanks_repeated = sched->vblanks_repeated;
+    }
+}
+
+/**
+ * Destroy scheduler
+ */
+void frame_scheduler_destroy(frame_scheduler_t *sched) {
+    free(sched);
+}
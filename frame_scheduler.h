@@ -0,0 +1,100 @@
+/*
+ * Frame Scheduler Module - PTS to Vblank Presentation Timing
+ *
+ * This module handles:
+ * - Mapping frame presentation timestamps onto display vblank times
+ * - Per-vsync show / wait (repeat current frame) / drop decisions
+ * - Stable 3:2 (and similar) cadence when frame rate and refresh differ
+ * - Re-anchoring after seeks, loops and large timestamp discontinuities
+ * - Slewing the anchor towards an external reference clock (wall sync)
+ */
+
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <stdint.h>
+
+/* Forward declarations */
+typedef struct frame_scheduler frame_scheduler_t;
+
+/* Decision for the frame at the head of the queue */
+typedef enum {
+    SCHEDULE_SHOW,            /* Present it on the next vblank */
+    SCHEDULE_WAIT,            /* Too early: keep the current frame up (repeat) */
+    SCHEDULE_DROP             /* Too late: discard it and look at the next one */
+} schedule_action_t;
+
+/* API Functions */
+
+/**
+ * Create frame scheduler
+ * @return New scheduler or NULL on error
+ */
+frame_scheduler_t *frame_scheduler_create(void);
+
+/**
+ * Configure scheduler timing
+ * @param sched Scheduler
+ * @param fps_num Stream frame rate numerator (0 = unknown)
+ * @param fps_den Stream frame rate denominator
+ * @param refresh_mhz Display refresh rate in millihertz (59940 for 59.94 Hz)
+ */
+void frame_scheduler_configure(frame_scheduler_t *sched, int fps_num, int fps_den,
+                               int refresh_mhz);
+
+/**
+ * Decide what to do with a frame for the upcoming vblank
+ * @param sched Scheduler
+ * @param pts_us Frame presentation timestamp (microseconds)
+ * @param vblank_us Expected time of the next vblank (CLOCK_MONOTONIC us)
+ * @return Scheduling decision
+ */
+schedule_action_t frame_scheduler_decide(frame_scheduler_t *sched, int64_t pts_us,
+                                         uint64_t vblank_us);
+
+/**
+ * Predict the next vblank from the last one observed
+ * @param sched Scheduler
+ * @param last_vblank_us Timestamp of the most recent vblank (0 = unknown)
+ * @param now_us Current CLOCK_MONOTONIC time
+ * @return Expected time of the next vblank
+ */
+uint64_t frame_scheduler_next_vblank(frame_scheduler_t *sched, uint64_t last_vblank_us,
+                                     uint64_t now_us);
+
+/**
+ * Steer the media clock towards a reference (another player's clock).
+ * Small errors are slewed out a little per call so the cadence is kept;
+ * large ones snap the anchor to the reference at once.
+ * @param sched Scheduler
+ * @param pts_us Reference timestamp
+ * @param vblank_us When the reference showed it (CLOCK_MONOTONIC us, local)
+ * @return Error before correction (positive = we show frames later), 0 if not anchored
+ */
+int64_t frame_scheduler_slew(frame_scheduler_t *sched, int64_t pts_us, uint64_t vblank_us);
+
+/**
+ * Forget the clock anchor (call after video_input_seek() or a loop restart)
+ * @param sched Scheduler
+ */
+void frame_scheduler_reset(frame_scheduler_t *sched);
+
+/**
+ * Get scheduler statistics
+ * @param sched Scheduler
+ * @param frames_shown Frames presented
+ * @param frames_dropped Frames discarded as late
+ * @param vblanks_repeated Vblanks on which the previous frame was kept
+ */
+void frame_scheduler_get_stats(frame_scheduler_t *sched,
+                               uint64_t *frames_shown,
+                               uint64_t *frames_dropped,
+                               uint64_t *vblanks_repeated);
+
+/**
+ * Destroy scheduler
+ * @param sched Scheduler
+ */
+void frame_scheduler_destroy(frame_scheduler_t *sched);
+
+#endif /* FRAME_SCHEDULER_H */
@@ -11,7 +11,10 @@
 #include <string.h>
 #include <math.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <drm_fourcc.h>
 #include <libavutil/pixfmt.h>
+#include <libavutil/frame.h>
 
 /* Ensure we have all necessary EGL extension definitions */
 #ifndef EGL_EXT_image_dma_buf_import
@@ -25,18 +28,138 @@
 #define EGL_DMA_BUF_PLANE0_FD_EXT            0x3272
 #define EGL_DMA_BUF_PLANE0_OFFSET_EXT        0x3273
 #define EGL_DMA_BUF_PLANE0_PITCH_EXT         0x3274
+#define EGL_DMA_BUF_PLANE1_FD_EXT            0x3275
+#define EGL_DMA_BUF_PLANE1_OFFSET_EXT        0x3276
+#define EGL_DMA_BUF_PLANE1_PITCH_EXT         0x3277
+#define EGL_DMA_BUF_PLANE2_FD_EXT            0x3278
+#define EGL_DMA_BUF_PLANE2_OFFSET_EXT        0x3279
+#define EGL_DMA_BUF_PLANE2_PITCH_EXT         0x327A
+#define EGL_YUV_COLOR_SPACE_HINT_EXT         0x327B
+#define EGL_SAMPLE_RANGE_HINT_EXT            0x327C
+#define EGL_ITU_REC601_EXT                   0x327F
+#define EGL_ITU_REC709_EXT                   0x3280
+#define EGL_YUV_NARROW_RANGE_EXT             0x3283
+#endif
+#ifndef EGL_ITU_REC2020_EXT
+#define EGL_ITU_REC2020_EXT                  0x3281
+#define EGL_YUV_FULL_RANGE_EXT               0x3282
+#endif
+
+/* Explicit tiling modifiers (SAND128 on the Pi 4) */
+#ifndef EGL_EXT_image_dma_buf_import_modifiers
+#define EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT   0x3443
+#define EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT   0x3444
+#define EGL_DMA_BUF_PLANE1_MODIFIER_LO_EXT   0x3445
+#define EGL_DMA_BUF_PLANE1_MODIFIER_HI_EXT   0x3446
+#define EGL_DMA_BUF_PLANE2_MODIFIER_LO_EXT   0x3447
+#define EGL_DMA_BUF_PLANE2_MODIFIER_HI_EXT   0x3448
 #endif
 
 /* OpenGL ES extensions */
 #ifndef GL_OES_EGL_image_external
 #define GL_TEXTURE_EXTERNAL_OES              0x8D65
 #endif
+#ifndef GL_EXT_disjoint_timer_query
+#define GL_TIME_ELAPSED_EXT                  0x88BF
+#define GL_GPU_DISJOINT_EXT                  0x8FBB
+#endif
 
 /* Default configuration */
 #define DEFAULT_BRIGHTNESS  1.0f
 #define DEFAULT_CONTRAST    1.0f
 #define DEFAULT_SATURATION  1.0f
 
+/* Program binary cache (glGetProgramBinary) - skips shader compile on later starts */
+#define SHADER_CACHE_MAGIC  0x42534b50u    /* "PKSB" */
+#define SHADER_CACHE_SUBDIR "pickle"
+
+/* Imported DMABUF cache size - comfortably above the V4L2 M2M capture pool */
+#define TEXTURE_CACHE_SIZE  16
+
+/* System-memory frames: PBO + plane textures per slot, so the CPU copy of
+ * one frame overlaps the GPU upload/draw of the previous two */
+#define UPLOAD_SLOTS        3
+#define UPLOAD_FENCE_TIMEOUT_NS  100000000ULL
+
+/* Edge-blend lookup texture unit (units 0-2 hold the frame's planes) */
+#define BLEND_TEXTURE_UNIT  3
+
+/* Timer query sets in flight: a frame's GPU times are read this many frames later */
+#define GPU_TIMER_FRAMES    4
+
+/* Shader variants: one program per input format, each with and without
+ * the colour-adjust stage and the edge-blend multiply */
+typedef enum {
+    SHADER_FORMAT_EXTERNAL,   /* DMABUF frame as one external-OES image */
+    SHADER_FORMAT_NV12,       /* System memory: Y + interleaved UV textures */
+    SHADER_FORMAT_YUV420,     /* System memory: Y, U, V textures */
+    SHADER_FORMAT_RGB,        /* RGB texture another GL user drew (libmpv fallback) */
+    SHADER_FORMAT_COUNT
+} shader_format_t;
+
+/* YUV->RGB matrices a stream can ask for */
+typedef enum {
+    COLOR_MATRIX_BT601,
+    COLOR_MATRIX_BT709,
+    COLOR_MATRIX_BT2020
+} color_matrix_t;
+
+/* One output head the frame is drawn to, with its own warp and source crop */
+typedef struct {
+    EGLSurface surface;
+    int width, height;
+    warp_matrix_t warp_matrix;
+    GLfloat crop[4];          /* Source rectangle: x, y, width, height (0..1, y down) */
+    GLuint blend_texture;     /* Edge blend / mask lookup, 0 = none */
+    GLfloat blend_coord[4];   /* gl_FragCoord -> lookup texcoord: scale xy, offset zw */
+} render_head_t;
+
+/* One linked variant: uniform locations (-1 where the variant has none)
+ * and which state was last uploaded, since uniforms persist per program */
+typedef struct {
+    GLuint program;
+    GLint u_matrix, u_crop, u_blend_coord;
+    GLint u_yuv_to_rgb, u_yuv_offset;
+    GLint u_brightness, u_contrast, u_saturation;
+    const render_head_t *warp_head;   /* Head whose warp, crop and blend are uploaded */
+    unsigned int warp_serial;
+    unsigned int config_serial;
+    int color_key;            /* Matrix/range behind u_yuv_to_rgb, -1 = not set */
+} shader_variant_t;
+
+/* Cached EGLImage + texture for one decoder capture buffer */
+typedef struct {
+    int in_use;
+    int fd;
+    uint64_t inode;           /* fds get reused, the dmabuf inode doesn't */
+    uint64_t device;
+    uint32_t offset;
+    int width, height;
+    uint32_t format;          /* DRM fourcc */
+    uint64_t modifier;
+    int color_key;            /* Colourspace hints baked into the image */
+    EGLImageKHR image;
+    GLuint texture;
+    uint64_t last_used;       /* Frame number for LRU eviction */
+} texture_cache_entry_t;
+
+/* One upload slot: staging PBO and the textures it fills */
+typedef struct {
+    GLuint pbo;
+    size_t pbo_size;
+    GLuint textures[3];       /* Y, U, V (or Y, UV for NV12) */
+    int width, height;
+    int format;               /* AV_PIX_FMT_* the textures were allocated for */
+    GLsync fence;             /* Last draw sampling these textures */
+} upload_slot_t;
+
+/* Timer queries around one frame's passes */
+typedef struct {
+    GLuint queries[GPU_PASS_COUNT];
+    int used[GPU_PASS_COUNT]; /* Pass ran this frame (the fallback's texture has no import) */
+    int pending;              /* Submitted, results not read back yet */
+} gpu_timer_frame_t;
+
 /* Internal renderer context */
 struct gpu_renderer_ctx {
     /* EGL context */
@@ -46,29 +169,59 @@ struct gpu_renderer_ctx {
     EGLConfig egl_config;
     
     /* OpenGL resources */
-    GLuint shader_program_yuv420;
-    GLuint shader_program_nv12;
-    GLuint current_program;
     GLuint vertex_buffer;
+    GLuint index_buffer;
     GLuint vertex_array;
+    GLsizei index_count;      /* 6 for the quad, more with a warp mesh */
+    int mesh_active;
     
-    /* Uniform locations */
-    GLint u_matrix;
-    GLint u_tex_y, u_tex_u, u_tex_v;  /* YUV420 textures */
-    GLint u_tex_nv12_y, u_tex_nv12_uv; /* NV12 textures */
-    GLint u_brightness, u_contrast, u_saturation;
+    /* Shader variants; the blend ones are only built once a blend is set */
+    shader_variant_t variants[SHADER_FORMAT_COUNT][2][2];   /* [format][colour adjust][blend] */
+    int blend_variants_built;
+    shader_variant_t *active_variant;
+    unsigned int warp_serial;     /* Bumped whenever any head's warp or crop changes */
+    unsigned int config_serial;   /* Bumped whenever the colour adjustments change */
+    
+    /* System-memory frame uploads */
+    upload_slot_t upload_slots[UPLOAD_SLOTS];
+    int upload_next;
+    int upload_unsupported_format;   /* Last format already reported as unsupported */
+    
+    /* EGL_EXT_image_dma_buf_import_modifiers is available */
+    int has_dmabuf_modifiers;
+    
+    /* Output heads (display_output's heads, sharing this context) */
+    render_head_t heads[DISPLAY_OUTPUT_MAX_HEADS];
+    int head_count;
+    render_head_t *current_head;
     
     /* Current state */
-    warp_matrix_t warp_matrix;
     renderer_config_t config;
     int video_width, video_height;
     int display_width, display_height;
     
+    /* DMABUF import cache */
+    texture_cache_entry_t texture_cache[TEXTURE_CACHE_SIZE];
+    int cache_width, cache_height;   /* Frame size the cached pool belongs to */
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    
     /* Statistics */
     uint64_t frames_rendered;
     uint64_t total_render_time_us;
     struct timeval last_frame_time;
     
+    /* GPU timing: a ring of query sets, polled (never waited on) frames later */
+    int has_timer_query;
+    gpu_timer_frame_t timer_frames[GPU_TIMER_FRAMES];
+    int timer_next;               /* Set the coming frame uses (the oldest one) */
+    int timer_pass;               /* Pass whose query is open, -1 = none */
+    uint64_t gpu_pass_ns[GPU_PASS_COUNT];
+    uint64_t gpu_frames_timed;
+    uint64_t gpu_frames_discarded;
+    struct timeval timing_start;  /* Submission of the first timed frame */
+    uint64_t timing_start_frame;  /* frames_rendered then */
+    
     /* Extension function pointers */
     PFNEGLCREATEIMAGEKHRPROC eglCreateImageKHR;
     PFNEGLDESTROYIMAGEKHRPROC eglDestroyImageKHR;
@@ -89,8 +242,8 @@ static const GLushort quad_indices[] = {
     2, 3, 0   /* Second triangle */
 };
 
-/* YUV420 Vertex Shader */
-const char *gpu_renderer_vertex_shader_yuv420 = 
+/* Vertex Shader */
+const char *gpu_renderer_vertex_shader = 
     "#version 310 es\n"
     "precision highp float;\n"
     "\n"
@@ -98,40 +251,72 @@ const char *gpu_renderer_vertex_shader_yuv420 =
     "layout(location = 1) in vec2 a_texcoord;\n"
     "\n"
     "uniform mat4 u_matrix;\n"
+    "uniform vec4 u_crop;\n"
     "\n"
     "out vec2 v_texcoord;\n"
     "\n"
     "void main() {\n"
     "    gl_Position = u_matrix * vec4(a_position, 0.0, 1.0);\n"
-    "    v_texcoord = a_texcoord;\n"
+    "    v_texcoord = u_crop.xy + a_texcoord * u_crop.zw;\n"
     "}\n";
 
-/* YUV420 Fragment Shader with color correction */
-const char *gpu_renderer_fragment_shader_yuv420 = 
-    "#version 310 es\n"
+/* Fragment shader template
+ * 
+ * build_variant() prefixes the version line, one FORMAT_* define and, for
+ * the colour-adjust and edge-blend variants, COLOR_ADJUST and EDGE_BLEND.
+ * The blend lookup is addressed in output (projector) pixels, so it stays
+ * put under any warp or crop. External-OES frames are one
+ * EGLImage converted by the sampler (colourspace hints set at import);
+ * planar frames get the stream's matrix and range folded into
+ * u_yuv_to_rgb and u_yuv_offset on the CPU.
+ */
+const char *gpu_renderer_fragment_shader_template = 
     "precision highp float;\n"
     "\n"
     "in vec2 v_texcoord;\n"
     "out vec4 fragColor;\n"
     "\n"
+    "#if defined(FORMAT_EXTERNAL)\n"
+    "uniform samplerExternalOES u_tex;\n"
+    "#elif defined(FORMAT_RGB)\n"
+    "uniform sampler2D u_tex;\n"
+    "#else\n"
     "uniform sampler2D u_tex_y;\n"
     "uniform sampler2D u_tex_u;\n"
+    "#if defined(FORMAT_YUV420)\n"
     "uniform sampler2D u_tex_v;\n"
+    "#endif\n"
+    "uniform mat3 u_yuv_to_rgb;\n"
+    "uniform vec3 u_yuv_offset;\n"
+    "#endif\n"
+    "\n"
+    "#if defined(COLOR_ADJUST)\n"
     "uniform float u_brightness;\n"
     "uniform float u_contrast;\n"
     "uniform float u_saturation;\n"
+    "#endif\n"
+    "\n"
+    "#if defined(EDGE_BLEND)\n"
+    "uniform sampler2D u_blend;\n"
+    "uniform vec4 u_blend_coord;\n"
+    "#endif\n"
     "\n"
     "void main() {\n"
-    "    float y = texture(u_tex_y, v_texcoord).r;\n"
-    "    float u = texture(u_tex_u, v_texcoord).r - 0.5;\n"
-    "    float v = texture(u_tex_v, v_texcoord).r - 0.5;\n"
-    "    \n"
-    "    /* YUV to RGB conversion (BT.709) */\n"
-    "    vec3 rgb;\n"
-    "    rgb.r = y + 1.5748 * v;\n"
-    "    rgb.g = y - 0.1873 * u - 0.4681 * v;\n"
-    "    rgb.b = y + 1.8556 * u;\n"
+    "#if defined(FORMAT_EXTERNAL) || defined(FORMAT_RGB)\n"
+    "    vec3 rgb = texture(u_tex, v_texcoord).rgb;\n"
+    "#else\n"
+    "    vec3 yuv;\n"
+    "    yuv.x = texture(u_tex_y, v_texcoord).r;\n"
+    "#if defined(FORMAT_NV12)\n"
+    "    yuv.yz = texture(u_tex_u, v_texcoord).rg;\n"
+    "#else\n"
+    "    yuv.y = texture(u_tex_u, v_texcoord).r;\n"
+    "    yuv.z = texture(u_tex_v, v_texcoord).r;\n"
+    "#endif\n"
+    "    vec3 rgb = u_yuv_to_rgb * (yuv - u_yuv_offset);\n"
+    "#endif\n"
     "    \n"
+    "#if defined(COLOR_ADJUST)\n"
     "    /* Color adjustments */\n"
     "    rgb = (rgb - 0.5) * u_contrast + 0.5; /* Contrast */\n"
     "    rgb += u_brightness - 1.0;            /* Brightness */\n"
@@ -139,60 +324,30 @@ const char *gpu_renderer_fragment_shader_yuv420 =
     "    /* Saturation */\n"
     "    float gray = dot(rgb, vec3(0.299, 0.587, 0.114));\n"
     "    rgb = mix(vec3(gray), rgb, u_saturation);\n"
+    "#endif\n"
     "    \n"
-    "    fragColor = vec4(clamp(rgb, 0.0, 1.0), 1.0);\n"
-    "}\n";
-
-/* NV12 shaders (similar structure, different texture sampling) */
-const char *gpu_renderer_vertex_shader_nv12 = 
-    "#version 310 es\n"
-    "precision highp float;\n"
-    "\n"
-    "layout(location = 0) in vec2 a_position;\n"
-    "layout(location = 1) in vec2 a_texcoord;\n"
-    "\n"
-    "uniform mat4 u_matrix;\n"
-    "\n"
-    "out vec2 v_texcoord;\n"
-    "\n"
-    "void main() {\n"
-    "    gl_Position = u_matrix * vec4(a_position, 0.0, 1.0);\n"
-    "    v_texcoord = a_texcoord;\n"
-    "}\n";
-
-const char *gpu_renderer_fragment_shader_nv12 = 
-    "#version 310 es\n"
-    "precision highp float;\n"
-    "\n"
-    "in vec2 v_texcoord;\n"
-    "out vec4 fragColor;\n"
-    "\n"
-    "uniform sampler2D u_tex_nv12_y;\n"
-    "uniform sampler2D u_tex_nv12_uv;\n"
-    "uniform float u_brightness;\n"
-    "uniform float u_contrast;\n"
-    "uniform float u_saturation;\n"
-    "\n"
-    "void main() {\n"
-    "    float y = texture(u_tex_nv12_y, v_texcoord).r;\n"
-    "    vec2 uv = texture(u_tex_nv12_uv, v_texcoord).rg - 0.5;\n"
-    "    \n"
-    "    /* YUV to RGB conversion (BT.709) */\n"
-    "    vec3 rgb;\n"
-    "    rgb.r = y + 1.5748 * uv.y;\n"
-    "    rgb.g = y - 0.1873 * uv.x - 0.4681 * uv.y;\n"
-    "    rgb.b = y + 1.8556 * uv.x;\n"
-    "    \n"
-    "    /* Color adjustments */\n"
-    "    rgb = (rgb - 0.5) * u_contrast + 0.5;\n"
-    "    rgb += u_brightness - 1.0;\n"
-    "    \n"
-    "    float gray = dot(rgb, vec3(0.299, 0.587, 0.114));\n"
-    "    rgb = mix(vec3(gray), rgb, u_saturation);\n"
+    "    rgb = clamp(rgb, 0.0, 1.0);\n"
+    "#if defined(EDGE_BLEND)\n"
+    "    /* Blend ramps and masks, in output pixels: one multiply */\n"
+    "    rgb *= texture(u_blend, gl_FragCoord.xy * u_blend_coord.xy + u_blend_coord.zw).rgb;\n"
+    "#endif\n"
     "    \n"
-    "    fragColor = vec4(clamp(rgb, 0.0, 1.0), 1.0);\n"
+    "    fragColor = vec4(rgb, 1.0);\n"
     "}\n";
 
+/* What each format prefixes to the template */
+static const struct {
+    const char *name;
+    const char *defines;
+} shader_formats[SHADER_FORMAT_COUNT] = {
+    [SHADER_FORMAT_EXTERNAL] = { "external-OES",
+                                 "#extension GL_OES_EGL_image_external_essl3 : require\n"
+                                 "#define FORMAT_EXTERNAL\n" },
+    [SHADER_FORMAT_NV12]     = { "NV12", "#define FORMAT_NV12\n" },
+    [SHADER_FORMAT_YUV420]   = { "YUV420", "#define FORMAT_YUV420\n" },
+    [SHADER_FORMAT_RGB]      = { "RGB", "#define FORMAT_RGB\n" },
+};
+
 /**
  * Check for OpenGL errors and print debug info
  */
@@ -247,12 +402,63 @@ gpu_renderer_ctx_t *gpu_renderer_create(void) {
     ctx->config.saturation = DEFAULT_SATURATION;
     ctx->config.enable_vsync = 1;
     
-    /* Initialize warp matrix to identity */
-    matrix_identity(ctx->warp_matrix.matrix);
+    /* Every head starts with an identity warp over the whole frame */
+    for (int i = 0; i < DISPLAY_OUTPUT_MAX_HEADS; i++) {
+        matrix_identity(ctx->heads[i].warp_matrix.matrix);
+        ctx->heads[i].crop[2] = 1.0f;
+        ctx->heads[i].crop[3] = 1.0f;
+    }
+    ctx->head_count = 1;
+    ctx->current_head = &ctx->heads[0];
+    
+    /* Every variant uploads its uniforms on first use */
+    ctx->warp_serial = 1;
+    ctx->config_serial = 1;
+    ctx->timer_pass = -1;
     
     return ctx;
 }
 
+/**
+ * Set renderer configuration
+ */
+int gpu_renderer_set_config(gpu_renderer_ctx_t *ctx, const renderer_config_t *config) {
+    if (!ctx || !config) {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    /* Vsync is applied by gpu_renderer_configure(), colour per draw */
+    ctx->config = *config;
+    ctx->config_serial++;
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Set color adjustment parameters
+ */
+int gpu_renderer_set_color_adjustments(gpu_renderer_ctx_t *ctx,
+                                      float brightness, float contrast, float saturation) {
+    if (!ctx || brightness < 0.0f || brightness > 2.0f || contrast < 0.0f || contrast > 2.0f ||
+        saturation < 0.0f || saturation > 2.0f) {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    ctx->config.brightness = brightness;
+    ctx->config.contrast = contrast;
+    ctx->config.saturation = saturation;
+    ctx->config_serial++;
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Colour adjustments away from their defaults (selects the adjusting variants)
+ */
+static int color_adjust_active(const gpu_renderer_ctx_t *ctx) {
+    return fabsf(ctx->config.brightness - DEFAULT_BRIGHTNESS) > 1e-4f ||
+           fabsf(ctx->config.contrast - DEFAULT_CONTRAST) > 1e-4f ||
+           fabsf(ctx->config.saturation - DEFAULT_SATURATION) > 1e-4f;
+}
+
 /**
  * Compile shader from source
  */
@@ -300,6 +506,9 @@ int gpu_renderer_create_program(gpu_renderer_ctx_t *ctx __attribute__((unused)),
     glBindAttribLocation(program, 0, "a_position");
     glBindAttribLocation(program, 1, "a_texcoord");
     
+    /* Allow the linked binary to be cached for the next start */
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    
     glLinkProgram(program);
     
     glGetProgramiv(program, GL_LINK_STATUS, &linked);
@@ -320,53 +529,318 @@ int gpu_renderer_create_program(gpu_renderer_ctx_t *ctx __attribute__((unused)),
     return GPU_RENDERER_OK;
 }
 
+/**
+ * FNV-1a over a string (cache key material)
+ */
+static uint64_t hash_string(uint64_t hash, const char *str) {
+    while (str && *str) {
+        hash ^= (unsigned char)*str++;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/**
+ * Cache file for a program: keyed by driver identity and shader sources
+ */
+static int shader_cache_path(const char *vertex_src, const char *fragment_src,
+                             char *path, size_t path_size) {
+    const char *base = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    char dir[512];
+    uint64_t key = 0xcbf29ce484222325ull;
+    
+    if (base && *base) {
+        snprintf(dir, sizeof(dir), "%s/%s", base, SHADER_CACHE_SUBDIR);
+    } else if (home && *home) {
+        snprintf(dir, sizeof(dir), "%s/.cache/%s", home, SHADER_CACHE_SUBDIR);
+    } else {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    /* A driver update invalidates binaries, so it is part of the key */
+    key = hash_string(key, (const char *)glGetString(GL_VENDOR));
+    key = hash_string(key, (const char *)glGetString(GL_RENDERER));
+    key = hash_string(key, (const char *)glGetString(GL_VERSION));
+    key = hash_string(key, vertex_src);
+    key = hash_string(key, fragment_src);
+    
+    snprintf(path, path_size, "%s/program-%016llx.bin", dir, (unsigned long long)key);
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Load a cached program binary (fails quietly on any mismatch)
+ */
+static int load_program_binary(const char *path, GLuint *program_out) {
+    uint32_t header[3];  /* magic, binary format, length */
+    GLint linked = 0;
+    GLint num_formats = 0;
+    void *binary;
+    
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    if (num_formats <= 0) {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    if (fread(header, sizeof(header), 1, file) != 1 ||
+        header[0] != SHADER_CACHE_MAGIC || header[2] == 0) {
+        fclose(file);
+        return GPU_RENDERER_ERROR;
+    }
+    
+    binary = malloc(header[2]);
+    if (!binary || fread(binary, header[2], 1, file) != 1) {
+        free(binary);
+        fclose(file);
+        return GPU_RENDERER_ERROR;
+    }
+    fclose(file);
+    
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, (GLenum)header[1], binary, (GLsizei)header[2]);
+    free(binary);
+    
+    /* The driver rejects binaries from another build by failing the link */
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        glDeleteProgram(program);
+        glGetError();  /* Clear the error glProgramBinary raised */
+        return GPU_RENDERER_ERROR;
+    }
+    
+    *program_out = program;
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Store a linked program's binary (best effort)
+ */
+static void save_program_binary(const char *path, GLuint program) {
+    uint32_t header[3] = { SHADER_CACHE_MAGIC, 0, 0 };
+    GLint length = 0;
+    GLenum format = 0;
+    char dir[512];
+    char tmp_path[560];
+    
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    
+    void *binary = malloc((size_t)length);
+    if (!binary) {
+        return;
+    }
+    
+    glGetProgramBinary(program, length, &length, &format, binary);
+    if (glGetError() != GL_NO_ERROR || length <= 0) {
+        free(binary);
+        return;
+    }
+    header[1] = (uint32_t)format;
+    header[2] = (uint32_t)length;
+    
+    /* Create <cache>/pickle (and <cache> itself for a fresh $HOME) */
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (slash) {
+        *slash = '\0';
+        char *parent = strrchr(dir, '/');
+        if (parent) {
+            *parent = '\0';
+            mkdir(dir, 0755);
+            *parent = '/';
+        }
+        mkdir(dir, 0755);
+    }
+    
+    /* Write then rename so a concurrent start never reads a partial file */
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *file = fopen(tmp_path, "wb");
+    if (file) {
+        int ok = fwrite(header, sizeof(header), 1, file) == 1 &&
+                 fwrite(binary, (size_t)length, 1, file) == 1;
+        ok = (fclose(file) == 0) && ok;
+        if (ok && rename(tmp_path, path) == 0) {
+            printf("Shader binary cached: %s\n", path);
+        } else {
+            remove(tmp_path);
+        }
+    }
+    
+    free(binary);
+}
+
 /**
  * Setup shaders and uniforms
  */
-static int setup_shaders(gpu_renderer_ctx_t *ctx) {
-    GLuint vs_yuv420, fs_yuv420, vs_nv12, fs_nv12;
+static int build_program(gpu_renderer_ctx_t *ctx, const char *fragment_src,
+                         const char *name, GLuint *program_out) {
+    char cache_path[600];
+    int have_cache_path;
+    GLuint vs, fs;
     int ret;
     
-    /* Compile YUV420 shaders */
+    /* A cached binary skips compile and link entirely */
+    have_cache_path = shader_cache_path(gpu_renderer_vertex_shader, fragment_src,
+                                        cache_path, sizeof(cache_path)) == GPU_RENDERER_OK;
+    if (have_cache_path &&
+        load_program_binary(cache_path, program_out) == GPU_RENDERER_OK) {
+        printf("GPU %s shaders loaded from cache\n", name);
+        return GPU_RENDERER_OK;
+    }
+    
+    /* Compile vertex + fragment shaders */
     ret = gpu_renderer_compile_shader(ctx, SHADER_VERTEX, 
-                                     gpu_renderer_vertex_shader_yuv420, &vs_yuv420);
+                                     gpu_renderer_vertex_shader, &vs);
     if (ret < 0) return ret;
     
-    ret = gpu_renderer_compile_shader(ctx, SHADER_FRAGMENT, 
-                                     gpu_renderer_fragment_shader_yuv420, &fs_yuv420);
-    if (ret < 0) return ret;
+    ret = gpu_renderer_compile_shader(ctx, SHADER_FRAGMENT, fragment_src, &fs);
+    if (ret < 0) {
+        glDeleteShader(vs);
+        return ret;
+    }
     
-    ret = gpu_renderer_create_program(ctx, vs_yuv420, fs_yuv420, &ctx->shader_program_yuv420);
-    if (ret < 0) return ret;
+    ret = gpu_renderer_create_program(ctx, vs, fs, program_out);
     
-    /* Compile NV12 shaders */
-    ret = gpu_renderer_compile_shader(ctx, SHADER_VERTEX,
-                                     gpu_renderer_vertex_shader_nv12, &vs_nv12);
-    if (ret < 0) return ret;
+    /* Clean up individual shaders */
+    glDeleteShader(vs);
+    glDeleteShader(fs);
     
-    ret = gpu_renderer_compile_shader(ctx, SHADER_FRAGMENT,
-                                     gpu_renderer_fragment_shader_nv12, &fs_nv12);
     if (ret < 0) return ret;
     
-    ret = gpu_renderer_create_program(ctx, vs_nv12, fs_nv12, &ctx->shader_program_nv12);
-    if (ret < 0) return ret;
+    if (have_cache_path) {
+        save_program_binary(cache_path, *program_out);
+    }
     
-    /* Clean up individual shaders */
-    glDeleteShader(vs_yuv420);
-    glDeleteShader(fs_yuv420);
-    glDeleteShader(vs_nv12);
-    glDeleteShader(fs_nv12);
+    printf("GPU %s shaders compiled successfully\n", name);
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Build one variant from the template and cache its uniform locations
+ */
+static int build_variant(gpu_renderer_ctx_t *ctx, shader_format_t format, int adjust, int blend) {
+    shader_variant_t *variant = &ctx->variants[format][adjust][blend];
+    char source[4096];
+    char name[64];
+    GLuint program;
+    int ret;
+    
+    ret = snprintf(source, sizeof(source), "#version 310 es\n%s%s%s%s",
+                   shader_formats[format].defines, adjust ? "#define COLOR_ADJUST\n" : "",
+                   blend ? "#define EDGE_BLEND\n" : "", gpu_renderer_fragment_shader_template);
+    if (ret < 0 || (size_t)ret >= sizeof(source)) {
+        return GPU_RENDERER_ERROR;
+    }
+    snprintf(name, sizeof(name), "%s%s%s", shader_formats[format].name,
+             adjust ? " + colour adjust" : "", blend ? " + edge blend" : "");
+    
+    ret = build_program(ctx, source, name, &program);
+    if (ret < 0) {
+        return ret;
+    }
+    
+    variant->program = program;
+    variant->u_matrix = glGetUniformLocation(program, "u_matrix");
+    variant->u_crop = glGetUniformLocation(program, "u_crop");
+    variant->u_blend_coord = glGetUniformLocation(program, "u_blend_coord");
+    variant->u_yuv_to_rgb = glGetUniformLocation(program, "u_yuv_to_rgb");
+    variant->u_yuv_offset = glGetUniformLocation(program, "u_yuv_offset");
+    variant->u_brightness = glGetUniformLocation(program, "u_brightness");
+    variant->u_contrast = glGetUniformLocation(program, "u_contrast");
+    variant->u_saturation = glGetUniformLocation(program, "u_saturation");
+    variant->warp_head = NULL;
+    variant->warp_serial = 0;
+    variant->config_serial = 0;
+    variant->color_key = -1;
+    
+    /* Texture units never change; samplers the variant lacks are location -1 (ignored) */
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "u_tex"), 0);
+    glUniform1i(glGetUniformLocation(program, "u_tex_y"), 0);
+    glUniform1i(glGetUniformLocation(program, "u_tex_u"), 1);
+    glUniform1i(glGetUniformLocation(program, "u_tex_v"), 2);
+    glUniform1i(glGetUniformLocation(program, "u_blend"), BLEND_TEXTURE_UNIT);
+    glUseProgram(0);
+    
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Build every variant (with or without the blend stage) so switching at draw time is a pointer swap
+ */
+static int build_variants(gpu_renderer_ctx_t *ctx, int blend) {
+    for (int format = 0; format < SHADER_FORMAT_COUNT; format++) {
+        for (int adjust = 0; adjust < 2; adjust++) {
+            int ret = build_variant(ctx, (shader_format_t)format, adjust, blend);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    }
+    
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Build the non-blend variants up front; blending installs are rare enough to wait for
+ */
+static int setup_shaders(gpu_renderer_ctx_t *ctx) {
+    int ret = build_variants(ctx, 0);
+    if (ret < 0) {
+        return ret;
+    }
     
-    printf("GPU shaders compiled successfully\n");
+    ctx->active_variant = NULL;
     return GPU_RENDERER_OK;
 }
 
+/**
+ * Make the variant for a format current and bring its uniforms up to date
+ * 
+ * glUseProgram and uniform uploads only happen when something changed, so
+ * steady single-head playback draws with no per-frame uniform traffic; with
+ * several heads each draw re-uploads its head's warp, crop and blend coords.
+ */
+static shader_variant_t *use_variant(gpu_renderer_ctx_t *ctx, shader_format_t format) {
+    const render_head_t *head = ctx->current_head;
+    shader_variant_t *variant =
+        &ctx->variants[format][color_adjust_active(ctx)][head->blend_texture != 0];
+    
+    if (variant != ctx->active_variant) {
+        glUseProgram(variant->program);
+        ctx->active_variant = variant;
+    }
+    
+    if (variant->warp_serial != ctx->warp_serial || variant->warp_head != head) {
+        glUniformMatrix4fv(variant->u_matrix, 1, GL_FALSE, head->warp_matrix.matrix);
+        glUniform4fv(variant->u_crop, 1, head->crop);
+        glUniform4fv(variant->u_blend_coord, 1, head->blend_coord);
+        variant->warp_head = head;
+        variant->warp_serial = ctx->warp_serial;
+    }
+    
+    if (variant->config_serial != ctx->config_serial) {
+        glUniform1f(variant->u_brightness, ctx->config.brightness);
+        glUniform1f(variant->u_contrast, ctx->config.contrast);
+        glUniform1f(variant->u_saturation, ctx->config.saturation);
+        variant->config_serial = ctx->config_serial;
+    }
+    
+    return variant;
+}
+
 /**
  * Setup vertex buffers and geometry
  */
 static int setup_geometry(gpu_renderer_ctx_t *ctx) {
-    GLuint index_buffer;
-    
     /* Generate vertex array object */
     glGenVertexArrays(1, &ctx->vertex_array);
     glBindVertexArray(ctx->vertex_array);
@@ -377,9 +851,11 @@ static int setup_geometry(gpu_renderer_ctx_t *ctx) {
     glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), quad_vertices, GL_STATIC_DRAW);
     
     /* Generate and setup index buffer */
-    glGenBuffers(1, &index_buffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+    glGenBuffers(1, &ctx->index_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ctx->index_buffer);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quad_indices), quad_indices, GL_STATIC_DRAW);
+    ctx->index_count = 6;
+    ctx->mesh_active = 0;
     
     /* Setup vertex attributes */
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (void*)0);
@@ -395,6 +871,29 @@ static int setup_geometry(gpu_renderer_ctx_t *ctx) {
     return GPU_RENDERER_OK;
 }
 
+/**
+ * Create the timer query ring (GL_EXT_disjoint_timer_query; optional)
+ */
+static void timer_setup(gpu_renderer_ctx_t *ctx) {
+    const char *gl_extensions = (const char *)glGetString(GL_EXTENSIONS);
+    GLint disjoint;
+    
+    if (ctx->has_timer_query) {
+        return;  /* Reconfigured: the ring is already there */
+    }
+    if (!gl_extensions || !strstr(gl_extensions, "GL_EXT_disjoint_timer_query")) {
+        printf("GPU timing: GL_EXT_disjoint_timer_query not supported\n");
+        return;
+    }
+    
+    for (int i = 0; i < GPU_TIMER_FRAMES; i++) {
+        glGenQueries(GPU_PASS_COUNT, ctx->timer_frames[i].queries);
+    }
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);  /* Reading clears it */
+    ctx->has_timer_query = 1;
+    printf("✓ GPU timing: %d frames of timer queries in flight\n", GPU_TIMER_FRAMES);
+}
+
 /**
  * Configure renderer with display and video parameters
  */
@@ -424,12 +923,33 @@ int gpu_renderer_configure(gpu_renderer_ctx_t *ctx,
         return GPU_RENDERER_ERROR;
     }
     
+    /* Further heads are drawn through the same context, one surface at a time */
+    ctx->egl_context = eglGetCurrentContext();
+    ctx->head_count = display_output_get_head_count(display_ctx);
+    if (ctx->head_count < 1) {
+        ctx->head_count = 1;
+    }
+    for (int i = 0; i < ctx->head_count; i++) {
+        render_head_t *head = &ctx->heads[i];
+        EGLint width = 0, height = 0;
+        
+        head->surface = i == 0 ? ctx->egl_surface : display_output_get_head_surface(display_ctx, i);
+        eglQuerySurface(ctx->egl_display, head->surface, EGL_WIDTH, &width);
+        eglQuerySurface(ctx->egl_display, head->surface, EGL_HEIGHT, &height);
+        head->width = width > 0 ? width : 1920;
+        head->height = height > 0 ? height : 1080;
+    }
+    
     /* Load EGL extensions */
     ret = load_egl_extensions(ctx);
     if (ret < 0) {
         return ret;
     }
     
+    const char *egl_extensions = eglQueryString(ctx->egl_display, EGL_EXTENSIONS);
+    ctx->has_dmabuf_modifiers = egl_extensions &&
+        strstr(egl_extensions, "EGL_EXT_image_dma_buf_import_modifiers") != NULL;
+    
     /* Setup OpenGL resources */
     ret = setup_shaders(ctx);
     if (ret < 0) {
@@ -441,18 +961,14 @@ int gpu_renderer_configure(gpu_renderer_ctx_t *ctx,
         return ret;
     }
     
-    /* Get uniform locations for YUV420 shader */
-    glUseProgram(ctx->shader_program_yuv420);
-    ctx->u_matrix = glGetUniformLocation(ctx->shader_program_yuv420, "u_matrix");
-    ctx->u_tex_y = glGetUniformLocation(ctx->shader_program_yuv420, "u_tex_y");
-    ctx->u_tex_u = glGetUniformLocation(ctx->shader_program_yuv420, "u_tex_u");
-    ctx->u_tex_v = glGetUniformLocation(ctx->shader_program_yuv420, "u_tex_v");
-    ctx->u_brightness = glGetUniformLocation(ctx->shader_program_yuv420, "u_brightness");
-    ctx->u_contrast = glGetUniformLocation(ctx->shader_program_yuv420, "u_contrast");
-    ctx->u_saturation = glGetUniformLocation(ctx->shader_program_yuv420, "u_saturation");
+    timer_setup(ctx);
     
-    /* Setup OpenGL state */
-    glViewport(0, 0, 1920, 1080);  /* Will be updated by resize */
+    /* Setup OpenGL state: the viewport follows the surface (1080p or 2160p modes) */
+    EGLint surface_width = 0, surface_height = 0;
+    eglQuerySurface(ctx->egl_display, ctx->egl_surface, EGL_WIDTH, &surface_width);
+    eglQuerySurface(ctx->egl_display, ctx->egl_surface, EGL_HEIGHT, &surface_height);
+    gpu_renderer_resize(ctx, surface_width > 0 ? surface_width : 1920,
+                        surface_height > 0 ? surface_height : 1080);
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glDisable(GL_DEPTH_TEST);
     glDisable(GL_CULL_FACE);
@@ -462,57 +978,211 @@ int gpu_renderer_configure(gpu_renderer_ctx_t *ctx,
     }
     
     check_gl_error("gpu_renderer_configure");
-    printf("GPU renderer configured: %dx%d video, OpenGL ES ready\n", 
-           video_width, video_height);
+    printf("GPU renderer configured: %dx%d video on %dx%d surface, OpenGL ES ready\n", 
+           video_width, video_height, ctx->display_width, ctx->display_height);
+    if (ctx->head_count > 1) {
+        printf("✓ Drawing each frame to %d heads from one import\n", ctx->head_count);
+    }
     
     return GPU_RENDERER_OK;
 }
 
 /**
- * Import DMABUF as OpenGL texture
+ * Destroy one cache entry's GL texture and EGLImage
  */
-int gpu_renderer_import_dmabuf(gpu_renderer_ctx_t *ctx,
-                              int dmabuf_fd, int width, int height,
-                              uint32_t format, GLuint *texture_out) {
-    EGLImageKHR egl_image;
-    GLuint texture;
+static void texture_cache_evict(gpu_renderer_ctx_t *ctx, texture_cache_entry_t *entry) {
+    if (!entry->in_use) {
+        return;
+    }
     
-    if (!ctx || dmabuf_fd < 0 || !texture_out) {
-        return GPU_RENDERER_ERROR;
+    if (entry->texture) {
+        glDeleteTextures(1, &entry->texture);
+    }
+    if (entry->image != EGL_NO_IMAGE_KHR && ctx->eglDestroyImageKHR) {
+        ctx->eglDestroyImageKHR(ctx->egl_display, entry->image);
+    }
+    
+    memset(entry, 0, sizeof(*entry));
+    entry->image = EGL_NO_IMAGE_KHR;
+}
+
+/**
+ * Drop every cached import (decoder reallocated its buffer pool)
+ */
+void gpu_renderer_flush_texture_cache(gpu_renderer_ctx_t *ctx) {
+    if (!ctx) {
+        return;
     }
     
-    /* EGL attributes for DMABUF import */
-    EGLint attribs[] = {
-        EGL_WIDTH, width,
-        EGL_HEIGHT, height,
-        EGL_LINUX_DRM_FOURCC_EXT, format,
-        EGL_DMA_BUF_PLANE0_FD_EXT, dmabuf_fd,
-        EGL_DMA_BUF_PLANE0_OFFSET_EXT, 0,
-        EGL_DMA_BUF_PLANE0_PITCH_EXT, width,  /* Simplified - should be actual stride */
-        EGL_NONE
+    for (int i = 0; i < TEXTURE_CACHE_SIZE; i++) {
+        texture_cache_evict(ctx, &ctx->texture_cache[i]);
+    }
+    ctx->cache_width = 0;
+    ctx->cache_height = 0;
+}
+
+/**
+ * Import a (multi-plane) DMABUF as a single external texture
+ * 
+ * Imports are cached by dmabuf identity (fd + inode + offset of plane 0).
+ * The decoder recycles a small fixed pool of capture buffers, so after the
+ * first pass through the pool every frame is a cache hit and costs no
+ * driver work.
+ */
+static int import_dmabuf_planes(gpu_renderer_ctx_t *ctx,
+                                int width, int height,
+                                uint32_t format, uint64_t modifier,
+                                int num_planes, const int *fds,
+                                const uint32_t *offsets, const uint32_t *pitches,
+                                color_matrix_t matrix, int full_range,
+                                GLuint *texture_out) {
+    static const EGLint color_space_hints[] = {
+        [COLOR_MATRIX_BT601] = EGL_ITU_REC601_EXT,
+        [COLOR_MATRIX_BT709] = EGL_ITU_REC709_EXT,
+        [COLOR_MATRIX_BT2020] = EGL_ITU_REC2020_EXT,
+    };
+    static const EGLint plane_attrs[3][5] = {
+        { EGL_DMA_BUF_PLANE0_FD_EXT, EGL_DMA_BUF_PLANE0_OFFSET_EXT, EGL_DMA_BUF_PLANE0_PITCH_EXT,
+          EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT, EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT },
+        { EGL_DMA_BUF_PLANE1_FD_EXT, EGL_DMA_BUF_PLANE1_OFFSET_EXT, EGL_DMA_BUF_PLANE1_PITCH_EXT,
+          EGL_DMA_BUF_PLANE1_MODIFIER_LO_EXT, EGL_DMA_BUF_PLANE1_MODIFIER_HI_EXT },
+        { EGL_DMA_BUF_PLANE2_FD_EXT, EGL_DMA_BUF_PLANE2_OFFSET_EXT, EGL_DMA_BUF_PLANE2_PITCH_EXT,
+          EGL_DMA_BUF_PLANE2_MODIFIER_LO_EXT, EGL_DMA_BUF_PLANE2_MODIFIER_HI_EXT },
     };
+    texture_cache_entry_t *entry = NULL;
+    texture_cache_entry_t *victim = NULL;
+    EGLint attribs[64];
+    EGLImageKHR egl_image;
+    GLuint texture;
+    struct stat st;
+    int use_modifier;
+    int color_key = (int)matrix * 2 + (full_range ? 1 : 0);
+    int n = 0;
     
-    /* Create EGL image from DMABUF */
-    egl_image = ctx->eglCreateImageKHR(ctx->egl_display, EGL_NO_CONTEXT,
-                                      EGL_LINUX_DMA_BUF_EXT, NULL, attribs);
-    if (egl_image == EGL_NO_IMAGE_KHR) {
-        fprintf(stderr, "Failed to create EGL image from DMABUF\n");
+    if (num_planes < 1 || num_planes > 3 || fds[0] < 0) {
         return GPU_RENDERER_ERROR;
     }
     
-    /* Create OpenGL texture from EGL image */
+    if (fstat(fds[0], &st) < 0) {
+        fprintf(stderr, "Failed to stat DMABUF fd %d\n", fds[0]);
+        return GPU_RENDERER_ERROR;
+    }
+    
+    /* A new frame size means the decoder reallocated its pool */
+    if (width != ctx->cache_width || height != ctx->cache_height) {
+        gpu_renderer_flush_texture_cache(ctx);
+        ctx->cache_width = width;
+        ctx->cache_height = height;
+    }
+    
+    for (int i = 0; i < TEXTURE_CACHE_SIZE; i++) {
+        texture_cache_entry_t *e = &ctx->texture_cache[i];
+        
+        if (!e->in_use) {
+            if (!victim || victim->in_use) victim = e;
+            continue;
+        }
+        
+        if (e->fd == fds[0] && e->inode == (uint64_t)st.st_ino && e->device == (uint64_t)st.st_dev &&
+            e->offset == offsets[0] && e->width == width && e->height == height &&
+            e->format == format && e->modifier == modifier && e->color_key == color_key) {
+            entry = e;
+            break;
+        }
+        
+        /* Same fd now refers to a different buffer - stale entry */
+        if (e->fd == fds[0]) {
+            texture_cache_evict(ctx, e);
+            if (!victim || victim->in_use) victim = e;
+            continue;
+        }
+        
+        if (!victim || (victim->in_use && e->last_used < victim->last_used)) {
+            victim = e;
+        }
+    }
+    
+    if (entry) {
+        entry->last_used = ctx->frames_rendered;
+        ctx->cache_hits++;
+        *texture_out = entry->texture;
+        return GPU_RENDERER_OK;
+    }
+    
+    ctx->cache_misses++;
+    
+    use_modifier = modifier != DRM_FORMAT_MOD_INVALID && modifier != DRM_FORMAT_MOD_LINEAR;
+    if (use_modifier && !ctx->has_dmabuf_modifiers) {
+        fprintf(stderr, "DMABUF uses modifier 0x%llx but EGL_EXT_image_dma_buf_import_modifiers "
+                "is not available\n", (unsigned long long)modifier);
+        return GPU_RENDERER_ERROR;
+    }
+    
+    /* EGL attributes for DMABUF import - every plane goes into one image */
+    attribs[n++] = EGL_WIDTH;
+    attribs[n++] = width;
+    attribs[n++] = EGL_HEIGHT;
+    attribs[n++] = height;
+    attribs[n++] = EGL_LINUX_DRM_FOURCC_EXT;
+    attribs[n++] = format;
+    
+    for (int i = 0; i < num_planes; i++) {
+        attribs[n++] = plane_attrs[i][0];
+        attribs[n++] = fds[i];
+        attribs[n++] = plane_attrs[i][1];
+        attribs[n++] = offsets[i];
+        attribs[n++] = plane_attrs[i][2];
+        attribs[n++] = pitches[i];
+        if (use_modifier) {
+            attribs[n++] = plane_attrs[i][3];
+            attribs[n++] = (EGLint)(modifier & 0xffffffff);
+            attribs[n++] = plane_attrs[i][4];
+            attribs[n++] = (EGLint)(modifier >> 32);
+        }
+    }
+    
+    /* The sampler converts with the stream's own matrix and range */
+    attribs[n++] = EGL_YUV_COLOR_SPACE_HINT_EXT;
+    attribs[n++] = color_space_hints[matrix];
+    attribs[n++] = EGL_SAMPLE_RANGE_HINT_EXT;
+    attribs[n++] = full_range ? EGL_YUV_FULL_RANGE_EXT : EGL_YUV_NARROW_RANGE_EXT;
+    attribs[n++] = EGL_NONE;
+    
+    /* Create EGL image from DMABUF */
+    egl_image = ctx->eglCreateImageKHR(ctx->egl_display, EGL_NO_CONTEXT,
+                                      EGL_LINUX_DMA_BUF_EXT, NULL, attribs);
+    if (egl_image == EGL_NO_IMAGE_KHR) {
+        fprintf(stderr, "Failed to create EGL image from DMABUF (fourcc %.4s, modifier 0x%llx): 0x%x\n",
+                (const char *)&format, (unsigned long long)modifier, eglGetError());
+        return GPU_RENDERER_ERROR;
+    }
+    
+    /* Create external OpenGL texture from EGL image */
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    ctx->glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, egl_image);
+    glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture);
+    ctx->glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, egl_image);
     
     /* Set texture parameters */
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    
-    /* Clean up EGL image */
-    ctx->eglDestroyImageKHR(ctx->egl_display, egl_image);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    
+    /* Least recently used entry makes room (pool larger than the cache) */
+    texture_cache_evict(ctx, victim);
+    victim->in_use = 1;
+    victim->fd = fds[0];
+    victim->inode = st.st_ino;
+    victim->device = st.st_dev;
+    victim->offset = offsets[0];
+    victim->width = width;
+    victim->height = height;
+    victim->format = format;
+    victim->modifier = modifier;
+    victim->color_key = color_key;
+    victim->image = egl_image;
+    victim->texture = texture;
+    victim->last_used = ctx->frames_rendered;
     
     *texture_out = texture;
     check_gl_error("import_dmabuf");
@@ -520,12 +1190,443 @@ int gpu_renderer_import_dmabuf(gpu_renderer_ctx_t *ctx,
     return GPU_RENDERER_OK;
 }
 
+/**
+ * Import single-plane DMABUF as OpenGL texture
+ */
+int gpu_renderer_import_dmabuf(gpu_renderer_ctx_t *ctx,
+                              int dmabuf_fd, int width, int height,
+                              uint32_t format, GLuint *texture_out) {
+    uint32_t offset = 0;
+    uint32_t pitch;
+    
+    if (!ctx || dmabuf_fd < 0 || !texture_out) {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    /* No layout information - assume a tightly packed 32bpp buffer */
+    pitch = (uint32_t)width * 4;
+    
+    /* Packed RGB: the colourspace hints do not apply */
+    return import_dmabuf_planes(ctx, width, height, format, DRM_FORMAT_MOD_INVALID,
+                                1, &dmabuf_fd, &offset, &pitch,
+                                COLOR_MATRIX_BT709, 0, texture_out);
+}
+
+/**
+ * Matrix and range a frame was encoded with (height heuristic when the
+ * stream does not say: SD is BT.601, HD is BT.709)
+ */
+static void frame_color(const AVFrame *frame, int height, color_matrix_t *matrix,
+                        int *full_range) {
+    enum AVColorSpace space = frame ? frame->colorspace : AVCOL_SPC_UNSPECIFIED;
+    
+    *full_range = frame && (frame->color_range == AVCOL_RANGE_JPEG ||
+                            frame->format == AV_PIX_FMT_YUVJ420P);
+    
+    switch (space) {
+    case AVCOL_SPC_BT709:
+        *matrix = COLOR_MATRIX_BT709;
+        break;
+    case AVCOL_SPC_BT2020_NCL:
+    case AVCOL_SPC_BT2020_CL:
+        *matrix = COLOR_MATRIX_BT2020;
+        break;
+    case AVCOL_SPC_BT470BG:
+    case AVCOL_SPC_SMPTE170M:
+    case AVCOL_SPC_FCC:
+        *matrix = COLOR_MATRIX_BT601;
+        break;
+    default:
+        *matrix = height > 576 ? COLOR_MATRIX_BT709 : COLOR_MATRIX_BT601;
+        break;
+    }
+}
+
+/**
+ * Import a decoded DRM PRIME frame (all planes) as one external texture
+ */
+int gpu_renderer_import_frame(gpu_renderer_ctx_t *ctx, const decoded_frame_t *frame,
+                             GLuint *texture_out) {
+    if (!ctx || !frame || !texture_out || frame->dmabuf_fd[0] < 0) {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    if (frame->drm_format == 0) {
+        fprintf(stderr, "Frame has no DRM format, cannot import\n");
+        return GPU_RENDERER_ERROR;
+    }
+    
+    color_matrix_t matrix;
+    int full_range;
+    frame_color(frame->av_frame, frame->height, &matrix, &full_range);
+    
+    return import_dmabuf_planes(ctx, frame->width, frame->height,
+                                frame->drm_format, frame->modifier,
+                                frame->num_planes, frame->dmabuf_fd,
+                                frame->offsets, frame->pitches,
+                                matrix, full_range, texture_out);
+}
+
+/**
+ * Plane geometry of the system-memory layouts the planar shader handles
+ * @return Number of planes, 0 if the format is not supported
+ */
+static int planar_layout(int format, int width, int height,
+                         int plane_w[3], int plane_h[3], int plane_bpp[3]) {
+    int chroma_w = (width + 1) / 2, chroma_h = (height + 1) / 2;
+    
+    plane_w[0] = width;
+    plane_h[0] = height;
+    plane_bpp[0] = 1;
+    
+    switch (format) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+        for (int i = 1; i < 3; i++) {
+            plane_w[i] = chroma_w;
+            plane_h[i] = chroma_h;
+            plane_bpp[i] = 1;
+        }
+        return 3;
+    case AV_PIX_FMT_NV12:
+        plane_w[1] = chroma_w;
+        plane_h[1] = chroma_h;
+        plane_bpp[1] = 2;
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * YUV->RGB for a system-memory frame, range folded into scale and offset
+ */
+static void planar_color_matrix(color_matrix_t color, int full_range,
+                                GLfloat matrix[9], GLfloat offset[3]) {
+    float kr = 0.299f, kb = 0.114f;     /* BT.601 */
+    
+    if (color == COLOR_MATRIX_BT709) {
+        kr = 0.2126f;
+        kb = 0.0722f;
+    } else if (color == COLOR_MATRIX_BT2020) {
+        kr = 0.2627f;
+        kb = 0.0593f;
+    }
+    
+    float kg = 1.0f - kr - kb;
+    float ys = full_range ? 1.0f : 255.0f / 219.0f;
+    float cs = full_range ? 1.0f : 255.0f / 224.0f;
+    
+    /* Column-major: the columns weight Y, U and V */
+    matrix[0] = ys;
+    matrix[1] = ys;
+    matrix[2] = ys;
+    matrix[3] = 0.0f;
+    matrix[4] = -cs * 2.0f * kb * (1.0f - kb) / kg;
+    matrix[5] = cs * 2.0f * (1.0f - kb);
+    matrix[6] = cs * 2.0f * (1.0f - kr);
+    matrix[7] = -cs * 2.0f * kr * (1.0f - kr) / kg;
+    matrix[8] = 0.0f;
+    
+    offset[0] = full_range ? 0.0f : 16.0f / 255.0f;
+    offset[1] = 128.0f / 255.0f;
+    offset[2] = 128.0f / 255.0f;
+}
+
+/**
+ * Release one upload slot's GL objects
+ */
+static void upload_slot_destroy(upload_slot_t *slot) {
+    if (slot->fence) {
+        glDeleteSync(slot->fence);
+    }
+    if (slot->pbo) {
+        glDeleteBuffers(1, &slot->pbo);
+    }
+    for (int i = 0; i < 3; i++) {
+        if (slot->textures[i]) {
+            glDeleteTextures(1, &slot->textures[i]);
+        }
+    }
+    memset(slot, 0, sizeof(*slot));
+}
+
+/**
+ * Copy a system-memory frame into the next PBO slot and upload its planes
+ * 
+ * Each slot's fence covers the last draw that sampled its textures, so with
+ * three slots the wait is normally already satisfied and the map does not
+ * stall on the GPU. glTexSubImage2D from a bound PBO returns immediately;
+ * the transfer runs on the GPU side ahead of the draw.
+ */
+static int upload_frame(gpu_renderer_ctx_t *ctx, const decoded_frame_t *frame,
+                        upload_slot_t **slot_out) {
+    const AVFrame *src = frame->av_frame;
+    int plane_w[3], plane_h[3], plane_bpp[3];
+    size_t plane_offset[3], total = 0;
+    GLbitfield map_flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+    
+    int num_planes = planar_layout(src->format, src->width, src->height,
+                                   plane_w, plane_h, plane_bpp);
+    if (num_planes == 0) {
+        if (ctx->upload_unsupported_format != src->format + 1) {
+            fprintf(stderr, "⚠ No upload path for system-memory format %d - frames skipped\n",
+                    src->format);
+            ctx->upload_unsupported_format = src->format + 1;
+        }
+        return GPU_RENDERER_ERROR;
+    }
+    
+    for (int i = 0; i < num_planes; i++) {
+        if (!src->data[i] || src->linesize[i] < plane_w[i] * plane_bpp[i]) {
+            fprintf(stderr, "Unsupported plane %d layout (linesize %d)\n", i, src->linesize[i]);
+            return GPU_RENDERER_ERROR;
+        }
+        plane_offset[i] = total;
+        total += (size_t)src->linesize[i] * (size_t)plane_h[i];
+    }
+    
+    upload_slot_t *slot = &ctx->upload_slots[ctx->upload_next];
+    ctx->upload_next = (ctx->upload_next + 1) % UPLOAD_SLOTS;
+    
+    /* GPU finished with this slot's previous frame? (normally long ago) */
+    if (slot->fence) {
+        GLenum status = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                         UPLOAD_FENCE_TIMEOUT_NS);
+        glDeleteSync(slot->fence);
+        slot->fence = NULL;
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+            map_flags |= GL_MAP_UNSYNCHRONIZED_BIT;
+        }
+    }
+    
+    /* (Re)allocate textures when the frame geometry changes */
+    if (slot->width != src->width || slot->height != src->height || slot->format != src->format) {
+        for (int i = 0; i < 3; i++) {
+            if (slot->textures[i]) {
+                glDeleteTextures(1, &slot->textures[i]);
+                slot->textures[i] = 0;
+            }
+        }
+        glGenTextures(num_planes, slot->textures);
+        for (int i = 0; i < num_planes; i++) {
+            glBindTexture(GL_TEXTURE_2D, slot->textures[i]);
+            glTexStorage2D(GL_TEXTURE_2D, 1, plane_bpp[i] == 2 ? GL_RG8 : GL_R8,
+                           plane_w[i], plane_h[i]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        slot->width = src->width;
+        slot->height = src->height;
+        slot->format = src->format;
+    }
+    
+    if (!slot->pbo) {
+        glGenBuffers(1, &slot->pbo);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->pbo);
+    if (slot->pbo_size < total) {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)total, NULL, GL_STREAM_DRAW);
+        slot->pbo_size = total;
+    }
+    
+    /* One memcpy per plane: keep the decoder's stride, GL skips the padding */
+    uint8_t *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)total, map_flags);
+    if (!dst) {
+        fprintf(stderr, "Failed to map upload PBO (0x%x)\n", glGetError());
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return GPU_RENDERER_ERROR;
+    }
+    for (int i = 0; i < num_planes; i++) {
+        size_t last_row = (size_t)plane_w[i] * (size_t)plane_bpp[i];
+        memcpy(dst + plane_offset[i], src->data[i],
+               (size_t)src->linesize[i] * (size_t)(plane_h[i] - 1) + last_row);
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int i = 0; i < num_planes; i++) {
+        glBindTexture(GL_TEXTURE_2D, slot->textures[i]);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, src->linesize[i] / plane_bpp[i]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, plane_w[i], plane_h[i],
+                        plane_bpp[i] == 2 ? GL_RG : GL_RED, GL_UNSIGNED_BYTE,
+                        (const void *)(uintptr_t)plane_offset[i]);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    
+    check_gl_error("upload_frame");
+    *slot_out = slot;
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Read back every frame whose queries have finished, oldest first, without waiting
+ */
+static void timer_collect(gpu_renderer_ctx_t *ctx) {
+    GLint disjoint = 0;
+    
+    if (!ctx->has_timer_query) {
+        return;
+    }
+    
+    /* A disjoint (GPU clock or power change) makes every result in flight meaningless */
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    
+    for (int n = 0; n < GPU_TIMER_FRAMES; n++) {
+        gpu_timer_frame_t *timer = &ctx->timer_frames[(ctx->timer_next + n) % GPU_TIMER_FRAMES];
+        GLuint available = 0;
+        
+        if (!timer->pending) {
+            continue;
+        }
+        
+        if (!disjoint) {
+            /* Queries finish in submission order: if this one hasn't, later ones haven't */
+            glGetQueryObjectuiv(timer->queries[timer->used[GPU_PASS_DRAW] ? GPU_PASS_DRAW :
+                                                                            GPU_PASS_IMPORT],
+                                GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                break;
+            }
+            for (int pass = 0; pass < GPU_PASS_COUNT; pass++) {
+                GLuint elapsed_ns = 0;
+                
+                if (timer->used[pass]) {
+                    glGetQueryObjectuiv(timer->queries[pass], GL_QUERY_RESULT, &elapsed_ns);
+                    ctx->gpu_pass_ns[pass] += elapsed_ns;
+                }
+            }
+            ctx->gpu_frames_timed++;
+        } else {
+            ctx->gpu_frames_discarded++;
+        }
+        
+        memset(timer->used, 0, sizeof(timer->used));
+        timer->pending = 0;
+    }
+}
+
+/**
+ * Open the timer query of one pass (one may be open at a time)
+ */
+static void timer_begin(gpu_renderer_ctx_t *ctx, gpu_pass_t pass) {
+    gpu_timer_frame_t *timer = &ctx->timer_frames[ctx->timer_next];
+    
+    /* Ring full (GPU more than GPU_TIMER_FRAMES behind): this frame goes untimed */
+    if (!ctx->has_timer_query || timer->pending) {
+        return;
+    }
+    
+    glBeginQuery(GL_TIME_ELAPSED_EXT, timer->queries[pass]);
+    timer->used[pass] = 1;
+    ctx->timer_pass = pass;
+}
+
+static void timer_end(gpu_renderer_ctx_t *ctx) {
+    if (ctx->timer_pass >= 0) {
+        glEndQuery(GL_TIME_ELAPSED_EXT);
+        ctx->timer_pass = -1;
+    }
+}
+
+/**
+ * The frame is submitted: its query set waits in the ring for the GPU
+ */
+static void timer_frame_done(gpu_renderer_ctx_t *ctx, const struct timeval *submitted) {
+    gpu_timer_frame_t *timer = &ctx->timer_frames[ctx->timer_next];
+    
+    timer_end(ctx);
+    if (!ctx->has_timer_query || timer->pending ||
+        !(timer->used[GPU_PASS_IMPORT] || timer->used[GPU_PASS_DRAW])) {
+        return;
+    }
+    
+    if (!ctx->timing_start.tv_sec && !ctx->timing_start.tv_usec) {
+        ctx->timing_start = *submitted;
+        ctx->timing_start_frame = ctx->frames_rendered;
+    }
+    timer->pending = 1;
+    ctx->timer_next = (ctx->timer_next + 1) % GPU_TIMER_FRAMES;
+}
+
+/**
+ * Make a head's surface current and clear it for the coming frame
+ */
+static int begin_head(gpu_renderer_ctx_t *ctx, int index) {
+    render_head_t *head = &ctx->heads[index];
+    
+    /* One head: its surface stays current and the viewport is already set */
+    if (ctx->head_count > 1) {
+        if (!eglMakeCurrent(ctx->egl_display, head->surface, head->surface, ctx->egl_context)) {
+            fprintf(stderr, "Failed to make head %d current\n", index + 1);
+            return GPU_RENDERER_ERROR;
+        }
+        glViewport(0, 0, head->width, head->height);
+    }
+    
+    ctx->current_head = head;
+    glClear(GL_COLOR_BUFFER_BIT);
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Draw the bound frame texture(s) into every head with its warp, crop and blend
+ */
+static int draw_heads(gpu_renderer_ctx_t *ctx, shader_format_t format, const AVFrame *planar) {
+    glBindVertexArray(ctx->vertex_array);
+    for (int i = 0; i < ctx->head_count; i++) {
+        int ret = begin_head(ctx, i);
+        if (ret < 0) return ret;
+        
+        shader_variant_t *variant = use_variant(ctx, format);
+        
+        /* The matrix only changes with the stream */
+        if (planar) {
+            const AVFrame *src = planar;
+            color_matrix_t matrix;
+            int full_range;
+            
+            frame_color(src, src->height, &matrix, &full_range);
+            int color_key = (int)matrix * 2 + full_range;
+            if (variant->color_key != color_key) {
+                GLfloat yuv_to_rgb[9], yuv_offset[3];
+                planar_color_matrix(matrix, full_range, yuv_to_rgb, yuv_offset);
+                glUniformMatrix3fv(variant->u_yuv_to_rgb, 1, GL_FALSE, yuv_to_rgb);
+                glUniform3fv(variant->u_yuv_offset, 1, yuv_offset);
+                variant->color_key = color_key;
+            }
+        }
+        
+        if (ctx->current_head->blend_texture) {
+            glActiveTexture(GL_TEXTURE0 + BLEND_TEXTURE_UNIT);
+            glBindTexture(GL_TEXTURE_2D, ctx->current_head->blend_texture);
+            glActiveTexture(GL_TEXTURE0);
+        }
+        
+        /* Render quad (or the baked warp mesh) */
+        glDrawElements(GL_TRIANGLES, ctx->index_count, GL_UNSIGNED_SHORT, 0);
+        
+        /* Heads before the last are submitted before their surface is switched away */
+        if (i + 1 < ctx->head_count) {
+            glFlush();
+        }
+    }
+    
+    return GPU_RENDERER_OK;
+}
+
 /**
  * Render frame with current warp matrix
  */
 int gpu_renderer_render_frame(gpu_renderer_ctx_t *ctx, const decoded_frame_t *frame) {
     struct timeval start_time, end_time;
-    GLuint textures[3] = {0};
+    upload_slot_t *slot = NULL;
+    shader_format_t format;
+    GLuint texture = 0;
     int ret;
     
     if (!ctx || !frame) {
@@ -533,17 +1634,13 @@ int gpu_renderer_render_frame(gpu_renderer_ctx_t *ctx, const decoded_frame_t *fr
     }
     
     gettimeofday(&start_time, NULL);
+    timer_collect(ctx);
     
-    /* Clear framebuffer */
-    glClear(GL_COLOR_BUFFER_BIT);
-    
-    /* Check for test pattern mode (no valid DMABUF) */
-    if (frame->dmabuf_fd[0] < 0) {
+    /* Check for test pattern mode (no DMABUF and no decoded picture) */
+    if (frame->dmabuf_fd[0] < 0 && !frame->av_frame) {
         /* Render a simple test pattern */
         glUseProgram(0); // Use fixed pipeline for simple pattern
-        
-        /* Set viewport */
-        glViewport(0, 0, ctx->video_width, ctx->video_height);
+        ctx->active_variant = NULL;
         
         /* Create a simple animated color pattern */
         static float color_cycle = 0.0f;
@@ -555,77 +1652,68 @@ int gpu_renderer_render_frame(gpu_renderer_ctx_t *ctx, const decoded_frame_t *fr
         float blue = 0.5f + 0.5f * sin(color_cycle * 6.28f + 4.18f);
         
         glClearColor(red, green, blue, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        
-        /* Swap buffers */
-        eglSwapBuffers(ctx->egl_display, ctx->egl_surface);
+        for (int i = 0; i < ctx->head_count; i++) {
+            ret = begin_head(ctx, i);
+            if (ret < 0) return ret;
+            glFlush();
+        }
         
         return GPU_RENDERER_OK;
     }
     
-    /* Import frame textures from DMABUF */
-    if (frame->format == AV_PIX_FMT_NV12) {
-        /* NV12: Y plane + interleaved UV plane */
-        ret = gpu_renderer_import_dmabuf(ctx, frame->dmabuf_fd[0], 
-                                        frame->width, frame->height,
-                                        frame->format, &textures[0]);
-        if (ret < 0) return ret;
+    /* The frame is imported or uploaded once, whatever the number of heads */
+    timer_begin(ctx, GPU_PASS_IMPORT);
+    if (frame->dmabuf_fd[0] >= 0) {
+        /* Import the whole frame as one external-OES texture */
+        ret = gpu_renderer_import_frame(ctx, frame, &texture);
+        if (ret < 0) {
+            timer_end(ctx);
+            return ret;
+        }
         
-        /* Use NV12 shader program */
-        glUseProgram(ctx->shader_program_nv12);
-        ctx->current_program = ctx->shader_program_nv12;
+        format = SHADER_FORMAT_EXTERNAL;
         
-        /* Bind Y texture */
+        /* Bind frame texture */
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textures[0]);
-        glUniform1i(glGetUniformLocation(ctx->current_program, "u_tex_nv12_y"), 0);
-        
-        /* TODO: Bind UV texture when multi-plane DMABUF is properly supported */
-        
+        glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture);
     } else {
-        /* YUV420: separate Y, U, V planes */
-        ret = gpu_renderer_import_dmabuf(ctx, frame->dmabuf_fd[0],
-                                        frame->width, frame->height,
-                                        frame->format, &textures[0]);
-        if (ret < 0) return ret;
+        /* Software decode: stage through a PBO into planar textures */
+        ret = upload_frame(ctx, frame, &slot);
+        if (ret < 0) {
+            timer_end(ctx);
+            return ret;
+        }
         
-        /* Use YUV420 shader program */
-        glUseProgram(ctx->shader_program_yuv420);
-        ctx->current_program = ctx->shader_program_yuv420;
+        format = frame->av_frame->format == AV_PIX_FMT_NV12 ?
+                 SHADER_FORMAT_NV12 : SHADER_FORMAT_YUV420;
         
-        /* Bind Y texture */
+        for (int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, slot->textures[i]);
+        }
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textures[0]);
-        glUniform1i(ctx->u_tex_y, 0);
-        
-        /* TODO: Import and bind U, V planes when multi-plane DMABUF is supported */
     }
+    timer_end(ctx);
     
-    /* Update uniforms */
-    glUniformMatrix4fv(ctx->u_matrix, 1, GL_FALSE, ctx->warp_matrix.matrix);
-    glUniform1f(ctx->u_brightness, ctx->config.brightness);
-    glUniform1f(ctx->u_contrast, ctx->config.contrast);
-    glUniform1f(ctx->u_saturation, ctx->config.saturation);
-    
-    /* Render quad */
-    glBindVertexArray(ctx->vertex_array);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+    timer_begin(ctx, GPU_PASS_DRAW);
+    ret = draw_heads(ctx, format, slot ? frame->av_frame : NULL);
+    timer_end(ctx);
+    if (ret < 0) return ret;
     
-    /* Clean up textures */
-    for (int i = 0; i < 3; i++) {
-        if (textures[i]) {
-            glDeleteTextures(1, &textures[i]);
-        }
+    /* The slot's PBO and textures are reusable once this draw has run */
+    if (slot) {
+        slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
     }
     
-    /* Present frame */
-    eglSwapBuffers(ctx->egl_display, ctx->egl_surface);
+    /* Submit now; display_output_present_frame() does the single swap + flip */
+    glFlush();
     
     /* Update statistics */
     gettimeofday(&end_time, NULL);
     uint64_t render_time = (end_time.tv_sec - start_time.tv_sec) * 1000000LL +
                           (end_time.tv_usec - start_time.tv_usec);
     
+    timer_frame_done(ctx, &start_time);
     ctx->frames_rendered++;
     ctx->total_render_time_us += render_time;
     ctx->last_frame_time = end_time;
@@ -634,6 +1722,49 @@ int gpu_renderer_render_frame(gpu_renderer_ctx_t *ctx, const decoded_frame_t *fr
     return GPU_RENDERER_OK;
 }
 
+/**
+ * Draw a texture another GL user rendered through every head's warp
+ */
+int gpu_renderer_render_texture(gpu_renderer_ctx_t *ctx, GLuint texture, int width, int height) {
+    struct timeval start_time, end_time;
+    int ret;
+    
+    if (!ctx || !texture || width <= 0 || height <= 0) {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    gettimeofday(&start_time, NULL);
+    timer_collect(ctx);
+    
+    /* The other renderer may have left any program, target or state bound */
+    ctx->active_variant = NULL;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glViewport(0, 0, ctx->heads[0].width, ctx->heads[0].height);  /* begin_head() sets the others */
+    
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    
+    timer_begin(ctx, GPU_PASS_DRAW);
+    ret = draw_heads(ctx, SHADER_FORMAT_RGB, NULL);
+    timer_end(ctx);
+    if (ret < 0) return ret;
+    glFlush();
+    
+    gettimeofday(&end_time, NULL);
+    timer_frame_done(ctx, &start_time);
+    ctx->frames_rendered++;
+    ctx->total_render_time_us += (end_time.tv_sec - start_time.tv_sec) * 1000000LL +
+                                 (end_time.tv_usec - start_time.tv_usec);
+    ctx->last_frame_time = end_time;
+    
+    check_gl_error("render_texture");
+    return GPU_RENDERER_OK;
+}
+
 /**
  * Set warp transformation matrix
  */
@@ -642,12 +1773,232 @@ int gpu_renderer_set_warp_matrix(gpu_renderer_ctx_t *ctx, const warp_matrix_t *m
         return GPU_RENDERER_ERROR;
     }
     
-    memcpy(&ctx->warp_matrix, matrix, sizeof(warp_matrix_t));
-    ctx->warp_matrix.dirty = 0;  /* Mark as clean */
+    /* Every head mirrors it; gpu_renderer_set_head_warp_matrix() sets one */
+    for (int i = 0; i < DISPLAY_OUTPUT_MAX_HEADS; i++) {
+        memcpy(&ctx->heads[i].warp_matrix, matrix, sizeof(warp_matrix_t));
+        ctx->heads[i].warp_matrix.dirty = 0;  /* Mark as clean */
+    }
+    ctx->warp_serial++;
+    
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Set one head's warp transformation matrix
+ */
+int gpu_renderer_set_head_warp_matrix(gpu_renderer_ctx_t *ctx, int head,
+                                      const warp_matrix_t *matrix) {
+    if (!ctx || !matrix || head < 0 || head >= DISPLAY_OUTPUT_MAX_HEADS) {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    memcpy(&ctx->heads[head].warp_matrix, matrix, sizeof(warp_matrix_t));
+    ctx->heads[head].warp_matrix.dirty = 0;
+    ctx->warp_serial++;
+    
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Set the part of the frame one head shows
+ */
+int gpu_renderer_set_head_crop(gpu_renderer_ctx_t *ctx, int head,
+                               float x, float y, float width, float height) {
+    if (!ctx || head < 0 || head >= DISPLAY_OUTPUT_MAX_HEADS ||
+        width <= 0.0f || height <= 0.0f || x < 0.0f || y < 0.0f ||
+        x + width > 1.0f + 1e-5f || y + height > 1.0f + 1e-5f) {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    ctx->heads[head].crop[0] = x;
+    ctx->heads[head].crop[1] = y;
+    ctx->heads[head].crop[2] = width;
+    ctx->heads[head].crop[3] = height;
+    ctx->warp_serial++;
     
     return GPU_RENDERER_OK;
 }
 
+/**
+ * Set one head's edge blend / mask lookup
+ */
+int gpu_renderer_set_head_blend(gpu_renderer_ctx_t *ctx, int head, const warp_blend_t *blend) {
+    render_head_t *target;
+    
+    if (!ctx || head < 0 || head >= DISPLAY_OUTPUT_MAX_HEADS) {
+        return GPU_RENDERER_ERROR;
+    }
+    target = &ctx->heads[head];
+    
+    if (!blend || !blend->texels) {
+        if (target->blend_texture) {
+            glDeleteTextures(1, &target->blend_texture);
+            target->blend_texture = 0;
+            ctx->warp_serial++;
+        }
+        return GPU_RENDERER_OK;
+    }
+    
+    if (blend->width <= 0 || blend->height <= 0 || target->width <= 0 || target->height <= 0) {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    if (!ctx->blend_variants_built) {
+        if (build_variants(ctx, 1) < 0) {
+            fprintf(stderr, "Failed to build edge-blend shaders\n");
+            return GPU_RENDERER_ERROR;
+        }
+        ctx->blend_variants_built = 1;
+        ctx->active_variant = NULL;
+    }
+    
+    if (!target->blend_texture) {
+        glGenTextures(1, &target->blend_texture);
+    }
+    glActiveTexture(GL_TEXTURE0 + BLEND_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, target->blend_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, blend->width, blend->height, 0,
+                 GL_RGB, GL_UNSIGNED_BYTE, blend->texels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glActiveTexture(GL_TEXTURE0);
+    
+    /* Texel rows run from the top; gl_FragCoord.y from the bottom */
+    target->blend_coord[0] = 1.0f / (GLfloat)target->width;
+    target->blend_coord[1] = -1.0f / (GLfloat)target->height;
+    target->blend_coord[2] = 0.0f;
+    target->blend_coord[3] = 1.0f;
+    ctx->warp_serial++;
+    
+    check_gl_error("set_head_blend");
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Set edge blend / mask lookup (every head)
+ */
+int gpu_renderer_set_blend(gpu_renderer_ctx_t *ctx, const warp_blend_t *blend) {
+    if (!ctx) {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    for (int i = 0; i < ctx->head_count; i++) {
+        int ret = gpu_renderer_set_head_blend(ctx, i, blend);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Set warp mesh
+ */
+int gpu_renderer_set_warp_mesh(gpu_renderer_ctx_t *ctx, const warp_mesh_t *mesh) {
+    if (!ctx || !ctx->vertex_array) {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    glBindVertexArray(ctx->vertex_array);
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->vertex_buffer);
+    
+    /* No mesh: back to the fullscreen quad */
+    if (!mesh || mesh->cols <= 0 || mesh->rows <= 0 || !mesh->points) {
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), quad_vertices, GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quad_indices), quad_indices, GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        ctx->index_count = 6;
+        ctx->mesh_active = 0;
+        return GPU_RENDERER_OK;
+    }
+    
+    if (mesh->cols > WARP_MESH_MAX_CELLS || mesh->rows > WARP_MESH_MAX_CELLS) {
+        glBindVertexArray(0);
+        fprintf(stderr, "Warp mesh too large: %dx%d (max %d)\n",
+                mesh->cols, mesh->rows, WARP_MESH_MAX_CELLS);
+        return GPU_RENDERER_ERROR;
+    }
+    
+    int stride = mesh->cols + 1;
+    int vertex_count = stride * (mesh->rows + 1);
+    int index_count = mesh->cols * mesh->rows * 6;
+    GLfloat *vertices = malloc((size_t)vertex_count * 4 * sizeof(GLfloat));
+    GLushort *indices = malloc((size_t)index_count * sizeof(GLushort));
+    if (!vertices || !indices) {
+        free(vertices);
+        free(indices);
+        glBindVertexArray(0);
+        return GPU_RENDERER_ERROR;
+    }
+    
+    /* Same layout as quad_vertices: clip-space position (y up), texcoord (v down) */
+    for (int row = 0; row <= mesh->rows; row++) {
+        for (int col = 0; col <= mesh->cols; col++) {
+            int i = row * stride + col;
+            vertices[i * 4 + 0] = mesh->points[i * 2 + 0];
+            vertices[i * 4 + 1] = -mesh->points[i * 2 + 1];
+            vertices[i * 4 + 2] = (GLfloat)col / (GLfloat)mesh->cols;
+            vertices[i * 4 + 3] = (GLfloat)row / (GLfloat)mesh->rows;
+        }
+    }
+    
+    GLushort *index = indices;
+    for (int row = 0; row < mesh->rows; row++) {
+        for (int col = 0; col < mesh->cols; col++) {
+            GLushort top_left = (GLushort)(row * stride + col);
+            GLushort bottom_left = (GLushort)(top_left + stride);
+            
+            *index++ = top_left;
+            *index++ = bottom_left;
+            *index++ = (GLushort)(top_left + 1);
+            *index++ = (GLushort)(top_left + 1);
+            *index++ = bottom_left;
+            *index++ = (GLushort)(bottom_left + 1);
+        }
+    }
+    
+    /* Uploaded once; every frame is still a single glDrawElements */
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertex_count * 4 * sizeof(GLfloat),
+                 vertices, GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)index_count * sizeof(GLushort),
+                 indices, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    
+    free(vertices);
+    free(indices);
+    
+    ctx->index_count = index_count;
+    ctx->mesh_active = 1;
+    check_gl_error("set_warp_mesh");
+    
+    printf("Warp mesh: %dx%d cells, %d triangles\n", mesh->cols, mesh->rows, index_count / 3);
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Resize renderer viewport
+ */
+int gpu_renderer_resize(gpu_renderer_ctx_t *ctx, int width, int height) {
+    if (!ctx || width <= 0 || height <= 0) {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    ctx->display_width = width;
+    ctx->display_height = height;
+    ctx->heads[0].width = width;
+    ctx->heads[0].height = height;
+    ctx->heads[0].blend_coord[0] = 1.0f / (GLfloat)width;   /* The lookup spans the new size */
+    ctx->heads[0].blend_coord[1] = -1.0f / (GLfloat)height;
+    ctx->warp_serial++;
+    glViewport(0, 0, width, height);
+    return GPU_RENDERER_OK;
+}
+
 /**
  * Get current warp transformation matrix
  */
@@ -656,10 +2007,112 @@ int gpu_renderer_get_warp_matrix(gpu_renderer_ctx_t *ctx, warp_matrix_t *matrix)
         return GPU_RENDERER_ERROR;
     }
     
-    memcpy(matrix, &ctx->warp_matrix, sizeof(warp_matrix_t));
+    memcpy(matrix, &ctx->heads[0].warp_matrix, sizeof(warp_matrix_t));
     return GPU_RENDERER_OK;
 }
 
+/**
+ * Get renderer statistics
+ */
+void gpu_renderer_get_stats(gpu_renderer_ctx_t *ctx,
+                           uint64_t *frames_rendered,
+                           uint64_t *avg_render_time_us,
+                           uint64_t *gpu_memory_used) {
+    uint64_t staging = 0;
+    
+    if (!ctx) {
+        return;
+    }
+    
+    for (int i = 0; i < UPLOAD_SLOTS; i++) {
+        staging += ctx->upload_slots[i].pbo_size;
+    }
+    
+    if (frames_rendered) {
+        *frames_rendered = ctx->frames_rendered;
+    }
+    if (avg_render_time_us) {
+        *avg_render_time_us = ctx->frames_rendered ?
+                              ctx->total_render_time_us / ctx->frames_rendered : 0;
+    }
+    if (gpu_memory_used) {
+        *gpu_memory_used = staging;
+    }
+}
+
+/**
+ * Get GPU execution times per pass and how idle the GPU was
+ */
+int gpu_renderer_get_gpu_timing(gpu_renderer_ctx_t *ctx, gpu_timing_t *timing) {
+    struct timeval now;
+    uint64_t frame_ns = 0;
+    
+    if (!ctx || !timing) {
+        return GPU_RENDERER_ERROR;
+    }
+    
+    memset(timing, 0, sizeof(*timing));
+    timing->available = ctx->has_timer_query;
+    timer_collect(ctx);
+    timing->frames_timed = ctx->gpu_frames_timed;
+    timing->frames_discarded = ctx->gpu_frames_discarded;
+    if (!ctx->gpu_frames_timed) {
+        return GPU_RENDERER_OK;
+    }
+    
+    for (int pass = 0; pass < GPU_PASS_COUNT; pass++) {
+        timing->avg_pass_us[pass] = ctx->gpu_pass_ns[pass] / ctx->gpu_frames_timed / 1000;
+        frame_ns += ctx->gpu_pass_ns[pass];
+    }
+    
+    /* Untimed frames (ring full, disjoint) are assumed to cost the average */
+    gettimeofday(&now, NULL);
+    double window_us = (double)(now.tv_sec - ctx->timing_start.tv_sec) * 1e6 +
+                       (double)(now.tv_usec - ctx->timing_start.tv_usec);
+    double busy_us = (double)frame_ns / (double)ctx->gpu_frames_timed / 1000.0 *
+                     (double)(ctx->frames_rendered - ctx->timing_start_frame);
+    if (window_us > 0.0) {
+        timing->idle_fraction = busy_us >= window_us ? 0.0 : 1.0 - busy_us / window_us;
+    }
+    
+    return GPU_RENDERER_OK;
+}
+
+/**
+ * Check if rendering would leave the frame unchanged
+ */
+int gpu_renderer_is_passthrough(gpu_renderer_ctx_t *ctx) {
+    float identity[16];
+    
+    if (!ctx) {
+        return 0;
+    }
+    
+    /* Several heads always go through GL (the overlay path drives one CRTC) */
+    if (ctx->mesh_active || ctx->head_count > 1 || ctx->heads[0].blend_texture) {
+        return 0;
+    }
+    
+    if (color_adjust_active(ctx)) {
+        return 0;
+    }
+    
+    const render_head_t *head = &ctx->heads[0];
+    if (head->crop[0] != 0.0f || head->crop[1] != 0.0f ||
+        head->crop[2] != 1.0f || head->crop[3] != 1.0f) {
+        return 0;
+    }
+    
+    matrix_identity(identity);
+    for (int i = 0; i < 16; i++) {
+        if (fabsf(head->warp_matrix.matrix[i] - identity[i]) > 1e-5f) {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
 /**
  * Check if required extensions are available
  */
@@ -688,19 +2141,41 @@ void gpu_renderer_destroy(gpu_renderer_ctx_t *ctx) {
         return;
     }
     
+    /* Release cached DMABUF imports and upload slots */
+    gpu_renderer_flush_texture_cache(ctx);
+    for (int i = 0; i < UPLOAD_SLOTS; i++) {
+        upload_slot_destroy(&ctx->upload_slots[i]);
+    }
+    
     /* Clean up OpenGL resources */
-    if (ctx->shader_program_yuv420) {
-        glDeleteProgram(ctx->shader_program_yuv420);
+    for (int format = 0; format < SHADER_FORMAT_COUNT; format++) {
+        for (int adjust = 0; adjust < 2; adjust++) {
+            for (int blend = 0; blend < 2; blend++) {
+                if (ctx->variants[format][adjust][blend].program) {
+                    glDeleteProgram(ctx->variants[format][adjust][blend].program);
+                }
+            }
+        }
     }
-    if (ctx->shader_program_nv12) {
-        glDeleteProgram(ctx->shader_program_nv12);
+    for (int i = 0; i < DISPLAY_OUTPUT_MAX_HEADS; i++) {
+        if (ctx->heads[i].blend_texture) {
+            glDeleteTextures(1, &ctx->heads[i].blend_texture);
+        }
     }
     if (ctx->vertex_buffer) {
         glDeleteBuffers(1, &ctx->vertex_buffer);
     }
+    if (ctx->index_buffer) {
+        glDeleteBuffers(1, &ctx->index_buffer);
+    }
     if (ctx->vertex_array) {
         glDeleteVertexArrays(1, &ctx->vertex_array);
     }
+    if (ctx->has_timer_query) {
+        for (int i = 0; i < GPU_TIMER_FRAMES; i++) {
+            glDeleteQueries(GPU_PASS_COUNT, ctx->timer_frames[i].queries);
+        }
+    }
     
     free(ctx);
 }
\ No newline at end of file
@@ -4,9 +4,18 @@
  * This module handles:
  * - OpenGL ES 3.2 context creation and management
  * - DMABUF import as OpenGL textures (zero-copy from decoder)
- * - YUV→RGB conversion using shaders
+ * - YUV→RGB conversion via external-OES sampling (multi-plane EGLImage)
+ * - Shader variants per input format, with the colour-adjust stage compiled
+ *   in only when it is in use; colour matrix and range taken from the stream
+ * - Triple-buffered PBO upload for software-decoded (system memory) frames
+ * - Warping RGB textures from another GL renderer (libmpv fallback)
  * - Keystone correction/warping with transformation matrices
- * - Frame rendering and presentation
+ * - Edge blending and masking through a low-resolution lookup multiplied
+ *   in the same pass (no extra full-screen pass)
+ * - Drawing one imported frame to every display head, each with its own
+ *   warp matrix and source crop (mirror or span across two HDMI outputs)
+ * - Linked program binary cache between runs (faster cold start)
+ * - Frame rendering (presentation is display_output's job)
  */
 
 #ifndef GPU_RENDERER_H
@@ -40,6 +49,30 @@ typedef struct {
     int dirty;         /* 1 if matrix needs to be updated */
 } warp_matrix_t;
 
+/* Largest warp mesh (cells per axis); keeps vertex indices within 16 bits */
+#define WARP_MESH_MAX_CELLS  64
+
+/*
+ * Warp mesh for curved surfaces: (cols+1) x (rows+1) grid points, row-major
+ * from the top-left, in the warp corner convention (x right, y down, -1..1).
+ * The warp matrix (homography) is applied on top of the mesh.
+ */
+typedef struct {
+    int cols, rows;           /* Cells per axis (0 = no mesh, plain quad) */
+    const float *points;      /* 2 floats per grid point */
+} warp_mesh_t;
+
+/*
+ * Edge blend / mask lookup for overlapping projectors: width x height RGB
+ * texels, row-major from the top-left of the output (not the source frame),
+ * multiplied into the final colour. Low resolution is fine; it is sampled
+ * with bilinear filtering.
+ */
+typedef struct {
+    int width, height;
+    const uint8_t *texels;    /* 3 bytes per texel, or NULL for no blend */
+} warp_blend_t;
+
 /* Renderer configuration */
 typedef struct {
     int enable_vsync;          /* Enable vertical sync */
@@ -50,6 +83,23 @@ typedef struct {
     float saturation;          /* Saturation adjustment (0.0-2.0, 1.0 = normal) */
 } renderer_config_t;
 
+/* GPU passes of a frame, timed with GL_EXT_disjoint_timer_query */
+typedef enum {
+    GPU_PASS_IMPORT,           /* PBO -> texture upload (DMABUF frames: texture bind only) */
+    GPU_PASS_DRAW,             /* YUV->RGB, warp, crop and blend into every head */
+    GPU_PASS_COUNT
+} gpu_pass_t;
+
+/* GPU-side timing; results come back a few frames after submission */
+typedef struct {
+    int available;                        /* Timer queries supported */
+    uint64_t frames_timed;
+    uint64_t frames_discarded;            /* Results lost to a GPU disjoint (clock/power change) */
+    uint64_t avg_pass_us[GPU_PASS_COUNT]; /* Mean GPU execution time per timed frame */
+    double idle_fraction;                 /* Share of wall time since the first timed frame
+                                           * the GPU spent on none of our passes (0-1) */
+} gpu_timing_t;
+
 /* Shader types */
 typedef enum {
     SHADER_VERTEX,
@@ -87,6 +137,9 @@ int gpu_renderer_configure(gpu_renderer_ctx_t *ctx,
 
 /**
  * Set renderer configuration (optional)
+ * 
+ * Brightness, contrast and saturation all at 1.0 select shader variants
+ * without the colour-adjust stage.
  * @param ctx Renderer context
  * @param config Configuration options
  * @return 0 on success, negative on error
@@ -94,12 +147,15 @@ int gpu_renderer_configure(gpu_renderer_ctx_t *ctx,
 int gpu_renderer_set_config(gpu_renderer_ctx_t *ctx, const renderer_config_t *config);
 
 /**
- * Import DMABUF as OpenGL texture (zero-copy)
+ * Import single-plane DMABUF as OpenGL texture (zero-copy)
+ * 
+ * Imports are cached per DMABUF; the returned GL_TEXTURE_EXTERNAL_OES
+ * texture is owned by the renderer and must not be deleted by the caller.
  * @param ctx Renderer context
  * @param dmabuf_fd DMABUF file descriptor
  * @param width Texture width
  * @param height Texture height
- * @param format V4L2 pixel format
+ * @param format DRM fourcc (packed 32bpp, linear)
  * @param texture_out Output texture ID
  * @return 0 on success, negative on error
  */
@@ -107,16 +163,59 @@ int gpu_renderer_import_dmabuf(gpu_renderer_ctx_t *ctx,
                               int dmabuf_fd, int width, int height,
                               uint32_t format, GLuint *texture_out);
 
+/**
+ * Import decoded frame as one external texture (zero-copy)
+ * 
+ * Every plane's fd, offset, pitch and the format modifier go into a single
+ * EGLImage, so YUV->RGB conversion happens in the texture sampler. The
+ * texture is cached and owned by the renderer.
+ * @param ctx Renderer context
+ * @param frame Decoded DRM PRIME frame
+ * @param texture_out Output GL_TEXTURE_EXTERNAL_OES texture ID
+ * @return 0 on success, negative on error
+ */
+int gpu_renderer_import_frame(gpu_renderer_ctx_t *ctx, const decoded_frame_t *frame,
+                             GLuint *texture_out);
+
+/**
+ * Drop all cached DMABUF imports
+ * 
+ * Call when the decoder reallocates its capture buffers (e.g. after a
+ * flush or stream change). A change of frame size flushes automatically.
+ * @param ctx Renderer context
+ */
+void gpu_renderer_flush_texture_cache(gpu_renderer_ctx_t *ctx);
+
 /**
  * Render frame with current warp matrix
+ * 
+ * Records and flushes the GL commands only; presenting (the buffer swap and
+ * page flip) is display_output_present_frame()'s job. With several display
+ * heads the frame is imported/uploaded once and drawn into each head's
+ * surface in turn; the last head's surface is left current.
  * @param ctx Renderer context
- * @param frame Decoded frame with DMABUF handles
+ * @param frame Decoded frame: DMABUF handles, or av_frame in system memory
+ *              (YUV420P/NV12, uploaded through PBOs)
  * @return 0 on success, negative on error
  */
 int gpu_renderer_render_frame(gpu_renderer_ctx_t *ctx, const decoded_frame_t *frame);
 
 /**
- * Set warp transformation matrix
+ * Render an RGB(A) GL_TEXTURE_2D through every head's warp, crop and blend
+ * 
+ * For frames another renderer sharing the context drew (the libmpv
+ * fallback into its FBO). Any GL state that renderer changed is rebound;
+ * presenting is again display_output_present_frame()'s job.
+ * @param ctx Renderer context
+ * @param texture Texture, rows from the top of the picture
+ * @param width Texture width
+ * @param height Texture height
+ * @return 0 on success, negative on error
+ */
+int gpu_renderer_render_texture(gpu_renderer_ctx_t *ctx, GLuint texture, int width, int height);
+
+/**
+ * Set warp transformation matrix (every head)
  * @param ctx Renderer context
  * @param matrix 4x4 transformation matrix (column-major)
  * @return 0 on success, negative on error
@@ -124,7 +223,63 @@ int gpu_renderer_render_frame(gpu_renderer_ctx_t *ctx, const decoded_frame_t *fr
 int gpu_renderer_set_warp_matrix(gpu_renderer_ctx_t *ctx, const warp_matrix_t *matrix);
 
 /**
- * Get current warp transformation matrix
+ * Set one head's warp transformation matrix
+ * @param ctx Renderer context
+ * @param head Display head index
+ * @param matrix 4x4 transformation matrix (column-major)
+ * @return 0 on success, negative on error
+ */
+int gpu_renderer_set_head_warp_matrix(gpu_renderer_ctx_t *ctx, int head,
+                                      const warp_matrix_t *matrix);
+
+/**
+ * Set the part of the frame one head shows (default: all of it)
+ * 
+ * Frame coordinates run 0..1 from the top-left; e.g. 0, 0, 0.5, 1 is the
+ * left half when spanning two heads. The warp is applied on top.
+ * @param ctx Renderer context
+ * @param head Display head index
+ * @param x Left edge
+ * @param y Top edge
+ * @param width Width
+ * @param height Height
+ * @return 0 on success, negative on error
+ */
+int gpu_renderer_set_head_crop(gpu_renderer_ctx_t *ctx, int head,
+                               float x, float y, float width, float height);
+
+/**
+ * Set one head's edge blend / mask lookup (uploaded once; call on the GL thread)
+ * 
+ * The first blend builds the blend shader variants; heads without one keep
+ * drawing with the variants that have no blend stage.
+ * @param ctx Renderer context
+ * @param head Display head index
+ * @param blend Lookup, or NULL / no texels to remove it
+ * @return 0 on success, negative on error
+ */
+int gpu_renderer_set_head_blend(gpu_renderer_ctx_t *ctx, int head, const warp_blend_t *blend);
+
+/**
+ * Set edge blend / mask lookup (every head)
+ * @param ctx Renderer context
+ * @param blend Lookup, or NULL / no texels to remove it
+ * @return 0 on success, negative on error
+ */
+int gpu_renderer_set_blend(gpu_renderer_ctx_t *ctx, const warp_blend_t *blend);
+
+/**
+ * Set warp mesh (uploaded once into a static VBO; call on the GL thread)
+ * 
+ * Drawing stays a single call whatever the mesh density.
+ * @param ctx Renderer context
+ * @param mesh Mesh, or NULL / 0 cells for the plain fullscreen quad
+ * @return 0 on success, negative on error
+ */
+int gpu_renderer_set_warp_mesh(gpu_renderer_ctx_t *ctx, const warp_mesh_t *mesh);
+
+/**
+ * Get current warp transformation matrix (first head)
  * @param ctx Renderer context
  * @param matrix Output matrix
  * @return 0 on success, negative on error
@@ -166,18 +321,39 @@ int gpu_renderer_create_program(gpu_renderer_ctx_t *ctx,
 int gpu_renderer_set_color_adjustments(gpu_renderer_ctx_t *ctx,
                                       float brightness, float contrast, float saturation);
 
+/**
+ * Check if rendering would leave the frame unchanged
+ * 
+ * True when there is one head showing the whole frame, the warp matrix is identity, no
+ * mesh or blend is set and the colour adjustments are at their defaults, i.e. the frame can be
+ * scanned out directly without GL.
+ * @param ctx Renderer context
+ * @return 1 if the GL pass is a no-op, 0 otherwise
+ */
+int gpu_renderer_is_passthrough(gpu_renderer_ctx_t *ctx);
+
 /**
  * Get renderer statistics
  * @param ctx Renderer context
  * @param frames_rendered Number of frames rendered
- * @param avg_render_time_us Average render time in microseconds
- * @param gpu_memory_used GPU memory usage in bytes
+ * @param avg_render_time_us Average CPU time to submit a frame in microseconds
+ * @param gpu_memory_used Upload staging (PBO) memory in bytes; imports belong to the decoder
  */
 void gpu_renderer_get_stats(gpu_renderer_ctx_t *ctx,
                            uint64_t *frames_rendered,
                            uint64_t *avg_render_time_us,
                            uint64_t *gpu_memory_used);
 
+/**
+ * Get GPU execution times per pass and how idle the GPU was (render thread)
+ * 
+ * Picks up any results that arrived since the last frame without waiting.
+ * @param ctx Renderer context
+ * @param timing Output timing (available = 0 without GL_EXT_disjoint_timer_query)
+ * @return 0 on success, negative on error
+ */
+int gpu_renderer_get_gpu_timing(gpu_renderer_ctx_t *ctx, gpu_timing_t *timing);
+
 /**
  * Resize renderer viewport
  * @param ctx Renderer context
@@ -210,9 +386,7 @@ int gpu_renderer_check_extensions(void);
 void gpu_renderer_get_info(const char **vendor, const char **renderer, const char **version);
 
 /* Built-in shader sources */
-extern const char *gpu_renderer_vertex_shader_yuv420;
-extern const char *gpu_renderer_fragment_shader_yuv420;
-extern const char *gpu_renderer_vertex_shader_nv12;
-extern const char *gpu_renderer_fragment_shader_nv12;
+extern const char *gpu_renderer_vertex_shader;
+extern const char *gpu_renderer_fragment_shader_template;  /* Needs a FORMAT_* define */
 
 #endif /* GPU_RENDERER_H */
\ No newline at end of file
@@ -1,27 +1,67 @@
 /*
- * Hardware Decoder Implementation - FFmpeg h264_v4l2m2m for Raspberry Pi 4
+ * Hardware Decoder Implementation - FFmpeg V4L2 decoders for Raspberry Pi 4
  * 
- * Uses FFmpeg's h264_v4l2m2m decoder which wraps the RPi4's hardware video decode unit.
+ * Picks a hardware decoder per codec from hw_decoder_table: h264_v4l2m2m for
+ * H.264, and for HEVC the stateless block through the v4l2-request hwaccel
+ * (hevc_v4l2m2m where that is all the build has), software as a last resort.
  * Implements zero-copy operation with DMABUF export for GPU texture import.
  */
 
 #include "hw_decoder.h"
+#include "pickle_log.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <time.h>
 #include <sys/time.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/opt.h>
 #include <libavutil/hwcontext.h>
 #include <libavutil/hwcontext_drm.h>
 #include <libavutil/pixfmt.h>
+#include <libavutil/pixdesc.h>
 
 /* Forward declarations */
 static int setup_drm_prime_context(hw_decoder_ctx_t *ctx);
 static int extract_dmabuf_from_frame(AVFrame *frame, decoded_frame_t *decoded_frame);
 
+/* Capture buffers beyond what the application holds: one being decoded, one queued */
+#define HW_DECODER_CAPTURE_HEADROOM  2
+
+/* How a hardware decoder reaches the V4L2 device */
+typedef enum {
+    HW_PATH_M2M,                  /* Stateful wrapper decoder (h264_v4l2m2m, ...) */
+    HW_PATH_REQUEST               /* Stateless request API: native decoder + DRM hwaccel */
+} hw_path_t;
+
+typedef struct {
+    const char *name;
+    hw_path_t path;
+} decoder_candidate_t;
+
+/* Hardware decoders to try per codec, in order of preference */
+typedef struct {
+    enum AVCodecID codec_id;
+    decoder_candidate_t candidates[3];
+} decoder_candidates_t;
+
+static const decoder_candidates_t hw_decoder_table[] = {
+    { AV_CODEC_ID_H264, { { "h264_v4l2m2m", HW_PATH_M2M }, { NULL, HW_PATH_M2M } } },
+    /* The Pi 4 HEVC block is stateless: 4K60 only exists behind v4l2-request */
+    { AV_CODEC_ID_HEVC, { { "hevc", HW_PATH_REQUEST }, { "hevc_v4l2m2m", HW_PATH_M2M },
+                          { NULL, HW_PATH_M2M } } },
+};
+
+/* Frame-released eventfd, shared by the context and every frame it hands out
+ * (frames may outlive hw_decoder_destroy) */
+typedef struct {
+    int fd;
+    int signalled;                /* fd has a count the decode side has not read */
+} release_event_t;
+
 /* Internal decoder context */
 struct hw_decoder_ctx {
     /* FFmpeg decoder components */
@@ -33,17 +73,192 @@ struct hw_decoder_ctx {
     /* DRM Prime hardware context */
     AVBufferRef *hw_device_ctx;
     
+    /* release_event_t: signalled as decoded frames are freed */
+    AVBufferRef *release_event;
+    
     /* Stream configuration */
     int width, height;
     int configured;
+    decoder_buffer_config_t buffer_config;  /* 0 fields = FFmpeg defaults */
+    
+    /* Decoder selection */
+    enum AVCodecID codec_id;
+    int hardware;                 /* codec is a V4L2 hardware decoder */
+    int request_api;              /* ... reached through the DRM (v4l2-request) hwaccel */
+    int drm_prime;                /* get_format negotiated AV_PIX_FMT_DRM_PRIME */
     
     /* Statistics */
+    uint64_t packets_submitted;
     uint64_t frames_decoded;
     uint64_t frames_dropped;
+    uint64_t frames_system_memory; /* Frames delivered without a DMABUF */
     uint64_t total_decode_time_us;
     struct timeval last_frame_time;
 };
 
+/**
+ * Check whether a decoder has a DRM_PRIME hwaccel (v4l2-request in the RPi FFmpeg)
+ */
+static int has_drm_hwaccel(const AVCodec *codec) {
+    const AVCodecHWConfig *config;
+    
+    for (int i = 0; (config = avcodec_get_hw_config(codec, i)) != NULL; i++) {
+        if (config->device_type == AV_HWDEVICE_TYPE_DRM &&
+            config->pix_fmt == AV_PIX_FMT_DRM_PRIME &&
+            (config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX)) {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * Pick the preferred decoder for a codec: V4L2 hardware first, then software
+ */
+static const AVCodec *select_decoder(enum AVCodecID codec_id, int allow_hw, int *hardware,
+                                     int *request_api) {
+    const AVCodec *codec;
+    
+    *hardware = 0;
+    *request_api = 0;
+    
+    if (allow_hw) {
+        for (size_t i = 0; i < sizeof(hw_decoder_table) / sizeof(hw_decoder_table[0]); i++) {
+            if (hw_decoder_table[i].codec_id != codec_id) {
+                continue;
+            }
+            for (int j = 0; hw_decoder_table[i].candidates[j].name; j++) {
+                const decoder_candidate_t *candidate = &hw_decoder_table[i].candidates[j];
+                
+                codec = avcodec_find_decoder_by_name(candidate->name);
+                if (!codec) {
+                    continue;
+                }
+                /* Native decoders only count when built with the request hwaccel */
+                if (candidate->path == HW_PATH_REQUEST && !has_drm_hwaccel(codec)) {
+                    continue;
+                }
+                *hardware = 1;
+                *request_api = candidate->path == HW_PATH_REQUEST;
+                return codec;
+            }
+        }
+    }
+    
+    codec = avcodec_find_decoder(codec_id);
+    if (codec) {
+        fprintf(stderr, "⚠ No usable hardware decoder for %s - falling back to software decoder '%s' "
+                "(expect high CPU load)\n", avcodec_get_name(codec_id), codec->name);
+    }
+    return codec;
+}
+
+/**
+ * Give the request-API hwaccel a DRM frames pool sized for this stream
+ */
+static int setup_request_frames(AVCodecContext *avctx) {
+    AVBufferRef *frames_ref = NULL;
+    int ret;
+    
+    ret = avcodec_get_hw_frames_parameters(avctx, avctx->hw_device_ctx,
+                                           AV_PIX_FMT_DRM_PRIME, &frames_ref);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to get DRM frame parameters: %s\n", av_err2str(ret));
+        return HW_DECODER_ERROR;
+    }
+    
+    ret = av_hwframe_ctx_init(frames_ref);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to initialise DRM frames context: %s\n", av_err2str(ret));
+        av_buffer_unref(&frames_ref);
+        return HW_DECODER_ERROR;
+    }
+    
+    /* get_format runs again on every sequence change; the old pool goes with it */
+    av_buffer_unref(&avctx->hw_frames_ctx);
+    avctx->hw_frames_ctx = frames_ref;
+    return HW_DECODER_OK;
+}
+
+/**
+ * Negotiate output format: always take DRM_PRIME when the decoder offers it
+ */
+static enum AVPixelFormat get_drm_prime_format(AVCodecContext *avctx, const enum AVPixelFormat *fmts) {
+    hw_decoder_ctx_t *ctx = avctx->opaque;
+    
+    for (const enum AVPixelFormat *p = fmts; *p != AV_PIX_FMT_NONE; p++) {
+        if (*p == AV_PIX_FMT_DRM_PRIME) {
+            if (ctx->request_api && setup_request_frames(avctx) < 0) {
+                break;
+            }
+            ctx->drm_prime = 1;
+            return AV_PIX_FMT_DRM_PRIME;
+        }
+    }
+    
+    ctx->drm_prime = 0;
+    fprintf(stderr, "⚠ Decoder '%s' does not offer DRM_PRIME output - frames will arrive in system memory\n",
+            avctx->codec ? avctx->codec->name : "unknown");
+    return avcodec_default_get_format(avctx, fmts);
+}
+
+/**
+ * Last reference to the release event gone: close the eventfd
+ */
+static void release_event_free(void *opaque, uint8_t *data) {
+    release_event_t *event = (release_event_t *)data;
+    
+    (void)opaque;
+    
+    close(event->fd);
+    av_free(event);
+}
+
+/**
+ * Last clone of a decoded frame freed: its buffer is back in the pool
+ */
+static void frame_released(void *opaque, uint8_t *data) {
+    AVBufferRef *event_ref = opaque;
+    release_event_t *event = (release_event_t *)event_ref->data;
+    uint64_t one = 1;
+    
+    (void)data;
+    
+    /* One write per wake-up, not per frame */
+    if (!__atomic_exchange_n(&event->signalled, 1, __ATOMIC_ACQ_REL)) {
+        if (write(event->fd, &one, sizeof(one)) < 0) {
+            __atomic_store_n(&event->signalled, 0, __ATOMIC_RELEASE);
+        }
+    }
+    av_buffer_unref(&event_ref);
+}
+
+/**
+ * Tag a frame so that freeing its last clone signals the release event
+ */
+static int attach_release_event(hw_decoder_ctx_t *ctx, AVFrame *frame) {
+    AVBufferRef *event_ref;
+    
+    if (!ctx->release_event || frame->opaque_ref) {
+        return HW_DECODER_OK;
+    }
+    
+    event_ref = av_buffer_ref(ctx->release_event);
+    if (!event_ref) {
+        return HW_DECODER_ERROR;
+    }
+    
+    /* opaque_ref is shared by av_frame_ref/clone and dropped after buf[] */
+    frame->opaque_ref = av_buffer_create(NULL, 0, frame_released, event_ref, 0);
+    if (!frame->opaque_ref) {
+        av_buffer_unref(&event_ref);
+        return HW_DECODER_ERROR;
+    }
+    
+    return HW_DECODER_OK;
+}
+
 /**
  * Create hardware decoder context
  */
@@ -54,35 +269,39 @@ hw_decoder_ctx_t *hw_decoder_create(void) {
         return NULL;
     }
     
-    /* Find H.264 decoder (let FFmpeg choose the best one) */
-    ctx->codec = avcodec_find_decoder(AV_CODEC_ID_H264);
-    if (!ctx->codec) {
-        fprintf(stderr, "H.264 decoder not found\n");
-        free(ctx);
-        return NULL;
-    }
-    
-    /* Allocate codec context */
-    ctx->codec_ctx = avcodec_alloc_context3(ctx->codec);
-    if (!ctx->codec_ctx) {
-        fprintf(stderr, "Failed to allocate codec context\n");
-        free(ctx);
-        return NULL;
-    }
+    /* The codec is picked in hw_decoder_configure() once the stream is known */
+    ctx->codec_id = AV_CODEC_ID_NONE;
     
     /* Allocate packet and frame */
     ctx->packet = av_packet_alloc();
     ctx->frame = av_frame_alloc();
     if (!ctx->packet || !ctx->frame) {
         fprintf(stderr, "Failed to allocate AVPacket/AVFrame\n");
-        avcodec_free_context(&ctx->codec_ctx);
         av_packet_free(&ctx->packet);
         av_frame_free(&ctx->frame);
         free(ctx);
         return NULL;
     }
     
-    printf("Created H.264 decoder context (%s)\n", ctx->codec->name);
+    /* Readiness fd for the pipeline; decoding works without it */
+    release_event_t *event = av_mallocz(sizeof(*event));
+    if (event) {
+        event->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (event->fd >= 0) {
+            ctx->release_event = av_buffer_create((uint8_t *)event, sizeof(*event),
+                                                  release_event_free, NULL, 0);
+        }
+        if (!ctx->release_event) {
+            if (event->fd >= 0) {
+                close(event->fd);
+            }
+            av_free(event);
+        }
+    }
+    if (!ctx->release_event) {
+        fprintf(stderr, "⚠ No decoder event fd - callers fall back to timed waits\n");
+    }
+    
     return ctx;
 }
 
@@ -107,24 +326,29 @@ static int setup_drm_prime_context(hw_decoder_ctx_t *ctx) {
 }
 
 /**
- * Configure decoder with stream parameters
+ * Allocate and open a codec context for the selected decoder
  */
-int hw_decoder_configure(hw_decoder_ctx_t *ctx, const video_stream_info_t *stream_info) {
+static int open_codec(hw_decoder_ctx_t *ctx, const video_stream_info_t *stream_info) {
     int ret;
     
-    if (!ctx || !stream_info) {
+    ctx->codec_ctx = avcodec_alloc_context3(ctx->codec);
+    if (!ctx->codec_ctx) {
+        fprintf(stderr, "Failed to allocate codec context\n");
         return HW_DECODER_ERROR;
     }
     
     /* Set codec parameters */
     ctx->codec_ctx->width = stream_info->width;
     ctx->codec_ctx->height = stream_info->height;
-    /* Let the decoder choose its preferred format initially */
+    /* Format is chosen by get_format: DRM_PRIME whenever it is offered */
     ctx->codec_ctx->pix_fmt = AV_PIX_FMT_NONE;
+    ctx->codec_ctx->opaque = ctx;
+    ctx->codec_ctx->get_format = get_drm_prime_format;
     
-    /* Set H.264 extradata if available */
+    /* Set codec extradata if available */
     if (stream_info->extradata && stream_info->extradata_size > 0) {
-        printf("H.264 extradata found: %d bytes (SPS/PPS parameters)\n", stream_info->extradata_size);
+        printf("%s extradata found: %d bytes (parameter sets)\n",
+               avcodec_get_name(ctx->codec_id), stream_info->extradata_size);
         
         ctx->codec_ctx->extradata = av_mallocz(stream_info->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
         if (!ctx->codec_ctx->extradata) {
@@ -136,28 +360,98 @@ int hw_decoder_configure(hw_decoder_ctx_t *ctx, const video_stream_info_t *strea
         ctx->codec_ctx->extradata_size = stream_info->extradata_size;
     }
     
-    /* Setup hardware context */
-    ret = setup_drm_prime_context(ctx);
-    if (ret < 0) {
-        return ret;
+    /* Setup hardware context (only the V4L2 decoders need it) */
+    if (ctx->hardware) {
+        ret = setup_drm_prime_context(ctx);
+        if (ret < 0) {
+            return ret;
+        }
+    } else {
+        /* Software decode has to keep up on four A72 cores: one frame per thread */
+        ctx->codec_ctx->thread_count = 0;
+        ctx->codec_ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
     }
     
     /* Set codec options for hardware acceleration */
     AVDictionary *opts = NULL;
+    const decoder_buffer_config_t *buffers = &ctx->buffer_config;
+    
+    /* Pool sizes: V4L2 OUTPUT = bitstream in, CAPTURE = decoded frames out */
+    if (ctx->hardware && !ctx->request_api) {
+        if (buffers->num_input_buffers > 0) {
+            av_dict_set_int(&opts, "num_output_buffers", buffers->num_input_buffers, 0);
+        }
+        if (buffers->num_output_buffers > 0) {
+            av_dict_set_int(&opts, "num_capture_buffers",
+                            buffers->num_output_buffers + HW_DECODER_CAPTURE_HEADROOM, 0);
+        }
+    } else if (ctx->request_api && buffers->num_output_buffers > 0) {
+        /* Added on top of the DPB when get_format sizes the DRM frames pool */
+        ctx->codec_ctx->extra_hw_frames = buffers->num_output_buffers;
+    }
     
     /* Open codec */
     ret = avcodec_open2(ctx->codec_ctx, ctx->codec, &opts);
+    if (av_dict_count(opts) > 0) {
+        fprintf(stderr, "⚠ %s ignored %d buffer option(s) - using its default pool sizes\n",
+                ctx->codec->name, av_dict_count(opts));
+    }
     av_dict_free(&opts);
     if (ret < 0) {
-        fprintf(stderr, "Failed to open h264_v4l2m2m codec: %s\n", av_err2str(ret));
+        fprintf(stderr, "Failed to open %s codec: %s\n", ctx->codec->name, av_err2str(ret));
+        return HW_DECODER_ERROR;
+    }
+    
+    return HW_DECODER_OK;
+}
+
+/**
+ * Configure decoder with stream parameters
+ */
+int hw_decoder_configure(hw_decoder_ctx_t *ctx, const video_stream_info_t *stream_info) {
+    int ret;
+    
+    if (!ctx || !stream_info) {
         return HW_DECODER_ERROR;
     }
     
+    if (ctx->configured) {
+        fprintf(stderr, "Decoder already configured\n");
+        return HW_DECODER_ERROR;
+    }
+    
+    /* Prefer V4L2 hardware (M2M or request API) over FFmpeg's software decoders */
+    ctx->codec_id = stream_info->codec_id;
+    ctx->codec = select_decoder(ctx->codec_id, 1, &ctx->hardware, &ctx->request_api);
+    if (!ctx->codec) {
+        fprintf(stderr, "%s decoder not found\n", avcodec_get_name(ctx->codec_id));
+        return HW_DECODER_ERROR;
+    }
+    
+    ret = open_codec(ctx, stream_info);
+    if (ret < 0 && ctx->hardware) {
+        /* Hardware decoder present but unusable (no /dev/video*, busy, ...) */
+        avcodec_free_context(&ctx->codec_ctx);
+        av_buffer_unref(&ctx->hw_device_ctx);
+        
+        ctx->codec = select_decoder(ctx->codec_id, 0, &ctx->hardware, &ctx->request_api);
+        if (!ctx->codec) {
+            return HW_DECODER_ERROR;
+        }
+        ret = open_codec(ctx, stream_info);
+    }
+    if (ret < 0) {
+        return ret;
+    }
+    
     ctx->width = stream_info->width;
     ctx->height = stream_info->height;
     ctx->configured = 1;
     
-    printf("FFmpeg H.264 decoder configured: %dx%d (%s)\n", ctx->width, ctx->height, ctx->codec->name);
+    printf("FFmpeg %s decoder configured: %dx%d (%s, %s)\n", avcodec_get_name(ctx->codec_id),
+           ctx->width, ctx->height, ctx->codec->name,
+           ctx->request_api ? "hardware, v4l2-request" :
+           ctx->hardware ? "hardware, v4l2m2m" : "software");
     return HW_DECODER_OK;
 }
 
@@ -192,7 +486,7 @@ int hw_decoder_submit_packet(hw_decoder_ctx_t *ctx, const frame_packet_t *packet
         if (ret == AVERROR(EAGAIN)) {
             return HW_DECODER_EAGAIN;
         }
-        fprintf(stderr, "Error sending packet to decoder: %s\n", av_err2str(ret));
+        LOG_ERROR("Error sending packet to decoder: %s", av_err2str(ret));
         return HW_DECODER_ERROR;
     }
     
@@ -203,11 +497,11 @@ int hw_decoder_submit_packet(hw_decoder_ctx_t *ctx, const frame_packet_t *packet
     
     /* FFmpeg decoder typically accepts packets immediately but needs time to produce frames.
      * For the first few packets, frames may not be immediately available. */
-    static int packet_count = 0;
-    packet_count++;
-    if (packet_count <= 3) {
-        printf("✓ Submitted packet %d (%s: %d bytes) to %s decoder\n", 
-               packet_count, packet->keyframe ? "keyframe" : "P-frame", packet->size, ctx->codec_ctx->codec->name);
+    ctx->packets_submitted++;
+    if (ctx->packets_submitted <= 3) {
+        LOG_DEBUG("✓ Submitted packet %llu (%s: %d bytes) to %s decoder",
+                  (unsigned long long)ctx->packets_submitted,
+                  packet->keyframe ? "keyframe" : "P-frame", packet->size, ctx->codec_ctx->codec->name);
     }
     
     return HW_DECODER_OK;
@@ -232,27 +526,29 @@ static int extract_dmabuf_from_frame(AVFrame *frame, decoded_frame_t *decoded_fr
             return HW_DECODER_ERROR;
         }
         
-        for (int i = 0; i < decoded_frame->num_planes && i < desc->nb_objects; i++) {
-            decoded_frame->dmabuf_fd[i] = desc->objects[i].fd;
-            
-            if (i < desc->layers[0].nb_planes) {
-                decoded_frame->offsets[i] = desc->layers[0].planes[i].offset;
-                decoded_frame->pitches[i] = desc->layers[0].planes[i].pitch;
+        /* Planes may share one object (typical NV12/SAND layout), so resolve
+         * each plane's fd through its object index */
+        for (int i = 0; i < decoded_frame->num_planes; i++) {
+            int obj = desc->layers[0].planes[i].object_index;
+            if (obj < 0 || obj >= desc->nb_objects) {
+                fprintf(stderr, "Invalid DRM object index %d for plane %d\n", obj, i);
+                return HW_DECODER_ERROR;
             }
+            
+            decoded_frame->dmabuf_fd[i] = desc->objects[obj].fd;
+            decoded_frame->offsets[i] = desc->layers[0].planes[i].offset;
+            decoded_frame->pitches[i] = desc->layers[0].planes[i].pitch;
         }
         
+        decoded_frame->drm_format = desc->layers[0].format;
+        /* SAND128 (request-API HEVC, 1080p+ M2M) arrives tiled; pass the modifier on */
+        decoded_frame->modifier = desc->objects[desc->layers[0].planes[0].object_index].format_modifier;
         decoded_frame->format = AV_PIX_FMT_DRM_PRIME;
-        printf("✓ Extracted DMABUF: %d planes, fd[0]=%d\n", 
-               decoded_frame->num_planes, decoded_frame->dmabuf_fd[0]);
+        LOG_TRACE("✓ Extracted DMABUF: %d planes, fd[0]=%d",
+                  decoded_frame->num_planes, decoded_frame->dmabuf_fd[0]);
         
     } else {
-        /* Hardware decoded frame in regular memory - this is still hardware accelerated! */
-        static int regular_frame_count = 0;
-        regular_frame_count++;
-        if (regular_frame_count <= 3) {
-            printf("✓ Hardware decoded frame %d in regular memory format (%d) - hardware acceleration working!\n", 
-                   regular_frame_count, frame->format);
-        }
+        /* Frame in system memory (software decode or no DRM_PRIME) - no zero-copy path */
         
         /* Set dummy DMABUF values to prevent crashes in GPU renderer */
         decoded_frame->num_planes = 0;
@@ -279,6 +575,17 @@ int hw_decoder_get_frame(hw_decoder_ctx_t *ctx, decoded_frame_t *frame) {
         return HW_DECODER_ERROR;
     }
     
+    /* Consume pending release wake-ups before looking, so none is lost */
+    if (ctx->release_event) {
+        release_event_t *event = (release_event_t *)ctx->release_event->data;
+        uint64_t count;
+        if (__atomic_exchange_n(&event->signalled, 0, __ATOMIC_ACQ_REL)) {
+            if (read(event->fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                LOG_WARN("Decoder event fd read failed: %s", strerror(errno));
+            }
+        }
+    }
+    
     /* Try to receive frame from decoder */
     av_frame_unref(ctx->frame);
     ret = avcodec_receive_frame(ctx->codec_ctx, ctx->frame);
@@ -286,36 +593,30 @@ int hw_decoder_get_frame(hw_decoder_ctx_t *ctx, decoded_frame_t *frame) {
     if (ret < 0) {
         if (ret == AVERROR(EAGAIN)) {
             /* No frame ready yet - this is normal for h264_v4l2m2m */
-            static int debug_count = 0;
-            debug_count++;
-            if (debug_count <= 5 || debug_count % 50 == 0) {
-                printf("Debug [%d]: avcodec_receive_frame returned EAGAIN (normal - decoder buffering frames)\n", debug_count);
-            }
+            LOG_TRACE("avcodec_receive_frame returned EAGAIN (decoder buffering frames)");
             return HW_DECODER_EAGAIN;
         } else if (ret == AVERROR_EOF) {
             return HW_DECODER_EOF;
         }
-        fprintf(stderr, "Error receiving frame from decoder: %s (%d)\n", av_err2str(ret), ret);
+        LOG_ERROR("Error receiving frame from decoder: %s (%d)", av_err2str(ret), ret);
         return HW_DECODER_ERROR;
     }
     
     /* Fill decoded frame structure */
+    frame->discontinuity = 0;
+    frame->seek_serial = 0;
+    frame->demux_us = 0;
+    frame->decoded_us = 0;
     frame->width = ctx->frame->width;
     frame->height = ctx->frame->height;
-    frame->timestamp_us = ctx->frame->pts;
+    /* Packet timestamps are already in microseconds (see video_input) */
+    frame->timestamp_us = ctx->frame->best_effort_timestamp != AV_NOPTS_VALUE ?
+                          ctx->frame->best_effort_timestamp : ctx->frame->pts;
     
-    /* Check frame format */
-    const char* format_name = "unknown";
-    switch (ctx->frame->format) {
-        case AV_PIX_FMT_DRM_PRIME: format_name = "DRM_PRIME"; break;
-        case AV_PIX_FMT_NV12: format_name = "NV12"; break;
-        case AV_PIX_FMT_YUV420P: format_name = "YUV420P"; break;
-        case AV_PIX_FMT_YUVJ420P: format_name = "YUVJ420P"; break;
-        default: format_name = "other"; break;
-    }
-    printf("✓ Received frame: %dx%d, format=%d (%s), pts=%ld\n", 
-           ctx->frame->width, ctx->frame->height, ctx->frame->format,
-           format_name, ctx->frame->pts);
+    LOG_TRACE("✓ Received frame: %dx%d, format=%d (%s), pts=%lld",
+              ctx->frame->width, ctx->frame->height, ctx->frame->format,
+              av_get_pix_fmt_name(ctx->frame->format) ? av_get_pix_fmt_name(ctx->frame->format) : "other",
+              (long long)ctx->frame->pts);
     
     /* Extract DMABUF information */
     ret = extract_dmabuf_from_frame(ctx->frame, frame);
@@ -323,12 +624,22 @@ int hw_decoder_get_frame(hw_decoder_ctx_t *ctx, decoded_frame_t *frame) {
         return ret;
     }
     
+    if (frame->dmabuf_fd[0] < 0) {
+        if (ctx->frames_system_memory++ == 0) {
+            fprintf(stderr, "⚠ %s delivered a frame in system memory (format %d) - uploading via PBO, no zero-copy\n",
+                    ctx->codec->name, ctx->frame->format);
+        }
+    }
+    
     /* Keep reference to AVFrame for cleanup */
     frame->av_frame = av_frame_clone(ctx->frame);
     if (!frame->av_frame) {
         fprintf(stderr, "Failed to clone AVFrame\n");
         return HW_DECODER_ERROR;
     }
+    if (attach_release_event(ctx, frame->av_frame) < 0) {
+        LOG_WARN("Could not tag frame for release events");
+    }
     
     ctx->frames_decoded++;
     gettimeofday(&ctx->last_frame_time, NULL);
@@ -357,12 +668,35 @@ void hw_decoder_release_frame(hw_decoder_ctx_t *ctx, decoded_frame_t *frame) {
 }
 
 /**
- * Set buffer configuration (stub for compatibility)
+ * Get pollable readiness fd
+ */
+int hw_decoder_get_event_fd(hw_decoder_ctx_t *ctx) {
+    if (!ctx || !ctx->release_event) {
+        return -1;
+    }
+    return ((release_event_t *)ctx->release_event->data)->fd;
+}
+
+/**
+ * Set buffer configuration
  */
 int hw_decoder_set_buffer_config(hw_decoder_ctx_t *ctx, const decoder_buffer_config_t *config) {
-    /* FFmpeg manages buffers internally */
-    (void)ctx;
-    (void)config;
+    if (!ctx || !config || config->num_input_buffers < 0 || config->num_output_buffers < 0) {
+        return HW_DECODER_ERROR;
+    }
+    
+    /* The pools are allocated when the codec opens */
+    if (ctx->configured) {
+        fprintf(stderr, "Decoder buffer config must be set before hw_decoder_configure()\n");
+        return HW_DECODER_ERROR;
+    }
+    
+    if (config->input_buffer_size > 0) {
+        fprintf(stderr, "⚠ input_buffer_size is sized by the V4L2 driver - ignoring %d\n",
+                config->input_buffer_size);
+    }
+    
+    ctx->buffer_config = *config;
     return HW_DECODER_OK;
 }
 
@@ -403,24 +737,76 @@ void hw_decoder_get_stats(hw_decoder_ctx_t *ctx,
     }
 }
 
+/**
+ * Get selected decoder backend
+ */
+void hw_decoder_get_backend(hw_decoder_ctx_t *ctx,
+                           const char **codec_name,
+                           int *hardware,
+                           uint64_t *frames_system_memory) {
+    if (!ctx) {
+        return;
+    }
+    
+    if (codec_name) {
+        *codec_name = ctx->codec ? ctx->codec->name : "none";
+    }
+    
+    if (hardware) {
+        *hardware = ctx->hardware;
+    }
+    
+    if (frames_system_memory) {
+        *frames_system_memory = ctx->frames_system_memory;
+    }
+}
+
+/**
+ * Check whether any of a codec's hardware candidates exists here
+ */
+static int has_hw_candidate(const decoder_candidates_t *entry) {
+    for (int j = 0; entry->candidates[j].name; j++) {
+        const decoder_candidate_t *candidate = &entry->candidates[j];
+        const AVCodec *codec = avcodec_find_decoder_by_name(candidate->name);
+        
+        if (codec && (candidate->path == HW_PATH_M2M || has_drm_hwaccel(codec))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
 /**
  * Check if hardware decoder is available on this system
  */
 int hw_decoder_is_available(void) {
-    const AVCodec *codec = avcodec_find_decoder_by_name("h264_v4l2m2m");
-    return codec ? 1 : 0;
+    /* Any hardware candidate for any codec */
+    for (size_t i = 0; i < sizeof(hw_decoder_table) / sizeof(hw_decoder_table[0]); i++) {
+        if (has_hw_candidate(&hw_decoder_table[i])) {
+            return 1;
+        }
+    }
+    return 0;
 }
 
 /**
  * Get list of supported input formats
  */
 int hw_decoder_get_supported_formats(uint32_t *formats, int max_formats) {
-    /* h264_v4l2m2m supports H.264 input */
-    if (formats && max_formats > 0) {
-        formats[0] = AV_CODEC_ID_H264;
-        return 1;
+    int count = 0;
+    
+    if (!formats) {
+        return 0;
     }
-    return 0;
+    
+    /* Codecs with a hardware decoder in this FFmpeg build */
+    for (size_t i = 0; i < sizeof(hw_decoder_table) / sizeof(hw_decoder_table[0]) &&
+                       count < max_formats; i++) {
+        if (has_hw_candidate(&hw_decoder_table[i])) {
+            formats[count++] = hw_decoder_table[i].codec_id;
+        }
+    }
+    return count;
 }
 
 /**
@@ -447,5 +833,8 @@ void hw_decoder_destroy(hw_decoder_ctx_t *ctx) {
         av_buffer_unref(&ctx->hw_device_ctx);
     }
     
+    /* Frames still held elsewhere keep the eventfd open until they go */
+    av_buffer_unref(&ctx->release_event);
+    
     free(ctx);
 }
\ No newline at end of file
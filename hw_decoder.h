@@ -1,8 +1,10 @@
 /*
- * Hardware Decoder Module - FFmpeg h264_v4l2m2m Hardware Decode
+ * Hardware Decoder Module - FFmpeg V4L2 Hardware Decode
  * 
  * This module handles:
- * - FFmpeg h264_v4l2m2m codec for RPi4 hardware decoder
+ * - Codec selection from the stream: h264_v4l2m2m (stateful) for H.264,
+ *   the v4l2-request hwaccel (stateless, up to 4K60) for HEVC, software last
+ * - DRM frames context for the request API, SAND128 tiled output
  * - AVFrame management for zero-copy operation
  * - DMABUF export for GPU texture import
  * - YUV420p/NV12 output format handling
@@ -45,6 +47,18 @@ typedef struct {
     uint32_t pitches[3];
     uint32_t sizes[3];
     
+    /* DRM layout of the DMABUF planes (valid when dmabuf_fd[0] >= 0) */
+    uint32_t drm_format;      /* DRM_FORMAT_* fourcc of layer 0 */
+    uint64_t modifier;        /* DRM format modifier (e.g. SAND128 on RPi4) */
+    
+    /* Set by the pipeline on the first frame after a seek or decoder switch */
+    int discontinuity;
+    unsigned int seek_serial; /* Set by the pipeline: seek request the frame was decoded for */
+    
+    /* Pipeline timestamps for latency stats (CLOCK_MONOTONIC us, 0 = unknown) */
+    uint64_t demux_us;
+    uint64_t decoded_us;
+    
     /* FFmpeg AVFrame reference for release */
     AVFrame *av_frame;
     
@@ -52,11 +66,12 @@ typedef struct {
     void *private_data;
 } decoded_frame_t;
 
-/* Buffer configuration */
+/* Buffer configuration (0 = decoder default) */
 typedef struct {
-    int num_input_buffers;    /* Number of input buffers to allocate */
-    int num_output_buffers;   /* Number of output buffers to allocate */
-    int input_buffer_size;    /* Size of each input buffer */
+    int num_input_buffers;    /* Bitstream buffers queued to the decoder (V4L2 M2M OUTPUT) */
+    int num_output_buffers;   /* Decoded frames the caller may hold at once (queued + on screen);
+                                 sizes the M2M CAPTURE pool / request-API extra_hw_frames */
+    int input_buffer_size;    /* Not adjustable (the V4L2 driver sizes it); ignored */
 } decoder_buffer_config_t;
 
 /* API Functions */
@@ -69,6 +84,9 @@ hw_decoder_ctx_t *hw_decoder_create(void);
 
 /**
  * Configure decoder with stream parameters
+ * 
+ * Picks the decoder for stream_info->codec_id (hardware first, software
+ * fallback) and opens it. Call once per context.
  * @param ctx Decoder context
  * @param stream_info Video stream information from input module
  * @return 0 on success, negative on error
@@ -77,6 +95,9 @@ int hw_decoder_configure(hw_decoder_ctx_t *ctx, const video_stream_info_t *strea
 
 /**
  * Set buffer configuration (optional, uses defaults if not called)
+ * 
+ * Must be called before hw_decoder_configure(). Holding more decoded frames
+ * than num_output_buffers stalls the decoder with HW_DECODER_EAGAIN.
  * @param ctx Decoder context
  * @param config Buffer configuration
  * @return 0 on success, negative on error
@@ -106,6 +127,19 @@ int hw_decoder_get_frame(hw_decoder_ctx_t *ctx, decoded_frame_t *frame);
  */
 void hw_decoder_release_frame(hw_decoder_ctx_t *ctx, decoded_frame_t *frame);
 
+/**
+ * Get a pollable decoder readiness fd
+ * 
+ * Becomes readable (POLLIN) when a decoded frame of this context has been
+ * freed everywhere - including clones held by the display - and its buffer
+ * is back in the pool. Wait on it when both submit and get_frame return
+ * HW_DECODER_EAGAIN; hw_decoder_get_frame() clears it. libavcodec keeps the
+ * V4L2 device fd private, so this is the event the decoder can expose.
+ * @param ctx Decoder context
+ * @return File descriptor (owned by the decoder), or -1 if unavailable
+ */
+int hw_decoder_get_event_fd(hw_decoder_ctx_t *ctx);
+
 /**
  * Flush decoder buffers
  * @param ctx Decoder context
@@ -131,6 +165,18 @@ void hw_decoder_get_stats(hw_decoder_ctx_t *ctx,
  */
 void hw_decoder_destroy(hw_decoder_ctx_t *ctx);
 
+/**
+ * Get the decoder backend actually in use
+ * @param ctx Decoder context
+ * @param codec_name Selected FFmpeg decoder name (e.g. "h264_v4l2m2m")
+ * @param hardware 1 if a V4L2 hardware decoder is in use, 0 for software
+ * @param frames_system_memory Frames delivered without a DMABUF (no zero-copy)
+ */
+void hw_decoder_get_backend(hw_decoder_ctx_t *ctx,
+                           const char **codec_name,
+                           int *hardware,
+                           uint64_t *frames_system_memory);
+
 /* Utility functions */
 
 /**
@@ -141,7 +187,7 @@ int hw_decoder_is_available(void);
 
 /**
  * Get list of supported input formats
- * @param formats Output array of V4L2_PIX_FMT_* values
+ * @param formats Output array of AVCodecID values (codecs with a hardware decoder)
  * @param max_formats Maximum number of formats to return
  * @return Number of formats returned
  */
@@ -11,7 +11,7 @@
  * Test with: ./pickle rpi4-e.mp4
  */
 
-#define _DEFAULT_SOURCE  /* For usleep() */
+#define _DEFAULT_SOURCE  /* POSIX + Linux APIs (clock_gettime, eventfd, termios) */
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -21,6 +21,10 @@
 #include <errno.h>
 #include <termios.h>
 #include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 
 #include "video_input.h"
 #include "hw_decoder.h"
@@ -28,6 +32,90 @@
 #include "display_output.h"
 #include "warp_control.h"
 #include "fallback.h"
+#include "frame_queue.h"
+#include "frame_scheduler.h"
+#include "pipeline_stats.h"
+#include "pickle_log.h"
+#include "wall_sync.h"
+#include "control_input.h"
+
+/* Pipeline queue depths */
+#define PACKET_QUEUE_DEPTH  32   /* Compressed packets read ahead of the decoder */
+#define FRAME_QUEUE_DEPTH   3    /* Decoded frames; each one pins a decoder capture buffer */
+#define FRAME_QUEUE_MAX     16
+
+/* Decoded frames the player holds outside the frame queue: the render
+ * thread's current frame plus the plane's on-screen and pending flips */
+#define PIPELINE_HELD_FRAMES 3
+
+/* Queue wait timeouts (ms) */
+#define DECODE_IDLE_MS      1000 /* Safety net only: packets, freed frames and stop all wake the poll */
+#define DECODER_RETRY_MS    1    /* Decoder full and busy, and no release event fd to wait on */
+#define RENDER_IDLE_MS      1000 /* Safety net only: frames, keys and signals all wake the poll */
+#define VBLANK_TIMEOUT_MS   1000
+
+/* Render thread wake-up sources (wait_for_events) */
+#define WAIT_FRAME          (1 << 0)  /* A decoded frame, or end of stream, is queued */
+#define WAIT_VBLANK         (1 << 1)  /* The awaited flip / vblank has landed */
+#define WAIT_INPUT          (1 << 2)  /* Quit/seek actions from the input thread */
+
+/* Keyboard seeking: , and . scrub to the nearest keyframe, p and n jump between
+ * chapters (or tenths of the item when the file has none) frame-accurately */
+#define SEEK_STEP_US        10000000
+#define SEEK_MAX_CHAPTERS   64
+#define SEEK_CHAPTER_SLACK_US 1000000  /* "Previous chapter" this far into one restarts it */
+#define TIMELINE_SEGMENTS   8         /* Rebases remembered to map screen times back */
+
+/* decoded_frame_t.discontinuity reasons */
+#define DISCONTINUITY_SEEK     1  /* Same decoder, new position: re-anchor the clock */
+#define DISCONTINUITY_DECODER  2  /* New decoder as well: its buffers replace the cached imports */
+
+/* Seek request (render thread -> demux thread) */
+typedef struct {
+    int64_t from_us;          /* Timestamp on screen when asked (output timeline) */
+    int64_t offset_us;        /* Relative seek, or ... */
+    int chapter_step;         /* ... +1 / -1 chapters when non-zero */
+    video_seek_mode_t mode;
+} seek_request_t;
+
+/* One stretch of the output timeline: packets from one item pass, one offset */
+typedef struct {
+    int64_t start_us;         /* First output timestamp in it */
+    int64_t pts_offset;       /* Output minus input timestamps */
+    int item;                 /* Playlist item generation (bumped per item change) */
+    int index;                /* Playlist index of that item */
+    int loop;                 /* Times the playlist had wrapped (--loop) */
+} timeline_segment_t;
+
+/* Recent segments, so screen times map back to media positions, not the demuxer's */
+typedef struct {
+    timeline_segment_t segments[TIMELINE_SEGMENTS];
+    unsigned int count;       /* Segments started; the newest is [(count - 1) % N] */
+} timeline_t;
+
+/* --heads: how one decoded frame is laid out over two HDMI outputs */
+typedef enum {
+    HEADS_SINGLE,             /* One output (default) */
+    HEADS_MIRROR,             /* Same picture and warp on both */
+    HEADS_SPAN,               /* Left half on the first head, right half on the second */
+    HEADS_DUAL                /* Same picture, each head warped from its own config */
+} head_layout_t;
+
+static const char *head_layout_names[] = { "single", "mirror", "span", "dual" };
+
+/* Warp config per head (--heads dual reads the second file for head 2) */
+#define WARP_CONFIG_FILE        "warp_config.txt"
+#define WARP_CONFIG_HEAD2_FILE  "warp_config.head2.txt"
+
+/* --sync follow: a master this far from us (or our own seek) triggers one seek */
+#define SYNC_SEEK_US        500000
+/* Seek this far ahead of the master, so the follower is waiting when it arrives */
+#define SYNC_SEEK_LEAD_US   1000000
+/* Master samples further from our frame are transients (a wrap or seek still in flight) */
+#define SYNC_SLEW_RANGE_US  (SYNC_SEEK_LEAD_US + SYNC_SEEK_US)
+
+/* Packets in flight inside the decoder whose demux time we remember */
+#define DEMUX_STAMP_SLOTS   64
 
 /* Global state for cleanup on signal */
 static struct {
@@ -36,8 +124,78 @@ static struct {
     gpu_renderer_ctx_t *renderer_ctx;
     display_output_ctx_t *display_ctx;
     warp_control_ctx_t *warp_ctx;
-    int running;
-} g_player_state = {0};
+    frame_scheduler_t *scheduler;
+    pipeline_stats_t *stats;
+    const char *stats_path;  /* Live metrics file (NULL = default) */
+    int running;             /* Set from startup; cleared by a signal or quit */
+    int stop_fd;             /* eventfd: readable once shutdown is requested */
+    int plane_path;          /* 1 while frames go straight to the overlay plane */
+    int display_ready;       /* display_ctx configured (the fallback can render into it) */
+    
+    /* Demux -> decode -> render threads */
+    frame_queue_t *packet_queue;
+    frame_queue_t *frame_queue;
+    pthread_t demux_thread;
+    pthread_t decode_thread;
+    int demux_started;
+    int decode_started;
+    int stopping;            /* Set once to make the worker threads exit */
+    
+    /* Playlist / looping */
+    const char **playlist;
+    int playlist_count;
+    int loop;                /* Wrap around to the first item at the end */
+    video_stream_info_t stream_info;  /* Stream the current decoder was configured for */
+    
+    /* Startup */
+    int self_test;           /* Show the 3 second test pattern before playback */
+    uint64_t start_us;       /* Process start, for time-to-first-frame */
+    int mode_width;          /* Requested display mode (--mode, 0 = connector default) */
+    int mode_height;
+    int mode_refresh;
+    int mode_match;          /* Refresh follows the content (--mode match), 2 = resolution too */
+    int queue_depth;         /* Decoded frames queued ahead of the renderer (--queue-depth) */
+    int mmap_input;          /* Map local files instead of read() (--mmap) */
+    head_layout_t head_layout;  /* One or two HDMI heads (--heads) */
+    float crop[4];           /* Part of the frame this node shows: x, y, w, h in 0..1 (--crop) */
+    
+    /* Video wall: one master publishes its clock, followers lock to it (--sync) */
+    int sync_enabled;
+    wall_sync_role_t sync_role;
+    char sync_group[64];     /* Empty = WALL_SYNC_DEFAULT_GROUP */
+    int sync_port;           /* 0 = WALL_SYNC_DEFAULT_PORT */
+    wall_sync_t *wall_sync;
+    
+    /* Keys, remotes and network control, read on their own thread */
+    control_input_t *control_input;
+    int control_port;        /* UDP control port (--control-port, 0 = off) */
+    int use_evdev;           /* Read USB keypads / remotes (--no-evdev turns it off) */
+    int grab_evdev;          /* Grab them, keyboards included (--grab-evdev) */
+    
+    /* Seeking: packets and frames from before the latest request are dropped */
+    pthread_mutex_t seek_lock;
+    seek_request_t seek;     /* Latest request (under seek_lock) */
+    unsigned int seek_serial;  /* Bumped per request (written under seek_lock) */
+    
+    /* Written by the demux thread, read by it and the render thread (wall sync) */
+    pthread_mutex_t timeline_lock;
+    timeline_t timeline;
+} g_player_state = { .running = 1, .mode_width = 1920, .mode_height = 1080, .mode_refresh = 60,
+                     .queue_depth = FRAME_QUEUE_DEPTH, .stop_fd = -1,
+                     .crop = { 0.0f, 0.0f, 1.0f, 1.0f }, .use_evdev = 1,
+                     .seek_lock = PTHREAD_MUTEX_INITIALIZER,
+                     .timeline_lock = PTHREAD_MUTEX_INITIALIZER };
+
+/* Packet queue element: a packet, or an item-change marker */
+typedef struct {
+    frame_packet_t packet;
+    uint64_t demux_us;                  /* When the packet left the demuxer */
+    unsigned int seek_serial;           /* Seek request this packet was read for */
+    int64_t discard_before_us;          /* Accurate seek: frames before this are not shown */
+    int item_change;
+    video_input_ctx_t *retire_input;    /* Input whose packets are all ahead of this marker */
+    hw_decoder_ctx_t *switch_decoder;   /* Drain the current decoder, then continue on this one */
+} queued_packet_t;
 
 /* Terminal state for keyboard input */
 static struct termios original_termios;
@@ -81,139 +239,332 @@ static void restore_terminal(void) {
     }
 }
 
-/* Check keyboard input */
-static char check_keyboard(void) {
-    if (!terminal_configured) return 0;
+/* Current CLOCK_MONOTONIC time (same clock as DRM vblank timestamps) */
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/* Wake every thread blocked in poll() on the stop fd (async-signal-safe) */
+static void request_stop(void) {
+    uint64_t one = 1;
     
-    char c = 0;
-    if (read(STDIN_FILENO, &c, 1) == 1) {
-        return c;
+    if (g_player_state.stop_fd >= 0 &&
+        write(g_player_state.stop_fd, &one, sizeof(one)) < 0) {
+        /* Counter saturated: already readable */
     }
-    return 0;
 }
 
 /* Signal handler for clean shutdown */
 static void signal_handler(int sig) {
-    printf("\nReceived signal %d, shutting down...\n", sig);
-    g_player_state.running = 0;
-    restore_terminal();
+    static const char msg[] = "\nReceived signal, shutting down...\n";
     
-    /* Create stop signal file for fallback player */
-    FILE *stop_file = fopen("/tmp/pickle_stop", "w");
-    if (stop_file) {
-        fprintf(stop_file, "stop\n");
-        fclose(stop_file);
+    /* Async-signal-safe only: stop_fd wakes every loop, the fallback's included;
+     * the terminal is restored by the normal exit path (and atexit) */
+    (void)sig;
+    g_player_state.running = 0;
+    request_stop();
+    if (write(STDOUT_FILENO, msg, sizeof(msg) - 1) < 0) {
+        /* Nothing to do about it here */
     }
 }
 
 /* Print usage information */
 static void print_usage(const char *prog_name) {
-    printf("Usage: %s <video_file.mp4>\n", prog_name);
+    printf("Usage: %s [--loop] [--self-test] [--stats <file>] [--mode WxH[@Hz]|auto|match|match-fit] [--queue-depth N] [--mmap] [--heads LAYOUT] [--sync master|follow] [--sync-group ADDR[:PORT]] [--crop X,Y,W,H] [--control-port PORT] [--no-evdev] [--grab-evdev] <video_file.mp4> [more files...]\n", prog_name);
     printf("       %s rpi4-e.mp4  (for testing)\n", prog_name);
+    printf("\nOptions:\n");
+    printf("  --loop        Play the file (or playlist) forever, gaplessly\n");
+    printf("  --self-test   Show a 3 second test pattern before playback\n");
+    printf("  --stats FILE  Live JSON metrics, rewritten every second (default %s)\n",
+           PIPELINE_STATS_DEFAULT_PATH);
+    printf("  --mode MODE   Display mode, e.g. 3840x2160@60, or auto for the connector default\n"
+           "                (default 1920x1080@60); match picks the refresh that is a multiple\n"
+           "                of the first file's frame rate, match-fit also the smallest\n"
+           "                resolution that holds it\n");
+    printf("  --queue-depth N  Decoded frames buffered ahead of the renderer, 1-%d (default %d);\n"
+           "                   the decoder's frame pool grows with it\n",
+           FRAME_QUEUE_MAX, FRAME_QUEUE_DEPTH);
+    printf("  --mmap        Read local files through a memory mapping (no read() syscalls)\n");
+    printf("  --heads LAYOUT  Drive both HDMI outputs from one decode: mirror, span (left/right\n"
+           "                half each; head 2 blended from %s) or dual (per-head\n"
+           "                warp and blend, head 2 from the same file)\n",
+           WARP_CONFIG_HEAD2_FILE);
+    printf("  --sync ROLE   Video wall: master publishes its clock over multicast, follow\n"
+           "                locks this node's presentation to it\n");
+    printf("  --sync-group ADDR[:PORT]  Multicast group for --sync (default %s:%d)\n",
+           WALL_SYNC_DEFAULT_GROUP, WALL_SYNC_DEFAULT_PORT);
+    printf("  --crop X,Y,W,H  Show only this part of the frame, as fractions of it\n"
+           "                (e.g. 0.5,0,0.5,0.5 is the top-right quarter)\n");
+    printf("  --control-port PORT  Accept control commands (text or OSC %s*) over UDP\n",
+           CONTROL_INPUT_OSC_PREFIX);
+    printf("  --no-evdev    Don't read USB keypads, keyboards and remotes\n");
+    printf("  --grab-evdev  Grab them for exclusive use (a keyboard then stops typing into the\n"
+           "                console, and Ctrl+C on it quits through the player)\n");
     printf("\nPickle - GPU-accelerated video player for Raspberry Pi 4\n");
     printf("Features:\n");
-    printf("  - Hardware H.264 decode via V4L2 M2M\n");
+    printf("  - Hardware H.264 decode via V4L2 M2M, HEVC up to 4K60 via V4L2 request API\n");
     printf("  - GPU rendering with OpenGL ES 3.2\n");
     printf("  - Real-time keystone correction\n");
     printf("  - Zero-copy pipeline for minimal CPU usage\n");
-    printf("  - DRM/KMS output at 1920x1080@60Hz\n");
+    printf("  - DRM/KMS output at 1920x1080@60Hz or any connector mode (--mode)\n");
     printf("\nRuntime controls:\n");
-    printf("  - Arrow keys: adjust keystone corners\n");
-    printf("  - R: reset warp to identity\n");
+    printf("  - Arrow keys: adjust keystone corners (1-4 select one, F fine steps)\n");
+    printf("  - R: reset warp to identity, S / L: save / load %s\n", WARP_CONFIG_FILE);
+    printf("  - , / .: scrub back / forward %d s (nearest keyframe)\n", SEEK_STEP_US / 1000000);
+    printf("  - P / N: previous / next chapter\n");
     printf("  - Q/ESC: quit\n");
 }
 
-/* Initialize all pipeline modules in sequence */
-static int init_pipeline(const char *video_file) {
-    int ret;
-    video_stream_info_t stream_info;
+/* Parse --mode: WxH, WxH@Hz, auto (connector's preferred mode) or match[-fit] (content's rate) */
+static int parse_mode(const char *arg) {
+    int width = 0, height = 0, refresh = 0;
     
-    printf("Initializing video pipeline...\n");
+    g_player_state.mode_match = strcmp(arg, "match") == 0 ? 1 :
+                                strcmp(arg, "match-fit") == 0 ? 2 : 0;
+    if (strcmp(arg, "auto") == 0 || g_player_state.mode_match) {
+        g_player_state.mode_width = 0;
+        g_player_state.mode_height = 0;
+        g_player_state.mode_refresh = 0;
+        return 0;
+    }
     
-    /* 1. Initialize video input */
-    g_player_state.input_ctx = video_input_create();
-    if (!g_player_state.input_ctx) {
-        fprintf(stderr, "Failed to create video input context\n");
+    if (sscanf(arg, "%dx%d@%d", &width, &height, &refresh) < 2 ||
+        width <= 0 || height <= 0 || refresh < 0) {
+        fprintf(stderr, "Invalid display mode '%s'\n", arg);
         return -1;
     }
     
-    ret = video_input_open(g_player_state.input_ctx, video_file);
-    if (ret < 0) {
-        fprintf(stderr, "Failed to open video file: %s\n", video_file);
-        return ret;
+    g_player_state.mode_width = width;
+    g_player_state.mode_height = height;
+    g_player_state.mode_refresh = refresh;
+    return 0;
+}
+
+/* Parse --heads: single, mirror, span or dual */
+static int parse_head_layout(const char *arg) {
+    for (int i = 0; i < (int)(sizeof(head_layout_names) / sizeof(head_layout_names[0])); i++) {
+        if (strcmp(arg, head_layout_names[i]) == 0) {
+            g_player_state.head_layout = (head_layout_t)i;
+            return 0;
+        }
     }
     
-    /* Get stream info for other modules */
-    ret = video_input_get_stream_info(g_player_state.input_ctx, &stream_info);
-    if (ret < 0) {
-        fprintf(stderr, "Failed to get video stream info\n");
-        return ret;
+    fprintf(stderr, "Invalid head layout '%s'\n", arg);
+    return -1;
+}
+
+/* Parse --crop: X,Y,W,H as fractions of the frame */
+static int parse_crop(const char *arg) {
+    float x, y, w, h;
+    
+    if (sscanf(arg, "%f,%f,%f,%f", &x, &y, &w, &h) != 4 ||
+        x < 0.0f || y < 0.0f || w <= 0.0f || h <= 0.0f ||
+        x + w > 1.0f + 1e-5f || y + h > 1.0f + 1e-5f) {
+        fprintf(stderr, "Invalid crop '%s'\n", arg);
+        return -1;
     }
     
-    /* 2. Initialize hardware decoder */
-    g_player_state.decoder_ctx = hw_decoder_create();
-    if (!g_player_state.decoder_ctx) {
-        fprintf(stderr, "Failed to create hardware decoder context\n");
+    g_player_state.crop[0] = x;
+    g_player_state.crop[1] = y;
+    g_player_state.crop[2] = w;
+    g_player_state.crop[3] = h;
+    return 0;
+}
+
+/* Parse --sync: master or follow */
+static int parse_sync_role(const char *arg) {
+    if (strcmp(arg, "master") == 0) {
+        g_player_state.sync_role = WALL_SYNC_MASTER;
+    } else if (strcmp(arg, "follow") == 0) {
+        g_player_state.sync_role = WALL_SYNC_FOLLOWER;
+    } else {
+        fprintf(stderr, "Invalid sync role '%s'\n", arg);
         return -1;
     }
     
-    /* Debug: Show extradata info */
-    if (stream_info.extradata && stream_info.extradata_size > 0) {
-        printf("H.264 extradata found: %d bytes (SPS/PPS parameters)\n", stream_info.extradata_size);
+    g_player_state.sync_enabled = 1;
+    return 0;
+}
+
+/* Parse --sync-group: ADDR or ADDR:PORT */
+static int parse_sync_group(const char *arg) {
+    const char *colon = strchr(arg, ':');
+    size_t len = colon ? (size_t)(colon - arg) : strlen(arg);
+    
+    if (len == 0 || len >= sizeof(g_player_state.sync_group) ||
+        (colon && (g_player_state.sync_port = atoi(colon + 1)) <= 0)) {
+        fprintf(stderr, "Invalid sync group '%s'\n", arg);
+        return -1;
+    }
+    
+    memcpy(g_player_state.sync_group, arg, len);
+    g_player_state.sync_group[len] = '\0';
+    return 0;
+}
+
+/* Switch to a refresh the content divides (--mode match); otherwise the scheduler paces it */
+static void match_display_mode(const video_stream_info_t *info) {
+    display_info_t display_info = {0};
+    display_mode_t mode;
+    int fit = g_player_state.mode_match == 2;
+    int ret;
+    
+    display_output_get_info(g_player_state.display_ctx, &display_info);
+    ret = display_output_find_content_mode(g_player_state.display_ctx, info->fps_num, info->fps_den,
+                                           fit ? info->width : 0, fit ? info->height : 0, &mode);
+    if (ret == DISPLAY_OUTPUT_EAGAIN) {
+        printf("⚠ No display mode at a multiple of %.3f fps - staying at %d Hz, "
+               "frames repeated to the cadence\n",
+               (double)info->fps_num / (double)info->fps_den, display_info.refresh_rate);
+        return;
+    }
+    if (ret < 0 || display_output_set_mode(g_player_state.display_ctx, &mode) < 0) {
+        printf("⚠ Content-matched mode unavailable - staying at %d Hz\n", display_info.refresh_rate);
+        return;
+    }
+    
+    printf("✓ Display follows the content: %.3f fps on %dx%d@%.3fHz\n",
+           (double)info->fps_num / (double)info->fps_den, mode.width, mode.height,
+           (double)mode.refresh_mhz / 1000.0);
+}
+
+/* Lay the frame (or this node's --crop of it) out over the heads the display came up with */
+static void configure_heads(void) {
+    gpu_renderer_ctx_t *renderer = g_player_state.renderer_ctx;
+    head_layout_t layout = g_player_state.head_layout;
+    const float *crop = g_player_state.crop;
+    int head_count = display_output_get_head_count(g_player_state.display_ctx);
+    warp_matrix_t matrix;
+    warp_blend_t blend;
+    
+    if (layout != HEADS_SINGLE && head_count < 2) {
+        printf("⚠ Only one head available - --heads %s shows a single output\n",
+               head_layout_names[layout]);
+        layout = HEADS_SINGLE;
+    }
+    
+    /* Where head 2 has its own config, the interactive warp and blend belong to head 1 */
+    warp_control_set_heads(g_player_state.warp_ctx, layout == HEADS_DUAL ? 0 : -1,
+                           layout == HEADS_SINGLE || layout == HEADS_MIRROR ? -1 : 0);
+    
+    if (layout == HEADS_SPAN) {
+        gpu_renderer_set_head_crop(renderer, 0, crop[0], crop[1], crop[2] / 2.0f, crop[3]);
+        gpu_renderer_set_head_crop(renderer, 1, crop[0] + crop[2] / 2.0f, crop[1],
+                                   crop[2] / 2.0f, crop[3]);
     } else {
-        printf("Warning: No H.264 extradata found - decoder may not work\n");
+        for (int i = 0; i < head_count; i++) {
+            gpu_renderer_set_head_crop(renderer, i, crop[0], crop[1], crop[2], crop[3]);
+        }
+    }
+    if (crop[2] < 1.0f || crop[3] < 1.0f) {
+        printf("✓ Showing crop %.3f,%.3f %.3fx%.3f of the frame\n",
+               crop[0], crop[1], crop[2], crop[3]);
     }
     
-    ret = hw_decoder_configure(g_player_state.decoder_ctx, &stream_info);
-    if (ret < 0) {
-        fprintf(stderr, "Failed to configure hardware decoder\n");
-        return ret;
+    /* Edge blend and masks from the first config (every head, unless head 2 has its own) */
+    if (warp_control_generate_blend(g_player_state.warp_ctx, &blend) == 0 && blend.texels &&
+        gpu_renderer_set_blend(renderer, &blend) == 0) {
+        printf("✓ Edge blend / masks applied\n");
     }
     
-    /* 3. Initialize display output first (creates EGL context) */
-    g_player_state.display_ctx = display_output_create();
-    if (!g_player_state.display_ctx) {
-        fprintf(stderr, "Failed to create display output context\n");
-        return -1;
+    if (layout == HEADS_SINGLE) {
+        return;
     }
     
-    ret = display_output_configure(g_player_state.display_ctx, 1920, 1080, 60);
-    if (ret < 0) {
-        fprintf(stderr, "Failed to configure display output\n");
-        return ret;
+    if (layout == HEADS_SPAN || layout == HEADS_DUAL) {
+        /* Each projector has its own overlap, so head 2 reads its own blend
+         * (and for dual its static warp); the mesh is shared */
+        warp_control_ctx_t *head2 = warp_control_create();
+        
+        if (head2 && warp_control_load_config(head2, WARP_CONFIG_HEAD2_FILE) < 0) {
+            printf("No %s found, head 2 %s\n", WARP_CONFIG_HEAD2_FILE,
+                   layout == HEADS_DUAL ? "unwarped" : "not blended");
+        }
+        if (head2 && warp_control_generate_blend(head2, &blend) == 0) {
+            gpu_renderer_set_head_blend(renderer, 1, &blend);
+        }
+        if (layout == HEADS_DUAL) {
+            if (warp_control_generate_matrix(g_player_state.warp_ctx, &matrix) == 0) {
+                gpu_renderer_set_head_warp_matrix(renderer, 0, &matrix);
+            }
+            if (head2 && warp_control_generate_matrix(head2, &matrix) == 0) {
+                gpu_renderer_set_head_warp_matrix(renderer, 1, &matrix);
+            }
+        }
+        if (head2) {
+            warp_control_destroy(head2);
+        }
     }
     
-    /* 4. Initialize GPU renderer (needs EGL context from display) */
-    g_player_state.renderer_ctx = gpu_renderer_create();
-    if (!g_player_state.renderer_ctx) {
-        fprintf(stderr, "Failed to create GPU renderer context\n");
-        return -1;
+    printf("✓ Two heads, one decode: %s\n", head_layout_names[layout]);
+}
+
+/* Create a decoder whose frame pool covers every frame the pipeline can hold */
+static hw_decoder_ctx_t *create_decoder(const video_stream_info_t *info) {
+    decoder_buffer_config_t buffers = {
+        .num_input_buffers = 0,   /* Bitstream queue: the driver default keeps up */
+        .num_output_buffers = g_player_state.queue_depth + PIPELINE_HELD_FRAMES,
+        .input_buffer_size = 0,
+    };
+    hw_decoder_ctx_t *decoder = hw_decoder_create();
+    
+    if (!decoder) {
+        fprintf(stderr, "Failed to create hardware decoder context\n");
+        return NULL;
     }
     
-    ret = gpu_renderer_configure(g_player_state.renderer_ctx, 
-                                g_player_state.display_ctx,
-                                stream_info.width, stream_info.height);
-    if (ret < 0) {
-        fprintf(stderr, "Failed to configure GPU renderer\n");
-        return ret;
+    if (hw_decoder_set_buffer_config(decoder, &buffers) < 0 ||
+        hw_decoder_configure(decoder, info) < 0) {
+        fprintf(stderr, "Failed to configure hardware decoder\n");
+        hw_decoder_destroy(decoder);
+        return NULL;
     }
     
-    /* 5. Initialize warp control */
-    g_player_state.warp_ctx = warp_control_create();
-    if (!g_player_state.warp_ctx) {
-        fprintf(stderr, "Failed to create warp control context\n");
-        return -1;
+    return decoder;
+}
+
+/* Demux/decode thread control (defined with the playback loop below) */
+static int start_pipeline_threads(void);
+static void stop_pipeline_threads(void);
+
+/* Container open + probe, run while DRM/GBM/EGL come up */
+typedef struct {
+    const char *video_file;
+    video_input_ctx_t *input;
+    video_stream_info_t stream_info;
+    int result;
+} media_probe_t;
+
+static void *media_probe_thread_main(void *arg) {
+    media_probe_t *probe = arg;
+    
+    probe->result = -1;
+    probe->input = video_input_create();
+    if (!probe->input) {
+        fprintf(stderr, "Failed to create video input context\n");
+        return NULL;
     }
+    video_input_set_mmap(probe->input, g_player_state.mmap_input);
     
-    ret = warp_control_load_config(g_player_state.warp_ctx, "warp_config.txt");
-    if (ret < 0) {
-        /* Non-fatal - use defaults */
-        printf("No warp config found, using defaults\n");
+    if (video_input_open(probe->input, probe->video_file) < 0) {
+        fprintf(stderr, "Failed to open video file: %s\n", probe->video_file);
+        return NULL;
     }
     
-    printf("Pipeline initialized successfully\n");
+    /* Get stream info for other modules */
+    if (video_input_get_stream_info(probe->input, &probe->stream_info) < 0) {
+        fprintf(stderr, "Failed to get video stream info\n");
+        return NULL;
+    }
     
-    /* Test the display pipeline with a simple pattern */
+    probe->result = 0;
+    return NULL;
+}
+
+/* Render the test pattern for 3 seconds (--self-test) */
+static void run_self_test(void) {
     printf("Testing display output with test pattern...\n");
     
     /* Create a simple test frame */
@@ -246,33 +597,264 @@ static int init_pipeline(const char *video_file) {
         if (i == 60) printf("✓ Test pattern still displaying (2 seconds left)...\n");
         if (i == 120) printf("✓ Test pattern still displaying (1 second left)...\n");
         
-        usleep(16667); // ~60 FPS
+        /* Pace to the display refresh (page flip completion) */
+        display_output_wait_vblank(g_player_state.display_ctx, NULL);
     }
     
     printf("✓ Test pattern completed - display pipeline works!\n");
+}
+
+/*
+ * Initialize all pipeline modules.
+ *
+ * The container is probed on a helper thread while KMS/EGL initialise here
+ * (the EGL context must belong to this thread). The decoder is configured
+ * once the display holds DRM master - it opens the same card - and decoding
+ * starts before the shaders are built, so the first frame is usually ready
+ * by the time the renderer is.
+ */
+static int init_pipeline(const char *video_file) {
+    int ret;
+    video_stream_info_t stream_info;
+    media_probe_t probe = {0};
+    pthread_t probe_thread;
+    int probe_started;
+    
+    printf("Initializing video pipeline...\n");
+    
+    /* 0. Latency/drop metrics (export failure is not fatal) */
+    g_player_state.stats = pipeline_stats_create();
+    if (g_player_state.stats) {
+        pipeline_stats_start_export(g_player_state.stats, g_player_state.stats_path);
+    }
+    
+    /* 1. Open and probe the container in the background */
+    probe.video_file = video_file;
+    probe_started = pthread_create(&probe_thread, NULL, media_probe_thread_main, &probe) == 0;
+    if (!probe_started) {
+        media_probe_thread_main(&probe);
+    }
+    
+    /* 2. Initialize display output (DRM/GBM/EGL) meanwhile */
+    g_player_state.display_ctx = display_output_create();
+    if (!g_player_state.display_ctx) {
+        fprintf(stderr, "Failed to create display output context\n");
+        ret = -1;
+    } else {
+        display_config_t display_config = {0};
+        
+        /* The second head takes the first one's mode */
+        display_config.head_count = g_player_state.head_layout == HEADS_SINGLE ? 1 : 2;
+        display_output_set_config(g_player_state.display_ctx, &display_config);
+        ret = display_output_configure(g_player_state.display_ctx, g_player_state.mode_width,
+                                       g_player_state.mode_height, g_player_state.mode_refresh);
+        if (ret < 0) {
+            fprintf(stderr, "Failed to configure display output\n");
+        } else {
+            g_player_state.display_ready = 1;
+        }
+    }
+    
+    if (probe_started) {
+        pthread_join(probe_thread, NULL);
+    }
+    g_player_state.input_ctx = probe.input;
+    if (probe.result < 0) {
+        return -1;
+    }
+    stream_info = probe.stream_info;
+    g_player_state.stream_info = stream_info;  /* Owns extradata from here on */
+    if (ret < 0) {
+        return ret;
+    }
+    printf("Display and container ready after %.1f ms\n",
+           (double)(monotonic_us() - g_player_state.start_us) / 1000.0);
+    
+    /* The stream's rate is known now and nothing has been shown: match the mode to it */
+    if (g_player_state.mode_match) {
+        match_display_mode(&stream_info);
+    }
+    
+    /* 3. Initialize hardware decoder */
+    /* Debug: Show extradata info */
+    if (stream_info.extradata && stream_info.extradata_size > 0) {
+        printf("H.264 extradata found: %d bytes (SPS/PPS parameters)\n", stream_info.extradata_size);
+    } else {
+        printf("Warning: No H.264 extradata found - decoder may not work\n");
+    }
+    
+    g_player_state.decoder_ctx = create_decoder(&stream_info);
+    if (!g_player_state.decoder_ctx) {
+        return -1;
+    }
+    
+    /* 4. Start demuxing/decoding while the renderer comes up */
+    ret = start_pipeline_threads();
+    if (ret < 0) {
+        return ret;
+    }
+    
+    /* 5. Initialize GPU renderer (needs EGL context from display) */
+    g_player_state.renderer_ctx = gpu_renderer_create();
+    if (!g_player_state.renderer_ctx) {
+        fprintf(stderr, "Failed to create GPU renderer context\n");
+        return -1;
+    }
+    
+    ret = gpu_renderer_configure(g_player_state.renderer_ctx, 
+                                g_player_state.display_ctx,
+                                stream_info.width, stream_info.height);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to configure GPU renderer\n");
+        return ret;
+    }
+    
+    /* 6. Initialize presentation scheduler (stream fps vs display refresh) */
+    g_player_state.scheduler = frame_scheduler_create();
+    if (!g_player_state.scheduler) {
+        fprintf(stderr, "Failed to create frame scheduler\n");
+        return -1;
+    }
+    
+    display_info_t display_info;
+    memset(&display_info, 0, sizeof(display_info));
+    display_output_get_info(g_player_state.display_ctx, &display_info);
+    frame_scheduler_configure(g_player_state.scheduler, stream_info.fps_num, stream_info.fps_den,
+                              display_info.refresh_mhz);
+    
+    /* 7. Initialize warp control */
+    g_player_state.warp_ctx = warp_control_create();
+    if (!g_player_state.warp_ctx) {
+        fprintf(stderr, "Failed to create warp control context\n");
+        return -1;
+    }
+    
+    ret = warp_control_load_config(g_player_state.warp_ctx, WARP_CONFIG_FILE);
+    if (ret < 0) {
+        /* Non-fatal - use defaults */
+        printf("No warp config found, using defaults\n");
+    }
+    
+    /* Corners, keystone and mesh reach the renderer from the first frame on */
+    ret = warp_control_configure(g_player_state.warp_ctx, g_player_state.renderer_ctx);
+    if (ret < 0) {
+        fprintf(stderr, "Failed to configure warp control\n");
+        return ret;
+    }
+    
+    /* 8. Lay the frame out over both HDMI heads (--heads) and crop it (--crop) */
+    configure_heads();
+    
+    /* 9. Join the video wall (--sync); without it this node just plays freely */
+    if (g_player_state.sync_enabled) {
+        g_player_state.wall_sync = wall_sync_create();
+        if (!g_player_state.wall_sync ||
+            wall_sync_configure(g_player_state.wall_sync, g_player_state.sync_role,
+                                g_player_state.sync_group[0] ? g_player_state.sync_group : NULL,
+                                g_player_state.sync_port) != WALL_SYNC_OK) {
+            printf("⚠ Wall sync unavailable - playing unsynchronised\n");
+            wall_sync_destroy(g_player_state.wall_sync);
+            g_player_state.wall_sync = NULL;
+        }
+    }
+    
+    /* 10. Hand the warp to the input thread; the render loop only picks up results */
+    control_input_config_t input_config = {
+        .warp = g_player_state.warp_ctx,
+        .use_stdin = terminal_configured,
+        .use_evdev = g_player_state.use_evdev,
+        .grab_evdev = g_player_state.grab_evdev,
+        .udp_port = g_player_state.control_port,
+    };
+    g_player_state.control_input = control_input_create();
+    if (!g_player_state.control_input ||
+        control_input_configure(g_player_state.control_input, &input_config) < 0) {
+        printf("⚠ Input thread unavailable - no runtime controls\n");
+        control_input_destroy(g_player_state.control_input);
+        g_player_state.control_input = NULL;
+    }
+    
+    printf("Pipeline initialized successfully after %.1f ms\n",
+           (double)(monotonic_us() - g_player_state.start_us) / 1000.0);
+    
+    /* Test the display pipeline with a simple pattern (decoding waits on the full queue) */
+    if (g_player_state.self_test) {
+        run_self_test();
+    }
+    
     return 0;
 }
 
-/* Clean up all pipeline resources */
-static void cleanup_pipeline(void) {
-    printf("Cleaning up pipeline...\n");
+/* Tear down the decode side; the display, renderer and warp stay up for the fallback */
+static void release_decode_pipeline(void) {
+    /* The input thread edits the warp, which the fallback recreates */
+    if (g_player_state.control_input) {
+        control_input_destroy(g_player_state.control_input);
+        g_player_state.control_input = NULL;
+    }
     
-    if (g_player_state.warp_ctx) {
-        warp_control_destroy(g_player_state.warp_ctx);
-        g_player_state.warp_ctx = NULL;
+    /* Threads use the decoder and inputs; also covers a failed init */
+    stop_pipeline_threads();
+    
+    if (g_player_state.wall_sync) {
+        wall_sync_destroy(g_player_state.wall_sync);
+        g_player_state.wall_sync = NULL;
+    }
+    
+    if (g_player_state.stats) {
+        pipeline_stats_print(g_player_state.stats);
+        pipeline_stats_destroy(g_player_state.stats);
+        g_player_state.stats = NULL;
+    }
+    
+    if (g_player_state.scheduler) {
+        uint64_t shown = 0, dropped = 0, repeated = 0;
+        
+        frame_scheduler_get_stats(g_player_state.scheduler, &shown, &dropped, &repeated);
+        printf("Scheduler: %llu frames shown, %llu dropped, %llu vblanks repeated\n",
+               (unsigned long long)shown, (unsigned long long)dropped,
+               (unsigned long long)repeated);
+        
+        frame_scheduler_destroy(g_player_state.scheduler);
+        g_player_state.scheduler = NULL;
     }
     
+    /* CPU submit cost next to GPU execution, to tell which side a drop came from */
     if (g_player_state.renderer_ctx) {
-        gpu_renderer_destroy(g_player_state.renderer_ctx);
-        g_player_state.renderer_ctx = NULL;
+        uint64_t rendered = 0, submit_us = 0;
+        gpu_timing_t timing;
+        
+        gpu_renderer_get_stats(g_player_state.renderer_ctx, &rendered, &submit_us, NULL);
+        gpu_renderer_get_gpu_timing(g_player_state.renderer_ctx, &timing);
+        if (timing.frames_timed) {
+            printf("Renderer: %llu frames, %llu us CPU submit; GPU %llu us import + %llu us draw, "
+                   "%.0f%% idle (%llu frames timed, %llu discarded)\n",
+                   (unsigned long long)rendered, (unsigned long long)submit_us,
+                   (unsigned long long)timing.avg_pass_us[GPU_PASS_IMPORT],
+                   (unsigned long long)timing.avg_pass_us[GPU_PASS_DRAW],
+                   timing.idle_fraction * 100.0, (unsigned long long)timing.frames_timed,
+                   (unsigned long long)timing.frames_discarded);
+        } else {
+            printf("Renderer: %llu frames, %llu us CPU submit; GPU time %s\n",
+                   (unsigned long long)rendered, (unsigned long long)submit_us,
+                   timing.available ? "not measured yet" : "unavailable (no timer queries)");
+        }
     }
     
-    if (g_player_state.display_ctx) {
-        display_output_destroy(g_player_state.display_ctx);
-        g_player_state.display_ctx = NULL;
+    /* Imports pin the decoder's buffers */
+    if (g_player_state.renderer_ctx) {
+        gpu_renderer_flush_texture_cache(g_player_state.renderer_ctx);
     }
     
     if (g_player_state.decoder_ctx) {
+        const char *decoder_name = NULL;
+        int decoder_hw = 0;
+        uint64_t sysmem_frames = 0;
+        
+        hw_decoder_get_backend(g_player_state.decoder_ctx, &decoder_name, &decoder_hw, &sysmem_frames);
+        printf("Decoder: %s (%s), %llu frames without DMABUF\n", decoder_name,
+               decoder_hw ? "hardware" : "software", (unsigned long long)sysmem_frames);
+        
         hw_decoder_destroy(g_player_state.decoder_ctx);
         g_player_state.decoder_ctx = NULL;
     }
@@ -282,140 +864,1117 @@ static void cleanup_pipeline(void) {
         g_player_state.input_ctx = NULL;
     }
     
-    /* Ensure terminal is always restored during cleanup */
-    restore_terminal();
+    free(g_player_state.stream_info.extradata);
+    g_player_state.stream_info.extradata = NULL;
 }
 
-/* Main playback loop with zero-copy frame processing */
-static int run_playback_loop(void) {
-    int ret = 0;
-    frame_packet_t packet = {0};
-    decoded_frame_t frame = {0};
+/* Clean up all pipeline resources */
+static void cleanup_pipeline(void) {
+    printf("Cleaning up pipeline...\n");
     
-    printf("Starting playback loop...\n");
-    g_player_state.running = 1;
+    release_decode_pipeline();
     
+    if (g_player_state.warp_ctx) {
+        warp_control_destroy(g_player_state.warp_ctx);
+        g_player_state.warp_ctx = NULL;
+    }
+    
+    if (g_player_state.renderer_ctx) {
+        gpu_renderer_destroy(g_player_state.renderer_ctx);
+        g_player_state.renderer_ctx = NULL;
+    }
+    
+    if (g_player_state.display_ctx) {
+        display_output_destroy(g_player_state.display_ctx);
+        g_player_state.display_ctx = NULL;
+    }
+    g_player_state.display_ready = 0;
+    
+    /* Ensure terminal is always restored during cleanup */
+    restore_terminal();
+}
+
+/* Show one decoded frame, bypassing GL when the warp pass would be a no-op */
+static int present_decoded_frame(decoded_frame_t *frame) {
+    int ret;
+    
+    if (gpu_renderer_is_passthrough(g_player_state.renderer_ctx)) {
+        ret = display_output_present_dmabuf(g_player_state.display_ctx, frame);
+        if (ret == DISPLAY_OUTPUT_OK) {
+            if (!g_player_state.plane_path) {
+                printf("Identity warp: scanning frames out directly on overlay plane\n");
+                g_player_state.plane_path = 1;
+            }
+            return 0;
+        }
+        if (ret != DISPLAY_OUTPUT_EAGAIN) {
+            return ret;
+        }
+    }
+    
+    if (g_player_state.plane_path) {
+        printf("Warp active: switching back to GL render path\n");
+        g_player_state.plane_path = 0;
+    }
+    
+    ret = gpu_renderer_render_frame(g_player_state.renderer_ctx, frame);
+    if (ret < 0) {
+        fprintf(stderr, "Error rendering frame: %d\n", ret);
+        return ret;
+    }
+    
+    ret = display_output_present_frame(g_player_state.display_ctx);
+    if (ret < 0) {
+        fprintf(stderr, "Error presenting frame: %d\n", ret);
+        return ret;
+    }
+    
+    return 0;
+}
+
+/* Same decoder configuration can carry on across items (no drain, no gap) */
+static int streams_compatible(const video_stream_info_t *a, const video_stream_info_t *b) {
+    return a->codec_id == b->codec_id &&
+           a->width == b->width && a->height == b->height &&
+           a->extradata_size == b->extradata_size &&
+           (a->extradata_size == 0 ||
+            memcmp(a->extradata, b->extradata, (size_t)a->extradata_size) == 0);
+}
+
+/* Preloaded next playlist item */
+typedef struct {
+    video_input_ctx_t *input;
+    hw_decoder_ctx_t *decoder;   /* NULL when the running decoder can be reused */
+    video_stream_info_t info;
+} playlist_item_t;
+
+static void free_playlist_item(playlist_item_t *item) {
+    if (item->decoder) {
+        hw_decoder_destroy(item->decoder);
+    }
+    if (item->input) {
+        video_input_destroy(item->input);
+    }
+    free(item->info.extradata);
+    memset(item, 0, sizeof(*item));
+}
+
+/* Open the next item's demuxer (and a decoder if the stream differs) ahead of EOF */
+static int preload_playlist_item(int index, const video_stream_info_t *current,
+                                 playlist_item_t *item) {
+    const char *file = g_player_state.playlist[index];
+    
+    memset(item, 0, sizeof(*item));
+    
+    item->input = video_input_create();
+    if (item->input) {
+        video_input_set_mmap(item->input, g_player_state.mmap_input);
+    }
+    if (!item->input || video_input_open(item->input, file) < 0 ||
+        video_input_get_stream_info(item->input, &item->info) < 0) {
+        fprintf(stderr, "Failed to preload playlist item: %s\n", file);
+        free_playlist_item(item);
+        return -1;
+    }
+    
+    if (!streams_compatible(current, &item->info)) {
+        item->decoder = create_decoder(&item->info);
+        if (!item->decoder) {
+            fprintf(stderr, "Failed to preload decoder for: %s\n", file);
+            free_playlist_item(item);
+            return -1;
+        }
+    }
+    
+    printf("Preloaded next item: %s (%dx%d, %s decoder)\n", file, item->info.width,
+           item->info.height, item->decoder ? "new" : "shared");
+    return 0;
+}
+
+/* Ask the demux thread to reposition; frames already decoded are dropped */
+static void request_seek(int64_t from_us, int64_t offset_us, int chapter_step,
+                         video_seek_mode_t mode) {
+    pthread_mutex_lock(&g_player_state.seek_lock);
+    g_player_state.seek.from_us = from_us;
+    g_player_state.seek.offset_us = offset_us;
+    g_player_state.seek.chapter_step = chapter_step;
+    g_player_state.seek.mode = mode;
+    __atomic_store_n(&g_player_state.seek_serial, g_player_state.seek_serial + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_player_state.seek_lock);
+}
+
+/* Turn a seek request into a target in the input's own timestamps */
+static int64_t resolve_seek_target(video_input_ctx_t *input, const video_stream_info_t *info,
+                                   const seek_request_t *req, int64_t position_us) {
+    int64_t start_us = info->start_us;
+    int64_t end_us = info->duration_us > 0 ? start_us + info->duration_us : INT64_MAX;
+    int64_t target_us = position_us + req->offset_us;
+    
+    if (req->chapter_step != 0) {
+        int64_t chapters[SEEK_MAX_CHAPTERS];
+        int count = video_input_get_chapters(input, chapters, SEEK_MAX_CHAPTERS);
+        
+        /* No chapter list: tenths of the item */
+        if (count <= 0 && info->duration_us > 0) {
+            for (count = 0; count < 10; count++) {
+                chapters[count] = start_us + info->duration_us * count / 10;
+            }
+        }
+        
+        /* Chapter the position is in (counting a restart within the slack as the one before) */
+        int current = 0;
+        int64_t anchor_us = req->chapter_step < 0 ? position_us - SEEK_CHAPTER_SLACK_US : position_us;
+        while (current + 1 < count && chapters[current + 1] <= anchor_us) {
+            current++;
+        }
+        
+        int wanted = current + (req->chapter_step > 0 ? 1 : 0);
+        if (count <= 0 || wanted >= count) {
+            return position_us;  /* Already in the last chapter */
+        }
+        target_us = chapters[wanted];
+    }
+    
+    if (target_us < start_us) {
+        target_us = start_us;
+    }
+    if (target_us > end_us) {
+        target_us = end_us;
+    }
+    return target_us;
+}
+
+/* Demux thread: packets from here on get pts_offset */
+static void timeline_start_segment(int64_t start_us, int64_t pts_offset, int item, int index,
+                                   int loop) {
+    timeline_t *timeline = &g_player_state.timeline;
+    
+    pthread_mutex_lock(&g_player_state.timeline_lock);
+    timeline_segment_t *segment = &timeline->segments[timeline->count % TIMELINE_SEGMENTS];
+    segment->start_us = start_us;
+    segment->pts_offset = pts_offset;
+    segment->item = item;
+    segment->index = index;
+    segment->loop = loop;
+    timeline->count++;
+    pthread_mutex_unlock(&g_player_state.timeline_lock);
+}
+
+/* Segment an output timestamp was demuxed in (the oldest remembered if before them all) */
+static timeline_segment_t timeline_lookup(int64_t output_us) {
+    const timeline_t *timeline = &g_player_state.timeline;
+    timeline_segment_t segment = {0};
+    
+    pthread_mutex_lock(&g_player_state.timeline_lock);
+    unsigned int kept = timeline->count < TIMELINE_SEGMENTS ? timeline->count : TIMELINE_SEGMENTS;
+    for (unsigned int i = 1; i <= kept; i++) {
+        segment = timeline->segments[(timeline->count - i) % TIMELINE_SEGMENTS];
+        if (segment.start_us <= output_us) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_player_state.timeline_lock);
+    return segment;
+}
+
+/* Demux thread: read packets ahead of the decoder, moving through the playlist */
+static void *demux_thread_main(void *arg) {
+    video_input_ctx_t *input = g_player_state.input_ctx;
+    video_stream_info_t info = g_player_state.stream_info;
+    playlist_item_t next = {0};
+    queued_packet_t item = {0};
+    int index = 0;
     int packet_count = 0;
-    while (g_player_state.running) {
-        /* 1. Read next packet from input */
-        ret = video_input_read_packet(g_player_state.input_ctx, &packet);
+    int rebase = 0;
+    int64_t pts_offset = 0;       /* Keeps timestamps monotonic across items/loops */
+    int64_t timeline_end = 0;     /* End of the last packet pushed (output timeline) */
+    int item_gen = 0;
+    int loop_gen = 0;
+    int64_t frame_duration = (info.fps_num > 0 && info.fps_den > 0) ?
+                             (int64_t)1000000 * info.fps_den / info.fps_num : 0;
+    unsigned int seek_serial = 0;
+    int64_t seek_target = AV_NOPTS_VALUE;  /* Accurate seek awaiting its rebase */
+    int64_t discard_before = INT64_MIN;
+    int ret;
+    
+    (void)arg;
+    
+    /* A new run starts a new timeline (the render thread maps frames through it) */
+    pthread_mutex_lock(&g_player_state.timeline_lock);
+    g_player_state.timeline.count = 0;
+    pthread_mutex_unlock(&g_player_state.timeline_lock);
+    timeline_start_segment(INT64_MIN, pts_offset, item_gen, index, loop_gen);
+    
+    /* A multi-item playlist keeps the next item open ahead of time */
+    if (g_player_state.playlist_count > 1) {
+        preload_playlist_item(1, &info, &next);
+    }
+    
+    while (!__atomic_load_n(&g_player_state.stopping, __ATOMIC_ACQUIRE)) {
+        /* A seek restarts the current item at a keyframe; the timeline carries on */
+        if (__atomic_load_n(&g_player_state.seek_serial, __ATOMIC_ACQUIRE) != seek_serial) {
+            seek_request_t req;
+            int64_t keyframe_us = 0;
+            
+            pthread_mutex_lock(&g_player_state.seek_lock);
+            req = g_player_state.seek;
+            seek_serial = g_player_state.seek_serial;
+            pthread_mutex_unlock(&g_player_state.seek_lock);
+            
+            /* Where the frame on screen is in this item; the demuxer may be well ahead of it */
+            timeline_segment_t shown = timeline_lookup(req.from_us);
+            int64_t position_us = shown.item == item_gen ? req.from_us - shown.pts_offset :
+                                  info.start_us;  /* Still showing the item before: from our start */
+            int64_t target_us = resolve_seek_target(input, &info, &req, position_us);
+            if (video_input_seek_to(input, target_us, req.mode, &keyframe_us) == VIDEO_INPUT_OK) {
+                LOG_INFO("Seek to %.3f s (keyframe at %.3f s)",
+                         (double)(target_us - info.start_us) / 1000000.0,
+                         (double)(keyframe_us - info.start_us) / 1000000.0);
+                seek_target = req.mode == VIDEO_SEEK_ACCURATE ? target_us : AV_NOPTS_VALUE;
+                discard_before = INT64_MIN;
+                rebase = 1;
+            }
+        }
+        
+        uint64_t read_start_us = monotonic_us();
+        ret = video_input_read_packet(input, &item.packet);
+        item.demux_us = monotonic_us();
         if (ret == VIDEO_INPUT_EOF) {
-            printf("End of file reached after %d packets\n", packet_count);
-            break;
+            LOG_INFO("End of file reached after %d packets", packet_count);
+            
+            int next_index = index + 1;
+            if (next_index >= g_player_state.playlist_count) {
+                if (!g_player_state.loop) {
+                    break;
+                }
+                next_index = 0;
+                loop_gen++;
+            }
+            
+            if (next_index == index) {
+                /* Single-file loop: rewind, decoder keeps running */
+                if (video_input_seek(input, 0) < 0) {
+                    break;
+                }
+            } else {
+                if (!next.input && preload_playlist_item(next_index, &info, &next) < 0) {
+                    break;
+                }
+                
+                /* Hand the old demuxer (and possibly a new decoder) to the decode thread */
+                memset(&item, 0, sizeof(item));
+                item.item_change = 1;
+                item.retire_input = input;
+                item.switch_decoder = next.decoder;
+                if (frame_queue_push(g_player_state.packet_queue, &item) != FRAME_QUEUE_OK) {
+                    /* Not handed over: cleanup still owns input, next is freed below */
+                    break;
+                }
+                
+                input = next.input;
+                if (info.extradata != g_player_state.stream_info.extradata) {
+                    free(info.extradata);
+                }
+                info = next.info;
+                memset(&next, 0, sizeof(next));
+                item_gen++;
+                __atomic_store_n(&g_player_state.input_ctx, input, __ATOMIC_RELEASE);
+                
+                /* Line up the item after this one */
+                int following = next_index + 1;
+                if (following >= g_player_state.playlist_count && g_player_state.loop) {
+                    following = 0;
+                }
+                if (following < g_player_state.playlist_count && following != next_index) {
+                    preload_playlist_item(following, &info, &next);
+                }
+            }
+            
+            LOG_INFO("Continuing with: %s", g_player_state.playlist[next_index]);
+            index = next_index;
+            packet_count = 0;
+            seek_target = AV_NOPTS_VALUE;
+            discard_before = INT64_MIN;
+            rebase = 1;
+            continue;
         } else if (ret < 0) {
-            fprintf(stderr, "Error reading packet: %d\n", ret);
+            LOG_ERROR("Error reading packet: %d", ret);
             break;
         }
         
+        /* The first packet of a new pass continues the timeline where the last ended */
+        int64_t ts = item.packet.pts != AV_NOPTS_VALUE ? item.packet.pts : item.packet.dts;
+        if (rebase && ts != AV_NOPTS_VALUE) {
+            pts_offset = timeline_end - ts;
+            timeline_start_segment(timeline_end, pts_offset, item_gen, index, loop_gen);
+            if (seek_target != AV_NOPTS_VALUE) {
+                discard_before = seek_target + pts_offset;
+                seek_target = AV_NOPTS_VALUE;
+            }
+            rebase = 0;
+        }
+        if (item.packet.pts != AV_NOPTS_VALUE) {
+            item.packet.pts += pts_offset;
+            if (item.packet.pts + frame_duration > timeline_end) {
+                timeline_end = item.packet.pts + frame_duration;
+            }
+        }
+        if (item.packet.dts != AV_NOPTS_VALUE) {
+            item.packet.dts += pts_offset;
+        }
+        
+        pipeline_stats_record_span(g_player_state.stats, STATS_STAGE_DEMUX,
+                                   read_start_us, item.demux_us);
+        
         packet_count++;
         if (packet_count <= 10) {
-            printf("Read packet %d: size=%d bytes, pts=%ld, keyframe=%d\n", 
-                   packet_count, packet.size, packet.pts, packet.keyframe);
+            LOG_DEBUG("Read packet %d: size=%d bytes, pts=%lld, keyframe=%d",
+                      packet_count, item.packet.size, (long long)item.packet.pts, item.packet.keyframe);
         }
         
-        /* 2. Submit packet to hardware decoder */
-        ret = hw_decoder_submit_packet(g_player_state.decoder_ctx, &packet);
-        if (ret < 0) {
-            if (ret == HW_DECODER_EAGAIN) {
-                /* Input queue is full, try to drain output queue first */
-                decoded_frame_t temp_frame;
-                int drain_ret = hw_decoder_get_frame(g_player_state.decoder_ctx, &temp_frame);
-                if (drain_ret == HW_DECODER_OK) {
-                    /* Process and render this frame */
-                    warp_control_process_input(g_player_state.warp_ctx);
-                    gpu_renderer_render_frame(g_player_state.renderer_ctx, &temp_frame);
-                    display_output_present_frame(g_player_state.display_ctx);
-                    hw_decoder_release_frame(g_player_state.decoder_ctx, &temp_frame);
-                    
-                    static int temp_frame_count = 0;
-                    temp_frame_count++;
-                    if (temp_frame_count <= 5) {
-                        printf("Temp frame %d: Processed during drain (%dx%d)\n", 
-                               temp_frame_count, temp_frame.width, temp_frame.height);
+        /* Blocks while the decoder is PACKET_QUEUE_DEPTH packets behind */
+        item.seek_serial = seek_serial;
+        item.discard_before_us = discard_before;
+        item.item_change = 0;
+        item.retire_input = NULL;
+        item.switch_decoder = NULL;
+        if (frame_queue_push(g_player_state.packet_queue, &item) != FRAME_QUEUE_OK) {
+            video_input_free_packet(&item.packet);
+            break;
+        }
+    }
+    
+    free_playlist_item(&next);
+    if (info.extradata != g_player_state.stream_info.extradata) {
+        free(info.extradata);
+    }
+    
+    /* Closing the queue is the end-of-stream signal for the decode thread */
+    frame_queue_close(g_player_state.packet_queue);
+    return NULL;
+}
+
+/* Decode thread state shared by its helpers */
+typedef struct {
+    int discontinuity;           /* Flag the next frame out (DISCONTINUITY_*) */
+    unsigned int seek_serial;    /* Seek request the decoder's packets belong to */
+    int64_t discard_before;      /* Accurate seek: release frames before this unseen */
+    struct {
+        int64_t pts;
+        uint64_t demux_us;
+    } stamps[DEMUX_STAMP_SLOTS]; /* Submitted packets, to time the decoder */
+    unsigned int next_stamp;
+} decode_state_t;
+
+/* Remember when a submitted packet was demuxed */
+static void remember_demux_time(decode_state_t *state, const queued_packet_t *item) {
+    if (item->packet.pts == AV_NOPTS_VALUE) {
+        return;
+    }
+    
+    unsigned int slot = state->next_stamp++ % DEMUX_STAMP_SLOTS;
+    state->stamps[slot].pts = item->packet.pts;
+    state->stamps[slot].demux_us = item->demux_us;
+}
+
+/* Demux time of the packet a frame came from (0 if unknown) */
+static uint64_t lookup_demux_time(decode_state_t *state, int64_t pts) {
+    for (int i = 0; i < DEMUX_STAMP_SLOTS; i++) {
+        if (state->stamps[i].demux_us && state->stamps[i].pts == pts) {
+            return state->stamps[i].demux_us;
+        }
+    }
+    return 0;
+}
+
+/* Decoder took no input and gave no output: sleep until a held frame is
+ * freed (its buffer rejoins the pool), a packet is queued (want_packet),
+ * or shutdown. Both V4L2 paths then have work: M2M blocks inside
+ * avcodec_receive_frame() for a submitted packet, request decodes in-line. */
+static void wait_for_decoder(hw_decoder_ctx_t *decoder, int want_packet) {
+    struct pollfd fds[3] = {
+        { .fd = hw_decoder_get_event_fd(decoder), .events = POLLIN },
+        { .fd = g_player_state.stop_fd, .events = POLLIN },
+        { .fd = want_packet ? frame_queue_get_fd(g_player_state.packet_queue) : -1,
+          .events = POLLIN },
+    };
+    
+    /* Negative fds are ignored; hw_decoder_get_frame() and the pop clear their events */
+    poll(fds, 3, fds[0].fd >= 0 ? DECODE_IDLE_MS : DECODER_RETRY_MS);
+}
+
+/* Push every frame the decoder has ready; HW_DECODER_EOF once fully drained */
+static int forward_decoded_frames(hw_decoder_ctx_t *decoder, decode_state_t *state) {
+    decoded_frame_t frame;
+    int ret;
+    
+    while ((ret = hw_decoder_get_frame(decoder, &frame)) == HW_DECODER_OK) {
+        /* Decoded from the keyframe only to reach the seek target (output is in pts order) */
+        if (frame.timestamp_us < state->discard_before) {
+            hw_decoder_release_frame(decoder, &frame);
+            continue;
+        }
+        state->discard_before = INT64_MIN;
+        
+        frame.discontinuity = state->discontinuity;
+        frame.seek_serial = state->seek_serial;
+        state->discontinuity = 0;
+        
+        frame.decoded_us = monotonic_us();
+        frame.demux_us = lookup_demux_time(state, frame.timestamp_us);
+        pipeline_stats_record_span(g_player_state.stats, STATS_STAGE_DECODE,
+                                   frame.demux_us, frame.decoded_us);
+        
+        /* Blocks while queue_depth frames wait for display */
+        if (frame_queue_push(g_player_state.frame_queue, &frame) != FRAME_QUEUE_OK) {
+            hw_decoder_release_frame(decoder, &frame);
+            return HW_DECODER_ERROR;
+        }
+    }
+    
+    if (ret != HW_DECODER_EAGAIN && ret != HW_DECODER_EOF) {
+        LOG_ERROR("Error getting decoded frame: %d", ret);
+        return HW_DECODER_EAGAIN;
+    }
+    return ret;
+}
+
+/* Playlist item change on the decode side */
+static int handle_item_change(hw_decoder_ctx_t **decoder, queued_packet_t *item,
+                              decode_state_t *state) {
+    if (item->switch_decoder) {
+        /* Stream differs: drain the old decoder so its last frames are still shown */
+        frame_packet_t eos = {0};
+        hw_decoder_submit_packet(*decoder, &eos);
+        
+        int ret;
+        while ((ret = forward_decoded_frames(*decoder, state)) == HW_DECODER_EAGAIN) {
+            if (__atomic_load_n(&g_player_state.stopping, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            wait_for_decoder(*decoder, 0);
+        }
+        
+        /* Outstanding frames keep their buffers referenced past the destroy */
+        hw_decoder_ctx_t *old = *decoder;
+        *decoder = item->switch_decoder;
+        item->switch_decoder = NULL;
+        __atomic_store_n(&g_player_state.decoder_ctx, *decoder, __ATOMIC_RELEASE);
+        hw_decoder_destroy(old);
+        
+        /* The new decoder's first frame re-anchors the presentation clock */
+        state->discontinuity = DISCONTINUITY_DECODER;
+        if (ret == HW_DECODER_ERROR) {
+            return ret;
+        }
+    }
+    
+    /* Every packet of the retired input has been submitted and freed */
+    if (item->retire_input) {
+        video_input_destroy(item->retire_input);
+        item->retire_input = NULL;
+    }
+    
+    return HW_DECODER_OK;
+}
+
+/* Before submitting a packet: drop it if a newer seek is pending, flush the
+ * decoder if it is the first of a completed one. Returns 1 to submit. */
+static int prepare_packet(hw_decoder_ctx_t *decoder, const queued_packet_t *item,
+                          decode_state_t *state) {
+    if (item->seek_serial != __atomic_load_n(&g_player_state.seek_serial, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    
+    if (item->seek_serial != state->seek_serial) {
+        /* Frames still inside the decoder belong to the old position */
+        hw_decoder_flush(decoder);
+        state->seek_serial = item->seek_serial;
+        state->discard_before = item->discard_before_us;
+        if (state->discontinuity < DISCONTINUITY_SEEK) {
+            state->discontinuity = DISCONTINUITY_SEEK;
+        }
+    }
+    
+    return 1;
+}
+
+/* Decode thread: feed packets to the decoder and queue its frames for rendering */
+static void *decode_thread_main(void *arg) {
+    hw_decoder_ctx_t *decoder = g_player_state.decoder_ctx;
+    queued_packet_t item = {0};
+    int have_packet = 0;
+    int eos_sent = 0;
+    decode_state_t state;
+    int ret;
+    
+    memset(&state, 0, sizeof(state));
+    state.discard_before = INT64_MIN;
+    
+    (void)arg;
+    
+    while (!__atomic_load_n(&g_player_state.stopping, __ATOMIC_ACQUIRE)) {
+        /* 1. Hand every frame the decoder has ready to the render thread */
+        ret = forward_decoded_frames(decoder, &state);
+        if (ret == HW_DECODER_ERROR) {
+            break;
+        } else if (ret == HW_DECODER_EOF) {
+            LOG_INFO("Decoder drained");
+            break;
+        }
+        
+        /* 2. Fetch the next packet unless one is still waiting for decoder space */
+        if (!have_packet && !eos_sent) {
+            ret = frame_queue_pop(g_player_state.packet_queue, &item, 0);
+            if (ret == FRAME_QUEUE_EAGAIN) {
+                /* Nothing queued: sleep until a packet arrives or a frame is freed */
+                wait_for_decoder(decoder, 1);
+            } else if (ret == FRAME_QUEUE_OK) {
+                if (item.item_change) {
+                    if (handle_item_change(&decoder, &item, &state) < 0) {
+                        break;
                     }
+                } else {
+                    have_packet = 1;
                 }
-                /* Don't free packet yet - we'll retry submission next iteration */
-                usleep(1000);  /* Small delay to prevent busy loop */
+            } else if (ret == FRAME_QUEUE_CLOSED) {
+                /* Demuxer finished: an empty packet puts the decoder into drain mode */
+                frame_packet_t eos = {0};
+                hw_decoder_submit_packet(decoder, &eos);
+                eos_sent = 1;
+            }
+            continue;
+        }
+        
+        /* 3. Submit it */
+        if (have_packet && !prepare_packet(decoder, &item, &state)) {
+            video_input_free_packet(&item.packet);  /* Read before the latest seek */
+            have_packet = 0;
+        } else if (have_packet) {
+            ret = hw_decoder_submit_packet(decoder, &item.packet);
+            if (ret == HW_DECODER_EAGAIN) {
+                /* Decoder input full: wait for it to produce output */
+                wait_for_decoder(decoder, 0);
                 continue;
+            } else if (ret < 0) {
+                LOG_ERROR("Error submitting packet to decoder: %d", ret);
             } else {
-                fprintf(stderr, "Error submitting packet to decoder: %d\n", ret);
-                video_input_free_packet(&packet);
-                continue;
+                remember_demux_time(&state, &item);
             }
+            video_input_free_packet(&item.packet);
+            have_packet = 0;
+        } else {
+            /* Draining after end of stream */
+            wait_for_decoder(decoder, 0);
         }
+    }
+    
+    if (have_packet) {
+        video_input_free_packet(&item.packet);
+    }
+    
+    /* No more frames for the renderer; unblock the demuxer if it is still running */
+    frame_queue_close(g_player_state.frame_queue);
+    frame_queue_close(g_player_state.packet_queue);
+    return NULL;
+}
+
+/* Stop worker threads and release anything still queued (a no-op once stopped) */
+static void stop_pipeline_threads(void) {
+    queued_packet_t item;
+    decoded_frame_t frame;
+    
+    /* Playback end, the fallback and cleanup all call this; the first does the work */
+    if (!g_player_state.packet_queue && !g_player_state.frame_queue &&
+        !g_player_state.demux_started && !g_player_state.decode_started) {
+        return;
+    }
+    
+    __atomic_store_n(&g_player_state.stopping, 1, __ATOMIC_RELEASE);
+    request_stop();
+    frame_queue_close(g_player_state.packet_queue);
+    frame_queue_close(g_player_state.frame_queue);
+    
+    if (g_player_state.demux_started) {
+        pthread_join(g_player_state.demux_thread, NULL);
+        g_player_state.demux_started = 0;
+    }
+    if (g_player_state.decode_started) {
+        pthread_join(g_player_state.decode_thread, NULL);
+        g_player_state.decode_started = 0;
+    }
+    
+    /* Only the workers were stopped: re-arm stop_fd, which the fallback loop also polls.
+     * A signal sets running before it writes, so one that raced the read is kept. */
+    uint64_t stops;
+    if (read(g_player_state.stop_fd, &stops, sizeof(stops)) < 0) {
+        /* Already clear */
+    }
+    if (!g_player_state.running) {
+        request_stop();
+    }
+    
+    /* Closed queues still drain */
+    while (frame_queue_pop(g_player_state.frame_queue, &frame, 0) == FRAME_QUEUE_OK) {
+        hw_decoder_release_frame(g_player_state.decoder_ctx, &frame);
+    }
+    /* In FIFO order, so a retired input outlives the packets queued ahead of its marker */
+    while (frame_queue_pop(g_player_state.packet_queue, &item, 0) == FRAME_QUEUE_OK) {
+        if (item.item_change) {
+            if (item.switch_decoder) {
+                hw_decoder_destroy(item.switch_decoder);
+            }
+            if (item.retire_input) {
+                video_input_destroy(item.retire_input);
+            }
+        } else {
+            video_input_free_packet(&item.packet);
+        }
+    }
+    
+    frame_queue_destroy(g_player_state.frame_queue);
+    frame_queue_destroy(g_player_state.packet_queue);
+    g_player_state.frame_queue = NULL;
+    g_player_state.packet_queue = NULL;
+}
+
+/* Create the queues and start the demux and decode threads */
+static int start_pipeline_threads(void) {
+    g_player_state.stopping = 0;
+    
+    g_player_state.packet_queue = frame_queue_create(sizeof(queued_packet_t), PACKET_QUEUE_DEPTH);
+    g_player_state.frame_queue = frame_queue_create(sizeof(decoded_frame_t),
+                                                    g_player_state.queue_depth);
+    if (!g_player_state.packet_queue || !g_player_state.frame_queue) {
+        fprintf(stderr, "Failed to create pipeline queues\n");
+        return -1;
+    }
+    
+    if (pthread_create(&g_player_state.demux_thread, NULL, demux_thread_main, NULL) != 0) {
+        fprintf(stderr, "Failed to start demux thread\n");
+        return -1;
+    }
+    g_player_state.demux_started = 1;
+    
+    if (pthread_create(&g_player_state.decode_thread, NULL, decode_thread_main, NULL) != 0) {
+        fprintf(stderr, "Failed to start decode thread\n");
+        return -1;
+    }
+    g_player_state.decode_started = 1;
+    
+    return 0;
+}
+
+/*
+ * Block in one poll() until something needs the render thread: a queued
+ * frame (WAIT_FRAME), the awaited flip/vblank (WAIT_VBLANK, dispatched here
+ * and stamped into vblank_us), a control action (WAIT_INPUT) or the stop fd.
+ * Returns the sources that fired, 0 on timeout/stop, negative on error.
+ */
+static int wait_for_events(int want, int timeout_ms, uint64_t *vblank_us) {
+    struct pollfd fds[4];
+    int frame_slot = -1, drm_slot = -1, input_slot = -1;
+    int n = 0;
+    int fired = 0;
+    
+    if (want & WAIT_FRAME) {
+        frame_slot = n;
+        fds[n++] = (struct pollfd){ .fd = frame_queue_get_fd(g_player_state.frame_queue),
+                                    .events = POLLIN };
+    }
+    if (want & WAIT_VBLANK) {
+        drm_slot = n;
+        fds[n++] = (struct pollfd){ .fd = display_output_get_event_fd(g_player_state.display_ctx),
+                                    .events = POLLIN };
+    }
+    /* Readable until control_input_take() clears it */
+    if ((want & WAIT_INPUT) && g_player_state.control_input) {
+        input_slot = n;
+        fds[n++] = (struct pollfd){ .fd = control_input_get_fd(g_player_state.control_input),
+                                    .events = POLLIN };
+    }
+    fds[n++] = (struct pollfd){ .fd = g_player_state.stop_fd, .events = POLLIN };
+    
+    if (poll(fds, (nfds_t)n, timeout_ms) < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    
+    if (drm_slot >= 0 && (fds[drm_slot].revents & POLLIN)) {
+        int ret = display_output_dispatch_events(g_player_state.display_ctx, vblank_us);
+        if (ret == DISPLAY_OUTPUT_OK) {
+            fired |= WAIT_VBLANK;
+        } else if (ret != DISPLAY_OUTPUT_EAGAIN) {
+            return -1;
+        }
+    }
+    if (frame_slot >= 0 && (fds[frame_slot].revents & POLLIN)) {
+        fired |= WAIT_FRAME;
+    }
+    if (input_slot >= 0 && (fds[input_slot].revents & POLLIN)) {
+        fired |= WAIT_INPUT;
+    }
+    
+    return fired;
+}
+
+/* Wait for the pending flip (or, when holding, the next vblank) to land */
+static int wait_for_vblank(uint64_t *vblank_us) {
+    uint64_t deadline_us = monotonic_us() + VBLANK_TIMEOUT_MS * 1000ULL;
+    
+    if (display_output_begin_vblank_wait(g_player_state.display_ctx) < 0) {
+        /* No DRM events (GBM-only/offscreen): paced sleep */
+        return display_output_wait_vblank(g_player_state.display_ctx, vblank_us);
+    }
+    
+    while (g_player_state.running) {
+        int fired = wait_for_events(WAIT_VBLANK, VBLANK_TIMEOUT_MS, vblank_us);
+        if (fired < 0) {
+            return -1;
+        }
+        if (fired & WAIT_VBLANK) {
+            return 0;
+        }
+        if (monotonic_us() > deadline_us) {
+            /* The event is lost: the next wait must request a new one */
+            display_output_cancel_vblank_wait(g_player_state.display_ctx);
+            LOG_ERROR("Timed out waiting for vblank");
+            return -1;
+        }
+    }
+    
+    return 0;  /* Stopping: cleanup lets any flip still in flight land */
+}
+
+/* Master state between published samples */
+typedef struct {
+    int started;
+    unsigned int epoch;       /* Bumped whenever the shown frame's timeline segment changes */
+    int64_t segment_start_us; /* Segment of the last sample */
+} wall_master_t;
+
+/* Video wall master: publish the media position of the frame that just went up */
+static void publish_wall_clock(wall_master_t *master, int64_t shown_us, uint64_t vblank_us) {
+    timeline_segment_t segment = timeline_lookup(shown_us);
+    
+    /* Seeks, loops and item changes each start a segment: followers realign on them */
+    if (master->started && segment.start_us != master->segment_start_us) {
+        master->epoch++;
+    }
+    master->started = 1;
+    master->segment_start_us = segment.start_us;
+    
+    wall_sync_clock_t clock = {
+        .epoch = master->epoch,
+        .item_index = segment.index,
+        .loop = (unsigned int)segment.loop,
+        .pts_us = shown_us - segment.pts_offset,
+        .vblank_us = vblank_us,
+    };
+    wall_sync_publish(g_player_state.wall_sync, &clock);
+}
+
+/* Follower state between wall clock samples */
+typedef struct {
+    int aligned;              /* Seek alignment done for this epoch / seek serial */
+    unsigned int epoch;       /* Master position generation aligned to */
+    unsigned int seek_serial; /* Our own seek serial at alignment */
+    int other_item;           /* Master item reported as not ours (-1 = none) */
+    unsigned int samples;
+} wall_follow_t;
+
+/* Video wall follower: seek onto the master once per position change, then
+ * slew the scheduler onto its clock. Positions are compared as media time
+ * (our own output timeline is unrelated to the master's); the master's is
+ * mapped onto ours through the shown frame's segment for the slew.
+ * Returns 1 if a seek was requested. */
+static int follow_wall_clock(wall_follow_t *follow, int64_t shown_us, unsigned int shown_serial) {
+    wall_sync_clock_t clock;
+    
+    if (wall_sync_get_clock(g_player_state.wall_sync, &clock) != WALL_SYNC_OK) {
+        return 0;
+    }
+    
+    /* Our own seek still in flight: the frame on screen is from before it */
+    unsigned int serial = __atomic_load_n(&g_player_state.seek_serial, __ATOMIC_ACQUIRE);
+    if (shown_serial != serial) {
+        return 0;
+    }
+    
+    /* A seek stays inside the item, so another one has to be played into */
+    timeline_segment_t segment = timeline_lookup(shown_us);
+    if (clock.item_index != segment.index) {
+        if (follow->other_item != clock.item_index) {
+            LOG_INFO("Wall sync: master on item %d (loop %u), this node on %d - not following yet",
+                     clock.item_index, clock.loop, segment.index);
+            follow->other_item = clock.item_index;
+        }
+        follow->aligned = 0;
+        return 0;
+    }
+    follow->other_item = -1;
+    
+    /* Where the master is now and where we are, in media time (both clocks run at 1x) */
+    int64_t master_now_us = clock.pts_us + ((int64_t)monotonic_us() - (int64_t)clock.vblank_us);
+    int64_t media_us = shown_us - segment.pts_offset;
+    
+    if (!follow->aligned || clock.epoch != follow->epoch || serial != follow->seek_serial) {
+        int seeking = 0;
         
-        /* 3. Try to get decoded frame (be more patient for initial frames) */
-        int max_attempts = (packet_count <= 10) ? 20 : 5;  /* More patience for first few packets */
-        int attempts = 0;
-        
-        do {
-            ret = hw_decoder_get_frame(g_player_state.decoder_ctx, &frame);
-            if (ret == HW_DECODER_OK) {
-                break;  /* Got a frame! */
-            } else if (ret != HW_DECODER_EAGAIN) {
-                fprintf(stderr, "Error getting decoded frame: %d\n", ret);
+        if (llabs(master_now_us - media_us) > SYNC_SEEK_US) {
+            /* Land a little ahead and let the scheduler hold the first frame until the master gets there */
+            LOG_INFO("Wall sync: %+.3f s from master, seeking", (double)(media_us - master_now_us) / 1e6);
+            request_seek(shown_us, master_now_us + SYNC_SEEK_LEAD_US - media_us, 0, VIDEO_SEEK_ACCURATE);
+            seeking = 1;
+        }
+        follow->aligned = 1;
+        follow->epoch = clock.epoch;
+        follow->seek_serial = __atomic_load_n(&g_player_state.seek_serial, __ATOMIC_ACQUIRE);
+        return seeking;
+    }
+    
+    /* The master's frame on our output timeline; far from ours only around a wrap */
+    int64_t local_pts_us = clock.pts_us + segment.pts_offset;
+    if (llabs(local_pts_us - shown_us) > SYNC_SLEW_RANGE_US) {
+        return 0;
+    }
+    
+    int64_t error_us = frame_scheduler_slew(g_player_state.scheduler, local_pts_us, clock.vblank_us);
+    if (++follow->samples % 50 == 0) {
+        LOG_DEBUG("Wall sync: %+lld us from master", (long long)error_us);
+    }
+    return 0;
+}
+
+/* Main playback loop: this thread owns the EGL context and renders/presents */
+static int run_playback_loop(void) {
+    int ret = 0;
+    decoded_frame_t frame = {0};
+    int have_frame = 0;
+    int frame_count = 0;
+    int first_frame_shown = 0;
+    uint64_t last_vblank_us = 0;
+    int64_t shown_us = 0;         /* Timestamp of the frame on screen */
+    unsigned int shown_serial = 0;  /* Seek request it was decoded for */
+    
+    /* Timestamps of the frame whose flip is pending, for latency stats */
+    int timing_pending = 0;
+    int timing_gl = 0;
+    uint64_t timing_demux_us = 0, timing_submit_us = 0;
+    
+    wall_master_t wall_master = {0};
+    wall_follow_t wall_follow = { .other_item = -1 };
+    
+    printf("Starting playback loop...\n");
+    frame_scheduler_reset(g_player_state.scheduler);
+    
+    while (g_player_state.running) {
+        /* 1. Take the next decoded frame if one is queued (a held early frame is kept) */
+        if (!have_frame) {
+            ret = frame_queue_pop(g_player_state.frame_queue, &frame, 0);
+            if (ret == FRAME_QUEUE_CLOSED) {
+                LOG_INFO("Playback finished after %d frames", frame_count);
                 break;
             }
-            
-            /* Decoder not ready yet, give it time especially for initial frames */
-            attempts++;
-            if (attempts < max_attempts) {
-                usleep(packet_count <= 5 ? 20000 : 5000);  /* 20ms for first 5 packets, then 5ms */
+            if (ret == FRAME_QUEUE_OK &&
+                frame.seek_serial != __atomic_load_n(&g_player_state.seek_serial, __ATOMIC_ACQUIRE)) {
+                /* Decoded before the latest seek */
+                hw_decoder_release_frame(g_player_state.decoder_ctx, &frame);
+                continue;
+            }
+            if (ret == FRAME_QUEUE_OK) {
+                have_frame = 1;
+                
+                /* New position: new clock; new stream from a different decoder: new buffer pool too */
+                if (frame.discontinuity) {
+                    frame_scheduler_reset(g_player_state.scheduler);
+                }
+                if (frame.discontinuity == DISCONTINUITY_DECODER) {
+                    gpu_renderer_flush_texture_cache(g_player_state.renderer_ctx);
+                }
+                
+                /* First 10 frames, then every 60th */
+                frame_count++;
+                if (frame_count <= 10 || frame_count % 60 == 0) {
+                    LOG_DEBUG("✓ Got frame %d: %dx%d, format=0x%x, dmabuf_fd=%d, pts=%lld",
+                              frame_count, frame.width, frame.height, frame.format, frame.dmabuf_fd[0],
+                              (long long)frame.timestamp_us);
+                }
             }
-        } while (attempts < max_attempts && ret == HW_DECODER_EAGAIN);
+        }
         
-        if (ret < 0) {
-            if (packet_count <= 30) {
-                printf("Decoder not ready after %d attempts for packet %d\n", 
-                       attempts, packet_count);
+        /* 2. Player actions from the input thread (already parsed and coalesced) */
+        control_input_actions_t actions;
+        control_input_take(g_player_state.control_input, &actions);
+        if (actions.quit) {
+            printf("Quit requested by user\n");
+            g_player_state.running = 0;
+            break;
+        }
+        
+        /* Seek keys: the held frame is already stale */
+        if (actions.seek_steps || actions.chapter_steps) {
+            request_seek(shown_us, (int64_t)actions.seek_steps * SEEK_STEP_US, actions.chapter_steps,
+                         actions.chapter_steps ? VIDEO_SEEK_ACCURATE : VIDEO_SEEK_KEYFRAME);
+            shown_us += (int64_t)actions.seek_steps * SEEK_STEP_US;  /* Repeated presses add up */
+            if (have_frame) {
+                hw_decoder_release_frame(g_player_state.decoder_ctx, &frame);
+                have_frame = 0;
             }
-            video_input_free_packet(&packet);
             continue;
         }
         
-        /* Debug: Show that we got a frame */
-        static int frame_count = 0;
-        frame_count++;
-        if (frame_count <= 10 || frame_count % 60 == 0) {  /* Print first 10 frames and every 60 frames */
-            printf("✓ Got frame %d: %dx%d, format=0x%x, dmabuf_fd=%d\n", 
-                   frame_count, frame.width, frame.height, frame.format, frame.dmabuf_fd[0]);
+        if (!have_frame) {
+            /* Decoder stall or pause - the last frame stays on screen, the thread sleeps */
+            if (wait_for_events(WAIT_FRAME | WAIT_INPUT, RENDER_IDLE_MS, NULL) < 0) {
+                LOG_ERROR("Render thread poll failed: %s", strerror(errno));
+                break;
+            }
+            continue;
         }
         
-        /* 4. Process warp control input (non-blocking) */
+        /* 3. Pick up the latest published warp (non-blocking) */
         warp_control_process_input(g_player_state.warp_ctx);
         
-        /* 5. Check for quit key (q or Q) */
-        char key = check_keyboard();
-        if (key == 'q' || key == 'Q' || key == 27) { /* 27 = ESC */
-            printf("Quit requested by user\n");
-            g_player_state.running = 0;
-            break;
+        /* 4. Show, hold or drop this frame for the coming vblank */
+        uint64_t next_vblank_us = frame_scheduler_next_vblank(g_player_state.scheduler,
+                                                              last_vblank_us, monotonic_us());
+        schedule_action_t action = frame_scheduler_decide(g_player_state.scheduler,
+                                                          frame.timestamp_us, next_vblank_us);
+        
+        if (action == SCHEDULE_DROP) {
+            pipeline_stats_count(g_player_state.stats, STATS_COUNTER_DROPPED, 1);
+            hw_decoder_release_frame(g_player_state.decoder_ctx, &frame);
+            have_frame = 0;
+            continue;  /* The next frame may still make this vblank */
         }
         
-        /* 6. Render frame with current warp parameters */
-        ret = gpu_renderer_render_frame(g_player_state.renderer_ctx, &frame);
-        if (ret < 0) {
-            fprintf(stderr, "Error rendering frame: %d\n", ret);
-        } else if (frame_count <= 5) {
-            printf("Frame %d: Rendered successfully (%dx%d)\n", frame_count, frame.width, frame.height);
+        if (action == SCHEDULE_SHOW) {
+            /* 5. Render with current warp parameters (or scan out directly) and present */
+            uint64_t submit_us = monotonic_us();
+            pipeline_stats_record_span(g_player_state.stats, STATS_STAGE_QUEUE,
+                                       frame.decoded_us, submit_us);
+            
+            ret = present_decoded_frame(&frame);
+            if (ret == 0) {
+                shown_us = frame.timestamp_us;
+                shown_serial = frame.seek_serial;
+                pipeline_stats_count(g_player_state.stats, STATS_COUNTER_FRAMES, 1);
+                timing_pending = 1;
+                timing_gl = !g_player_state.plane_path;
+                timing_demux_us = frame.demux_us;
+                timing_submit_us = submit_us;
+            }
+            if (ret == 0 && !first_frame_shown) {
+                LOG_INFO("✓ First frame presented %.1f ms after start",
+                         (double)(monotonic_us() - g_player_state.start_us) / 1000.0);
+                first_frame_shown = 1;
+            }
+            if (ret == 0 && frame_count <= 5) {
+                LOG_DEBUG("Frame %d: Presented to display (%dx%d, %s)", frame_count,
+                          frame.width, frame.height, g_player_state.plane_path ? "plane" : "GL");
+            }
+            
+            /* Clean up frame resources */
+            hw_decoder_release_frame(g_player_state.decoder_ctx, &frame);
+            have_frame = 0;
+        } else {
+            pipeline_stats_count(g_player_state.stats, STATS_COUNTER_REPEATED, 1);
         }
         
-        /* 7. Present to display */
-        ret = display_output_present_frame(g_player_state.display_ctx);
-        if (ret < 0) {
-            fprintf(stderr, "Error presenting frame: %d\n", ret);
-        } else if (frame_count <= 5) {
-            printf("Frame %d: Presented to display\n", frame_count);
+        /* Block until the flip (or, when holding, the next vblank) lands */
+        if (wait_for_vblank(&last_vblank_us) < 0) {
+            LOG_WARN("Vblank wait failed - pacing may slip");
+        }
+        if (!g_player_state.running) {
+            break;
         }
         
-        /* Clean up frame resources */
-        hw_decoder_release_frame(g_player_state.decoder_ctx, &frame);
-        video_input_free_packet(&packet);
+        /* The flip has completed: close out the shown frame's timeline */
+        if (timing_pending) {
+            uint64_t gpu_done_us = 0;
+            
+            if (timing_gl &&
+                display_output_get_render_done(g_player_state.display_ctx, &gpu_done_us) == 0) {
+                pipeline_stats_record_span(g_player_state.stats, STATS_STAGE_GPU,
+                                           timing_submit_us, gpu_done_us);
+                pipeline_stats_record_span(g_player_state.stats, STATS_STAGE_SCANOUT,
+                                           gpu_done_us, last_vblank_us);
+            } else if (!timing_gl) {
+                /* Direct scanout: no GPU work between submit and the flip */
+                pipeline_stats_record_span(g_player_state.stats, STATS_STAGE_SCANOUT,
+                                           timing_submit_us, last_vblank_us);
+            }
+            pipeline_stats_record_span(g_player_state.stats, STATS_STAGE_TOTAL,
+                                       timing_demux_us, last_vblank_us);
+            timing_pending = 0;
+            
+            /* Video wall master: this frame went up on this vblank */
+            if (g_player_state.wall_sync && g_player_state.sync_role == WALL_SYNC_MASTER) {
+                publish_wall_clock(&wall_master, shown_us, last_vblank_us);
+            }
+        }
         
-        /* Basic frame rate control (will be improved with proper timing) */
-        usleep(16667); // ~60 FPS
+        /* Video wall follower: steer onto the master's clock (a seek makes the held frame stale) */
+        if (g_player_state.wall_sync && g_player_state.sync_role == WALL_SYNC_FOLLOWER &&
+            first_frame_shown && follow_wall_clock(&wall_follow, shown_us, shown_serial) &&
+            have_frame) {
+            hw_decoder_release_frame(g_player_state.decoder_ctx, &frame);
+            have_frame = 0;
+        }
+    }
+    
+    if (have_frame) {
+        hw_decoder_release_frame(g_player_state.decoder_ctx, &frame);
     }
     
+    stop_pipeline_threads();
+    return 0;
+}
+
+/* Bring a renderer and the warp up on the display the failed init left behind */
+static int prepare_fallback_output(void) {
+    display_info_t info;
+    
+    release_decode_pipeline();
+    
+    if (!g_player_state.display_ready) {
+        return -1;
+    }
+    
+    /* Init may have stopped half way through either; start both afresh */
+    if (g_player_state.warp_ctx) {
+        warp_control_destroy(g_player_state.warp_ctx);
+        g_player_state.warp_ctx = NULL;
+    }
+    if (g_player_state.renderer_ctx) {
+        gpu_renderer_destroy(g_player_state.renderer_ctx);
+        g_player_state.renderer_ctx = NULL;
+    }
+    
+    memset(&info, 0, sizeof(info));
+    display_output_get_info(g_player_state.display_ctx, &info);
+    g_player_state.renderer_ctx = gpu_renderer_create();
+    if (!g_player_state.renderer_ctx ||
+        gpu_renderer_configure(g_player_state.renderer_ctx, g_player_state.display_ctx,
+                               info.width, info.height) < 0) {
+        fprintf(stderr, "Failed to configure GPU renderer for the fallback\n");
+        return -1;
+    }
+    
+    /* Same warp, heads and crop as the hardware path would have used */
+    g_player_state.warp_ctx = warp_control_create();
+    if (!g_player_state.warp_ctx) {
+        return -1;
+    }
+    if (warp_control_load_config(g_player_state.warp_ctx, WARP_CONFIG_FILE) < 0) {
+        printf("No warp config found, using defaults\n");
+    }
+    if (warp_control_configure(g_player_state.warp_ctx, g_player_state.renderer_ctx) < 0) {
+        fprintf(stderr, "Failed to configure warp control for the fallback\n");
+        return -1;
+    }
+    configure_heads();
+    
     return 0;
 }
 
@@ -426,12 +1985,32 @@ static int try_fallback_playback(const char *video_file) {
     fallback_ctx_t *fallback_ctx = fallback_create();
     if (!fallback_ctx) {
         fprintf(stderr, "Failed to create fallback context\n");
+        cleanup_pipeline();
         return -1;
     }
     
+    /* Keep our display: mpv renders into it and the warp still applies */
+    if (prepare_fallback_output() == 0) {
+        fallback_output_t output = {
+            .display = g_player_state.display_ctx,
+            .renderer = g_player_state.renderer_ctx,
+            .warp = g_player_state.warp_ctx,
+        };
+        fallback_set_output(fallback_ctx, &output);
+    } else {
+        /* mpv opens its own output and needs the DRM device we hold */
+        printf("⚠ Display pipeline unavailable - mpv uses its own video output\n");
+        cleanup_pipeline();
+    }
+    
+    /* Ctrl+C and SIGTERM end fallback playback through the same eventfd */
+    fallback_set_stop_fd(fallback_ctx, g_player_state.stop_fd);
+    
     int ret = fallback_play_file(fallback_ctx, video_file);
     
+    /* The render context goes before the EGL context it draws with */
     fallback_destroy(fallback_ctx);
+    cleanup_pipeline();
     
     if (ret < 0) {
         fprintf(stderr, "Fallback playback also failed\n");
@@ -444,19 +2023,89 @@ static int try_fallback_playback(const char *video_file) {
 int main(int argc, char *argv[]) {
     int ret = 0;
     
+    g_player_state.start_us = monotonic_us();
+    g_player_state.stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_player_state.stop_fd < 0) {
+        fprintf(stderr, "Failed to create stop eventfd: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    
     /* Parse command line arguments */
-    if (argc != 2) {
+    int first_file = 1;
+    for (; first_file < argc && strncmp(argv[first_file], "--", 2) == 0; first_file++) {
+        if (strcmp(argv[first_file], "--loop") == 0) {
+            g_player_state.loop = 1;
+        } else if (strcmp(argv[first_file], "--mmap") == 0) {
+            g_player_state.mmap_input = 1;
+        } else if (strcmp(argv[first_file], "--self-test") == 0) {
+            g_player_state.self_test = 1;
+        } else if (strcmp(argv[first_file], "--stats") == 0 && first_file + 1 < argc) {
+            g_player_state.stats_path = argv[++first_file];
+        } else if (strcmp(argv[first_file], "--mode") == 0 && first_file + 1 < argc) {
+            if (parse_mode(argv[++first_file]) < 0) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[first_file], "--heads") == 0 && first_file + 1 < argc) {
+            if (parse_head_layout(argv[++first_file]) < 0) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[first_file], "--sync") == 0 && first_file + 1 < argc) {
+            if (parse_sync_role(argv[++first_file]) < 0) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[first_file], "--sync-group") == 0 && first_file + 1 < argc) {
+            if (parse_sync_group(argv[++first_file]) < 0) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[first_file], "--crop") == 0 && first_file + 1 < argc) {
+            if (parse_crop(argv[++first_file]) < 0) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[first_file], "--control-port") == 0 && first_file + 1 < argc) {
+            g_player_state.control_port = atoi(argv[++first_file]);
+            if (g_player_state.control_port < 1 || g_player_state.control_port > 65535) {
+                fprintf(stderr, "Invalid control port '%s'\n", argv[first_file]);
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[first_file], "--no-evdev") == 0) {
+            g_player_state.use_evdev = 0;
+        } else if (strcmp(argv[first_file], "--grab-evdev") == 0) {
+            g_player_state.grab_evdev = 1;
+        } else if (strcmp(argv[first_file], "--queue-depth") == 0 && first_file + 1 < argc) {
+            g_player_state.queue_depth = atoi(argv[++first_file]);
+            if (g_player_state.queue_depth < 1 || g_player_state.queue_depth > FRAME_QUEUE_MAX) {
+                fprintf(stderr, "Invalid queue depth '%s'\n", argv[first_file]);
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    if (first_file >= argc) {
         print_usage(argv[0]);
         return EXIT_FAILURE;
     }
     
-    const char *video_file = argv[1];
+    g_player_state.playlist = (const char **)&argv[first_file];
+    g_player_state.playlist_count = argc - first_file;
+    const char *video_file = g_player_state.playlist[0];
     
-    /* Check if file exists */
-    if (access(video_file, R_OK) != 0) {
-        fprintf(stderr, "Error: Cannot read file '%s': %s\n", 
-                video_file, strerror(errno));
-        return EXIT_FAILURE;
+    /* Check if files exist */
+    for (int i = 0; i < g_player_state.playlist_count; i++) {
+        if (access(g_player_state.playlist[i], R_OK) != 0) {
+            fprintf(stderr, "Error: Cannot read file '%s': %s\n", 
+                    g_player_state.playlist[i], strerror(errno));
+            return EXIT_FAILURE;
+        }
     }
     
     /* Set up signal handlers for clean shutdown */
@@ -471,13 +2120,17 @@ int main(int argc, char *argv[]) {
     
     printf("Pickle starting with file: %s\n", video_file);
     
+    /* Per-frame logging goes through a ring so it never stalls playback */
+    pickle_log_start();
+    
     /* Initialize the complete pipeline */
     ret = init_pipeline(video_file);
     if (ret < 0) {
         fprintf(stderr, "Pipeline initialization failed, trying fallback...\n");
-        cleanup_pipeline();
+        ret = try_fallback_playback(video_file);
+        pickle_log_stop();
         restore_terminal();
-        return try_fallback_playback(video_file);
+        return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
     }
     
     /* Run the main playback loop */
@@ -485,6 +2138,7 @@ int main(int argc, char *argv[]) {
     
     /* Clean shutdown */
     cleanup_pipeline();
+    pickle_log_stop();
     restore_terminal();
     
     if (ret < 0) {
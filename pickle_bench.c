@@ -0,0 +1,452 @@
+/*
+ * Pickle Bench - Headless Decode/Render Throughput and Latency Suite
+ *
+ * Drives video_input -> hw_decoder -> gpu_renderer into an offscreen GBM
+ * surface (render node, no scanout, no vsync), twice per clip:
+ * - Decode pass: demux + decode only, frames handed straight back
+ * - Render pass: every frame imported, rendered and swapped
+ *
+ * Reported per clip: decode-only fps, import+render fps (time spent in
+ * import/render/swap only), end-to-end fps of the render pass, frame
+ * latency percentiles (packet read -> swap returned) and CPU% per stage.
+ * Results go to stdout and, with --output, to a JSON file so runs can be
+ * compared build against build.
+ *
+ * The loop is single threaded on purpose: stage costs add up to the wall
+ * time and per-stage CPU is read from the thread CPU clock.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "video_input.h"
+#include "hw_decoder.h"
+#include "gpu_renderer.h"
+#include "display_output.h"
+#include "pipeline_stats.h"
+#include "pickle_log.h"
+
+/* Frames per pass unless --frames says otherwise (0 = whole clip) */
+#define BENCH_DEFAULT_FRAMES      600
+/* Back-off when the decoder neither takes input nor has output */
+#define BENCH_IDLE_SLEEP_US       500
+/* Packet read times kept for matching against decoder output */
+#define BENCH_STAMP_SLOTS         64
+
+/* Timed stages */
+typedef enum {
+    BENCH_STAGE_DEMUX,
+    BENCH_STAGE_DECODE,
+    BENCH_STAGE_RENDER,           /* Import + draw + swap */
+    BENCH_STAGE_COUNT
+} bench_stage_t;
+
+static const char *stage_names[BENCH_STAGE_COUNT] = { "demux", "decode", "render" };
+
+/* Wall and CPU time of one stage */
+typedef struct {
+    uint64_t wall_us;
+    uint64_t cpu_us;
+} stage_time_t;
+
+/* Start of a timed section */
+typedef struct {
+    uint64_t wall_us;
+    uint64_t cpu_us;
+} stage_mark_t;
+
+/* Result of one pass over a clip */
+typedef struct {
+    int frames;
+    uint64_t wall_us;
+    uint64_t process_cpu_us;
+    stage_time_t stages[BENCH_STAGE_COUNT];
+    stats_summary_t latency;
+} pass_result_t;
+
+/* Shared offscreen output */
+typedef struct {
+    display_output_ctx_t *display;
+    gpu_renderer_ctx_t *renderer;
+    int width, height;
+} bench_output_t;
+
+static uint64_t clock_us(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+static uint64_t process_cpu_us(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL +
+           (uint64_t)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+static void stage_begin(stage_mark_t *mark) {
+    mark->wall_us = clock_us(CLOCK_MONOTONIC);
+    mark->cpu_us = clock_us(CLOCK_THREAD_CPUTIME_ID);
+}
+
+static void stage_end(pass_result_t *result, bench_stage_t stage, const stage_mark_t *mark) {
+    result->stages[stage].wall_us += clock_us(CLOCK_MONOTONIC) - mark->wall_us;
+    result->stages[stage].cpu_us += clock_us(CLOCK_THREAD_CPUTIME_ID) - mark->cpu_us;
+}
+
+static double per_second(int frames, uint64_t us) {
+    return us > 0 ? (double)frames * 1e6 / (double)us : 0.0;
+}
+
+static double percent(uint64_t part_us, uint64_t whole_us) {
+    return whole_us > 0 ? 100.0 * (double)part_us / (double)whole_us : 0.0;
+}
+
+/**
+ * Run one pass over a clip with a fresh input and decoder
+ */
+static int run_pass(const char *path, bench_output_t *output, int render, int max_frames,
+                    pass_result_t *result) {
+    video_input_ctx_t *input = NULL;
+    hw_decoder_ctx_t *decoder = NULL;
+    pipeline_stats_t *stats = NULL;
+    video_stream_info_t info;
+    frame_packet_t packet;
+    decoded_frame_t frame;
+    struct { int64_t pts; uint64_t read_us; } stamps[BENCH_STAMP_SLOTS];
+    int next_stamp = 0;
+    int have_packet = 0, eos_sent = 0, done = 0;
+    int ret = -1;
+    stage_mark_t mark;
+    uint64_t start_us, start_cpu_us;
+    
+    memset(result, 0, sizeof(*result));
+    memset(stamps, 0, sizeof(stamps));
+    
+    input = video_input_create();
+    if (!input || video_input_open(input, path) < 0 ||
+        video_input_get_stream_info(input, &info) < 0) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        goto out;
+    }
+    
+    decoder = hw_decoder_create();
+    if (!decoder || hw_decoder_configure(decoder, &info) < 0) {
+        fprintf(stderr, "Failed to configure decoder for %s\n", path);
+        goto out;
+    }
+    
+    stats = pipeline_stats_create();
+    if (!stats) {
+        goto out;
+    }
+    
+    /* The previous pass's decoder owned different buffers */
+    if (render) {
+        gpu_renderer_flush_texture_cache(output->renderer);
+    }
+    
+    start_us = clock_us(CLOCK_MONOTONIC);
+    start_cpu_us = process_cpu_us();
+    
+    while (!done && (max_frames <= 0 || result->frames < max_frames)) {
+        int progress = 0;
+        
+        /* 1. Read the next packet; an empty one starts the decoder draining */
+        if (!have_packet && !eos_sent) {
+            stage_begin(&mark);
+            int read = video_input_read_packet(input, &packet);
+            stage_end(result, BENCH_STAGE_DEMUX, &mark);
+            
+            if (read == VIDEO_INPUT_EOF) {
+                frame_packet_t eos = {0};
+                hw_decoder_submit_packet(decoder, &eos);
+                eos_sent = 1;
+            } else if (read < 0) {
+                fprintf(stderr, "Error reading packet from %s: %d\n", path, read);
+                goto out;
+            } else {
+                stamps[next_stamp].pts = packet.pts;
+                stamps[next_stamp].read_us = mark.wall_us;
+                next_stamp = (next_stamp + 1) % BENCH_STAMP_SLOTS;
+                have_packet = 1;
+            }
+        }
+        
+        /* 2. Hand it to the decoder; EAGAIN means drain output first */
+        if (have_packet) {
+            stage_begin(&mark);
+            int submitted = hw_decoder_submit_packet(decoder, &packet);
+            stage_end(result, BENCH_STAGE_DECODE, &mark);
+            
+            if (submitted == HW_DECODER_OK) {
+                video_input_free_packet(&packet);
+                have_packet = 0;
+                progress = 1;
+            } else if (submitted != HW_DECODER_EAGAIN) {
+                fprintf(stderr, "Error submitting packet from %s: %d\n", path, submitted);
+                goto out;
+            }
+        }
+        
+        /* 3. Take every frame that is ready */
+        while (max_frames <= 0 || result->frames < max_frames) {
+            stage_begin(&mark);
+            int got = hw_decoder_get_frame(decoder, &frame);
+            stage_end(result, BENCH_STAGE_DECODE, &mark);
+            
+            if (got == HW_DECODER_EAGAIN) {
+                break;
+            } else if (got == HW_DECODER_EOF) {
+                done = 1;
+                break;
+            } else if (got < 0) {
+                fprintf(stderr, "Error decoding %s: %d\n", path, got);
+                goto out;
+            }
+            
+            progress = 1;
+            result->frames++;
+            
+            if (render) {
+                stage_begin(&mark);
+                int rendered = gpu_renderer_render_frame(output->renderer, &frame);
+                if (rendered == 0) {
+                    rendered = display_output_present_frame(output->display);
+                }
+                stage_end(result, BENCH_STAGE_RENDER, &mark);
+                
+                if (rendered < 0) {
+                    fprintf(stderr, "Error rendering %s: %d\n", path, rendered);
+                    hw_decoder_release_frame(decoder, &frame);
+                    goto out;
+                }
+                
+                for (int i = 0; i < BENCH_STAMP_SLOTS; i++) {
+                    if (stamps[i].read_us && stamps[i].pts == frame.timestamp_us) {
+                        pipeline_stats_record_span(stats, STATS_STAGE_TOTAL, stamps[i].read_us,
+                                                   clock_us(CLOCK_MONOTONIC));
+                        stamps[i].read_us = 0;
+                        break;
+                    }
+                }
+            }
+            
+            hw_decoder_release_frame(decoder, &frame);
+        }
+        
+        /* Decoder busy with input full and no output yet: don't spin */
+        if (!progress && !done) {
+            struct timespec idle = { 0, BENCH_IDLE_SLEEP_US * 1000L };
+            nanosleep(&idle, NULL);
+        }
+    }
+    
+    result->wall_us = clock_us(CLOCK_MONOTONIC) - start_us;
+    result->process_cpu_us = process_cpu_us() - start_cpu_us;
+    pipeline_stats_get_summary(stats, STATS_STAGE_TOTAL, &result->latency);
+    ret = result->frames > 0 ? 0 : -1;
+
+out:
+    if (have_packet) {
+        video_input_free_packet(&packet);
+    }
+    pipeline_stats_destroy(stats);
+    if (decoder) {
+        hw_decoder_destroy(decoder);
+    }
+    if (input) {
+        video_input_destroy(input);
+    }
+    return ret;
+}
+
+/**
+ * Write a JSON string literal
+ */
+static void json_string(FILE *out, const char *str) {
+    fputc('"', out);
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\') {
+            fprintf(out, "\\%c", *str);
+        } else if ((unsigned char)*str < 0x20) {
+            fprintf(out, "\\u%04x", (unsigned char)*str);
+        } else {
+            fputc(*str, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/**
+ * Write the CPU% per stage of a pass
+ */
+static void json_cpu(FILE *out, const pass_result_t *pass, int stages) {
+    fprintf(out, "\"cpu_percent\": {");
+    for (int s = 0; s < stages; s++) {
+        fprintf(out, "\"%s\": %.1f, ", stage_names[s],
+                percent(pass->stages[s].cpu_us, pass->wall_us));
+    }
+    fprintf(out, "\"total\": %.1f}", percent(pass->process_cpu_us, pass->wall_us));
+}
+
+/**
+ * Benchmark one clip, appending its JSON object to out (may be NULL)
+ */
+static int bench_clip(const char *path, bench_output_t *output, int max_frames,
+                      FILE *out, int first) {
+    pass_result_t decode, render;
+    const char *error = NULL;
+    
+    printf("Benchmarking %s...\n", path);
+    
+    if (run_pass(path, output, 0, max_frames, &decode) < 0) {
+        error = "decode pass failed";
+    } else if (run_pass(path, output, 1, max_frames, &render) < 0) {
+        error = "render pass failed";
+    }
+    
+    if (out) {
+        fprintf(out, "%s    {\"clip\": ", first ? "" : ",\n");
+        json_string(out, path);
+        if (error) {
+            fprintf(out, ", \"error\": \"%s\"}", error);
+        }
+    }
+    
+    if (error) {
+        fprintf(stderr, "⚠ %s: %s\n", path, error);
+        return -1;
+    }
+    
+    double decode_fps = per_second(decode.frames, decode.wall_us);
+    double render_fps = per_second(render.frames, render.stages[BENCH_STAGE_RENDER].wall_us);
+    double e2e_fps = per_second(render.frames, render.wall_us);
+    
+    printf("✓ %s: decode %.1f fps, import+render %.1f fps, end-to-end %.1f fps, "
+           "latency p50 %.1f ms / p99 %.1f ms\n", path, decode_fps, render_fps, e2e_fps,
+           (double)render.latency.p50_us / 1000.0, (double)render.latency.p99_us / 1000.0);
+    printf("  CPU: demux %.1f%%, decode %.1f%%, render %.1f%%, process %.1f%%\n",
+           percent(render.stages[BENCH_STAGE_DEMUX].cpu_us, render.wall_us),
+           percent(render.stages[BENCH_STAGE_DECODE].cpu_us, render.wall_us),
+           percent(render.stages[BENCH_STAGE_RENDER].cpu_us, render.wall_us),
+           percent(render.process_cpu_us, render.wall_us));
+    
+    if (out) {
+        fprintf(out, ",\n     \"decode_only\": {\"frames\": %d, \"fps\": %.2f, ",
+                decode.frames, decode_fps);
+        json_cpu(out, &decode, BENCH_STAGE_RENDER);
+        fprintf(out, "},\n     \"end_to_end\": {\"frames\": %d, \"fps\": %.2f, "
+                "\"render_fps\": %.2f,\n      \"latency_us\": {\"p50\": %llu, \"p99\": %llu, "
+                "\"max\": %llu},\n      ", render.frames, e2e_fps, render_fps,
+                (unsigned long long)render.latency.p50_us,
+                (unsigned long long)render.latency.p99_us,
+                (unsigned long long)render.latency.max_us);
+        json_cpu(out, &render, BENCH_STAGE_COUNT);
+        fprintf(out, "}}");
+    }
+    
+    return 0;
+}
+
+static void print_usage(const char *program) {
+    printf("Usage: %s [--frames N] [--size WxH] [--output results.json] <clip> [clip...]\n",
+           program);
+    printf("  --frames N   Frames per pass (default %d, 0 = whole clip)\n", BENCH_DEFAULT_FRAMES);
+    printf("  --size WxH   Offscreen render target (default 1920x1080)\n");
+    printf("  --output F   Write results as JSON to F\n");
+}
+
+int main(int argc, char *argv[]) {
+    bench_output_t output = { NULL, NULL, 1920, 1080 };
+    display_config_t display_config = {0};
+    renderer_config_t renderer_config = {0};
+    const char *output_path = NULL;
+    int max_frames = BENCH_DEFAULT_FRAMES;
+    int failures = 0;
+    FILE *out = NULL;
+    
+    int first_clip = 1;
+    for (; first_clip < argc && strncmp(argv[first_clip], "--", 2) == 0; first_clip++) {
+        if (strcmp(argv[first_clip], "--frames") == 0 && first_clip + 1 < argc) {
+            max_frames = atoi(argv[++first_clip]);
+        } else if (strcmp(argv[first_clip], "--size") == 0 && first_clip + 1 < argc &&
+                   sscanf(argv[first_clip + 1], "%dx%d", &output.width, &output.height) == 2) {
+            first_clip++;
+        } else if (strcmp(argv[first_clip], "--output") == 0 && first_clip + 1 < argc) {
+            output_path = argv[++first_clip];
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    if (first_clip >= argc) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    pickle_log_start();
+    
+    /* One offscreen surface and renderer shared by every clip */
+    output.display = display_output_create();
+    display_config.headless = 1;
+    if (!output.display ||
+        display_output_set_config(output.display, &display_config) < 0 ||
+        display_output_configure(output.display, output.width, output.height, 0) < 0) {
+        fprintf(stderr, "Failed to create offscreen output\n");
+        failures = -1;
+        goto out;
+    }
+    
+    output.renderer = gpu_renderer_create();
+    renderer_config.brightness = 1.0f;
+    renderer_config.contrast = 1.0f;
+    renderer_config.saturation = 1.0f;
+    if (!output.renderer ||
+        gpu_renderer_set_config(output.renderer, &renderer_config) < 0 ||
+        gpu_renderer_configure(output.renderer, output.display, output.width, output.height) < 0) {
+        fprintf(stderr, "Failed to configure GPU renderer\n");
+        failures = -1;
+        goto out;
+    }
+    
+    if (output_path) {
+        out = fopen(output_path, "w");
+        if (!out) {
+            fprintf(stderr, "Cannot write %s\n", output_path);
+            failures = -1;
+            goto out;
+        }
+        fprintf(out, "{\n  \"target\": \"%dx%d\",\n  \"frames_per_pass\": %d,\n  \"clips\": [\n",
+                output.width, output.height, max_frames);
+    }
+    
+    for (int i = first_clip; i < argc; i++) {
+        if (bench_clip(argv[i], &output, max_frames, out, i == first_clip) < 0) {
+            failures++;
+        }
+    }
+    
+    if (out) {
+        fprintf(out, "\n  ]\n}\n");
+        fclose(out);
+        printf("Results written to %s\n", output_path);
+    }
+
+out:
+    if (output.renderer) {
+        gpu_renderer_destroy(output.renderer);
+    }
+    if (output.display) {
+        display_output_destroy(output.display);
+    }
+    pickle_log_stop();
+    
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
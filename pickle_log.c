@@ -0,0 +1,245 @@
+/*
+ * Pickle Log Implementation - Lock-Free Ring and Flush Thread
+ *
+ * The ring is a bounded multi-producer queue: each slot carries a sequence
+ * number that says whether it is free for ticket N (seq == N) or holds the
+ * message for ticket N (seq == N + 1). Writers claim a ticket with one CAS
+ * and format straight into the slot; the single flush thread copies the
+ * text out and hands the slot back with seq = N + capacity. A writer that
+ * finds the next slot still occupied drops its message and bumps a counter,
+ * so a stalled stdout can slow the log but never the pipeline.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pickle_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+
+/* Ring geometry (capacity must be a power of two) */
+#define LOG_RING_CAPACITY         256
+#define LOG_MESSAGE_MAX           240
+/* How long the flush thread sleeps when the ring is empty */
+#define LOG_FLUSH_INTERVAL_MS     20
+/* ... and while shutdown waits for a writer still formatting its message */
+#define LOG_STOP_POLL_US          1000
+
+/* One queued message */
+typedef struct {
+    unsigned int seq;
+    int level;
+    char text[LOG_MESSAGE_MAX];
+} log_slot_t;
+
+/* Internal logger state (one per process) */
+static struct {
+    log_slot_t slots[LOG_RING_CAPACITY];
+    unsigned int head;            /* Next ticket to claim (writers) */
+    unsigned int tail;            /* Next ticket to flush (flush thread only) */
+    unsigned int dropped;
+    
+    int threshold;
+    int running;
+    int stopping;
+    pthread_t thread;
+} g_log = { .threshold = PICKLE_LOG_LEVEL };
+
+static const char *level_names[] = { "error", "warn", "info", "debug", "trace" };
+
+/**
+ * Parse $PICKLE_LOG: a level name or number
+ */
+static int parse_level(const char *value) {
+    for (int i = 0; i <= LOG_LEVEL_TRACE; i++) {
+        if (strcasecmp(value, level_names[i]) == 0) {
+            return i;
+        }
+    }
+    
+    if (value[0] >= '0' && value[0] <= '9') {
+        return atoi(value);
+    }
+    
+    return -1;
+}
+
+/**
+ * Write one message to its stream (errors and warnings to stderr)
+ */
+static void emit(int level, const char *text) {
+    FILE *out = level <= LOG_LEVEL_WARN ? stderr : stdout;
+    size_t len = strlen(text);
+    
+    fwrite(text, 1, len, out);
+    if (len == 0 || text[len - 1] != '\n') {
+        fputc('\n', out);
+    }
+}
+
+/**
+ * Write out every published message; returns how many there were
+ */
+static int drain_ring(void) {
+    char text[LOG_MESSAGE_MAX];
+    unsigned int dropped;
+    int count = 0;
+    
+    for (;;) {
+        unsigned int pos = g_log.tail;
+        log_slot_t *slot = &g_log.slots[pos & (LOG_RING_CAPACITY - 1)];
+        
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+            break;  /* Empty, or the writer is still formatting */
+        }
+        
+        int level = slot->level;
+        memcpy(text, slot->text, sizeof(text));
+        __atomic_store_n(&slot->seq, pos + LOG_RING_CAPACITY, __ATOMIC_RELEASE);
+        g_log.tail = pos + 1;
+        
+        emit(level, text);
+        count++;
+    }
+    
+    dropped = __atomic_exchange_n(&g_log.dropped, 0, __ATOMIC_RELAXED);
+    if (dropped > 0) {
+        fprintf(stderr, "⚠ Log ring full: %u messages dropped\n", dropped);
+    }
+    
+    if (count > 0) {
+        fflush(stdout);
+    }
+    
+    return count;
+}
+
+/**
+ * Flush thread: drain, then nap while the ring is empty; on stop, empty it
+ */
+static void *flush_thread_main(void *arg) {
+    struct timespec nap = { 0, LOG_FLUSH_INTERVAL_MS * 1000000L };
+    struct timespec stop_nap = { 0, LOG_STOP_POLL_US * 1000L };
+    
+    (void)arg;
+    
+    while (!__atomic_load_n(&g_log.stopping, __ATOMIC_ACQUIRE)) {
+        if (drain_ring() == 0) {
+            nanosleep(&nap, NULL);
+        }
+    }
+    
+    /* Every claimed ticket gets written, including ones still being formatted */
+    while (g_log.tail != __atomic_load_n(&g_log.head, __ATOMIC_ACQUIRE)) {
+        if (drain_ring() == 0) {
+            nanosleep(&stop_nap, NULL);
+        }
+    }
+    
+    return NULL;
+}
+
+/**
+ * Start the flush thread
+ */
+int pickle_log_start(void) {
+    const char *env = getenv("PICKLE_LOG");
+    
+    for (unsigned int i = 0; i < LOG_RING_CAPACITY; i++) {
+        g_log.slots[i].seq = i;
+    }
+    g_log.head = 0;
+    g_log.tail = 0;
+    g_log.stopping = 0;
+    
+    if (env && *env) {
+        int level = parse_level(env);
+        if (level < 0) {
+            fprintf(stderr, "⚠ Unknown PICKLE_LOG level '%s' - ignoring\n", env);
+        } else {
+            if (level > PICKLE_LOG_LEVEL) {
+                fprintf(stderr, "⚠ PICKLE_LOG=%s: this build only has levels up to %s\n",
+                        env, level_names[PICKLE_LOG_LEVEL]);
+            }
+            g_log.threshold = level;
+        }
+    }
+    
+    if (pthread_create(&g_log.thread, NULL, flush_thread_main, NULL) != 0) {
+        fprintf(stderr, "Failed to start log thread - logging synchronously\n");
+        return PICKLE_LOG_ERROR;
+    }
+    
+    __atomic_store_n(&g_log.running, 1, __ATOMIC_RELEASE);
+    return PICKLE_LOG_OK;
+}
+
+/**
+ * Queue one message
+ */
+void pickle_log_write(int level, const char *fmt, ...) {
+    va_list args;
+    log_slot_t *slot;
+    unsigned int pos;
+    
+    if (level > g_log.threshold) {
+        return;
+    }
+    
+    /* Not started (or already stopped): nothing else can reorder us */
+    if (!__atomic_load_n(&g_log.running, __ATOMIC_ACQUIRE)) {
+        char text[LOG_MESSAGE_MAX];
+        va_start(args, fmt);
+        vsnprintf(text, sizeof(text), fmt, args);
+        va_end(args);
+        emit(level, text);
+        return;
+    }
+    
+    /* Claim the next ticket whose slot the flush thread has released */
+    pos = __atomic_load_n(&g_log.head, __ATOMIC_RELAXED);
+    for (;;) {
+        slot = &g_log.slots[pos & (LOG_RING_CAPACITY - 1)];
+        int diff = (int)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&g_log.head, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* Ring full: lose the message rather than the frame */
+            __atomic_fetch_add(&g_log.dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n(&g_log.head, __ATOMIC_RELAXED);
+        }
+    }
+    
+    slot->level = level;
+    va_start(args, fmt);
+    vsnprintf(slot->text, sizeof(slot->text), fmt, args);
+    va_end(args);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Stop the flush thread
+ */
+void pickle_log_stop(void) {
+    if (!__atomic_load_n(&g_log.running, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    
+    /* New messages go direct from here on; the thread empties the ring before exiting */
+    __atomic_store_n(&g_log.running, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_log.stopping, 1, __ATOMIC_RELEASE);
+    pthread_join(g_log.thread, NULL);
+    
+    /* A writer that saw running just before it was cleared */
+    drain_ring();
+}
@@ -0,0 +1,71 @@
+/*
+ * Pickle Log Module - Leveled, Non-Blocking Hot-Path Logging
+ *
+ * This module handles:
+ * - Five log levels, compiled out above PICKLE_LOG_LEVEL (set by the Makefile)
+ * - A further runtime threshold from the PICKLE_LOG environment variable
+ * - Formatting into a fixed lock-free ring; a full ring drops, never waits
+ * - A background thread that writes the ring to stdout/stderr
+ *
+ * Use it on paths that run per packet or per frame. One-off startup and
+ * shutdown messages keep using printf directly; the two are not ordered
+ * against each other, so ring output can trail a printf by one flush.
+ */
+
+#ifndef PICKLE_LOG_H
+#define PICKLE_LOG_H
+
+/* Log levels */
+#define LOG_LEVEL_ERROR           0
+#define LOG_LEVEL_WARN            1
+#define LOG_LEVEL_INFO            2
+#define LOG_LEVEL_DEBUG           3
+#define LOG_LEVEL_TRACE           4
+
+/* Highest level compiled in (release builds pass -DPICKLE_LOG_LEVEL=1) */
+#ifndef PICKLE_LOG_LEVEL
+#define PICKLE_LOG_LEVEL          LOG_LEVEL_DEBUG
+#endif
+
+/* Log return codes */
+#define PICKLE_LOG_OK             0
+#define PICKLE_LOG_ERROR         -1
+
+/* A constant-false level check lets the compiler drop the call and its arguments */
+#define PICKLE_LOG_AT(level, ...) \
+    do { \
+        if ((level) <= PICKLE_LOG_LEVEL) { \
+            pickle_log_write((level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_ERROR(...)            PICKLE_LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...)             PICKLE_LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...)             PICKLE_LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...)            PICKLE_LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_TRACE(...)            PICKLE_LOG_AT(LOG_LEVEL_TRACE, __VA_ARGS__)
+
+/* API Functions */
+
+/**
+ * Start the flush thread and read the runtime threshold from $PICKLE_LOG
+ * (a level name or number; default: everything compiled in). Messages
+ * written before this, or if it fails, go straight to stdout/stderr.
+ * @return 0 on success, negative on error
+ */
+int pickle_log_start(void);
+
+/**
+ * Queue one message (any thread; formats into the ring, never blocks)
+ * @param level Message level
+ * @param fmt printf-style format; a trailing newline is added if missing
+ */
+void pickle_log_write(int level, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * Stop the flush thread after writing out everything still queued
+ */
+void pickle_log_stop(void);
+
+#endif /* PICKLE_LOG_H */
@@ -0,0 +1,410 @@
+/*
+ * Pipeline Stats Implementation - Lock-Free Latency Histograms
+ *
+ * Buckets are log-linear like HdrHistogram with 3 sub-bucket bits: exact
+ * below 8 us, then 8 buckets per power of two (worst-case error 12.5%) up
+ * to ~67 s. Recording is one relaxed fetch_add per sample plus a CAS loop
+ * for the maxima, so the render thread never takes a lock. The exporter
+ * thread diffs against its previous snapshot to get per-second windows.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pipeline_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+/* Histogram geometry */
+#define STATS_SUB_BITS      3
+#define STATS_SUB_COUNT     (1 << STATS_SUB_BITS)
+#define STATS_MAX_MSB       25
+#define STATS_BUCKETS       ((STATS_MAX_MSB - STATS_SUB_BITS + 2) * STATS_SUB_COUNT)
+
+/* Export period */
+#define STATS_EXPORT_MS     1000
+
+static const char *stage_names[STATS_STAGE_COUNT] = {
+    "demux", "decode", "queue", "gpu", "scanout", "total"
+};
+
+static const char *counter_names[STATS_COUNTER_COUNT] = {
+    "frames", "dropped", "repeated"
+};
+
+/* One stage's histogram (written lock-free by the pipeline threads) */
+typedef struct {
+    uint64_t buckets[STATS_BUCKETS];
+    uint64_t max_us;
+    uint64_t interval_max_us;     /* Reset by the exporter each period */
+} stats_histogram_t;
+
+/* Internal stats context */
+struct pipeline_stats {
+    stats_histogram_t stages[STATS_STAGE_COUNT];
+    uint64_t counters[STATS_COUNTER_COUNT];
+    uint64_t start_us;
+    
+    /* Exporter (its snapshots are private to the export thread) */
+    char *path;
+    pthread_t thread;
+    int thread_started;
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    uint64_t prev_buckets[STATS_STAGE_COUNT][STATS_BUCKETS];
+    uint64_t prev_counters[STATS_COUNTER_COUNT];
+};
+
+/**
+ * Current CLOCK_MONOTONIC time
+ */
+static uint64_t stats_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/**
+ * Histogram bucket for a value
+ */
+static int bucket_index(uint64_t value) {
+    if (value < STATS_SUB_COUNT) {
+        return (int)value;
+    }
+    
+    int msb = 63 - __builtin_clzll(value);
+    if (msb > STATS_MAX_MSB) {
+        return STATS_BUCKETS - 1;
+    }
+    
+    int shift = msb - STATS_SUB_BITS;
+    return (msb - STATS_SUB_BITS + 1) * STATS_SUB_COUNT +
+           (int)((value >> shift) & (STATS_SUB_COUNT - 1));
+}
+
+/**
+ * Highest value that lands in a bucket (reported percentiles never flatter)
+ */
+static uint64_t bucket_upper(int index) {
+    if (index < STATS_SUB_COUNT) {
+        return (uint64_t)index;
+    }
+    
+    int group = index / STATS_SUB_COUNT;
+    int sub = index % STATS_SUB_COUNT;
+    int shift = group - 1;
+    return (((uint64_t)(STATS_SUB_COUNT + sub) << shift) + ((uint64_t)1 << shift)) - 1;
+}
+
+/**
+ * Raise an atomic maximum
+ */
+static void atomic_max(uint64_t *target, uint64_t value) {
+    uint64_t current = __atomic_load_n(target, __ATOMIC_RELAXED);
+    while (value > current &&
+           !__atomic_compare_exchange_n(target, &current, value, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * Percentiles over a bucket array
+ */
+static void summarise(const uint64_t *buckets, uint64_t max_us, stats_summary_t *summary) {
+    uint64_t total = 0, seen = 0;
+    
+    memset(summary, 0, sizeof(*summary));
+    for (int i = 0; i < STATS_BUCKETS; i++) {
+        total += buckets[i];
+    }
+    if (total == 0) {
+        return;
+    }
+    
+    uint64_t p50_rank = (total + 1) / 2;
+    uint64_t p99_rank = total - total / 100;
+    
+    for (int i = 0; i < STATS_BUCKETS; i++) {
+        seen += buckets[i];
+        if (!summary->p50_us && seen >= p50_rank) {
+            summary->p50_us = bucket_upper(i);
+        }
+        if (seen >= p99_rank) {
+            summary->p99_us = bucket_upper(i);
+            break;
+        }
+    }
+    
+    summary->count = total;
+    summary->max_us = max_us;
+    
+    /* Bucket bounds can overshoot the exact maximum */
+    if (summary->p50_us > max_us) summary->p50_us = max_us;
+    if (summary->p99_us > max_us) summary->p99_us = max_us;
+}
+
+/**
+ * Create stats context
+ */
+pipeline_stats_t *pipeline_stats_create(void) {
+    pthread_condattr_t attr;
+    
+    pipeline_stats_t *stats = calloc(1, sizeof(pipeline_stats_t));
+    if (!stats) {
+        fprintf(stderr, "Failed to allocate pipeline stats\n");
+        return NULL;
+    }
+    
+    stats->start_us = stats_now_us();
+    
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&stats->lock, NULL);
+    pthread_cond_init(&stats->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    
+    return stats;
+}
+
+/**
+ * Record one latency sample
+ */
+void pipeline_stats_record(pipeline_stats_t *stats, stats_stage_t stage, uint64_t value_us) {
+    if (!stats || stage < 0 || stage >= STATS_STAGE_COUNT) {
+        return;
+    }
+    
+    stats_histogram_t *hist = &stats->stages[stage];
+    __atomic_fetch_add(&hist->buckets[bucket_index(value_us)], 1, __ATOMIC_RELAXED);
+    atomic_max(&hist->max_us, value_us);
+    atomic_max(&hist->interval_max_us, value_us);
+}
+
+/**
+ * Record the interval between two timestamps
+ */
+void pipeline_stats_record_span(pipeline_stats_t *stats, stats_stage_t stage,
+                                uint64_t start_us, uint64_t end_us) {
+    if (start_us == 0 || end_us < start_us) {
+        return;
+    }
+    
+    pipeline_stats_record(stats, stage, end_us - start_us);
+}
+
+/**
+ * Add to an event counter
+ */
+void pipeline_stats_count(pipeline_stats_t *stats, stats_counter_t counter, uint64_t n) {
+    if (!stats || counter < 0 || counter >= STATS_COUNTER_COUNT) {
+        return;
+    }
+    
+    __atomic_fetch_add(&stats->counters[counter], n, __ATOMIC_RELAXED);
+}
+
+/**
+ * Summarise a stage since start
+ */
+void pipeline_stats_get_summary(pipeline_stats_t *stats, stats_stage_t stage,
+                                stats_summary_t *summary) {
+    uint64_t buckets[STATS_BUCKETS];
+    
+    if (!summary) {
+        return;
+    }
+    memset(summary, 0, sizeof(*summary));
+    if (!stats || stage < 0 || stage >= STATS_STAGE_COUNT) {
+        return;
+    }
+    
+    for (int i = 0; i < STATS_BUCKETS; i++) {
+        buckets[i] = __atomic_load_n(&stats->stages[stage].buckets[i], __ATOMIC_RELAXED);
+    }
+    summarise(buckets, __atomic_load_n(&stats->stages[stage].max_us, __ATOMIC_RELAXED), summary);
+}
+
+/**
+ * Write one JSON sample (last-second window plus lifetime totals)
+ */
+static void write_sample(pipeline_stats_t *stats, FILE *file) {
+    uint64_t now_us = stats_now_us();
+    uint64_t buckets[STATS_BUCKETS];
+    uint64_t lifetime[STATS_BUCKETS];
+    stats_summary_t window, total;
+    
+    fprintf(file, "{\n  \"timestamp_us\": %llu,\n  \"uptime_s\": %.1f,\n",
+            (unsigned long long)now_us, (double)(now_us - stats->start_us) / 1e6);
+    
+    /* Counters: lifetime and since the previous sample */
+    fprintf(file, "  \"counters\": {");
+    for (int c = 0; c < STATS_COUNTER_COUNT; c++) {
+        uint64_t value = __atomic_load_n(&stats->counters[c], __ATOMIC_RELAXED);
+        fprintf(file, "%s\n    \"%s\": { \"total\": %llu, \"last_second\": %llu }",
+                c ? "," : "", counter_names[c], (unsigned long long)value,
+                (unsigned long long)(value - stats->prev_counters[c]));
+        stats->prev_counters[c] = value;
+    }
+    fprintf(file, "\n  },\n");
+    
+    fprintf(file, "  \"stages_us\": {");
+    for (int s = 0; s < STATS_STAGE_COUNT; s++) {
+        stats_histogram_t *hist = &stats->stages[s];
+        
+        for (int i = 0; i < STATS_BUCKETS; i++) {
+            lifetime[i] = __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+            buckets[i] = lifetime[i] - stats->prev_buckets[s][i];
+            stats->prev_buckets[s][i] = lifetime[i];
+        }
+        summarise(buckets, __atomic_exchange_n(&hist->interval_max_us, 0, __ATOMIC_RELAXED),
+                  &window);
+        summarise(lifetime, __atomic_load_n(&hist->max_us, __ATOMIC_RELAXED), &total);
+        
+        fprintf(file, "%s\n    \"%s\": { \"count\": %llu, \"p50\": %llu, \"p99\": %llu, "
+                "\"max\": %llu, \"total_count\": %llu, \"total_p99\": %llu, \"total_max\": %llu }",
+                s ? "," : "", stage_names[s],
+                (unsigned long long)window.count, (unsigned long long)window.p50_us,
+                (unsigned long long)window.p99_us, (unsigned long long)window.max_us,
+                (unsigned long long)total.count, (unsigned long long)total.p99_us,
+                (unsigned long long)total.max_us);
+    }
+    fprintf(file, "\n  }\n}\n");
+}
+
+/* Move an absolute deadline on by one export period */
+static void advance_deadline(struct timespec *deadline) {
+    deadline->tv_sec += STATS_EXPORT_MS / 1000;
+    deadline->tv_nsec += (long)(STATS_EXPORT_MS % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+ * Export thread: rewrite the stats file once per second
+ */
+static void *export_thread_main(void *arg) {
+    pipeline_stats_t *stats = arg;
+    size_t tmp_len = strlen(stats->path) + 5;
+    char *tmp_path = malloc(tmp_len);
+    struct timespec deadline;
+    
+    if (!tmp_path) {
+        return NULL;
+    }
+    snprintf(tmp_path, tmp_len, "%s.tmp", stats->path);
+    
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    advance_deadline(&deadline);
+    
+    pthread_mutex_lock(&stats->lock);
+    while (!stats->stop) {
+        if (pthread_cond_timedwait(&stats->wake, &stats->lock, &deadline) != ETIMEDOUT) {
+            continue;  /* Woken for shutdown (or spuriously): same deadline */
+        }
+        /* From the last deadline, not from now, so the export cadence never drifts */
+        advance_deadline(&deadline);
+        pthread_mutex_unlock(&stats->lock);
+        
+        /* Readers never see a half-written file */
+        FILE *file = fopen(tmp_path, "w");
+        if (file) {
+            write_sample(stats, file);
+            if (fclose(file) == 0) {
+                rename(tmp_path, stats->path);
+            }
+        }
+        
+        pthread_mutex_lock(&stats->lock);
+    }
+    pthread_mutex_unlock(&stats->lock);
+    
+    free(tmp_path);
+    return NULL;
+}
+
+/**
+ * Start exporting JSON once per second
+ */
+int pipeline_stats_start_export(pipeline_stats_t *stats, const char *path) {
+    if (!stats || stats->thread_started) {
+        return PIPELINE_STATS_ERROR;
+    }
+    
+    stats->path = strdup(path ? path : PIPELINE_STATS_DEFAULT_PATH);
+    if (!stats->path) {
+        return PIPELINE_STATS_ERROR;
+    }
+    
+    /* Create the parent directory (e.g. /run/pickle) if needed */
+    char *slash = strrchr(stats->path, '/');
+    if (slash && slash != stats->path) {
+        *slash = '\0';
+        if (mkdir(stats->path, 0755) < 0 && errno != EEXIST) {
+            fprintf(stderr, "⚠ Stats export disabled: cannot create %s: %s\n",
+                    stats->path, strerror(errno));
+            *slash = '/';
+            return PIPELINE_STATS_ERROR;
+        }
+        *slash = '/';
+    }
+    
+    if (pthread_create(&stats->thread, NULL, export_thread_main, stats) != 0) {
+        fprintf(stderr, "Failed to start stats export thread\n");
+        return PIPELINE_STATS_ERROR;
+    }
+    stats->thread_started = 1;
+    
+    printf("✓ Pipeline stats exported to %s every %d ms\n", stats->path, STATS_EXPORT_MS);
+    return PIPELINE_STATS_OK;
+}
+
+/**
+ * Print a lifetime summary
+ */
+void pipeline_stats_print(pipeline_stats_t *stats) {
+    stats_summary_t summary;
+    
+    if (!stats) {
+        return;
+    }
+    
+    printf("Pipeline latency (p50 / p99 / max, us):\n");
+    for (int s = 0; s < STATS_STAGE_COUNT; s++) {
+        pipeline_stats_get_summary(stats, (stats_stage_t)s, &summary);
+        if (summary.count == 0) {
+            continue;
+        }
+        printf("  %-8s %7llu / %7llu / %7llu  (%llu samples)\n", stage_names[s],
+               (unsigned long long)summary.p50_us, (unsigned long long)summary.p99_us,
+               (unsigned long long)summary.max_us, (unsigned long long)summary.count);
+    }
+}
+
+/**
+ * Stop exporting and destroy stats context
+ */
+void pipeline_stats_destroy(pipeline_stats_t *stats) {
+    if (!stats) {
+        return;
+    }
+    
+    if (stats->thread_started) {
+        pthread_mutex_lock(&stats->lock);
+        stats->stop = 1;
+        pthread_cond_signal(&stats->wake);
+        pthread_mutex_unlock(&stats->lock);
+        pthread_join(stats->thread, NULL);
+    }
+    
+    pthread_cond_destroy(&stats->wake);
+    pthread_mutex_destroy(&stats->lock);
+    free(stats->path);
+    free(stats);
+}
@@ -0,0 +1,119 @@
+/*
+ * Pipeline Stats Module - Per-Stage Latency Histograms and Live Metrics
+ *
+ * This module handles:
+ * - Lock-free latency recording from any pipeline thread (a few atomics each)
+ * - HDR-style log-linear histograms per stage (p50/p99/max, ~12% resolution)
+ * - Drop / repeat / frame counters
+ * - Once-per-second JSON export to a file (default /run/pickle/stats)
+ *
+ * Stages follow one frame from the demuxer to the screen; all timestamps
+ * are CLOCK_MONOTONIC microseconds.
+ */
+
+#ifndef PIPELINE_STATS_H
+#define PIPELINE_STATS_H
+
+#include <stdint.h>
+
+/* Return codes */
+#define PIPELINE_STATS_OK          0
+#define PIPELINE_STATS_ERROR      -1
+
+/* Default export location */
+#define PIPELINE_STATS_DEFAULT_PATH "/run/pickle/stats"
+
+/* Forward declarations */
+typedef struct pipeline_stats pipeline_stats_t;
+
+/* Latency stages */
+typedef enum {
+    STATS_STAGE_DEMUX,        /* Packet read from the container */
+    STATS_STAGE_DECODE,       /* Demuxed -> decoder output */
+    STATS_STAGE_QUEUE,        /* Decoder output -> render submit */
+    STATS_STAGE_GPU,          /* Render submit -> GPU done (fence signalled) */
+    STATS_STAGE_SCANOUT,      /* GPU done -> flip complete */
+    STATS_STAGE_TOTAL,        /* Demuxed -> flip complete */
+    STATS_STAGE_COUNT
+} stats_stage_t;
+
+/* Event counters */
+typedef enum {
+    STATS_COUNTER_FRAMES,     /* Frames presented */
+    STATS_COUNTER_DROPPED,    /* Frames discarded as late */
+    STATS_COUNTER_REPEATED,   /* Vblanks on which the previous frame was kept */
+    STATS_COUNTER_COUNT
+} stats_counter_t;
+
+/* Percentile summary for one stage */
+typedef struct {
+    uint64_t count;
+    uint64_t p50_us;
+    uint64_t p99_us;
+    uint64_t max_us;
+} stats_summary_t;
+
+/* API Functions */
+
+/**
+ * Create stats context
+ * @return New context or NULL on error
+ */
+pipeline_stats_t *pipeline_stats_create(void);
+
+/**
+ * Record one latency sample (any thread, lock-free)
+ * @param stats Stats context (NULL is ignored)
+ * @param stage Stage
+ * @param value_us Latency in microseconds
+ */
+void pipeline_stats_record(pipeline_stats_t *stats, stats_stage_t stage, uint64_t value_us);
+
+/**
+ * Record the interval between two timestamps (ignored unless 0 < start <= end)
+ * @param stats Stats context (NULL is ignored)
+ * @param stage Stage
+ * @param start_us Earlier CLOCK_MONOTONIC timestamp
+ * @param end_us Later CLOCK_MONOTONIC timestamp
+ */
+void pipeline_stats_record_span(pipeline_stats_t *stats, stats_stage_t stage,
+                                uint64_t start_us, uint64_t end_us);
+
+/**
+ * Add to an event counter (any thread, lock-free)
+ * @param stats Stats context (NULL is ignored)
+ * @param counter Counter
+ * @param n Amount to add
+ */
+void pipeline_stats_count(pipeline_stats_t *stats, stats_counter_t counter, uint64_t n);
+
+/**
+ * Summarise a stage since start
+ * @param stats Stats context
+ * @param stage Stage
+ * @param summary Output summary
+ */
+void pipeline_stats_get_summary(pipeline_stats_t *stats, stats_stage_t stage,
+                                stats_summary_t *summary);
+
+/**
+ * Start exporting JSON once per second
+ * @param stats Stats context
+ * @param path Output file (written atomically via rename), NULL for the default
+ * @return 0 on success, negative on error
+ */
+int pipeline_stats_start_export(pipeline_stats_t *stats, const char *path);
+
+/**
+ * Print a lifetime summary to stdout
+ * @param stats Stats context
+ */
+void pipeline_stats_print(pipeline_stats_t *stats);
+
+/**
+ * Stop exporting and destroy stats context
+ * @param stats Stats context
+ */
+void pipeline_stats_destroy(pipeline_stats_t *stats);
+
+#endif /* PIPELINE_STATS_H */
@@ -2,26 +2,92 @@
  * Video Input Module Implementation
  * 
  * Implements MP4 demuxing using libavformat with zero-copy packet extraction.
- * Optimized for H.264 streams on Raspberry Pi 4.
+ * Optimized for H.264/HEVC streams on Raspberry Pi 4.
  */
 
+#define _GNU_SOURCE  /* For readahead() */
+
 #include "video_input.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 /* FFmpeg compatibility */
 #ifndef AV_TIME_BASE_Q
 #define AV_TIME_BASE_Q (AVRational){1, AV_TIME_BASE}
 #endif
 
+/* Read-ahead defaults */
+#define DEFAULT_READAHEAD_BYTES    (16 * 1024 * 1024)
+#define DEFAULT_POOLED_PACKETS     64
+#define READAHEAD_CHUNK_BYTES      (1024 * 1024)
+#define READAHEAD_IDLE_MS          50
+
+/* Mapped input: AVIOContext buffer for header parsing; packet payloads bypass it */
+#define MAPPED_IO_BUFFER_SIZE      4096
+
+/* One keyframe from the container's sample tables (decode timestamps) */
+typedef struct {
+    int64_t timestamp;            /* DTS in the stream time base, as av_seek_frame() wants it */
+    int64_t dts_us;
+    int64_t pos;                  /* Byte offset of the sample, -1 if unknown */
+} keyframe_entry_t;
+
+/* Pooled AVPacket; frame_packet_t.private_data points at one of these */
+typedef struct packet_slot {
+    AVPacket *av_packet;
+    struct video_input_ctx *owner;
+    struct packet_slot *next;
+} packet_slot_t;
+
 /* Internal context structure */
 struct video_input_ctx {
     AVFormatContext *format_ctx;
     AVCodecParameters *codec_params;
     int video_stream_index;
     int64_t start_time;
+    int64_t last_pts;             /* Last packet read, AV_NOPTS_VALUE if none */
     int initialized;
+    
+    /* Keyframe index (built on the first video_input_seek_to) */
+    keyframe_entry_t *keyframes;
+    int keyframe_count;
+    int keyframes_built;
+    int64_t key_delay_us;         /* Keyframe PTS - DTS (B-frame reorder), from the packets read */
+    int key_delay_known;
+    
+    /* Memory-mapped input (video_input_set_mmap) */
+    int mmap_input;
+    uint8_t *map;
+    size_t map_size;
+    int64_t map_pos;
+    AVIOContext *avio;
+    
+    /* AVPacket free-list (freed from the decode thread, reused by the demuxer) */
+    pthread_mutex_t pool_lock;
+    packet_slot_t *pool;
+    int pool_count;
+    int max_pooled_packets;
+    
+    /* Page-cache read-ahead thread */
+    int readahead_fd;             /* Private fd on the input file, -1 if not a file */
+    int64_t file_size;
+    size_t readahead_bytes;
+    int64_t demux_pos;            /* Byte offset the demuxer has reached */
+    int64_t prefetched_end;       /* Read-ahead has populated up to here */
+    uint64_t bytes_prefetched;
+    pthread_t readahead_thread;
+    pthread_mutex_t readahead_lock;
+    pthread_cond_t readahead_cond;
+    int readahead_running;
+    int readahead_stop;
 };
 
 /**
@@ -35,9 +101,351 @@ video_input_ctx_t *video_input_create(void) {
     }
     
     ctx->video_stream_index = -1;
+    ctx->last_pts = AV_NOPTS_VALUE;
+    ctx->readahead_fd = -1;
+    ctx->readahead_bytes = DEFAULT_READAHEAD_BYTES;
+    ctx->max_pooled_packets = DEFAULT_POOLED_PACKETS;
+    pthread_mutex_init(&ctx->pool_lock, NULL);
+    pthread_mutex_init(&ctx->readahead_lock, NULL);
+    pthread_cond_init(&ctx->readahead_cond, NULL);
     return ctx;
 }
 
+/**
+ * Set read-ahead and packet pool configuration
+ */
+int video_input_set_prefetch(video_input_ctx_t *ctx, const video_input_prefetch_config_t *config) {
+    if (!ctx || !config || config->max_pooled_packets < 0) {
+        return VIDEO_INPUT_ERROR;
+    }
+    
+    pthread_mutex_lock(&ctx->readahead_lock);
+    ctx->readahead_bytes = config->readahead_bytes;
+    pthread_cond_signal(&ctx->readahead_cond);
+    pthread_mutex_unlock(&ctx->readahead_lock);
+    
+    pthread_mutex_lock(&ctx->pool_lock);
+    ctx->max_pooled_packets = config->max_pooled_packets;
+    pthread_mutex_unlock(&ctx->pool_lock);
+    
+    return VIDEO_INPUT_OK;
+}
+
+/**
+ * Map local files instead of reading them
+ */
+int video_input_set_mmap(video_input_ctx_t *ctx, int enable) {
+    if (!ctx || ctx->format_ctx) {
+        return VIDEO_INPUT_ERROR;
+    }
+    
+    ctx->mmap_input = enable ? 1 : 0;
+    return VIDEO_INPUT_OK;
+}
+
+/**
+ * AVIOContext read callback: copy straight out of the mapping
+ */
+static int mapped_read(void *opaque, uint8_t *buf, int buf_size) {
+    video_input_ctx_t *ctx = opaque;
+    int64_t left = (int64_t)ctx->map_size - ctx->map_pos;
+    
+    if (left <= 0) {
+        return AVERROR_EOF;
+    }
+    if (buf_size > left) {
+        buf_size = (int)left;
+    }
+    
+    memcpy(buf, ctx->map + ctx->map_pos, buf_size);
+    ctx->map_pos += buf_size;
+    return buf_size;
+}
+
+/**
+ * AVIOContext seek callback: seeking is just moving the offset
+ */
+static int64_t mapped_seek(void *opaque, int64_t offset, int whence) {
+    video_input_ctx_t *ctx = opaque;
+    int64_t pos;
+    
+    switch (whence & ~AVSEEK_FORCE) {
+        case AVSEEK_SIZE: return (int64_t)ctx->map_size;
+        case SEEK_SET:    pos = offset; break;
+        case SEEK_CUR:    pos = ctx->map_pos + offset; break;
+        case SEEK_END:    pos = (int64_t)ctx->map_size + offset; break;
+        default:          return AVERROR(EINVAL);
+    }
+    
+    if (pos < 0 || pos > (int64_t)ctx->map_size) {
+        return AVERROR(EINVAL);
+    }
+    
+    ctx->map_pos = pos;
+    return pos;
+}
+
+/**
+ * Map a regular file and wrap it in an AVIOContext
+ *
+ * The demuxer still copies every sample into its packet (mov reads
+ * payloads with av_get_packet, which cannot borrow a caller's buffer), but
+ * with direct I/O that is the only copy: page cache -> packet, no read()
+ * syscalls and no pass through the AVIOContext buffer.
+ */
+static int open_mapped(video_input_ctx_t *ctx, const char *filename) {
+    struct stat st;
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    
+    if (fd < 0) {
+        return VIDEO_INPUT_ERROR;  /* Not a local path - libavformat opens it */
+    }
+    
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        (uint64_t)st.st_size > SIZE_MAX) {
+        close(fd);
+        return VIDEO_INPUT_ERROR;
+    }
+    
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  /* The mapping keeps the file referenced */
+    if (map == MAP_FAILED) {
+        printf("⚠ Cannot map %s (%s) - using buffered reads\n", filename, strerror(errno));
+        return VIDEO_INPUT_ERROR;
+    }
+    
+    /* Sequential streaming: aggressive kernel read-ahead, early reclaim behind
+     * us, and the first window faulted in before the demuxer asks for it */
+    size_t first_window = ctx->readahead_bytes > 0 && ctx->readahead_bytes < (size_t)st.st_size ?
+                          ctx->readahead_bytes : (size_t)st.st_size;
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+    madvise(map, first_window, MADV_WILLNEED);
+    
+    uint8_t *buffer = av_malloc(MAPPED_IO_BUFFER_SIZE);
+    ctx->avio = buffer ? avio_alloc_context(buffer, MAPPED_IO_BUFFER_SIZE, 0, ctx,
+                                            mapped_read, NULL, mapped_seek) : NULL;
+    if (!ctx->avio) {
+        av_free(buffer);
+        munmap(map, (size_t)st.st_size);
+        return VIDEO_INPUT_ERROR;
+    }
+    ctx->avio->direct = 1;  /* avio_read() goes straight from the mapping to the packet */
+    
+    ctx->format_ctx = avformat_alloc_context();
+    if (!ctx->format_ctx) {
+        av_freep(&ctx->avio->buffer);
+        avio_context_free(&ctx->avio);
+        munmap(map, (size_t)st.st_size);
+        return VIDEO_INPUT_ERROR;
+    }
+    ctx->format_ctx->pb = ctx->avio;
+    ctx->format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+    
+    ctx->map = map;
+    ctx->map_size = (size_t)st.st_size;
+    ctx->map_pos = 0;
+    return VIDEO_INPUT_OK;
+}
+
+/**
+ * Release the mapping and its AVIOContext (after the format context is closed)
+ */
+static void close_mapped(video_input_ctx_t *ctx) {
+    if (ctx->avio) {
+        av_freep(&ctx->avio->buffer);
+        avio_context_free(&ctx->avio);
+    }
+    if (ctx->map) {
+        munmap(ctx->map, ctx->map_size);
+        ctx->map = NULL;
+    }
+}
+
+/**
+ * Read-ahead thread: keep readahead_bytes of the file ahead of the demuxer
+ * in the page cache so av_read_frame() doesn't block on SD/NFS latency
+ */
+static void *readahead_thread_main(void *arg) {
+    video_input_ctx_t *ctx = arg;
+    
+    pthread_mutex_lock(&ctx->readahead_lock);
+    while (!ctx->readahead_stop) {
+        int64_t pos = ctx->demux_pos;
+        int64_t budget = (int64_t)ctx->readahead_bytes;
+        
+        /* Window ran off the end (seek forward) or is implausibly far ahead (seek back) */
+        if (ctx->prefetched_end < pos || ctx->prefetched_end > pos + budget) {
+            ctx->prefetched_end = pos;
+        }
+        
+        int64_t start = ctx->prefetched_end;
+        int64_t len = pos + budget - start;
+        if (len > READAHEAD_CHUNK_BYTES) len = READAHEAD_CHUNK_BYTES;
+        if (start + len > ctx->file_size) len = ctx->file_size - start;
+        
+        if (len <= 0) {
+            /* Window full (or EOF): wait for the demuxer to consume some */
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += READAHEAD_IDLE_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&ctx->readahead_cond, &ctx->readahead_lock, &deadline);
+            continue;
+        }
+        
+        /* Blocking read into the page cache, outside the lock */
+        pthread_mutex_unlock(&ctx->readahead_lock);
+#ifdef __linux__
+        if (readahead(ctx->readahead_fd, start, (size_t)len) < 0)
+#endif
+        {
+            posix_fadvise(ctx->readahead_fd, start, len, POSIX_FADV_WILLNEED);
+        }
+        pthread_mutex_lock(&ctx->readahead_lock);
+        
+        if (ctx->prefetched_end == start) {
+            ctx->prefetched_end = start + len;
+        }
+        ctx->bytes_prefetched += (uint64_t)len;
+    }
+    pthread_mutex_unlock(&ctx->readahead_lock);
+    
+    return NULL;
+}
+
+/**
+ * Open a private fd on the input and start the read-ahead thread (files only)
+ */
+static void start_readahead(video_input_ctx_t *ctx, const char *filename) {
+    struct stat st;
+    
+    if (ctx->readahead_bytes == 0) {
+        return;
+    }
+    
+    ctx->readahead_fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (ctx->readahead_fd < 0) {
+        /* Not a local path (URL, pipe) - libavformat does its own buffering */
+        return;
+    }
+    
+    if (fstat(ctx->readahead_fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(ctx->readahead_fd);
+        ctx->readahead_fd = -1;
+        return;
+    }
+    
+    ctx->file_size = st.st_size;
+    posix_fadvise(ctx->readahead_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    
+    if (pthread_create(&ctx->readahead_thread, NULL, readahead_thread_main, ctx) != 0) {
+        fprintf(stderr, "Failed to start read-ahead thread: %s\n", strerror(errno));
+        close(ctx->readahead_fd);
+        ctx->readahead_fd = -1;
+        return;
+    }
+    
+    ctx->readahead_running = 1;
+    printf("  Read-ahead: %zu KB window\n", ctx->readahead_bytes / 1024);
+}
+
+/**
+ * Stop the read-ahead thread
+ */
+static void stop_readahead(video_input_ctx_t *ctx) {
+    if (ctx->readahead_running) {
+        pthread_mutex_lock(&ctx->readahead_lock);
+        ctx->readahead_stop = 1;
+        pthread_cond_signal(&ctx->readahead_cond);
+        pthread_mutex_unlock(&ctx->readahead_lock);
+        
+        pthread_join(ctx->readahead_thread, NULL);
+        ctx->readahead_running = 0;
+    }
+    
+    if (ctx->readahead_fd >= 0) {
+        close(ctx->readahead_fd);
+        ctx->readahead_fd = -1;
+    }
+}
+
+/**
+ * Report how far the demuxer has read (wakes the read-ahead thread)
+ */
+static void update_demux_pos(video_input_ctx_t *ctx, int64_t pos) {
+    if (!ctx->readahead_running || pos < 0) {
+        return;
+    }
+    
+    pthread_mutex_lock(&ctx->readahead_lock);
+    ctx->demux_pos = pos;
+    /* Only wake the thread once half the window has been consumed */
+    if (ctx->prefetched_end - pos < (int64_t)ctx->readahead_bytes / 2) {
+        pthread_cond_signal(&ctx->readahead_cond);
+    }
+    pthread_mutex_unlock(&ctx->readahead_lock);
+}
+
+/**
+ * Take an AVPacket from the free-list (or allocate one)
+ */
+static packet_slot_t *packet_slot_get(video_input_ctx_t *ctx) {
+    packet_slot_t *slot;
+    
+    pthread_mutex_lock(&ctx->pool_lock);
+    slot = ctx->pool;
+    if (slot) {
+        ctx->pool = slot->next;
+        ctx->pool_count--;
+    }
+    pthread_mutex_unlock(&ctx->pool_lock);
+    
+    if (slot) {
+        slot->next = NULL;
+        return slot;
+    }
+    
+    slot = calloc(1, sizeof(packet_slot_t));
+    if (!slot) {
+        return NULL;
+    }
+    
+    slot->av_packet = av_packet_alloc();
+    if (!slot->av_packet) {
+        free(slot);
+        return NULL;
+    }
+    
+    slot->owner = ctx;
+    return slot;
+}
+
+/**
+ * Return an AVPacket to the free-list (payload is released, the struct kept)
+ */
+static void packet_slot_put(packet_slot_t *slot) {
+    video_input_ctx_t *ctx = slot->owner;
+    
+    av_packet_unref(slot->av_packet);
+    
+    pthread_mutex_lock(&ctx->pool_lock);
+    if (ctx->pool_count < ctx->max_pooled_packets) {
+        slot->next = ctx->pool;
+        ctx->pool = slot;
+        ctx->pool_count++;
+        slot = NULL;
+    }
+    pthread_mutex_unlock(&ctx->pool_lock);
+    
+    if (slot) {
+        av_packet_free(&slot->av_packet);
+        free(slot);
+    }
+}
+
 /**
  * Open video file and initialize demuxer
  */
@@ -55,11 +463,16 @@ int video_input_open(video_input_ctx_t *ctx, const char *filename) {
         ctx->initialized = 1;
     }
     
-    /* Open input file */
+    /* Open input file (through the mapping if requested and possible) */
+    if (ctx->mmap_input) {
+        open_mapped(ctx, filename);
+    }
+    
     ret = avformat_open_input(&ctx->format_ctx, filename, NULL, NULL);
     if (ret < 0) {
         fprintf(stderr, "Failed to open input file '%s': %s\n", 
                 filename, av_err2str(ret));
+        close_mapped(ctx);  /* format_ctx is already freed on failure */
         return VIDEO_INPUT_ERROR;
     }
     
@@ -70,7 +483,7 @@ int video_input_open(video_input_ctx_t *ctx, const char *filename) {
         return VIDEO_INPUT_ERROR;
     }
     
-    /* Find H.264 video stream */
+    /* Find the video stream */
     ctx->video_stream_index = av_find_best_stream(
         ctx->format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
     
@@ -82,10 +495,10 @@ int video_input_open(video_input_ctx_t *ctx, const char *filename) {
     /* Get codec parameters */
     ctx->codec_params = ctx->format_ctx->streams[ctx->video_stream_index]->codecpar;
     
-    /* Verify it's H.264 */
-    if (ctx->codec_params->codec_id != AV_CODEC_ID_H264) {
-        fprintf(stderr, "Video stream is not H.264 (codec_id: %d)\n", 
-                ctx->codec_params->codec_id);
+    /* Codec choice (hardware or software) is up to hw_decoder_configure */
+    if (!avcodec_find_decoder(ctx->codec_params->codec_id)) {
+        fprintf(stderr, "No decoder for video codec %s\n",
+                avcodec_get_name(ctx->codec_params->codec_id));
         return VIDEO_INPUT_ERROR;
     }
     
@@ -95,9 +508,16 @@ int video_input_open(video_input_ctx_t *ctx, const char *filename) {
                       video_stream->start_time : 0;
     
     printf("Video input opened successfully:\n");
-    printf("  Codec: H.264\n");
+    printf("  Codec: %s\n", avcodec_get_name(ctx->codec_params->codec_id));
     printf("  Resolution: %dx%d\n", ctx->codec_params->width, ctx->codec_params->height);
     printf("  Profile: %d, Level: %d\n", ctx->codec_params->profile, ctx->codec_params->level);
+    if (ctx->map) {
+        printf("  Input: memory-mapped (%zu MB)\n", ctx->map_size / (1024 * 1024));
+    }
+    
+    /* Keep the page cache ahead of av_read_frame() */
+    ctx->demux_pos = avio_tell(ctx->format_ctx->pb);
+    start_readahead(ctx, filename);
     
     return VIDEO_INPUT_OK;
 }
@@ -113,6 +533,7 @@ int video_input_get_stream_info(video_input_ctx_t *ctx, video_stream_info_t *inf
     AVStream *stream = ctx->format_ctx->streams[ctx->video_stream_index];
     
     /* Basic parameters */
+    info->codec_id = ctx->codec_params->codec_id;
     info->width = ctx->codec_params->width;
     info->height = ctx->codec_params->height;
     info->profile = ctx->codec_params->profile;
@@ -126,7 +547,7 @@ int video_input_get_stream_info(video_input_ctx_t *ctx, video_stream_info_t *inf
     info->fps_num = fps.num;
     info->fps_den = fps.den;
     
-    /* Extradata (SPS/PPS for H.264) */
+    /* Extradata (parameter sets) */
     if (ctx->codec_params->extradata_size > 0) {
         info->extradata_size = ctx->codec_params->extradata_size;
         info->extradata = malloc(info->extradata_size);
@@ -146,6 +567,7 @@ int video_input_get_stream_info(video_input_ctx_t *ctx, video_stream_info_t *inf
     } else {
         info->duration_us = -1;  /* Unknown duration */
     }
+    info->start_us = av_rescale_q(ctx->start_time, stream->time_base, AV_TIME_BASE_Q);
     
     return VIDEO_INPUT_OK;
 }
@@ -158,18 +580,19 @@ int video_input_read_packet(video_input_ctx_t *ctx, frame_packet_t *packet) {
         return VIDEO_INPUT_ERROR;
     }
     
-    /* Allocate AVPacket (will be freed in video_input_free_packet) */
-    AVPacket *av_packet = av_packet_alloc();
-    if (!av_packet) {
+    /* Recycled AVPacket (returned to the pool in video_input_free_packet) */
+    packet_slot_t *slot = packet_slot_get(ctx);
+    if (!slot) {
         fprintf(stderr, "Failed to allocate AVPacket\n");
         return VIDEO_INPUT_ERROR;
     }
+    AVPacket *av_packet = slot->av_packet;
     
     int ret;
     while (1) {
         ret = av_read_frame(ctx->format_ctx, av_packet);
         if (ret < 0) {
-            av_packet_free(&av_packet);
+            packet_slot_put(slot);
             if (ret == AVERROR_EOF) {
                 return VIDEO_INPUT_EOF;
             }
@@ -190,7 +613,10 @@ int video_input_read_packet(video_input_ctx_t *ctx, frame_packet_t *packet) {
     packet->data = av_packet->data;
     packet->size = av_packet->size;
     packet->keyframe = (av_packet->flags & AV_PKT_FLAG_KEY) ? 1 : 0;
-    packet->private_data = av_packet;  /* Store for later cleanup */
+    packet->private_data = slot;  /* Store for later cleanup */
+    
+    update_demux_pos(ctx, av_packet->pos >= 0 ? av_packet->pos + av_packet->size
+                                              : avio_tell(ctx->format_ctx->pb));
     
     /* Convert timestamps to microseconds */
     AVStream *stream = ctx->format_ctx->streams[ctx->video_stream_index];
@@ -199,6 +625,7 @@ int video_input_read_packet(video_input_ctx_t *ctx, frame_packet_t *packet) {
     } else {
         packet->pts = AV_NOPTS_VALUE;
     }
+    ctx->last_pts = packet->pts;
     
     if (av_packet->dts != AV_NOPTS_VALUE) {
         packet->dts = av_rescale_q(av_packet->dts, stream->time_base, AV_TIME_BASE_Q);
@@ -206,6 +633,13 @@ int video_input_read_packet(video_input_ctx_t *ctx, frame_packet_t *packet) {
         packet->dts = AV_NOPTS_VALUE;
     }
     
+    /* The index holds DTS; this maps its keyframes onto the PTS seeks ask for */
+    if (!ctx->key_delay_known && packet->keyframe &&
+        packet->pts != AV_NOPTS_VALUE && packet->dts != AV_NOPTS_VALUE) {
+        ctx->key_delay_us = packet->pts - packet->dts;
+        ctx->key_delay_known = 1;
+    }
+    
     return VIDEO_INPUT_OK;
 }
 
@@ -217,23 +651,108 @@ void video_input_free_packet(frame_packet_t *packet) {
         return;
     }
     
-    AVPacket *av_packet = (AVPacket *)packet->private_data;
-    av_packet_free(&av_packet);
+    packet_slot_put((packet_slot_t *)packet->private_data);
     
     /* Clear packet structure */
     memset(packet, 0, sizeof(frame_packet_t));
 }
 
+/**
+ * Copy the demuxer's keyframe entries into a compact sorted table
+ *
+ * The mov demuxer has already expanded stss/stco/stsc/stsz into one index
+ * entry per sample at open time; keeping just the sync samples makes the
+ * per-seek lookup a binary search over a few hundred entries.
+ */
+static void build_keyframe_index(video_input_ctx_t *ctx) {
+    AVStream *stream = ctx->format_ctx->streams[ctx->video_stream_index];
+    int entries = avformat_index_get_entries_count(stream);
+    
+    ctx->keyframes_built = 1;
+    if (entries <= 0) {
+        printf("⚠ No keyframe index in container - seeking by timestamp\n");
+        return;
+    }
+    
+    ctx->keyframes = malloc(entries * sizeof(keyframe_entry_t));
+    if (!ctx->keyframes) {
+        fprintf(stderr, "Failed to allocate keyframe index\n");
+        return;
+    }
+    
+    for (int i = 0; i < entries; i++) {
+        const AVIndexEntry *entry = avformat_index_get_entry(stream, i);
+        if (!entry || !(entry->flags & AVINDEX_KEYFRAME)) {
+            continue;
+        }
+        
+        keyframe_entry_t *kf = &ctx->keyframes[ctx->keyframe_count++];
+        kf->timestamp = entry->timestamp;
+        kf->dts_us = av_rescale_q(entry->timestamp, stream->time_base, AV_TIME_BASE_Q);
+        kf->pos = entry->pos;
+    }
+    
+    printf("✓ Keyframe index: %d keyframes in %d samples\n", ctx->keyframe_count, entries);
+}
+
+/**
+ * Pick the keyframe to land on for a target (both decode timestamps)
+ */
+static const keyframe_entry_t *find_keyframe(video_input_ctx_t *ctx, int64_t dts_us,
+                                             video_seek_mode_t mode) {
+    int lo = 0, hi = ctx->keyframe_count - 1;
+    
+    /* Last keyframe at or before the target (the first one if none is) */
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (ctx->keyframes[mid].dts_us <= dts_us) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    
+    if (mode == VIDEO_SEEK_KEYFRAME && lo + 1 < ctx->keyframe_count &&
+        ctx->keyframes[lo + 1].dts_us - dts_us < dts_us - ctx->keyframes[lo].dts_us) {
+        lo++;
+    }
+    
+    return &ctx->keyframes[lo];
+}
+
 /**
  * Seek to specific timestamp
  */
 int video_input_seek(video_input_ctx_t *ctx, int64_t timestamp_us) {
+    return video_input_seek_to(ctx, timestamp_us, VIDEO_SEEK_ACCURATE, NULL);
+}
+
+/**
+ * Seek through the keyframe index
+ */
+int video_input_seek_to(video_input_ctx_t *ctx, int64_t timestamp_us,
+                        video_seek_mode_t mode, int64_t *keyframe_us) {
     if (!ctx || ctx->video_stream_index < 0) {
         return VIDEO_INPUT_ERROR;
     }
     
+    if (!ctx->keyframes_built) {
+        build_keyframe_index(ctx);
+    }
+    
     AVStream *stream = ctx->format_ctx->streams[ctx->video_stream_index];
-    int64_t seek_target = av_rescale_q(timestamp_us, AV_TIME_BASE_Q, stream->time_base);
+    const keyframe_entry_t *kf = NULL;
+    int64_t kf_pts_us = timestamp_us;
+    int64_t seek_target;
+    
+    if (ctx->keyframe_count > 0) {
+        /* The target is a PTS; the index is in DTS, keyframes sit key_delay_us earlier */
+        kf = find_keyframe(ctx, timestamp_us - ctx->key_delay_us, mode);
+        kf_pts_us = kf->dts_us + ctx->key_delay_us;
+        seek_target = kf->timestamp;
+    } else {
+        seek_target = av_rescale_q(timestamp_us, AV_TIME_BASE_Q, stream->time_base);
+    }
     
     int ret = av_seek_frame(ctx->format_ctx, ctx->video_stream_index, 
                            seek_target, AVSEEK_FLAG_BACKWARD);
@@ -242,9 +761,42 @@ int video_input_seek(video_input_ctx_t *ctx, int64_t timestamp_us) {
         return VIDEO_INPUT_ERROR;
     }
     
+    /* Restart read-ahead from the new position; the index already knows it */
+    update_demux_pos(ctx, kf && kf->pos >= 0 ? kf->pos : avio_tell(ctx->format_ctx->pb));
+    
+    ctx->last_pts = kf ? kf_pts_us : AV_NOPTS_VALUE;
+    if (keyframe_us) {
+        *keyframe_us = kf_pts_us;
+    }
+    
     return VIDEO_INPUT_OK;
 }
 
+/**
+ * Get chapter start times from the container
+ */
+int video_input_get_chapters(video_input_ctx_t *ctx, int64_t *starts_us, int max_chapters) {
+    if (!ctx || !ctx->format_ctx || !starts_us || max_chapters < 0) {
+        return VIDEO_INPUT_ERROR;
+    }
+    
+    int count = 0;
+    for (unsigned int i = 0; i < ctx->format_ctx->nb_chapters && count < max_chapters; i++) {
+        const AVChapter *chapter = ctx->format_ctx->chapters[i];
+        int64_t start_us = av_rescale_q(chapter->start, chapter->time_base, AV_TIME_BASE_Q);
+        
+        /* Keep the list sorted; containers normally store chapters in order */
+        int j = count++;
+        while (j > 0 && starts_us[j - 1] > start_us) {
+            starts_us[j] = starts_us[j - 1];
+            j--;
+        }
+        starts_us[j] = start_us;
+    }
+    
+    return count;
+}
+
 /**
  * Get current playback position
  */
@@ -253,7 +805,11 @@ int64_t video_input_get_position(video_input_ctx_t *ctx) {
         return -1;
     }
     
-    /* This is approximate - would need packet-level tracking for accuracy */
+    if (ctx->last_pts != AV_NOPTS_VALUE) {
+        return ctx->last_pts;
+    }
+    
+    /* Nothing read yet (or no timestamps): estimate from the byte position */
     AVStream *stream = ctx->format_ctx->streams[ctx->video_stream_index];
     int64_t pos = avio_tell(ctx->format_ctx->pb);
     
@@ -278,9 +834,25 @@ void video_input_destroy(video_input_ctx_t *ctx) {
         return;
     }
     
+    stop_readahead(ctx);
+    
     if (ctx->format_ctx) {
         avformat_close_input(&ctx->format_ctx);
     }
+    close_mapped(ctx);
+    
+    free(ctx->keyframes);
+    
+    /* Drain the packet free-list */
+    while (ctx->pool) {
+        packet_slot_t *slot = ctx->pool;
+        ctx->pool = slot->next;
+        av_packet_free(&slot->av_packet);
+        free(slot);
+    }
     
+    pthread_cond_destroy(&ctx->readahead_cond);
+    pthread_mutex_destroy(&ctx->readahead_lock);
+    pthread_mutex_destroy(&ctx->pool_lock);
     free(ctx);
 }
\ No newline at end of file
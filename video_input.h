@@ -1,11 +1,13 @@
 /*
- * Video Input Module - libavformat MP4 demuxing and H.264 packet extraction
+ * Video Input Module - libavformat MP4 demuxing and H.264/HEVC packet extraction
  * 
  * This module handles:
  * - MP4 container demuxing
- * - H.264 stream parsing
+ * - H.264 / HEVC stream parsing
  * - Packet extraction for hardware decoder
  * - Stream metadata and timing information
+ * - Keyframe-index seeking for chapter jumps and scrubbing
+ * - Optional memory-mapped input for local files
  */
 
 #ifndef VIDEO_INPUT_H
@@ -26,17 +28,31 @@ typedef struct video_input_ctx video_input_ctx_t;
 
 /* Video stream information */
 typedef struct {
+    enum AVCodecID codec_id;  /* Compressed format (H.264, HEVC, ...) */
     int width;
     int height;
     int fps_num;
     int fps_den;
     int profile;
     int level;
-    uint8_t *extradata;
+    uint8_t *extradata;       /* Codec setup: SPS/PPS (H.264), VPS/SPS/PPS (HEVC) */
     int extradata_size;
     int64_t duration_us;  /* Duration in microseconds */
+    int64_t start_us;     /* First timestamp, in frame_packet_t pts units */
 } video_stream_info_t;
 
+/* Seek modes */
+typedef enum {
+    VIDEO_SEEK_ACCURATE,      /* Keyframe at or before the target; caller decodes up to it */
+    VIDEO_SEEK_KEYFRAME       /* Nearest keyframe on either side (scrubbing) */
+} video_seek_mode_t;
+
+/* Read-ahead / packet pool configuration */
+typedef struct {
+    size_t readahead_bytes;   /* Page-cache window kept ahead of the demuxer (0 = off) */
+    int max_pooled_packets;   /* Recycled AVPackets kept on the free-list */
+} video_input_prefetch_config_t;
+
 /* Frame packet structure for zero-copy operation */
 typedef struct {
     uint8_t *data;
@@ -44,7 +60,7 @@ typedef struct {
     int64_t pts;          /* Presentation timestamp */
     int64_t dts;          /* Decode timestamp */
     int keyframe;         /* 1 if keyframe, 0 otherwise */
-    void *private_data;   /* Internal AVPacket reference */
+    void *private_data;   /* Internal pooled AVPacket reference */
 } frame_packet_t;
 
 /* API Functions */
@@ -63,6 +79,28 @@ video_input_ctx_t *video_input_create(void);
  */
 int video_input_open(video_input_ctx_t *ctx, const char *filename);
 
+/**
+ * Set read-ahead and packet pool configuration (optional, defaults are used otherwise)
+ * 
+ * May be called before or after video_input_open(); a running read-ahead
+ * thread picks up the new window on its next pass.
+ * @param ctx Video input context
+ * @param config Prefetch configuration
+ * @return 0 on success, negative on error
+ */
+int video_input_set_prefetch(video_input_ctx_t *ctx, const video_input_prefetch_config_t *config);
+
+/**
+ * Read local files through a memory mapping instead of read() (default off)
+ * 
+ * Must be called before video_input_open(). Inputs that cannot be mapped
+ * (URLs, pipes, files larger than the address space) are opened normally.
+ * @param ctx Video input context
+ * @param enable 1 to map regular files, 0 for libavformat's file protocol
+ * @return 0 on success, negative on error
+ */
+int video_input_set_mmap(video_input_ctx_t *ctx, int enable);
+
 /**
  * Get video stream information
  * @param ctx Video input context
@@ -81,22 +119,53 @@ int video_input_read_packet(video_input_ctx_t *ctx, frame_packet_t *packet);
 
 /**
  * Free packet resources
+ * 
+ * The AVPacket goes back to its context's free-list, so every packet must
+ * be freed before video_input_destroy(). Safe to call from any thread.
  * @param packet Packet to free
  */
 void video_input_free_packet(frame_packet_t *packet);
 
 /**
- * Seek to specific timestamp
+ * Seek to specific timestamp (same as VIDEO_SEEK_ACCURATE)
  * @param ctx Video input context
  * @param timestamp_us Timestamp in microseconds
  * @return 0 on success, negative on error
  */
 int video_input_seek(video_input_ctx_t *ctx, int64_t timestamp_us);
 
+/**
+ * Seek through the keyframe index
+ * 
+ * The index comes from the container's sample tables (stss/stco in MP4)
+ * and is built on the first call; the demuxer is then repositioned on the
+ * chosen keyframe without re-opening the file. Containers without an index
+ * fall back to a plain backward seek. Decoders holding frames from before
+ * the seek must be flushed by the caller. In VIDEO_SEEK_ACCURATE mode the
+ * frames decoded before timestamp_us are the caller's to discard.
+ * @param ctx Video input context
+ * @param timestamp_us Target, in frame_packet_t pts units (see start_us)
+ * @param mode Seek mode
+ * @param keyframe_us Output: presentation time of the keyframe the next packet
+ *                    starts at (may be NULL)
+ * @return 0 on success, negative on error
+ */
+int video_input_seek_to(video_input_ctx_t *ctx, int64_t timestamp_us,
+                        video_seek_mode_t mode, int64_t *keyframe_us);
+
+/**
+ * Get chapter start times from the container
+ * @param ctx Video input context
+ * @param starts_us Output: chapter starts in frame_packet_t pts units, ascending
+ * @param max_chapters Capacity of starts_us
+ * @return Number of chapters stored (0 if the file has none), negative on error
+ */
+int video_input_get_chapters(video_input_ctx_t *ctx, int64_t *starts_us, int max_chapters);
+
 /**
  * Get current playback position
  * @param ctx Video input context
- * @return Current position in microseconds, negative on error
+ * @return Timestamp of the last packet read in microseconds, negative on error
  */
 int64_t video_input_get_position(video_input_ctx_t *ctx);
 
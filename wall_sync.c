@@ -0,0 +1,347 @@
+/*
+ * Wall Sync Implementation - UDP Multicast Clock Distribution
+ *
+ * The master sends a small packet every WALL_SYNC_INTERVAL_MS carrying the
+ * media position of the frame it just put on screen, the vblank that flip
+ * landed on and the time of sending, both in its own CLOCK_MONOTONIC. A
+ * follower stamps each packet on arrival; receive time minus send time is
+ * the clock offset plus the network delay. Queuing only ever adds delay, so
+ * the minimum over the last WALL_SYNC_WINDOW samples is taken as the
+ * offset: on a LAN it lands within a few hundred microseconds, far inside
+ * one refresh period.
+ *
+ * Receiving runs on its own thread so the stamp is taken when the packet
+ * arrives, not when the render thread next gets round to it.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "wall_sync.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <endian.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* Packet identification */
+#define WALL_SYNC_MAGIC           0x504b5753u  /* "PKWS" */
+#define WALL_SYNC_VERSION         2
+
+/* Master publish period */
+#define WALL_SYNC_INTERVAL_MS     100
+/* Offset samples the minimum is taken over (~3 s at the publish period) */
+#define WALL_SYNC_WINDOW          32
+/* An offset this far from the estimate means the master restarted */
+#define WALL_SYNC_RESET_US        1000000
+
+/* On-the-wire clock packet (big-endian) */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t epoch;
+    uint32_t sequence;
+    int32_t item_index;
+    uint32_t loop;
+    int64_t pts_us;           /* Media position */
+    uint64_t vblank_us;       /* Master CLOCK_MONOTONIC */
+    uint64_t send_us;         /* Master CLOCK_MONOTONIC at sendto() */
+} wall_sync_packet_t;
+
+/* Internal wall sync context */
+struct wall_sync {
+    wall_sync_role_t role;
+    int sock;
+    struct sockaddr_in group_addr;
+    
+    /* Master */
+    uint32_t sequence;
+    uint64_t last_publish_us;
+    
+    /* Follower: receive thread and offset estimate (thread-private) */
+    pthread_t thread;
+    int thread_started;
+    int stop_fd;
+    int64_t offsets[WALL_SYNC_WINDOW];
+    int offset_count;
+    int offset_next;
+    
+    /* Follower: latest translated clock (under lock) */
+    pthread_mutex_t lock;
+    wall_sync_clock_t clock;
+    unsigned int clock_serial;
+    unsigned int clock_taken;
+};
+
+/**
+ * Current CLOCK_MONOTONIC time
+ */
+static uint64_t sync_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/**
+ * Create wall sync context
+ */
+wall_sync_t *wall_sync_create(void) {
+    wall_sync_t *ctx = calloc(1, sizeof(wall_sync_t));
+    if (!ctx) {
+        fprintf(stderr, "Failed to allocate wall sync context\n");
+        return NULL;
+    }
+    
+    ctx->sock = -1;
+    ctx->stop_fd = -1;
+    pthread_mutex_init(&ctx->lock, NULL);
+    return ctx;
+}
+
+/**
+ * Add one offset sample and return the current estimate (window minimum)
+ */
+static int64_t update_offset(wall_sync_t *ctx, int64_t sample) {
+    int64_t estimate = ctx->offsets[0];
+    
+    for (int i = 1; i < ctx->offset_count; i++) {
+        if (ctx->offsets[i] < estimate) {
+            estimate = ctx->offsets[i];
+        }
+    }
+    
+    /* Master restarted (new monotonic base) or the network path changed */
+    if (ctx->offset_count > 0 &&
+        (sample < estimate - WALL_SYNC_RESET_US || sample > estimate + WALL_SYNC_RESET_US)) {
+        printf("⚠ Wall sync: master clock jumped, re-estimating offset\n");
+        ctx->offset_count = 0;
+        ctx->offset_next = 0;
+    }
+    
+    ctx->offsets[ctx->offset_next] = sample;
+    ctx->offset_next = (ctx->offset_next + 1) % WALL_SYNC_WINDOW;
+    if (ctx->offset_count < WALL_SYNC_WINDOW) {
+        ctx->offset_count++;
+    }
+    
+    estimate = ctx->offsets[0];
+    for (int i = 1; i < ctx->offset_count; i++) {
+        if (ctx->offsets[i] < estimate) {
+            estimate = ctx->offsets[i];
+        }
+    }
+    return estimate;
+}
+
+/**
+ * Receive thread: stamp each packet on arrival and publish the translated clock
+ */
+static void *receive_thread_main(void *arg) {
+    wall_sync_t *ctx = arg;
+    wall_sync_packet_t packet;
+    int have_master = 0;
+    
+    for (;;) {
+        struct pollfd fds[2] = {
+            { .fd = ctx->sock, .events = POLLIN },
+            { .fd = ctx->stop_fd, .events = POLLIN },
+        };
+        
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Wall sync poll failed: %s\n", strerror(errno));
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+        
+        ssize_t len = recv(ctx->sock, &packet, sizeof(packet), MSG_DONTWAIT);
+        uint64_t recv_us = sync_now_us();
+        if (len != (ssize_t)sizeof(packet) || be32toh(packet.magic) != WALL_SYNC_MAGIC ||
+            be16toh(packet.version) != WALL_SYNC_VERSION) {
+            continue;  /* Short read, EAGAIN or someone else's traffic on the group */
+        }
+        
+        int64_t offset = update_offset(ctx, (int64_t)(recv_us - be64toh(packet.send_us)));
+        if (!have_master) {
+            printf("✓ Wall sync: following master clock\n");
+            have_master = 1;
+        }
+        
+        pthread_mutex_lock(&ctx->lock);
+        ctx->clock.epoch = be32toh(packet.epoch);
+        ctx->clock.item_index = (int32_t)be32toh((uint32_t)packet.item_index);
+        ctx->clock.loop = be32toh(packet.loop);
+        ctx->clock.pts_us = (int64_t)be64toh((uint64_t)packet.pts_us);
+        ctx->clock.vblank_us = (uint64_t)((int64_t)be64toh(packet.vblank_us) + offset);
+        ctx->clock_serial++;
+        pthread_mutex_unlock(&ctx->lock);
+    }
+    
+    return NULL;
+}
+
+/**
+ * Open the multicast socket
+ */
+int wall_sync_configure(wall_sync_t *ctx, wall_sync_role_t role, const char *group, int port) {
+    if (!ctx || ctx->sock >= 0) {
+        return WALL_SYNC_ERROR;
+    }
+    
+    ctx->role = role;
+    memset(&ctx->group_addr, 0, sizeof(ctx->group_addr));
+    ctx->group_addr.sin_family = AF_INET;
+    ctx->group_addr.sin_port = htons((uint16_t)(port > 0 ? port : WALL_SYNC_DEFAULT_PORT));
+    if (inet_pton(AF_INET, group ? group : WALL_SYNC_DEFAULT_GROUP,
+                  &ctx->group_addr.sin_addr) != 1 ||
+        !IN_MULTICAST(ntohl(ctx->group_addr.sin_addr.s_addr))) {
+        fprintf(stderr, "Wall sync: '%s' is not an IPv4 multicast group\n",
+                group ? group : WALL_SYNC_DEFAULT_GROUP);
+        return WALL_SYNC_ERROR;
+    }
+    
+    ctx->sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (ctx->sock < 0) {
+        fprintf(stderr, "Wall sync: socket failed: %s\n", strerror(errno));
+        return WALL_SYNC_ERROR;
+    }
+    
+    if (role == WALL_SYNC_MASTER) {
+        /* One subnet; loop back so a follower on this host hears us too */
+        unsigned char ttl = 1, loop = 1;
+        setsockopt(ctx->sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        setsockopt(ctx->sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    } else {
+        struct sockaddr_in bind_addr = ctx->group_addr;
+        struct ip_mreq mreq;
+        int reuse = 1;
+        
+        /* Several followers may share a host (testing); bind the group itself */
+        setsockopt(ctx->sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (bind(ctx->sock, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) < 0) {
+            fprintf(stderr, "Wall sync: bind failed: %s\n", strerror(errno));
+            close(ctx->sock);
+            ctx->sock = -1;
+            return WALL_SYNC_ERROR;
+        }
+        
+        mreq.imr_multiaddr = ctx->group_addr.sin_addr;
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (setsockopt(ctx->sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            fprintf(stderr, "Wall sync: joining group failed: %s\n", strerror(errno));
+            close(ctx->sock);
+            ctx->sock = -1;
+            return WALL_SYNC_ERROR;
+        }
+        
+        ctx->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (ctx->stop_fd < 0 ||
+            pthread_create(&ctx->thread, NULL, receive_thread_main, ctx) != 0) {
+            fprintf(stderr, "Wall sync: failed to start receive thread\n");
+            return WALL_SYNC_ERROR;
+        }
+        ctx->thread_started = 1;
+    }
+    
+    printf("Wall sync: %s on %s:%d\n", role == WALL_SYNC_MASTER ? "clock master" : "follower",
+           inet_ntoa(ctx->group_addr.sin_addr), ntohs(ctx->group_addr.sin_port));
+    return WALL_SYNC_OK;
+}
+
+/**
+ * Publish the master's clock
+ */
+int wall_sync_publish(wall_sync_t *ctx, const wall_sync_clock_t *clock) {
+    wall_sync_packet_t packet;
+    uint64_t now_us = sync_now_us();
+    
+    if (!ctx || !clock || ctx->role != WALL_SYNC_MASTER || ctx->sock < 0) {
+        return WALL_SYNC_ERROR;
+    }
+    
+    if (now_us - ctx->last_publish_us < WALL_SYNC_INTERVAL_MS * 1000ULL) {
+        return WALL_SYNC_OK;
+    }
+    
+    memset(&packet, 0, sizeof(packet));
+    packet.magic = htobe32(WALL_SYNC_MAGIC);
+    packet.version = htobe16(WALL_SYNC_VERSION);
+    packet.epoch = htobe32(clock->epoch);
+    packet.sequence = htobe32(ctx->sequence++);
+    packet.item_index = (int32_t)htobe32((uint32_t)clock->item_index);
+    packet.loop = htobe32(clock->loop);
+    packet.pts_us = (int64_t)htobe64((uint64_t)clock->pts_us);
+    packet.vblank_us = htobe64(clock->vblank_us);
+    packet.send_us = htobe64(sync_now_us());
+    
+    /* A full socket buffer just loses this sample; the next one follows shortly */
+    if (sendto(ctx->sock, &packet, sizeof(packet), MSG_DONTWAIT,
+               (struct sockaddr *)&ctx->group_addr, sizeof(ctx->group_addr)) < 0 &&
+        errno != EAGAIN && errno != EWOULDBLOCK) {
+        return WALL_SYNC_ERROR;
+    }
+    
+    ctx->last_publish_us = now_us;
+    return WALL_SYNC_OK;
+}
+
+/**
+ * Latest master clock, in the follower's CLOCK_MONOTONIC
+ */
+int wall_sync_get_clock(wall_sync_t *ctx, wall_sync_clock_t *clock) {
+    int ret = WALL_SYNC_EAGAIN;
+    
+    if (!ctx || !clock || ctx->role != WALL_SYNC_FOLLOWER) {
+        return WALL_SYNC_ERROR;
+    }
+    
+    pthread_mutex_lock(&ctx->lock);
+    if (ctx->clock_serial != ctx->clock_taken) {
+        *clock = ctx->clock;
+        ctx->clock_taken = ctx->clock_serial;
+        ret = WALL_SYNC_OK;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    
+    return ret;
+}
+
+/**
+ * Stop the receive thread and free the context
+ */
+void wall_sync_destroy(wall_sync_t *ctx) {
+    if (!ctx) {
+        return;
+    }
+    
+    if (ctx->thread_started) {
+        uint64_t one = 1;
+        if (write(ctx->stop_fd, &one, sizeof(one)) < 0) {
+            /* Can't fail for an eventfd below its maximum */
+        }
+        pthread_join(ctx->thread, NULL);
+    }
+    
+    if (ctx->stop_fd >= 0) {
+        close(ctx->stop_fd);
+    }
+    if (ctx->sock >= 0) {
+        close(ctx->sock);
+    }
+    
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx);
+}
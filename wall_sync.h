@@ -0,0 +1,89 @@
+/*
+ * Wall Sync Module - Frame-Locked Playback Across Players (Video Walls)
+ *
+ * This module handles:
+ * - A clock master broadcasting (media timestamp, vblank time) over UDP multicast
+ * - Followers receiving it on a background thread and estimating the
+ *   master's CLOCK_MONOTONIC offset (minimum one-way delay over a window)
+ * - Handing followers the master's clock translated into their own time,
+ *   for frame_scheduler_slew() and the one-time seek alignment
+ *
+ * No pixels cross the network: every node decodes the same file and shows
+ * its own crop of it. Samples carry the media position (playlist index and
+ * the file's own timestamps), not a node's output timeline: that one runs
+ * on across seeks, loops and items and differs between nodes started apart.
+ */
+
+#ifndef WALL_SYNC_H
+#define WALL_SYNC_H
+
+#include <stdint.h>
+
+/* Return codes */
+#define WALL_SYNC_OK               0
+#define WALL_SYNC_ERROR           -1
+#define WALL_SYNC_EAGAIN          -2
+
+/* Default multicast group (administratively scoped) and port */
+#define WALL_SYNC_DEFAULT_GROUP   "239.255.80.1"
+#define WALL_SYNC_DEFAULT_PORT    5860
+
+/* Forward declarations */
+typedef struct wall_sync wall_sync_t;
+
+/* Node role */
+typedef enum {
+    WALL_SYNC_MASTER,         /* Plays freely and publishes its clock */
+    WALL_SYNC_FOLLOWER        /* Locks its presentation to the master's clock */
+} wall_sync_role_t;
+
+/* One clock sample: media position pts_us is on screen from vblank_us on */
+typedef struct {
+    unsigned int epoch;       /* Master's position generation (changes on every seek and item) */
+    int item_index;           /* Playlist index being shown */
+    unsigned int loop;        /* Times the master's playlist has wrapped (--loop) */
+    int64_t pts_us;           /* Input timestamp of the frame, in the file's own timebase */
+    uint64_t vblank_us;       /* CLOCK_MONOTONIC; followers get it in their own clock */
+} wall_sync_clock_t;
+
+/* API Functions */
+
+/**
+ * Create wall sync context
+ * @return New context or NULL on error
+ */
+wall_sync_t *wall_sync_create(void);
+
+/**
+ * Open the multicast socket (followers also start the receive thread)
+ * @param ctx Wall sync context
+ * @param role Master or follower
+ * @param group IPv4 multicast group (NULL = WALL_SYNC_DEFAULT_GROUP)
+ * @param port UDP port (0 = WALL_SYNC_DEFAULT_PORT)
+ * @return 0 on success, negative on error
+ */
+int wall_sync_configure(wall_sync_t *ctx, wall_sync_role_t role, const char *group, int port);
+
+/**
+ * Publish the master's clock (rate-limited internally; never blocks)
+ * @param ctx Wall sync context (master)
+ * @param clock Frame just shown and the vblank its flip landed on
+ * @return 0 if sent or skipped by the rate limit, negative on error
+ */
+int wall_sync_publish(wall_sync_t *ctx, const wall_sync_clock_t *clock);
+
+/**
+ * Latest master clock, in the follower's CLOCK_MONOTONIC (never blocks)
+ * @param ctx Wall sync context (follower)
+ * @param clock Output clock sample
+ * @return 0 if a sample arrived since the last call, WALL_SYNC_EAGAIN if not
+ */
+int wall_sync_get_clock(wall_sync_t *ctx, wall_sync_clock_t *clock);
+
+/**
+ * Stop the receive thread, close the socket and free the context
+ * @param ctx Wall sync context
+ */
+void wall_sync_destroy(wall_sync_t *ctx);
+
+#endif /* WALL_SYNC_H */
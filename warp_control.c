@@ -3,6 +3,25 @@
  * 
  * Implements real-time keystone/perspective correction with keyboard controls.
  * Generates transformation matrices for GPU renderer.
+ *
+ * Corners and keystone are turned into a true 4-point homography packed into
+ * the 4x4 matrix (the projective terms go in the w row), so the GPU's
+ * perspective divide does the correction with perspective-correct texture
+ * interpolation and no per-pixel work. An optional mesh handles curved
+ * surfaces; it is baked into the renderer's VBO only when it changes.
+ *
+ * Edge blends are baked the same way: ramps and masks go into a small RGB
+ * lookup in output space, rebuilt only when the parameters change, which
+ * the fragment shader multiplies in. Ramps are smoothstep in linear light,
+ * so two overlapping projectors sum to constant brightness, then encoded
+ * with the display gamma.
+ *
+ * Editing and rendering run on different threads. Input actions change the
+ * parameters on the input thread, which also solves the homography and bakes
+ * the blend; warp_control_publish() then fills the back half of a two-slot
+ * buffer and bumps a generation counter. The render thread takes the newest
+ * slot once per frame without locking. The editor only refills a slot once
+ * the render thread has moved past it, and keeps coalescing edits until then.
  */
 
 #include "warp_control.h"
@@ -10,83 +29,69 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
-#include <termios.h>
-#include <unistd.h>
-#include <fcntl.h>
 #include <errno.h>
 
 /* Default configuration */
 #define DEFAULT_STEP_SIZE      0.01f
+/* Smallest projective w allowed at a corner (rejects folded/flipped quads) */
+#define HOMOGRAPHY_MIN_W       1e-3
 #define DEFAULT_CONFIG_FILE    "warp_config.txt"
 
-/* Key codes */
-#define KEY_ARROW_UP    65
-#define KEY_ARROW_DOWN  66
-#define KEY_ARROW_RIGHT 67
-#define KEY_ARROW_LEFT  68
+/* Edge blend lookup resolution (bilinear-filtered up to the output) */
+#define BLEND_LOOKUP_WIDTH     256
+#define BLEND_LOOKUP_HEIGHT    144
+#define DEFAULT_BLEND_GAMMA    2.2f
+
+/* Corner positions are kept this close to the output */
+#define CORNER_LIMIT           2.0f
+
+/* One published warp state; mesh and blend data only when they changed */
+typedef struct {
+    warp_params_t params;
+    warp_matrix_t matrix;
+    int mesh_changed;
+    warp_mesh_t mesh;
+    float *mesh_points;       /* Room for the largest mesh, allocated on first use */
+    int blend_changed;
+    warp_blend_t blend;
+    uint8_t *blend_texels;
+} warp_slot_t;
 
 /* Internal warp control context */
 struct warp_control_ctx {
     gpu_renderer_ctx_t *renderer_ctx;
+    int matrix_head;          /* Heads the render thread applies to (-1 = all) */
+    int blend_head;
     warp_params_t params;
     warp_input_config_t input_config;
     
     /* Input state */
-    int stdin_configured;
-    struct termios original_termios;
     int selected_corner;      /* 0-3 for corners, -1 for global */
     int fine_mode;
     
+    /* Curved-surface mesh ((cols+1) x (rows+1) points, NULL when unused) */
+    int mesh_cols, mesh_rows;
+    float *mesh_points;
+    int mesh_dirty;
+    
+    /* Edge blend / masks and their baked lookup (NULL until first baked) */
+    warp_blend_params_t blend;
+    uint8_t *blend_texels;
+    int blend_baked;          /* blend_texels match the parameters */
+    int blend_dirty;          /* Renderer still has the previous lookup */
+    
     /* State tracking */
     int matrix_dirty;
     warp_matrix_t current_matrix;
-};
-
-/**
- * Setup non-blocking keyboard input
- */
-static int setup_keyboard_input(warp_control_ctx_t *ctx) {
-    struct termios new_termios;
-    
-    /* Get current terminal settings */
-    if (tcgetattr(STDIN_FILENO, &ctx->original_termios) < 0) {
-        fprintf(stderr, "Failed to get terminal attributes: %s\n", strerror(errno));
-        return WARP_CONTROL_ERROR;
-    }
-    
-    /* Configure for non-blocking, non-canonical input */
-    new_termios = ctx->original_termios;
-    new_termios.c_lflag &= ~(ICANON | ECHO);
-    new_termios.c_cc[VMIN] = 0;   /* Non-blocking */
-    new_termios.c_cc[VTIME] = 0;
-    
-    if (tcsetattr(STDIN_FILENO, TCSANOW, &new_termios) < 0) {
-        fprintf(stderr, "Failed to set terminal attributes: %s\n", strerror(errno));
-        return WARP_CONTROL_ERROR;
-    }
     
-    /* Set stdin to non-blocking */
-    int flags = fcntl(STDIN_FILENO, F_GETFL);
-    fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
-    
-    ctx->stdin_configured = 1;
-    return WARP_CONTROL_OK;
-}
+    /* Editor -> render thread: generation N lives in slots[N & 1] */
+    warp_slot_t slots[2];
+    unsigned int published;   /* Newest generation (written by the editor) */
+    unsigned int consumed;    /* Generation the render thread is done with */
+    unsigned int taken;       /* Render thread: generation it holds */
+};
 
-/**
- * Restore terminal settings
- */
-static void restore_keyboard_input(warp_control_ctx_t *ctx) {
-    if (ctx->stdin_configured) {
-        tcsetattr(STDIN_FILENO, TCSANOW, &ctx->original_termios);
-        
-        /* Restore blocking mode */
-        int flags = fcntl(STDIN_FILENO, F_GETFL);
-        fcntl(STDIN_FILENO, F_SETFL, flags & ~O_NONBLOCK);
-        
-        ctx->stdin_configured = 0;
-    }
-}
+static const char *corner_names[4] = { "Top-left", "Top-right", "Bottom-left", "Bottom-right" };
 
 /**
  * Initialize default warp parameters
@@ -125,6 +130,7 @@ warp_control_ctx_t *warp_control_create(void) {
     
     /* Initialize default parameters */
     init_default_params(&ctx->params);
+    ctx->blend.gamma = DEFAULT_BLEND_GAMMA;
     
     /* Default input configuration */
     ctx->input_config.step_size = DEFAULT_STEP_SIZE;
@@ -135,6 +141,8 @@ warp_control_ctx_t *warp_control_create(void) {
     ctx->matrix_dirty = 1;
     
     ctx->selected_corner = 0;  /* Start with top-left corner */
+    ctx->matrix_head = -1;
+    ctx->blend_head = -1;
     
     return ctx;
 }
@@ -149,11 +157,10 @@ int warp_control_configure(warp_control_ctx_t *ctx, gpu_renderer_ctx_t *renderer
     
     ctx->renderer_ctx = renderer_ctx;
     
-    /* Setup keyboard input */
-    int ret = setup_keyboard_input(ctx);
+    /* The loaded configuration is the first snapshot (no editor thread yet) */
+    int ret = warp_control_publish(ctx);
     if (ret < 0) {
-        fprintf(stderr, "Warning: Could not setup keyboard input for warp control\n");
-        /* Continue without interactive control */
+        return ret;
     }
     
     printf("Warp control configured\n");
@@ -170,39 +177,121 @@ int warp_control_configure(warp_control_ctx_t *ctx, gpu_renderer_ctx_t *renderer
 }
 
 /**
- * Generate transformation matrix from corner points
+ * Choose the heads the matrix and blend are applied to
  */
-int warp_control_corners_to_matrix(const corner_points_t *corners, warp_matrix_t *matrix) {
-    if (!corners || !matrix) {
+int warp_control_set_heads(warp_control_ctx_t *ctx, int matrix_head, int blend_head) {
+    if (!ctx || matrix_head >= DISPLAY_OUTPUT_MAX_HEADS || blend_head >= DISPLAY_OUTPUT_MAX_HEADS) {
         return WARP_CONTROL_ERROR;
     }
     
-    /* This is a simplified perspective transformation.
-     * For a complete implementation, you would solve the perspective
-     * transformation equation to map unit square to arbitrary quadrilateral.
-     */
+    ctx->matrix_head = matrix_head < 0 ? -1 : matrix_head;
+    ctx->blend_head = blend_head < 0 ? -1 : blend_head;
+    return WARP_CONTROL_OK;
+}
+
+/**
+ * Solve the 3x3 homography mapping four source points onto four destinations
+ */
+int warp_control_solve_homography(const float src[4][2], const float dst[4][2], float h[9]) {
+    double a[8][9];
+    
+    if (!src || !dst || !h) {
+        return WARP_CONTROL_ERROR;
+    }
     
-    /* For now, create a simple transformation matrix */
-    matrix_identity(matrix->matrix);
+    /* Two equations per point pair, h[8] fixed at 1 */
+    for (int i = 0; i < 4; i++) {
+        double x = src[i][0], y = src[i][1];
+        double u = dst[i][0], v = dst[i][1];
+        double *r0 = a[i * 2];
+        double *r1 = a[i * 2 + 1];
+        
+        r0[0] = x;   r0[1] = y;   r0[2] = 1.0;
+        r0[3] = 0.0; r0[4] = 0.0; r0[5] = 0.0;
+        r0[6] = -x * u; r0[7] = -y * u; r0[8] = u;
+        
+        r1[0] = 0.0; r1[1] = 0.0; r1[2] = 0.0;
+        r1[3] = x;   r1[4] = y;   r1[5] = 1.0;
+        r1[6] = -x * v; r1[7] = -y * v; r1[8] = v;
+    }
     
-    /* Apply basic scaling and translation based on corner positions */
-    float center_x = (corners->top_left[0] + corners->top_right[0] + 
-                     corners->bottom_left[0] + corners->bottom_right[0]) * 0.25f;
-    float center_y = (corners->top_left[1] + corners->top_right[1] +
-                     corners->bottom_left[1] + corners->bottom_right[1]) * 0.25f;
+    /* Gaussian elimination with partial pivoting */
+    for (int col = 0; col < 8; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < 8; row++) {
+            if (fabs(a[row][col]) > fabs(a[pivot][col])) {
+                pivot = row;
+            }
+        }
+        
+        /* Three collinear points: no unique solution */
+        if (fabs(a[pivot][col]) < 1e-9) {
+            return WARP_CONTROL_ERROR;
+        }
+        
+        if (pivot != col) {
+            for (int k = 0; k < 9; k++) {
+                double tmp = a[col][k];
+                a[col][k] = a[pivot][k];
+                a[pivot][k] = tmp;
+            }
+        }
+        
+        for (int row = 0; row < 8; row++) {
+            if (row == col) continue;
+            double f = a[row][col] / a[col][col];
+            for (int k = col; k < 9; k++) {
+                a[row][k] -= f * a[col][k];
+            }
+        }
+    }
     
-    /* Simple keystone approximation */
-    float h_keystone __attribute__((unused)) = (corners->top_right[0] - corners->top_left[0]) -
-                      (corners->bottom_right[0] - corners->bottom_left[0]);
-    float v_keystone __attribute__((unused)) = (corners->bottom_left[1] - corners->top_left[1]) -
-                      (corners->bottom_right[1] - corners->top_right[1]);
+    for (int i = 0; i < 8; i++) {
+        h[i] = (float)(a[i][8] / a[i][i]);
+    }
+    h[8] = 1.0f;
     
-    /* Apply transformation (simplified) */
-    matrix->matrix[12] = center_x;  /* Translation X */
-    matrix->matrix[13] = center_y;  /* Translation Y */
+    return WARP_CONTROL_OK;
+}
+
+/**
+ * Generate transformation matrix from corner points
+ */
+int warp_control_corners_to_matrix(const corner_points_t *corners, warp_matrix_t *matrix) {
+    float h[9];
     
-    /* Note: Full perspective transformation requires solving a system of equations
-     * This is a placeholder for the complete implementation */
+    if (!corners || !matrix) {
+        return WARP_CONTROL_ERROR;
+    }
+    
+    /* Quad vertices in clip space (y up) -> requested corners (y down) */
+    const float src[4][2] = {
+        { -1.0f,  1.0f }, {  1.0f,  1.0f },
+        { -1.0f, -1.0f }, {  1.0f, -1.0f }
+    };
+    const float dst[4][2] = {
+        { corners->top_left[0],     -corners->top_left[1] },
+        { corners->top_right[0],    -corners->top_right[1] },
+        { corners->bottom_left[0],  -corners->bottom_left[1] },
+        { corners->bottom_right[0], -corners->bottom_right[1] }
+    };
+    
+    if (warp_control_solve_homography(src, dst, h) < 0) {
+        return WARP_CONTROL_ERROR;
+    }
+    
+    /* w must stay positive across the quad, or it folds through infinity */
+    for (int i = 0; i < 4; i++) {
+        if (h[6] * src[i][0] + h[7] * src[i][1] + h[8] < HOMOGRAPHY_MIN_W) {
+            return WARP_CONTROL_ERROR;
+        }
+    }
+    
+    /* Column-major: x' = row 0, y' = row 1, w' = row 3; z passes through */
+    matrix_identity(matrix->matrix);
+    matrix->matrix[0]  = h[0];  matrix->matrix[4]  = h[1];  matrix->matrix[12] = h[2];
+    matrix->matrix[1]  = h[3];  matrix->matrix[5]  = h[4];  matrix->matrix[13] = h[5];
+    matrix->matrix[3]  = h[6];  matrix->matrix[7]  = h[7];  matrix->matrix[15] = h[8];
     
     matrix->dirty = 1;
     return WARP_CONTROL_OK;
@@ -212,186 +301,455 @@ int warp_control_corners_to_matrix(const corner_points_t *corners, warp_matrix_t
  * Generate keystone transformation matrix
  */
 int warp_control_keystone_to_matrix(float h_keystone, float v_keystone, warp_matrix_t *matrix) {
+    corner_points_t corners;
+    
     if (!matrix) {
         return WARP_CONTROL_ERROR;
     }
     
-    matrix_identity(matrix->matrix);
+    h_keystone = fmaxf(-1.0f, fminf(1.0f, h_keystone));
+    v_keystone = fmaxf(-1.0f, fminf(1.0f, v_keystone));
     
-    /* Apply keystone transformation */
-    /* This creates a simple perspective effect */
-    matrix->matrix[1] = h_keystone * 0.5f;  /* Horizontal skew */
-    matrix->matrix[4] = v_keystone * 0.5f;  /* Vertical skew */
+    /* Vertical keystone narrows the top (>0) or bottom (<0) edge,
+     * horizontal keystone shortens the left (>0) or right (<0) edge */
+    float top = v_keystone > 0.0f ? v_keystone * 0.5f : 0.0f;
+    float bottom = v_keystone < 0.0f ? -v_keystone * 0.5f : 0.0f;
+    float left = h_keystone > 0.0f ? h_keystone * 0.5f : 0.0f;
+    float right = h_keystone < 0.0f ? -h_keystone * 0.5f : 0.0f;
     
-    matrix->dirty = 1;
+    corners.top_left[0] = -1.0f + top;      corners.top_left[1] = -1.0f + left;
+    corners.top_right[0] = 1.0f - top;      corners.top_right[1] = -1.0f + right;
+    corners.bottom_left[0] = -1.0f + bottom; corners.bottom_left[1] = 1.0f - left;
+    corners.bottom_right[0] = 1.0f - bottom; corners.bottom_right[1] = 1.0f - right;
+    
+    return warp_control_corners_to_matrix(&corners, matrix);
+}
+
+/**
+ * Set curved-surface mesh
+ */
+int warp_control_set_mesh(warp_control_ctx_t *ctx, int cols, int rows, const float *points) {
+    if (!ctx) {
+        return WARP_CONTROL_ERROR;
+    }
+    
+    if (cols <= 0 || rows <= 0) {
+        free(ctx->mesh_points);
+        ctx->mesh_points = NULL;
+        ctx->mesh_cols = ctx->mesh_rows = 0;
+        ctx->mesh_dirty = 1;
+        ctx->matrix_dirty = 1;
+        return WARP_CONTROL_OK;
+    }
+    
+    if (cols > WARP_MESH_MAX_CELLS || rows > WARP_MESH_MAX_CELLS) {
+        fprintf(stderr, "Warp mesh too large: %dx%d (max %d)\n", cols, rows, WARP_MESH_MAX_CELLS);
+        return WARP_CONTROL_ERROR;
+    }
+    
+    size_t count = (size_t)(cols + 1) * (size_t)(rows + 1);
+    float *mesh = malloc(count * 2 * sizeof(float));
+    if (!mesh) {
+        return WARP_CONTROL_ERROR;
+    }
+    
+    /* No points given: start from a regular grid */
+    for (int row = 0; row <= rows; row++) {
+        for (int col = 0; col <= cols; col++) {
+            size_t i = (size_t)row * (size_t)(cols + 1) + (size_t)col;
+            if (points) {
+                mesh[i * 2 + 0] = points[i * 2 + 0];
+                mesh[i * 2 + 1] = points[i * 2 + 1];
+            } else {
+                mesh[i * 2 + 0] = -1.0f + 2.0f * (float)col / (float)cols;
+                mesh[i * 2 + 1] = -1.0f + 2.0f * (float)row / (float)rows;
+            }
+        }
+    }
+    
+    free(ctx->mesh_points);
+    ctx->mesh_points = mesh;
+    ctx->mesh_cols = cols;
+    ctx->mesh_rows = rows;
+    ctx->mesh_dirty = 1;
+    ctx->matrix_dirty = 1;
     return WARP_CONTROL_OK;
 }
 
 /**
- * Update transformation matrix and apply to renderer
+ * Set edge blend ramps and masks
  */
-static int update_matrix(warp_control_ctx_t *ctx) {
-    int ret;
+int warp_control_set_blend(warp_control_ctx_t *ctx, const warp_blend_params_t *params) {
+    if (!ctx || !params || params->mask_count < 0 || params->mask_count > WARP_BLEND_MAX_MASKS ||
+        params->left < 0.0f || params->right < 0.0f || params->top < 0.0f || params->bottom < 0.0f ||
+        params->left + params->right > 1.0f || params->top + params->bottom > 1.0f ||
+        params->gamma <= 0.0f) {
+        return WARP_CONTROL_ERROR;
+    }
     
-    if (!ctx->matrix_dirty) {
+    ctx->blend = *params;
+    ctx->blend_baked = 0;
+    ctx->blend_dirty = 1;
+    ctx->matrix_dirty = 1;
+    return WARP_CONTROL_OK;
+}
+
+/**
+ * Get edge blend ramps and masks
+ */
+int warp_control_get_blend(warp_control_ctx_t *ctx, warp_blend_params_t *params) {
+    if (!ctx || !params) {
+        return WARP_CONTROL_ERROR;
+    }
+    
+    *params = ctx->blend;
+    return WARP_CONTROL_OK;
+}
+
+/**
+ * Linear-light weight across one ramp (0 at the outer edge, 1 inside)
+ */
+static float blend_ramp(float distance, float width) {
+    if (width <= 0.0f || distance >= width) {
+        return 1.0f;
+    }
+    
+    float t = distance > 0.0f ? distance / width : 0.0f;
+    return t * t * (3.0f - 2.0f * t);  /* w(t) + w(1 - t) = 1 across an overlap */
+}
+
+/**
+ * Bake the blend parameters into the renderer's lookup
+ */
+int warp_control_generate_blend(warp_control_ctx_t *ctx, warp_blend_t *blend) {
+    const warp_blend_params_t *p;
+    
+    if (!ctx || !blend) {
+        return WARP_CONTROL_ERROR;
+    }
+    p = &ctx->blend;
+    
+    blend->width = BLEND_LOOKUP_WIDTH;
+    blend->height = BLEND_LOOKUP_HEIGHT;
+    blend->texels = NULL;
+    
+    /* Nothing blended or masked: the renderer keeps its blend-free shaders */
+    if (p->left <= 0.0f && p->right <= 0.0f && p->top <= 0.0f && p->bottom <= 0.0f &&
+        p->mask_count == 0) {
         return WARP_CONTROL_OK;
     }
     
+    if (!ctx->blend_texels) {
+        ctx->blend_texels = malloc(BLEND_LOOKUP_WIDTH * BLEND_LOOKUP_HEIGHT * 3);
+        if (!ctx->blend_texels) {
+            return WARP_CONTROL_ERROR;
+        }
+        ctx->blend_baked = 0;
+    }
+    
+    if (!ctx->blend_baked) {
+        for (int y = 0; y < BLEND_LOOKUP_HEIGHT; y++) {
+            float v = ((float)y + 0.5f) / (float)BLEND_LOOKUP_HEIGHT;
+            float row_weight = blend_ramp(v, p->top) * blend_ramp(1.0f - v, p->bottom);
+            
+            for (int x = 0; x < BLEND_LOOKUP_WIDTH; x++) {
+                float u = ((float)x + 0.5f) / (float)BLEND_LOOKUP_WIDTH;
+                float weight = row_weight * blend_ramp(u, p->left) * blend_ramp(1.0f - u, p->right);
+                
+                for (int m = 0; m < p->mask_count; m++) {
+                    const float *r = p->masks[m];
+                    if (u >= r[0] && u < r[0] + r[2] && v >= r[1] && v < r[1] + r[3]) {
+                        weight = 0.0f;
+                        break;
+                    }
+                }
+                
+                /* Light adds linearly; the display applies its gamma to what we output */
+                uint8_t level = (uint8_t)(powf(weight, 1.0f / p->gamma) * 255.0f + 0.5f);
+                uint8_t *texel = &ctx->blend_texels[(y * BLEND_LOOKUP_WIDTH + x) * 3];
+                texel[0] = texel[1] = texel[2] = level;
+            }
+        }
+        ctx->blend_baked = 1;
+    }
+    
+    blend->texels = ctx->blend_texels;
+    return WARP_CONTROL_OK;
+}
+
+/**
+ * Generate transformation matrix from current parameters
+ */
+int warp_control_generate_matrix(warp_control_ctx_t *ctx, warp_matrix_t *matrix) {
+    if (!ctx || !matrix) {
+        return WARP_CONTROL_ERROR;
+    }
+    
     /* Generate matrix based on current mode */
     switch (ctx->params.mode) {
         case WARP_MODE_CORNERS:
-            ret = warp_control_corners_to_matrix(&ctx->params.corners, &ctx->current_matrix);
-            break;
-            
+        case WARP_MODE_PERSPECTIVE:
+            return warp_control_corners_to_matrix(&ctx->params.corners, matrix);
+        
         case WARP_MODE_KEYSTONE:
-            ret = warp_control_keystone_to_matrix(ctx->params.keystone_h, 
-                                                 ctx->params.keystone_v, 
-                                                 &ctx->current_matrix);
-            break;
-            
+            return warp_control_keystone_to_matrix(ctx->params.keystone_h, 
+                                                  ctx->params.keystone_v, 
+                                                  matrix);
+        
         default:
             /* Use identity matrix for unsupported modes */
-            matrix_identity(ctx->current_matrix.matrix);
-            ret = WARP_CONTROL_OK;
-            break;
+            matrix_identity(matrix->matrix);
+            matrix->dirty = 1;
+            return WARP_CONTROL_OK;
     }
+}
+
+/**
+ * Fill a slot from the current parameters (editor thread)
+ */
+static int fill_slot(warp_control_ctx_t *ctx, warp_slot_t *slot) {
+    warp_matrix_t matrix;
+    
+    if (warp_control_generate_matrix(ctx, &matrix) < 0) {
+        /* Collinear or folded corners: keep showing the last valid warp */
+        printf("⚠ Degenerate warp corners, keeping previous warp\n");
+    } else {
+        ctx->current_matrix = matrix;
+    }
+    slot->params = ctx->params;
+    slot->matrix = ctx->current_matrix;
     
-    if (ret < 0) {
-        return ret;
+    /* The mesh VBO is rebuilt only when the mesh itself changed */
+    slot->mesh_changed = ctx->mesh_dirty;
+    if (ctx->mesh_dirty) {
+        size_t count = (size_t)(ctx->mesh_cols + 1) * (size_t)(ctx->mesh_rows + 1);
+        
+        if (!slot->mesh_points) {
+            slot->mesh_points = malloc((size_t)(WARP_MESH_MAX_CELLS + 1) *
+                                       (WARP_MESH_MAX_CELLS + 1) * 2 * sizeof(float));
+            if (!slot->mesh_points) {
+                return WARP_CONTROL_ERROR;
+            }
+        }
+        slot->mesh.cols = ctx->mesh_cols;
+        slot->mesh.rows = ctx->mesh_rows;
+        slot->mesh.points = ctx->mesh_points ? slot->mesh_points : NULL;
+        if (ctx->mesh_points) {
+            memcpy(slot->mesh_points, ctx->mesh_points, count * 2 * sizeof(float));
+        }
+    }
+    
+    /* Likewise the blend lookup (baked here, off the render thread) */
+    slot->blend_changed = ctx->blend_dirty;
+    if (ctx->blend_dirty) {
+        size_t size = BLEND_LOOKUP_WIDTH * BLEND_LOOKUP_HEIGHT * 3;
+        
+        if (warp_control_generate_blend(ctx, &slot->blend) < 0) {
+            return WARP_CONTROL_ERROR;
+        }
+        if (slot->blend.texels) {
+            if (!slot->blend_texels) {
+                slot->blend_texels = malloc(size);
+                if (!slot->blend_texels) {
+                    return WARP_CONTROL_ERROR;
+                }
+            }
+            memcpy(slot->blend_texels, slot->blend.texels, size);
+            slot->blend.texels = slot->blend_texels;
+        }
+    }
+    
+    return WARP_CONTROL_OK;
+}
+
+/**
+ * Publish the current parameters to the render thread
+ */
+int warp_control_publish(warp_control_ctx_t *ctx) {
+    unsigned int generation;
+    
+    if (!ctx) {
+        return WARP_CONTROL_ERROR;
+    }
+    
+    if (!ctx->matrix_dirty) {
+        return WARP_CONTROL_OK;
     }
     
-    /* Apply to renderer */
-    ret = gpu_renderer_set_warp_matrix(ctx->renderer_ctx, &ctx->current_matrix);
+    /* The back slot may still be the one the render thread holds */
+    generation = __atomic_load_n(&ctx->published, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&ctx->consumed, __ATOMIC_ACQUIRE) != generation) {
+        return WARP_CONTROL_EAGAIN;
+    }
+    
+    int ret = fill_slot(ctx, &ctx->slots[(generation + 1) & 1]);
     if (ret < 0) {
         return ret;
     }
     
+    ctx->mesh_dirty = 0;
+    ctx->blend_dirty = 0;
     ctx->matrix_dirty = 0;
+    __atomic_store_n(&ctx->published, generation + 1, __ATOMIC_RELEASE);
     return WARP_CONTROL_OK;
 }
 
 /**
- * Process keyboard input
+ * Take the newest published warp (render thread)
  */
-static int process_keyboard(warp_control_ctx_t *ctx) {
-    char ch;
-    int updated = 0;
-    float step = ctx->fine_mode ? ctx->input_config.step_size * 0.1f : ctx->input_config.step_size;
-    
-    while (read(STDIN_FILENO, &ch, 1) > 0) {
-        switch (ch) {
-            case 27: /* ESC key or escape sequence start */
-                /* Check if it's a single ESC key or start of arrow key sequence */
-                if (read(STDIN_FILENO, &ch, 1) <= 0) {
-                    return WARP_CONTROL_ERROR;  /* Single ESC - quit */
-                } else if (ch == '[') {
-                    /* Arrow key sequence */
-                    if (read(STDIN_FILENO, &ch, 1) > 0) {
-                        float *corner_x = NULL, *corner_y = NULL;
-                        
-                        /* Get pointer to selected corner coordinates */
-                        switch (ctx->selected_corner) {
-                            case 0: corner_x = &ctx->params.corners.top_left[0]; 
-                                   corner_y = &ctx->params.corners.top_left[1]; break;
-                            case 1: corner_x = &ctx->params.corners.top_right[0];
-                                   corner_y = &ctx->params.corners.top_right[1]; break;
-                            case 2: corner_x = &ctx->params.corners.bottom_left[0];
-                                   corner_y = &ctx->params.corners.bottom_left[1]; break;
-                            case 3: corner_x = &ctx->params.corners.bottom_right[0];
-                                   corner_y = &ctx->params.corners.bottom_right[1]; break;
-                        }
-                        
-                        if (corner_x && corner_y) {
-                            switch (ch) {
-                                case KEY_ARROW_UP:    *corner_y -= step; break;
-                                case KEY_ARROW_DOWN:  *corner_y += step; break;
-                                case KEY_ARROW_LEFT:  *corner_x -= step; break;
-                                case KEY_ARROW_RIGHT: *corner_x += step; break;
-                            }
-                            
-                            /* Clamp to valid range */
-                            *corner_x = fmaxf(-2.0f, fminf(2.0f, *corner_x));
-                            *corner_y = fmaxf(-2.0f, fminf(2.0f, *corner_y));
-                            
-                            ctx->matrix_dirty = 1;
-                            updated = 1;
-                        }
-                    }
-                } else {
-                    return WARP_CONTROL_ERROR;  /* ESC + other key - quit */
-                }
-                break;
-                
-            case 'q':
-            case 'Q':
-                return WARP_CONTROL_ERROR;  /* Signal to quit */
-                
-            case 'r':
-            case 'R':
-                init_default_params(&ctx->params);
-                ctx->matrix_dirty = 1;
-                updated = 1;
-                printf("Warp reset to identity\n");
-                break;
-                
-            case 'f':
-            case 'F':
-                ctx->fine_mode = !ctx->fine_mode;
-                printf("Fine adjustment mode: %s\n", ctx->fine_mode ? "ON" : "OFF");
-                break;
-                
-            case '1': ctx->selected_corner = 0; printf("Selected: Top-left corner\n"); break;
-            case '2': ctx->selected_corner = 1; printf("Selected: Top-right corner\n"); break;
-            case '3': ctx->selected_corner = 2; printf("Selected: Bottom-left corner\n"); break;
-            case '4': ctx->selected_corner = 3; printf("Selected: Bottom-right corner\n"); break;
-                
-            case 's':
-            case 'S':
-                warp_control_save_config(ctx, ctx->input_config.config_file);
-                printf("Configuration saved\n");
-                break;
-                
-            case 'l':
-            case 'L':
-                if (warp_control_load_config(ctx, ctx->input_config.config_file) == 0) {
-                    ctx->matrix_dirty = 1;
-                    updated = 1;
-                    printf("Configuration loaded\n");
-                } else {
-                    printf("Failed to load configuration\n");
+int warp_control_take_snapshot(warp_control_ctx_t *ctx, warp_snapshot_t *snapshot) {
+    const warp_slot_t *slot;
+    unsigned int generation;
+    
+    if (!ctx || !snapshot) {
+        return WARP_CONTROL_ERROR;
+    }
+    
+    /* Done with the previous slot: the editor may refill it */
+    __atomic_store_n(&ctx->consumed, ctx->taken, __ATOMIC_RELEASE);
+    
+    generation = __atomic_load_n(&ctx->published, __ATOMIC_ACQUIRE);
+    if (generation == ctx->taken) {
+        return WARP_CONTROL_OK;
+    }
+    
+    slot = &ctx->slots[generation & 1];
+    snapshot->params = slot->params;
+    snapshot->matrix = slot->matrix;
+    snapshot->mesh = slot->mesh_changed ? &slot->mesh : NULL;
+    snapshot->blend = slot->blend_changed ? &slot->blend : NULL;
+    ctx->taken = generation;
+    return WARP_CONTROL_UPDATED;
+}
+
+/**
+ * Corner coordinates by index (0-3, as selected with the 1-4 keys)
+ */
+static float *corner_point(corner_points_t *corners, int corner) {
+    switch (corner) {
+        case 0: return corners->top_left;
+        case 1: return corners->top_right;
+        case 2: return corners->bottom_left;
+        case 3: return corners->bottom_right;
+        default: return NULL;
+    }
+}
+
+/**
+ * Apply one input action
+ */
+int warp_control_apply_action(warp_control_ctx_t *ctx, const warp_action_t *action) {
+    float *corner;
+    float step;
+    
+    if (!ctx || !action) {
+        return WARP_CONTROL_ERROR;
+    }
+    
+    switch (action->type) {
+        case WARP_ACTION_NUDGE:
+        case WARP_ACTION_SET_CORNER:
+            if (action->type == WARP_ACTION_NUDGE) {
+                step = ctx->fine_mode ? ctx->input_config.step_size * 0.1f : ctx->input_config.step_size;
+                corner = corner_point(&ctx->params.corners, ctx->selected_corner);
+                corner[0] += action->x * step;
+                corner[1] += action->y * step;
+            } else {
+                corner = corner_point(&ctx->params.corners, action->corner);
+                if (!corner) {
+                    return WARP_CONTROL_ERROR;
                 }
-                break;
-        }
+                corner[0] = action->x;
+                corner[1] = action->y;
+            }
+            
+            /* Clamp to valid range */
+            corner[0] = fmaxf(-CORNER_LIMIT, fminf(CORNER_LIMIT, corner[0]));
+            corner[1] = fmaxf(-CORNER_LIMIT, fminf(CORNER_LIMIT, corner[1]));
+            ctx->matrix_dirty = 1;
+            return WARP_CONTROL_UPDATED;
+        
+        case WARP_ACTION_SELECT:
+            if (!corner_point(&ctx->params.corners, action->corner)) {
+                return WARP_CONTROL_ERROR;
+            }
+            ctx->selected_corner = action->corner;
+            printf("Selected: %s corner\n", corner_names[action->corner]);
+            return WARP_CONTROL_OK;
+        
+        case WARP_ACTION_RESET:
+            init_default_params(&ctx->params);
+            warp_control_set_mesh(ctx, 0, 0, NULL);
+            ctx->matrix_dirty = 1;
+            printf("Warp reset to identity\n");
+            return WARP_CONTROL_UPDATED;
+        
+        case WARP_ACTION_FINE:
+            ctx->fine_mode = !ctx->fine_mode;
+            printf("Fine adjustment mode: %s\n", ctx->fine_mode ? "ON" : "OFF");
+            return WARP_CONTROL_OK;
+        
+        case WARP_ACTION_SAVE:
+            if (warp_control_save_config(ctx, ctx->input_config.config_file) < 0) {
+                return WARP_CONTROL_ERROR;
+            }
+            printf("Configuration saved\n");
+            return WARP_CONTROL_OK;
+        
+        case WARP_ACTION_LOAD:
+            if (warp_control_load_config(ctx, ctx->input_config.config_file) < 0) {
+                printf("Failed to load configuration\n");
+                return WARP_CONTROL_ERROR;
+            }
+            printf("Configuration loaded\n");
+            return WARP_CONTROL_UPDATED;
     }
     
-    return updated ? WARP_CONTROL_UPDATED : WARP_CONTROL_OK;
+    return WARP_CONTROL_ERROR;
 }
 
 /**
- * Process input events
+ * Apply the newest published warp to the renderer (render thread, once per frame)
  */
 int warp_control_process_input(warp_control_ctx_t *ctx) {
+    warp_snapshot_t snapshot;
     int ret;
     
-    if (!ctx) {
+    if (!ctx || !ctx->renderer_ctx) {
         return WARP_CONTROL_ERROR;
     }
     
-    /* Process keyboard input if configured */
-    if (ctx->stdin_configured) {
-        ret = process_keyboard(ctx);
+    if (warp_control_take_snapshot(ctx, &snapshot) != WARP_CONTROL_UPDATED) {
+        return WARP_CONTROL_OK;
+    }
+    
+    ret = ctx->matrix_head < 0 ?
+          gpu_renderer_set_warp_matrix(ctx->renderer_ctx, &snapshot.matrix) :
+          gpu_renderer_set_head_warp_matrix(ctx->renderer_ctx, ctx->matrix_head, &snapshot.matrix);
+    if (ret < 0) {
+        return ret;
+    }
+    
+    if (snapshot.mesh) {
+        ret = gpu_renderer_set_warp_mesh(ctx->renderer_ctx, snapshot.mesh);
         if (ret < 0) {
             return ret;
         }
     }
     
-    /* Update matrix if parameters changed */
-    ret = update_matrix(ctx);
-    if (ret < 0) {
-        return ret;
+    if (snapshot.blend) {
+        ret = ctx->blend_head < 0 ?
+              gpu_renderer_set_blend(ctx->renderer_ctx, snapshot.blend) :
+              gpu_renderer_set_head_blend(ctx->renderer_ctx, ctx->blend_head, snapshot.blend);
+        if (ret < 0) {
+            return ret;
+        }
     }
     
-    return WARP_CONTROL_OK;
+    /* Uploaded: the editor can refill the slot without waiting for the next frame */
+    __atomic_store_n(&ctx->consumed, ctx->taken, __ATOMIC_RELEASE);
+    
+    return WARP_CONTROL_UPDATED;
 }
 
 /**
@@ -403,9 +761,10 @@ int warp_control_reset(warp_control_ctx_t *ctx) {
     }
     
     init_default_params(&ctx->params);
+    warp_control_set_mesh(ctx, 0, 0, NULL);
     ctx->matrix_dirty = 1;
     
-    return update_matrix(ctx);
+    return WARP_CONTROL_OK;
 }
 
 /**
@@ -433,6 +792,26 @@ int warp_control_save_config(warp_control_ctx_t *ctx, const char *filename) {
     fprintf(file, "keystone_h=%.6f\n", ctx->params.keystone_h);
     fprintf(file, "keystone_v=%.6f\n", ctx->params.keystone_v);
     
+    /* Mesh: size line, then one line per grid point (col,row,x,y) */
+    if (ctx->mesh_points) {
+        fprintf(file, "mesh=%d,%d\n", ctx->mesh_cols, ctx->mesh_rows);
+        for (int row = 0; row <= ctx->mesh_rows; row++) {
+            for (int col = 0; col <= ctx->mesh_cols; col++) {
+                const float *pt = &ctx->mesh_points[(row * (ctx->mesh_cols + 1) + col) * 2];
+                fprintf(file, "mesh_pt=%d,%d,%.6f,%.6f\n", col, row, pt[0], pt[1]);
+            }
+        }
+    }
+    
+    /* Edge blend: ramp widths left,right,top,bottom; one line per black mask */
+    fprintf(file, "blend=%.6f,%.6f,%.6f,%.6f\n", ctx->blend.left, ctx->blend.right,
+            ctx->blend.top, ctx->blend.bottom);
+    fprintf(file, "blend_gamma=%.3f\n", ctx->blend.gamma);
+    for (int m = 0; m < ctx->blend.mask_count; m++) {
+        const float *r = ctx->blend.masks[m];
+        fprintf(file, "mask=%.6f,%.6f,%.6f,%.6f\n", r[0], r[1], r[2], r[3]);
+    }
+    
     fclose(file);
     return WARP_CONTROL_OK;
 }
@@ -453,6 +832,9 @@ int warp_control_load_config(warp_control_ctx_t *ctx, const char *filename) {
         return WARP_CONTROL_ERROR;  /* File doesn't exist, not an error */
     }
     
+    /* The file describes the whole blend; masks don't accumulate across loads */
+    warp_blend_params_t blend = { .gamma = DEFAULT_BLEND_GAMMA };
+    
     while (fgets(line, sizeof(line), file)) {
         if (line[0] == '#' || line[0] == '\n') continue;
         
@@ -463,6 +845,34 @@ int warp_control_load_config(warp_control_ctx_t *ctx, const char *filename) {
         if (sscanf(line, "keystone_h=%f", &ctx->params.keystone_h) == 1) continue;
         if (sscanf(line, "keystone_v=%f", &ctx->params.keystone_v) == 1) continue;
         
+        int cols, rows, col, row;
+        float x, y;
+        if (sscanf(line, "mesh=%d,%d", &cols, &rows) == 2) {
+            warp_control_set_mesh(ctx, cols, rows, NULL);
+            continue;
+        }
+        if (sscanf(line, "mesh_pt=%d,%d,%f,%f", &col, &row, &x, &y) == 4) {
+            if (ctx->mesh_points && col >= 0 && col <= ctx->mesh_cols &&
+                row >= 0 && row <= ctx->mesh_rows) {
+                float *pt = &ctx->mesh_points[(row * (ctx->mesh_cols + 1) + col) * 2];
+                pt[0] = x;
+                pt[1] = y;
+            }
+            continue;
+        }
+        
+        float r[4];
+        if (sscanf(line, "blend=%f,%f,%f,%f", &blend.left, &blend.right, &blend.top, &blend.bottom) == 4) continue;
+        if (sscanf(line, "blend_gamma=%f", &blend.gamma) == 1) continue;
+        if (sscanf(line, "mask=%f,%f,%f,%f", &r[0], &r[1], &r[2], &r[3]) == 4) {
+            if (blend.mask_count < WARP_BLEND_MAX_MASKS) {
+                memcpy(blend.masks[blend.mask_count++], r, sizeof(r));
+            } else {
+                printf("⚠ More than %d masks in %s, extra ones ignored\n", WARP_BLEND_MAX_MASKS, filename);
+            }
+            continue;
+        }
+        
         int mode;
         if (sscanf(line, "mode=%d", &mode) == 1) {
             ctx->params.mode = (warp_mode_t)mode;
@@ -470,6 +880,10 @@ int warp_control_load_config(warp_control_ctx_t *ctx, const char *filename) {
     }
     
     fclose(file);
+    if (warp_control_set_blend(ctx, &blend) < 0) {
+        printf("⚠ Invalid edge blend in %s, ignored\n", filename);
+    }
+    ctx->matrix_dirty = 1;
     return WARP_CONTROL_OK;
 }
 
@@ -498,13 +912,16 @@ void warp_control_destroy(warp_control_ctx_t *ctx) {
         return;
     }
     
-    /* Restore terminal settings */
-    restore_keyboard_input(ctx);
-    
     /* Auto-save configuration if enabled */
     if (ctx->input_config.enable_auto_save) {
         warp_control_save_config(ctx, ctx->input_config.config_file);
     }
     
+    for (int i = 0; i < 2; i++) {
+        free(ctx->slots[i].mesh_points);
+        free(ctx->slots[i].blend_texels);
+    }
+    free(ctx->mesh_points);
+    free(ctx->blend_texels);
     free(ctx);
 }
\ No newline at end of file
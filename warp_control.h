@@ -4,8 +4,17 @@
  * This module handles:
  * - Interactive keystone/perspective correction
  * - Transformation matrix generation and updates
- * - Real-time parameter adjustment via keyboard input
+ * - Real-time parameter adjustment from input actions (keys, remotes, network)
+ * - Handing each adjusted warp to the render thread as a lock-free snapshot
  * - Corner-based and matrix-based warp controls
+ * - 4-point homography solving and NxM mesh warps for curved surfaces
+ * - Edge-blend ramps and black masks for overlapping projectors, baked
+ *   into one low-resolution lookup for the renderer
+ *
+ * Threads: one editing thread (the input thread once it runs) owns the
+ * parameters and calls everything except warp_control_take_snapshot() and
+ * warp_control_process_input(), which belong to the render thread. Until an
+ * editing thread starts, the render thread may call both sides.
  */
 
 #ifndef WARP_CONTROL_H
@@ -18,6 +27,7 @@
 #define WARP_CONTROL_OK          0
 #define WARP_CONTROL_ERROR      -1
 #define WARP_CONTROL_UPDATED     1
+#define WARP_CONTROL_EAGAIN     -2
 
 /* Forward declarations */
 typedef struct warp_control_ctx warp_control_ctx_t;
@@ -32,7 +42,7 @@ typedef enum {
 
 /* Corner points for perspective correction */
 typedef struct {
-    float top_left[2];        /* X, Y coordinates (-1.0 to 1.0) */
+    float top_left[2];        /* X, Y coordinates (-1.0 to 1.0, Y down) */
     float top_right[2];
     float bottom_left[2];
     float bottom_right[2];
@@ -49,6 +59,43 @@ typedef struct {
     float offset_x, offset_y; /* Position offset */
 } warp_params_t;
 
+/* Most black mask rectangles in one configuration */
+#define WARP_BLEND_MAX_MASKS     8
+
+/* Edge blending and masking, in output coordinates (0.0 to 1.0 from the top-left) */
+typedef struct {
+    float left, right;        /* Blend ramp widths at each edge (0 = no ramp) */
+    float top, bottom;
+    float gamma;              /* Display gamma the ramps are corrected for */
+    int mask_count;
+    float masks[WARP_BLEND_MAX_MASKS][4];  /* Black rectangles: x, y, width, height */
+} warp_blend_params_t;
+
+/* Adjustments an input source can make */
+typedef enum {
+    WARP_ACTION_NUDGE,        /* Move the selected corner by x, y steps (Y down) */
+    WARP_ACTION_SELECT,       /* Select corner `corner` (0-3) */
+    WARP_ACTION_SET_CORNER,   /* Put corner `corner` at x, y (-1.0 to 1.0, Y down) */
+    WARP_ACTION_RESET,        /* Back to identity, mesh removed */
+    WARP_ACTION_FINE,         /* Toggle fine (tenth-size) steps */
+    WARP_ACTION_SAVE,         /* Write the configuration file */
+    WARP_ACTION_LOAD          /* Re-read the configuration file */
+} warp_action_type_t;
+
+typedef struct {
+    warp_action_type_t type;
+    int corner;
+    float x, y;
+} warp_action_t;
+
+/* One published warp; mesh and blend are only set when they changed */
+typedef struct {
+    warp_params_t params;
+    warp_matrix_t matrix;
+    const warp_mesh_t *mesh;     /* NULL = unchanged */
+    const warp_blend_t *blend;   /* NULL = unchanged; NULL texels = blend removed */
+} warp_snapshot_t;
+
 /* Input configuration */
 typedef struct {
     float step_size;          /* Adjustment step size */
@@ -66,13 +113,22 @@ typedef struct {
 warp_control_ctx_t *warp_control_create(void);
 
 /**
- * Configure warp control with renderer
+ * Configure warp control with renderer (publishes the current parameters)
  * @param ctx Warp control context
  * @param renderer_ctx GPU renderer context
  * @return 0 on success, negative on error
  */
 int warp_control_configure(warp_control_ctx_t *ctx, gpu_renderer_ctx_t *renderer_ctx);
 
+/**
+ * Choose the heads warp_control_process_input() applies to
+ * @param ctx Warp control context
+ * @param matrix_head Head the matrix goes to (-1 = all heads)
+ * @param blend_head Head the edge blend goes to (-1 = all heads)
+ * @return 0 on success, negative on error
+ */
+int warp_control_set_heads(warp_control_ctx_t *ctx, int matrix_head, int blend_head);
+
 /**
  * Set input configuration
  * @param ctx Warp control context
@@ -82,9 +138,37 @@ int warp_control_configure(warp_control_ctx_t *ctx, gpu_renderer_ctx_t *renderer
 int warp_control_set_input_config(warp_control_ctx_t *ctx, const warp_input_config_t *config);
 
 /**
- * Process input events (non-blocking)
+ * Apply one input action (coalesce a burst, then warp_control_publish() once)
+ * @param ctx Warp control context
+ * @param action Action
+ * @return WARP_CONTROL_UPDATED if the warp changed, 0 if not, negative on error
+ */
+int warp_control_apply_action(warp_control_ctx_t *ctx, const warp_action_t *action);
+
+/**
+ * Publish the current parameters to the render thread (editing thread)
+ * 
+ * Solves the matrix and bakes a changed blend here, so the render thread
+ * only uploads. Nothing is done if nothing changed since the last publish.
+ * @param ctx Warp control context
+ * @return 0 on success, WARP_CONTROL_EAGAIN if the render thread has not
+ *         taken the previous snapshot yet (retry later), negative on error
+ */
+int warp_control_publish(warp_control_ctx_t *ctx);
+
+/**
+ * Take the newest published warp (render thread; never blocks)
+ * @param ctx Warp control context
+ * @param snapshot Output; mesh and blend stay valid until the next call
+ * @return WARP_CONTROL_UPDATED if there is a new one, 0 if not, negative on error
+ */
+int warp_control_take_snapshot(warp_control_ctx_t *ctx, warp_snapshot_t *snapshot);
+
+/**
+ * Apply the newest published warp to the configured renderer (render thread,
+ * once per frame; never blocks or reads input)
  * @param ctx Warp control context
- * @return WARP_CONTROL_UPDATED if parameters changed, 0 if no change, negative on error
+ * @return WARP_CONTROL_UPDATED if the renderer's warp changed, 0 if not, negative on error
  */
 int warp_control_process_input(warp_control_ctx_t *ctx);
 
@@ -113,7 +197,7 @@ int warp_control_get_params(warp_control_ctx_t *ctx, warp_params_t *params);
 int warp_control_set_params(warp_control_ctx_t *ctx, const warp_params_t *params);
 
 /**
- * Reset warp to identity (no transformation)
+ * Reset warp to identity (no transformation; publish to apply it)
  * @param ctx Warp control context
  * @return 0 on success, negative on error
  */
@@ -143,6 +227,31 @@ int warp_control_save_config(warp_control_ctx_t *ctx, const char *filename);
  */
 int warp_control_generate_matrix(warp_control_ctx_t *ctx, warp_matrix_t *matrix);
 
+/**
+ * Set edge blend ramps and masks
+ * @param ctx Warp control context
+ * @param params Blend parameters
+ * @return 0 on success, negative on error
+ */
+int warp_control_set_blend(warp_control_ctx_t *ctx, const warp_blend_params_t *params);
+
+/**
+ * Get edge blend ramps and masks
+ * @param ctx Warp control context
+ * @param params Output blend parameters
+ * @return 0 on success, negative on error
+ */
+int warp_control_get_blend(warp_control_ctx_t *ctx, warp_blend_params_t *params);
+
+/**
+ * Bake the blend parameters into the renderer's lookup (only when they changed)
+ * @param ctx Warp control context
+ * @param blend Output lookup; texels are NULL when nothing is blended or masked,
+ *              and stay valid until the blend parameters change
+ * @return 0 on success, negative on error
+ */
+int warp_control_generate_blend(warp_control_ctx_t *ctx, warp_blend_t *blend);
+
 /**
  * Apply corner-based perspective correction
  * @param ctx Warp control context
@@ -160,6 +269,17 @@ int warp_control_set_corners(warp_control_ctx_t *ctx, const corner_points_t *cor
  */
 int warp_control_set_keystone(warp_control_ctx_t *ctx, float horizontal, float vertical);
 
+/**
+ * Set curved-surface mesh, applied underneath the corner/keystone homography
+ * @param ctx Warp control context
+ * @param cols Mesh cells across (0 = remove mesh, max WARP_MESH_MAX_CELLS)
+ * @param rows Mesh cells down
+ * @param points (cols+1)*(rows+1) x,y pairs, row-major from top-left
+ *               (-1.0 to 1.0, Y down), or NULL for a regular grid
+ * @return 0 on success, negative on error
+ */
+int warp_control_set_mesh(warp_control_ctx_t *ctx, int cols, int rows, const float *points);
+
 /**
  * Get control help text
  * @return Help text string
@@ -182,6 +302,15 @@ void warp_control_destroy(warp_control_ctx_t *ctx);
  */
 int warp_control_corners_to_matrix(const corner_points_t *corners, warp_matrix_t *matrix);
 
+/**
+ * Solve the homography mapping four source points onto four destinations
+ * @param src Source points
+ * @param dst Destination points
+ * @param h Output 3x3 matrix (row-major, h[8] = 1)
+ * @return 0 on success, negative if three points are collinear
+ */
+int warp_control_solve_homography(const float src[4][2], const float dst[4][2], float h[9]);
+
 /**
  * Convert keystone parameters to transformation matrix
  * @param h_keystone Horizontal keystone